@@ -705,7 +705,7 @@ var format = {
          }, 
          "mesh" : {
             "_brief" : "Loads a mesh from an external file", 
-            "_desc"  : "Milton supports loading meshes in obj and ply formats. Each distinct mesh will have its own, internal acceleration data structure, and as such, when specifying a mesh in the scenefile, you may add hints to the acceleration data structure to customize its performance towards a particular mesh.", 
+            "_desc"  : "Milton supports loading meshes in obj and ply formats. Each distinct mesh file will have its own, internal acceleration data structure, and as such, when specifying a mesh in the scenefile, you may add hints to the acceleration data structure to customize its performance towards a particular mesh. Mesh elements which reference the same file (with the same normalize setting) automatically share a single copy of the mesh's geometry and acceleration data structure, each with their own transform and material, unless they specify their own spatialAccel hints.", 
             "_note"  : "Meshes are great candidates for <i>instancing</i>, where you load a 'master' mesh once, give it a name, and then have multiple, lightweight copies of that one master mesh called instances by referencing the master mesh's name. Any scene node may be instanced in Milton, but in practice, it is generally only useful (and tested..) to instance meshes because each instance would otherwise cost so much in terms of memory and speed during rendering.", 
             "_class" : "Mesh", 
             "_usage" : "usage/shape.js", 
@@ -1,6 +1,6 @@
 "spatialAccel" : {
    "_brief" : "Acceleration data structure for accelerating ray-object intersection queries and visibility tests that are prominent in many rendering algorithms", 
-   "_desc"  : "Available spatialAccel variants include:  %naive (no acceleration) and kdTree (default)", 
+   "_desc"  : "Available spatialAccel variants include:  %naive (no acceleration), kdTree (default), and bvh (bounding volume hierarchy).  A shapeSet containing mesh instances defaults to bvh, forming a two-level hierarchy in which rays descend directly from the top-level BVH into each instance's shared mesh kdTree", 
    "_class" : "SpatialAccel", 
    "_note"  : "'naive' spatialAccel corresponds to linear traversal through all primitives when calculating the closest positive intersection between a ray and a set of primitives", 
    "_info"  : { "type" : "string", "optional" : true, "default" : "kdTree" }
@@ -38,3 +38,23 @@
    "_brief" : "SAH empty cell bias factor", 
    "_info"  : { "type" : "real", "optional" : true, "default" : "0.9" }
 }, 
+"bvhMaxPrimitives" : {
+   "_brief" : "Maximum number of primitives stored in a single BVH leaf", 
+   "_info"  : { "type" : "uint", "optional" : true, "default" : "4" }
+}, 
+"bvhNoBins" : {
+   "_brief" : "Number of bins per axis used to approximate the SAH during BVH construction", 
+   "_info"  : { "type" : "uint", "optional" : true, "default" : "16" }
+}, 
+"bvhCostTraversal" : {
+   "_brief" : "SAH relative cost of traversing a BVH node", 
+   "_info"  : { "type" : "real", "optional" : true, "default" : "1" }
+}, 
+"bvhCostIntersect" : {
+   "_brief" : "SAH relative cost of intersecting a primitive", 
+   "_info"  : { "type" : "real", "optional" : true, "default" : "1" }
+}, 
+"bvhRefitThreshold" : {
+   "_brief" : "Maximum ratio of a refitted BVH's SAH cost to its cost when last built, beyond which animated geometry triggers a full rebuild", 
+   "_info"  : { "type" : "real", "optional" : true, "default" : "1.5" }
+}, 
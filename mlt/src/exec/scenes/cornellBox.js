@@ -19,6 +19,7 @@
       "renderer" : {
          /*"type" : "bidirectionalPathTracer", */
          /*"type" : "rayTracer", */
+         /*"type" : "mlt", "mltMode" : "pss", */ /* or "veach" */
          "type" : "preview", 
          "noRenderThreads" : 8, 
          "noDirectSamples" : 4, 
@@ -0,0 +1,63 @@
+/**<!-------------------------------------------------------------------->
+   @file   main.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Merges raw films written by independent renders of the same scene 
+   (eg. on different machines with different seeds, see FileRenderOutput's 
+   'rawFilm' option) into a single raw film, weighting each pixel by the 
+   reconstruction filter weights accumulated by each render (see RawFilm).
+   <!-------------------------------------------------------------------->**/
+
+#include <milton.h>
+#include <iostream>
+using namespace std;
+using namespace milton;
+
+void printUsage(char **argv) {
+   cerr << "usage: " << argv[0] << " <output-film> <input-film> "
+        << "[<input-film> ...]" << endl;
+   cerr << "   films may be 'exr' (if supported), 'pfm', or 'hdr' files, "
+        << "where the weights of" << endl
+        << "   non-'exr' films are read from / written to "
+        << "'<film>.weights.pfm'" << endl;
+}
+
+int main(int argc, char **argv) {
+   if (argc < 3) {
+      printUsage(argv);
+      return 1;
+   }
+   
+   RawFilm merged;
+   
+   for(int i = 2; i < argc; ++i) {
+      RawFilm *film = RawFilm::load(argv[i]);
+      
+      if (NULL == film) {
+         cerr << "error loading raw film '" << argv[i] << "'" << endl;
+         return 1;
+      }
+      
+      const bool success = merged.merge(*film);
+      safeDelete(film);
+      
+      if (!success) {
+         cerr << "raw film '" << argv[i] << "' doesn't match the dimensions "
+              << "of the preceding films" << endl;
+         return 1;
+      }
+   }
+   
+   if (!merged.save(argv[1])) {
+      cerr << "error saving merged film to '" << argv[1] << "'" << endl;
+      return 1;
+   }
+   
+   cout << "merged " << (argc - 2) << " films into '" << argv[1] << "'"
+        << endl;
+   
+   return 0;
+}
+
@@ -0,0 +1,820 @@
+/**<!-------------------------------------------------------------------->
+   @file   BVHAccel.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Fall 2008
+   
+   @brief
+      Bounding volume hierarchy built with a binned surface area heuristic
+   over the world-space AABBs of its primitives.  Unlike a kd-Tree, a BVH
+   never splits a primitive's bounds across multiple cells, which makes it
+   well-suited as the top level of a two-level hierarchy over large numbers
+   of (possibly overlapping) instances.
+      The tree's topology also remains valid when its primitives move, so 
+   animated geometry may be handled by refitting node bounds bottom-up in 
+   O(n) (see update) instead of rebuilding the tree from scratch.  Since 
+   refitting gradually degrades tree quality, the tree is rebuilt whenever 
+   its SAH cost exceeds that of the originally built tree by more than 
+   bvhRefitThreshold.
+      Primitives which expose a bottom-level SpatialAccel (Meshes and
+   instances thereof; see Transformable::getSpatialAccel) are stored as
+   compact instance records holding an affine world-to-accel transform, and
+   traversal descends directly into the shared bottom-level accel using a
+   single stack-allocated Ray, bypassing the per-instance virtual call chain
+   which would otherwise transform the ray once per level.
+   <!-------------------------------------------------------------------->**/
+
+#include "BVHAccel.h"
+
+#include <shapes/Transformable.h>
+#include <SurfacePoint.h>
+#include <Log.h>
+
+#include <algorithm>
+#include <limits>
+using namespace std;
+
+namespace milton {
+
+#define BVH_NO_INSTANCE          ((unsigned)(-1))
+#define BVH_LEAF_FLAG            (3)
+
+#define BVH_IS_LEAF(n)           (((n).flags & 3) == BVH_LEAF_FLAG)
+#define BVH_GET_AXIS(n)          ((n).flags & 3)
+#define BVH_GET_NO_PRIMS(n)      ((n).flags >> 2)
+
+/**
+ * @brief 
+ *    Compact (32-byte) BVH node whose bounds are stored in single precision, 
+ * rounded outwards s.t. they always conservatively enclose the original 
+ * bounds
+ */
+struct bvhNode {
+   float    min[3];
+   float    max[3];
+   
+   /// leaf: index of first primitive; interior: index of second child
+   /// (the first child always immediately follows its parent)
+   unsigned offset;
+   
+   /// leaf: (noPrimitives << 2) | BVH_LEAF_FLAG; interior: split axis
+   unsigned flags;
+   
+   inline void setBounds(const AABB &aabb) {
+      for(unsigned i = 3; i--;) {
+         min[i] = (float) aabb.min[i];
+         max[i] = (float) aabb.max[i];
+         
+         if (min[i] > aabb.min[i])
+            min[i] = nextafterf(min[i], -numeric_limits<float>::infinity());
+         if (max[i] < aabb.max[i])
+            max[i] = nextafterf(max[i],  numeric_limits<float>::infinity());
+      }
+   }
+   
+   /// sets the bounds of this node to the union of two other nodes' bounds
+   inline void setBounds(const bvhNode &a, const bvhNode &b) {
+      for(unsigned i = 3; i--;) {
+         min[i] = std::min(a.min[i], b.min[i]);
+         max[i] = std::max(a.max[i], b.max[i]);
+      }
+   }
+   
+   inline real_t getSurfaceArea() const {
+      const real_t dx = max[0] - min[0];
+      const real_t dy = max[1] - min[1];
+      const real_t dz = max[2] - min[2];
+      
+      return 2 * (dx * dy + dy * dz + dz * dx);
+   }
+   
+   /// @returns whether or not the given ray (origin and inverse direction)
+   ///    overlaps this node within the interval (0, tMax)
+   /// @note NaNs arising from zero direction components coinciding with a
+   ///    slab are ignored, which errs on the side of visiting the node
+   inline bool intersects(const real_t *origin, const real_t *invDir, 
+                          real_t tMax) const
+   {
+      real_t tNear = 0, tFar = tMax;
+      
+      for(unsigned i = 0; i < 3; ++i) {
+         real_t t0 = (min[i] - origin[i]) * invDir[i];
+         real_t t1 = (max[i] - origin[i]) * invDir[i];
+         
+         if (t0 > t1)
+            std::swap(t0, t1);
+         
+         if (t0 > tNear)
+            tNear = t0;
+         if (t1 < tFar)
+            tFar  = t1;
+         
+         if (tNear > tFar)
+            return false;
+      }
+      
+      return true;
+   }
+};
+
+/// reference to a primitive stored in a BVH leaf
+struct bvhPrimitive {
+   Intersectable *primitive;
+   
+   /// index into m_instances, or BVH_NO_INSTANCE if this primitive has no
+   /// bottom-level accel of its own
+   unsigned       instance;
+   
+   /// index of this primitive in the original (unordered) primitive list
+   unsigned       index;
+};
+
+/**
+ * @brief 
+ *    Compact per-instance record storing the upper 3x4 of the transform
+ * from world space into the space of a shared bottom-level SpatialAccel
+ */
+struct bvhInstance {
+   real_t         trans[12];
+   SpatialAccel  *accel;
+   Transformable *shape;
+   
+   /// (re)initializes this record from the current state of @p trans
+   inline void init(Transformable *trans) {
+      const real_t *m = *trans->getTransToAccel();
+      
+      for(unsigned j = 12; j--;)
+         this->trans[j] = m[j];
+      
+      accel = trans->getSpatialAccel();
+      shape = trans;
+   }
+   
+   /// transforms the given world-space ray into the space of accel,
+   /// writing the result into an existing ray
+   inline void transform(const Ray &ray, Ray &local) const {
+      const real_t *m = trans;
+      const Point3  &o = ray.origin;
+      const Vector3 &d = ray.direction;
+      
+      local.origin[0] = m[0] * o[0] + m[1] * o[1] + m[2]  * o[2] + m[3];
+      local.origin[1] = m[4] * o[0] + m[5] * o[1] + m[6]  * o[2] + m[7];
+      local.origin[2] = m[8] * o[0] + m[9] * o[1] + m[10] * o[2] + m[11];
+      
+      local.direction[0] = m[0] * d[0] + m[1] * d[1] + m[2]  * d[2];
+      local.direction[1] = m[4] * d[0] + m[5] * d[1] + m[6]  * d[2];
+      local.direction[2] = m[8] * d[0] + m[9] * d[1] + m[10] * d[2];
+      
+      local.invDir = local.direction.getReciprocal();
+   }
+};
+
+/// BVH construction statistics
+struct bvhAccelLog {
+   unsigned noInternal;
+   unsigned noLeaves;
+   unsigned maxDepth;
+   unsigned maxPrimitives;
+   
+   inline bvhAccelLog()
+      : noInternal(0), noLeaves(0), maxDepth(0), maxPrimitives(0)
+   { }
+};
+
+/// single SAH bin used during construction
+struct bvhBin {
+   AABB     aabb;
+   unsigned noPrimitives;
+};
+
+/// buffer used internally during tree construction
+struct bvhWorkBuffer : public Log {
+   bvhAccelLog            log;
+   
+   // world-space bounds and centroids of all primitives, indexed by
+   // bvhPrimitive::index
+   std::vector<AABB>      bounds;
+   std::vector<Vector3>   centroids;
+   
+   // reused across all nodes to avoid per-node allocations
+   std::vector<bvhBin>    bins;
+   std::vector<real_t>    rightAreas;
+   std::vector<unsigned>  rightCounts;
+   
+   inline bvhWorkBuffer()
+      : log()
+   {
+      init();
+   }
+   
+   virtual ~bvhWorkBuffer()
+   { }
+};
+
+/// predicate for partitioning primitives about a binned split plane
+struct bvhBinPredicate {
+   const bvhWorkBuffer *workBuf;
+   unsigned             axis;
+   real_t               min;
+   real_t               scale;
+   unsigned             split;
+   
+   inline bool operator()(const bvhPrimitive &prim) const {
+      const real_t c = workBuf->centroids[prim.index][axis];
+      unsigned bin   = (unsigned) ((c - min) * scale);
+      
+      if (bin >= workBuf->bins.size())
+         bin = workBuf->bins.size() - 1;
+      
+      return (bin < split);
+   }
+};
+
+/// predicate for ordering primitives along an axis by centroid
+struct bvhCentroidPredicate {
+   const bvhWorkBuffer *workBuf;
+   unsigned             axis;
+   
+   inline bool operator()(const bvhPrimitive &a, const bvhPrimitive &b) const {
+      return (workBuf->centroids[a.index][axis] <
+              workBuf->centroids[b.index][axis]);
+   }
+};
+
+/// unions @p aabb into @p dest, where @p dest may still be empty
+static inline void bvhAddAABB(AABB &dest, bool &empty, const AABB &aabb) {
+   if (empty) {
+      dest  = aabb;
+      empty = false;
+   } else {
+      dest.add(aabb);
+   }
+}
+
+
+// -------------------------------------------------------------------------
+// Main public interface
+// -------------------------------------------------------------------------
+
+
+BVHAccel::BVHAccel()
+   : SpatialAccel(), m_buildParams(), m_buildCost(0)
+{ }
+
+BVHAccel::~BVHAccel() {
+   _reset();
+}
+
+void BVHAccel::init() {
+   bvhWorkBuffer workBuf;
+   
+   // free any prior data structures
+   _reset();
+   
+   // initialize global AABB
+   SpatialAccel::init();
+   
+   // initialize build parameters from PropertyMap
+   _initProperties(workBuf);
+   
+   // gather primitive bounds and compact instance records
+   _initPrimitives(workBuf);
+   
+   if (m_prims.size() > 1) {
+      workBuf << "initializing BVH: " << m_prims.size() << " primitives ("
+              << m_instances.size() << " instances)" << endl;
+   }
+   
+   if (m_prims.empty())
+      return;
+   
+   // build the tree!
+   m_nodes.reserve(2 * m_prims.size() / m_buildParams.bvhMaxPrimitives + 1);
+   m_nodes.push_back(bvhNode());
+   
+   _buildTreeHelper(workBuf, 0, 0, m_prims.size(), 0);
+   m_buildCost = getSAHCost();
+   
+   const bvhAccelLog &log = workBuf.log;
+   ASSERT(log.noLeaves == log.noInternal + 1);
+   
+   // print out useful debugging info / stats
+   if (m_prims.size() > 1) {
+      workBuf << "   " << "maxDepth:      " << log.maxDepth << endl;
+      workBuf << "   " << "noInternal:    " << log.noInternal << endl;
+      workBuf << "   " << "noLeaves:      " << log.noLeaves << endl;
+      workBuf << "   " << "maxPrimitives: " << log.maxPrimitives << endl;
+      workBuf << "   " << "avgPrimitives: " <<
+         ((real_t) m_prims.size() / log.noLeaves) << endl;
+      workBuf << "   " << "SAH cost:      " << m_buildCost << endl;
+   }
+}
+
+void BVHAccel::update() {
+   ASSERT(m_primitives);
+   
+   // topology changed (or tree was never built), so refitting is impossible
+   if (m_nodes.empty() || m_prims.size() != m_primitives->size()) {
+      init();
+      return;
+   }
+   
+   // recompute global AABB
+   SpatialAccel::init();
+   
+   _refit();
+   
+   const real_t cost = getSAHCost();
+   
+   if (cost > m_buildParams.bvhRefitThreshold * m_buildCost) {
+      Log log;
+      
+      log << "BVH SAH cost degraded from " << m_buildCost << " to " << cost 
+          << " after refit; rebuilding" << endl;
+      
+      init();
+   }
+}
+
+real_t BVHAccel::getIntersection(const Ray &ray, SurfacePoint &pt) {
+   if (m_nodes.empty())
+      return INFINITY;
+   
+   const real_t origin[3] = { ray.origin[0], ray.origin[1], ray.origin[2] };
+   const real_t invDir[3] = { ray.invDir[0], ray.invDir[1], ray.invDir[2] };
+   
+   real_t   tMin       = INFINITY;
+   unsigned normalCase = pt.normalCase;
+   unsigned index      = pt.index;
+   Shape   *shape      = pt.shape;
+   
+   // scratch ray reused for every instance visited during traversal
+   Ray      local;
+   
+   unsigned stack[BVH_MAX_DEPTH];
+   unsigned stackSize = 0;
+   unsigned cur       = 0;
+   
+   for(;;) {
+      const bvhNode &node = m_nodes[cur];
+      
+      if (node.intersects(origin, invDir, tMin)) {
+         if (!BVH_IS_LEAF(node)) {
+            // visit the near child first, deferring the far child
+            if (ray.direction[BVH_GET_AXIS(node)] < 0) {
+               stack[stackSize++] = cur + 1;
+               cur = node.offset;
+            } else {
+               stack[stackSize++] = node.offset;
+               cur = cur + 1;
+            }
+            
+            ASSERT(stackSize <= BVH_MAX_DEPTH);
+            continue;
+         }
+         
+         const bvhPrimitive *prim = &m_prims[node.offset];
+         
+         for(unsigned i = BVH_GET_NO_PRIMS(node); i--; ++prim) {
+            pt.shape  = NULL;
+            pt.index  = (unsigned)(-1);
+            
+            const real_t t = _getIntersection(*prim, ray, local, pt);
+            
+            if (t > EPSILON && t < tMin) {
+               tMin = t;
+               
+               shape      = (pt.shape ? pt.shape :
+                             static_cast<Shape*>(prim->primitive));
+               index      = (pt.index == ((unsigned)(-1)) ?
+                             prim->index : pt.index);
+               normalCase = pt.normalCase;
+            }
+         }
+      }
+      
+      if (stackSize == 0)
+         break;
+      
+      cur = stack[--stackSize];
+   }
+   
+   pt.shape      = shape;
+   pt.normalCase = normalCase;
+   pt.index      = index;
+   
+   return tMin;
+}
+
+bool BVHAccel::intersects(const Ray &ray, real_t clipMax) {
+   if (m_nodes.empty())
+      return false;
+   
+   const real_t origin[3] = { ray.origin[0], ray.origin[1], ray.origin[2] };
+   const real_t invDir[3] = { ray.invDir[0], ray.invDir[1], ray.invDir[2] };
+   
+   // scratch ray reused for every instance visited during traversal
+   Ray      local;
+   
+   unsigned stack[BVH_MAX_DEPTH];
+   unsigned stackSize = 0;
+   unsigned cur       = 0;
+   
+   for(;;) {
+      const bvhNode &node = m_nodes[cur];
+      
+      if (node.intersects(origin, invDir, clipMax)) {
+         if (!BVH_IS_LEAF(node)) {
+            // order doesn't matter for occlusion queries
+            stack[stackSize++] = node.offset;
+            cur = cur + 1;
+            
+            ASSERT(stackSize <= BVH_MAX_DEPTH);
+            continue;
+         }
+         
+         const bvhPrimitive *prim = &m_prims[node.offset];
+         
+         for(unsigned i = BVH_GET_NO_PRIMS(node); i--; ++prim) {
+            if (_intersects(*prim, ray, local, clipMax))
+               return true;
+         }
+      }
+      
+      if (stackSize == 0)
+         break;
+      
+      cur = stack[--stackSize];
+   }
+   
+   return false;
+}
+
+
+real_t BVHAccel::getSAHCost() const {
+   if (m_nodes.empty())
+      return 0;
+   
+   const real_t rootArea = m_nodes[0].getSurfaceArea();
+   
+   // degenerate tree whose root has no surface area
+   if (rootArea <= 0)
+      return m_buildParams.bvhCostIntersect * m_prims.size();
+   
+   real_t cost = 0;
+   
+   for(unsigned i = m_nodes.size(); i--;) {
+      const bvhNode &node = m_nodes[i];
+      const real_t   area = node.getSurfaceArea();
+      
+      if (BVH_IS_LEAF(node)) {
+         cost += area * m_buildParams.bvhCostIntersect * 
+            BVH_GET_NO_PRIMS(node);
+      } else {
+         cost += area * m_buildParams.bvhCostTraversal;
+      }
+   }
+   
+   return cost / rootArea;
+}
+
+
+// -------------------------------------------------------------------------
+// Internal traversal methods
+// -------------------------------------------------------------------------
+
+
+inline real_t BVHAccel::_getIntersection(const bvhPrimitive &prim, 
+                                         const Ray &ray, Ray &local, 
+                                         SurfacePoint &pt) const
+{
+   if (prim.instance == BVH_NO_INSTANCE)
+      return prim.primitive->getIntersection(ray, pt);
+   
+   // descend directly into the shared bottom-level accel; note t-values
+   // are invariant under the (affine) change of basis
+   const bvhInstance &instance = m_instances[prim.instance];
+   instance.transform(ray, local);
+   
+   const real_t t = instance.accel->getIntersection(local, pt);
+   
+   if (Ray::isValid(t))
+      pt.shape = instance.shape;
+   
+   return t;
+}
+
+inline bool BVHAccel::_intersects(const bvhPrimitive &prim, const Ray &ray, 
+                                  Ray &local, real_t tMax) const
+{
+   if (prim.instance == BVH_NO_INSTANCE)
+      return prim.primitive->intersects(ray, tMax);
+   
+   const bvhInstance &instance = m_instances[prim.instance];
+   instance.transform(ray, local);
+   
+   return instance.accel->intersects(local, tMax);
+}
+
+
+// -------------------------------------------------------------------------
+// Internal construction methods
+// -------------------------------------------------------------------------
+
+
+void BVHAccel::_reset() {
+   m_nodes.clear();
+   m_prims.clear();
+   m_instances.clear();
+   
+   m_buildCost = 0;
+}
+
+void BVHAccel::_refit() {
+   // refresh instance transforms, which may have been animated as well
+   FOREACH(bvhInstanceListIter, m_instances, iter) {
+      Transformable *trans = iter->shape;
+      
+      iter->init(trans);
+      ASSERT(iter->accel);
+   }
+   
+   // children are always stored after their parents, so visiting nodes in 
+   // reverse order refits the tree bottom-up in a single pass
+   for(unsigned i = m_nodes.size(); i--;) {
+      bvhNode &node = m_nodes[i];
+      
+      if (BVH_IS_LEAF(node)) {
+         const bvhPrimitive *prim = &m_prims[node.offset];
+         AABB aabb;
+         bool empty = true;
+         
+         for(unsigned j = BVH_GET_NO_PRIMS(node); j--; ++prim) {
+            const AABB &primAABB = prim->primitive->getAABB();
+            ASSERT(primAABB.isValid());
+            
+            bvhAddAABB(aabb, empty, primAABB);
+         }
+         
+         node.setBounds(aabb);
+      } else {
+         node.setBounds(m_nodes[i + 1], m_nodes[node.offset]);
+      }
+   }
+}
+
+void BVHAccel::_initProperties(bvhWorkBuffer &workBuf) {
+#define GET_PARAM(name, type) \
+   m_buildParams.name = getValue<type>(#name, m_buildParams.name);
+   
+   GET_PARAM(bvhMaxPrimitives, unsigned);
+   GET_PARAM(bvhNoBins,        unsigned);
+   GET_PARAM(bvhCostTraversal, real_t);
+   GET_PARAM(bvhCostIntersect, real_t);
+   GET_PARAM(bvhRefitThreshold, real_t);
+
+#undef GET_PARAM
+   
+   m_buildParams.bvhMaxPrimitives = MAX(1u, m_buildParams.bvhMaxPrimitives);
+   m_buildParams.bvhNoBins = CLAMP(m_buildParams.bvhNoBins, 2u, 256u);
+   m_buildParams.bvhRefitThreshold = 
+      MAX(create_real(1), m_buildParams.bvhRefitThreshold);
+   
+   workBuf.bins.resize(m_buildParams.bvhNoBins);
+   workBuf.rightAreas.resize(m_buildParams.bvhNoBins);
+   workBuf.rightCounts.resize(m_buildParams.bvhNoBins);
+}
+
+void BVHAccel::_initPrimitives(bvhWorkBuffer &workBuf) {
+   ASSERT(m_primitives);
+   const unsigned noPrimitives = m_primitives->size();
+   
+   m_prims.resize(noPrimitives);
+   workBuf.bounds.resize(noPrimitives);
+   workBuf.centroids.resize(noPrimitives);
+   
+   for(unsigned i = 0; i < noPrimitives; ++i) {
+      Intersectable *primitive = (*m_primitives)[i];
+      bvhPrimitive  &prim      = m_prims[i];
+      
+      prim.primitive = primitive;
+      prim.instance  = BVH_NO_INSTANCE;
+      prim.index     = i;
+      
+      const AABB &aabb = primitive->getAABB();
+      ASSERT(aabb.isValid());
+      
+      workBuf.bounds[i]    = aabb;
+      workBuf.centroids[i] = (aabb.min + aabb.max) * 0.5;
+      
+      // record a compact instance for primitives whose hits may be resolved
+      // directly against a bottom-level accel
+      Transformable *trans = dynamic_cast<Transformable*>(primitive);
+      SpatialAccel  *accel = (trans ? trans->getSpatialAccel() : NULL);
+      
+      if (accel) {
+         bvhInstance instance;
+         instance.init(trans);
+         
+         prim.instance  = m_instances.size();
+         m_instances.push_back(instance);
+      }
+   }
+}
+
+void BVHAccel::_buildTreeHelper(bvhWorkBuffer &workBuf, unsigned nodeIndex, 
+                                unsigned begin, unsigned end, unsigned depth)
+{
+   ASSERT(begin < end);
+   const unsigned noPrimitives = end - begin;
+   
+   // compute bounds of primitives and their centroids
+   AABB aabb, centroids;
+   bool empty = true;
+   
+   for(unsigned i = begin; i < end; ++i) {
+      const unsigned index = m_prims[i].index;
+      
+      if (empty) {
+         centroids.min = workBuf.centroids[index];
+         centroids.max = workBuf.centroids[index];
+      } else {
+         centroids.add(workBuf.centroids[index]);
+      }
+      
+      bvhAddAABB(aabb, empty, workBuf.bounds[index]);
+   }
+   
+   m_nodes[nodeIndex].setBounds(aabb);
+   
+   if (depth > workBuf.log.maxDepth)
+      workBuf.log.maxDepth = depth;
+   
+   // determine whether or not to split this node
+   unsigned axis = 0, mid = begin;
+   
+   if (noPrimitives > m_buildParams.bvhMaxPrimitives &&
+       depth < BVH_MAX_DEPTH - 1)
+   {
+      mid = _partition(workBuf, begin, end, centroids, axis);
+      
+      // SAH prefers a leaf, or all centroids coincide
+      if (mid == begin || mid == end) {
+         if (noPrimitives <= 4 * m_buildParams.bvhMaxPrimitives) {
+            mid = begin;
+         } else {
+            // fall back to splitting at the median centroid
+            axis = centroids.getMaxExtent();
+            mid  = begin + noPrimitives / 2;
+            
+            bvhCentroidPredicate pred;
+            pred.workBuf = &workBuf;
+            pred.axis    = axis;
+            
+            std::nth_element(m_prims.begin() + begin, m_prims.begin() + mid, 
+                             m_prims.begin() + end, pred);
+         }
+      }
+   }
+   
+   if (mid == begin) {
+      bvhNode &node = m_nodes[nodeIndex];
+      node.offset   = begin;
+      node.flags    = (noPrimitives << 2) | BVH_LEAF_FLAG;
+      
+      ++workBuf.log.noLeaves;
+      if (noPrimitives > workBuf.log.maxPrimitives)
+         workBuf.log.maxPrimitives = noPrimitives;
+      
+      return;
+   }
+   
+   ++workBuf.log.noInternal;
+   
+   // first child immediately follows its parent
+   const unsigned left = m_nodes.size();
+   ASSERT(left == nodeIndex + 1);
+   m_nodes.push_back(bvhNode());
+   _buildTreeHelper(workBuf, left, begin, mid, depth + 1);
+   
+   const unsigned right = m_nodes.size();
+   m_nodes.push_back(bvhNode());
+   _buildTreeHelper(workBuf, right, mid, end, depth + 1);
+   
+   // note: m_nodes may have been reallocated by the recursive calls
+   m_nodes[nodeIndex].offset = right;
+   m_nodes[nodeIndex].flags  = axis;
+}
+
+unsigned BVHAccel::_partition(bvhWorkBuffer &workBuf, unsigned begin, 
+                              unsigned end, const AABB &centroids, 
+                              unsigned &outAxis)
+{
+   const unsigned noBins       = workBuf.bins.size();
+   const unsigned noPrimitives = end - begin;
+   
+   real_t   bestCost  = m_buildParams.bvhCostIntersect * noPrimitives;
+   unsigned bestAxis  = 3;
+   unsigned bestSplit = 0;
+   real_t   parentArea = 0;
+   
+   for(unsigned axis = 0; axis < 3; ++axis) {
+      const real_t extent = centroids.max[axis] - centroids.min[axis];
+      
+      if (extent <= 0)
+         continue;
+      
+      const real_t min   = centroids.min[axis];
+      const real_t scale = noBins / extent;
+      
+      for(unsigned b = noBins; b--;)
+         workBuf.bins[b].noPrimitives = 0;
+      
+      // bin primitives by centroid
+      AABB all;
+      bool allEmpty = true;
+      
+      for(unsigned i = begin; i < end; ++i) {
+         const unsigned index = m_prims[i].index;
+         unsigned b = (unsigned) ((workBuf.centroids[index][axis] - min) * scale);
+         
+         if (b >= noBins)
+            b = noBins - 1;
+         
+         bvhBin &bin = workBuf.bins[b];
+         bool binEmpty = (0 == bin.noPrimitives);
+         
+         bvhAddAABB(bin.aabb, binEmpty, workBuf.bounds[index]);
+         bvhAddAABB(all, allEmpty, workBuf.bounds[index]);
+         ++bin.noPrimitives;
+      }
+      
+      parentArea = all.getSurfaceArea();
+      if (parentArea <= 0)
+         return begin;
+      
+      // sweep from the right, recording the area and count to the right of
+      // each candidate split
+      AABB     right;
+      bool     rightEmpty = true;
+      unsigned rightCount = 0;
+      
+      for(unsigned b = noBins; b-- > 1;) {
+         const bvhBin &bin = workBuf.bins[b];
+         
+         if (bin.noPrimitives > 0) {
+            bvhAddAABB(right, rightEmpty, bin.aabb);
+            rightCount += bin.noPrimitives;
+         }
+         
+         workBuf.rightAreas[b]  = (rightEmpty ? 0 : right.getSurfaceArea());
+         workBuf.rightCounts[b] = rightCount;
+      }
+      
+      // sweep from the left, evaluating the SAH at each candidate split
+      AABB     left;
+      bool     leftEmpty = true;
+      unsigned leftCount = 0;
+      
+      for(unsigned b = 1; b < noBins; ++b) {
+         const bvhBin &bin = workBuf.bins[b - 1];
+         
+         if (bin.noPrimitives > 0) {
+            bvhAddAABB(left, leftEmpty, bin.aabb);
+            leftCount += bin.noPrimitives;
+         }
+         
+         if (leftCount == 0 || workBuf.rightCounts[b] == 0)
+            continue;
+         
+         const real_t cost = m_buildParams.bvhCostTraversal +
+            m_buildParams.bvhCostIntersect *
+            (left.getSurfaceArea() * leftCount +
+             workBuf.rightAreas[b] * workBuf.rightCounts[b]) / parentArea;
+         
+         if (cost < bestCost) {
+            bestCost  = cost;
+            bestAxis  = axis;
+            bestSplit = b;
+         }
+      }
+   }
+   
+   if (bestAxis > 2)
+      return begin;
+   
+   bvhBinPredicate pred;
+   pred.workBuf = &workBuf;
+   pred.axis    = bestAxis;
+   pred.min     = centroids.min[bestAxis];
+   pred.scale   = noBins / (centroids.max[bestAxis] - centroids.min[bestAxis]);
+   pred.split   = bestSplit;
+   
+   const bvhPrimitiveList::iterator mid =
+      std::partition(m_prims.begin() + begin, m_prims.begin() + end, pred);
+   
+   outAxis = bestAxis;
+   return (mid - m_prims.begin());
+}
+
+}
+
@@ -0,0 +1,186 @@
+/**<!-------------------------------------------------------------------->
+   @class  BVHAccel
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Fall 2008
+   
+   @brief
+      Bounding volume hierarchy built with a binned surface area heuristic
+   over the world-space AABBs of its primitives.  Unlike a kd-Tree, a BVH
+   never splits a primitive's bounds across multiple cells, which makes it
+   well-suited as the top level of a two-level hierarchy over large numbers
+   of (possibly overlapping) instances.
+      The tree's topology also remains valid when its primitives move, so 
+   animated geometry may be handled by refitting node bounds bottom-up in 
+   O(n) (see update) instead of rebuilding the tree from scratch.  Since 
+   refitting gradually degrades tree quality, the tree is rebuilt whenever 
+   its SAH cost exceeds that of the originally built tree by more than 
+   bvhRefitThreshold.
+      Primitives which expose a bottom-level SpatialAccel (Meshes and
+   instances thereof; see Transformable::getSpatialAccel) are stored as
+   compact instance records holding an affine world-to-accel transform, and
+   traversal descends directly into the shared bottom-level accel using a
+   single stack-allocated Ray, bypassing the per-instance virtual call chain
+   which would otherwise transform the ray once per level.
+   <!-------------------------------------------------------------------->**/
+
+#ifndef BVH_ACCEL_H_
+#define BVH_ACCEL_H_
+
+#include "accel/SpatialAccel.h"
+
+namespace milton {
+
+#define BVH_MAX_DEPTH      (64)
+
+struct bvhNode;
+struct bvhPrimitive;
+struct bvhInstance;
+struct bvhWorkBuffer;
+
+DECLARE_STL_TYPEDEF(std::vector<bvhNode>,      bvhNodeList);
+DECLARE_STL_TYPEDEF(std::vector<bvhPrimitive>, bvhPrimitiveList);
+DECLARE_STL_TYPEDEF(std::vector<bvhInstance>,  bvhInstanceList);
+
+class MILTON_DLL_EXPORT BVHAccel : public SpatialAccel {
+   
+   public:
+      /**
+       * @brief Parameters for customizing the construction of the BVH
+       */
+      struct BuildParams {
+         /// maximum number of primitives stored in a single leaf
+         unsigned bvhMaxPrimitives;
+         
+         /// number of bins used to approximate the SAH along each axis
+         unsigned bvhNoBins;
+         
+         /// SAH relative cost of traversing an interior node
+         real_t   bvhCostTraversal;
+         
+         /// SAH relative cost of intersecting a primitive
+         real_t   bvhCostIntersect;
+         
+         /// maximum ratio of a refitted tree's SAH cost to its cost when 
+         /// last built, beyond which update rebuilds the tree from scratch
+         real_t   bvhRefitThreshold;
+         
+         inline BuildParams()
+            : bvhMaxPrimitives(4), bvhNoBins(16), 
+              bvhCostTraversal(1), bvhCostIntersect(1), 
+              bvhRefitThreshold(1.5)
+         { }
+      };
+      
+      
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      explicit BVHAccel();
+      
+      virtual ~BVHAccel();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Initialization Routines
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Builds the BVH over the world-space AABBs of all primitives, 
+       * assuming all primitives have already been initialized
+       */
+      virtual void init();
+      
+      /**
+       * @brief 
+       *    Refits the bounds of all nodes bottom-up to the current AABBs of 
+       * this BVH's primitives without changing the tree's topology, falling 
+       * back to a full rebuild if the resulting tree's SAH cost has degraded 
+       * past bvhRefitThreshold
+       * 
+       * @note assumes the number and order of primitives are unchanged
+       */
+      virtual void update();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      virtual real_t getIntersection(const Ray &ray, SurfacePoint &pt);
+      
+      virtual bool intersects(const Ray &ray, real_t tMax = INFINITY);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @returns the SAH cost of this BVH in its current state, relative to 
+       *    the cost of intersecting a single primitive
+       */
+      real_t getSAHCost() const;
+      
+      /// @returns the SAH cost of this BVH when it was last (re)built
+      inline real_t getBuildSAHCost() const {
+         return m_buildCost;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      ///@name Internal construction methods
+      //@{-----------------------------------------------------------------
+      
+      void _initProperties(bvhWorkBuffer &workBuf);
+      
+      void _initPrimitives(bvhWorkBuffer &workBuf);
+      
+      void _reset();
+      
+      void _buildTreeHelper(bvhWorkBuffer &workBuf, unsigned nodeIndex, 
+                            unsigned begin, unsigned end, unsigned depth);
+      
+      unsigned _partition(bvhWorkBuffer &workBuf, unsigned begin, 
+                          unsigned end, const AABB &centroids, 
+                          unsigned &axis);
+      
+      void _refit();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Internal traversal methods
+      //@{-----------------------------------------------------------------
+      
+      inline real_t _getIntersection(const bvhPrimitive &prim, 
+                                     const Ray &ray, Ray &local, 
+                                     SurfacePoint &pt) const;
+      
+      inline bool _intersects(const bvhPrimitive &prim, const Ray &ray, 
+                              Ray &local, real_t tMax) const;
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      BuildParams      m_buildParams;
+      
+      /// flattened tree in depth-first order
+      bvhNodeList      m_nodes;
+      
+      /// primitive references, reordered s.t. each leaf is a contiguous range
+      bvhPrimitiveList m_prims;
+      
+      /// compact transforms of primitives which have a bottom-level accel
+      bvhInstanceList  m_instances;
+      
+      /// SAH cost of the tree when it was last built (see update)
+      real_t           m_buildCost;
+};
+
+}
+
+#endif // BVH_ACCEL_H_
+
@@ -55,6 +55,18 @@ class MILTON_DLL_EXPORT SpatialAccel : public PropertyMap, public SSEAligned {
          }
       }
       
+      /**
+       * @brief 
+       *    Updates this accel to reflect changes in the geometry (but not the 
+       * number or order) of its primitives, e.g., after the vertices of an 
+       * animated mesh have been moved between frames
+       * 
+       * @note the default implementation rebuilds from scratch via init
+       */
+      virtual void update() {
+         init();
+      }
+      
       
       //@}-----------------------------------------------------------------
       ///@name Main usage interface
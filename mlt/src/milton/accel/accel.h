@@ -11,6 +11,7 @@
 #define MILTON_ACCEL_H_
 
 #include <accel/AABB.h>
+#include <accel/BVHAccel.h>
 #include <accel/NaiveSpatialAccel.h>
 #include <accel/kdTreeAccel.h>
 #include <accel/SpatialAccel.h>
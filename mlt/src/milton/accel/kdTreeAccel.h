@@ -16,7 +16,7 @@
    the SAH produces the best quality tree overall with respect to visibility 
    tests, it can take a long time to build and is thus mainly suitable for 
    static scenes (whereas other acceleration data structures may be more 
-   appropriate for dynamic geometry & animations).
+   appropriate for dynamic geometry & animations; see BVHAccel::update).
       The SAH kd-Tree may be tweaked with several parameters.  See 
    kdTreeAccelParams for more info.  The O(nlog n) SAH construction has 
    been implemented as opposed to the O(n) or O(n^2) alternatives (using 
@@ -29,6 +29,27 @@
 
 //#define MILTON_ENABLE_SSE (1)
 
+// SIMD backend used by the vectorized matrix-vector kernels (see 
+// common/math/simd/MatrixSIMD.inl), selectable independently of precision
+#define MILTON_SIMD_NONE   (0)
+#define MILTON_SIMD_SSE2   (1)
+#define MILTON_SIMD_AVX    (2)
+
+#ifndef MILTON_SIMD
+#  if defined(__AVX__)
+#     define MILTON_SIMD   MILTON_SIMD_AVX
+#  elif defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#     define MILTON_SIMD   MILTON_SIMD_SSE2
+#  else
+#     define MILTON_SIMD   MILTON_SIMD_NONE
+#  endif
+#endif
+
+// store mesh geometry and perform ray-triangle visibility tests in single 
+// precision, independent of real_t (shading is still done with real_t)
+#define MILTON_FLOAT_GEOMETRY (1)
+
 #ifdef INFINITY
 #  undef  INFINITY
 #endif
@@ -138,7 +159,8 @@ namespace milton {
    
 #  if MILTON_ENABLE_SSE
 #     warning "SSE is currently only supported when compiled with " \
-              "single-precision floating-point"
+              "single-precision floating-point; see MILTON_SIMD for " \
+              "double-precision vectorization"
 #     undef MILTON_ENABLE_SSE
 #     define MILTON_ENABLE_SSE (0)
 #  endif // MILTON_ENABLE_SSE
@@ -148,6 +170,13 @@ namespace milton {
 
 #define create_real(x)   (static_cast<real_t>(x))
 
+#if MILTON_FLOAT_GEOMETRY
+   /// compact floating-point type used for geometry storage and visibility
+   typedef float  geom_real_t;
+#else
+   typedef real_t geom_real_t;
+#endif
+
 #define M_PI_DIV_2 (M_PI_2)
 #define M_INV_PI   (M_1_PI)
 #define M_INV_2PI  (M_2_PI)
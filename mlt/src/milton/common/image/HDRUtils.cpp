@@ -12,6 +12,12 @@
    (http://scanline.ca/exrtools/)
    <!-------------------------------------------------------------------->**/
 
+// 64-bit off_t for fseeko/ftello on 32-bit POSIX platforms (must precede 
+// all system headers)
+#ifndef _FILE_OFFSET_BITS
+#  define _FILE_OFFSET_BITS 64
+#endif
+
 #include "HDRUtils.h"
 #include "HDRImage.h"
 #include "RgbaImage.h"
@@ -23,6 +29,9 @@
 
 // third-party
 #include "rgbe.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 
 #ifdef HAVE_OPENEXR
 #  include "exrinput.h"
@@ -33,8 +42,119 @@ using namespace std;
 
 namespace milton {
 
+/// scale factors ldexp(1, e - (128 + 8)) for each RGBE exponent e, s.t. 
+/// decoding a pixel requires no calls to ldexp
+struct hdrUtilsRGBETable {
+   real_t scale[256];
+   
+   hdrUtilsRGBETable() {
+      scale[0] = 0;
+      
+      for(int e = 1; e < 256; ++e)
+         scale[e] = ldexp(1.0, e - (128 + 8));
+   }
+};
+
+static const hdrUtilsRGBETable s_rgbeTable;
+
+/// encodes the given pixel in Ward's shared-exponent RGBE format
+static inline void hdrUtilsToRGBE(const RgbaHDR &p, unsigned char *rgbe) {
+   const real_t r = MAX(create_real(0), p.r);
+   const real_t g = MAX(create_real(0), p.g);
+   const real_t b = MAX(create_real(0), p.b);
+   real_t v = MAX(r, MAX(g, b));
+   
+   if (v < 1e-32) {
+      rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+   } else {
+      int e;
+      
+      v = frexp(v, &e) * 256.0 / v;
+      rgbe[0] = (unsigned char) (r * v);
+      rgbe[1] = (unsigned char) (g * v);
+      rgbe[2] = (unsigned char) (b * v);
+      rgbe[3] = (unsigned char) (e + 128);
+   }
+}
+
+/// decodes the given RGBE pixel
+static inline void hdrUtilsFromRGBE(const unsigned char *rgbe, RgbaHDR &p) {
+   const real_t f = s_rgbeTable.scale[rgbe[3]];
+   
+   p.r = rgbe[0] * f;
+   p.g = rgbe[1] * f;
+   p.b = rgbe[2] * f;
+   p.a = 1;
+}
+
+static inline bool hdrUtilsIsLittleEndian() {
+   const unsigned short one = 1;
+   
+   return (*((const unsigned char *) &one) == 1);
+}
+
+static inline void hdrUtilsSwapBytes(float &value) {
+   unsigned char *bytes = (unsigned char *) &value;
+   
+   std::swap(bytes[0], bytes[3]);
+   std::swap(bytes[1], bytes[2]);
+}
+
+/// @returns the current position in @p file as a 64-bit offset (long is 
+///    only 32 bits wide on Windows, which would limit PFMs to 2GB), or a 
+///    negative value upon error
+static inline int64_t hdrUtilsTell(FILE *file) {
+#ifdef MILTON_ARCH_WINDOWS
+   return _ftelli64(file);
+#else
+   return ftello(file);
+#endif
+}
+
+/// seeks to the given 64-bit offset in @p file, relative to @p origin
+static inline bool hdrUtilsSeek(FILE *file, int64_t offset, int origin) {
+#ifdef MILTON_ARCH_WINDOWS
+   return (0 == _fseeki64(file, offset, origin));
+#else
+   return (0 == fseeko(file, (off_t) offset, origin));
+#endif
+}
+
+/// writes the given image one scanline at a time, reading the rows of an 
+/// HDRImage's underlying data directly
+static bool hdrUtilsSave(const string &filename, const Image *image, 
+                         HDRScanlineWriter::Format format)
+{
+   ASSERT(image);
+   
+   const unsigned width  = image->getWidth();
+   const unsigned height = image->getHeight();
+   HDRScanlineWriter writer;
+   
+   if (!writer.open(filename, width, height, format))
+      return false;
+   
+   if (image->isHDR()) {
+      const HDRImage *hdr = static_cast<const HDRImage *>(image);
+      
+      for(unsigned i = 0; i < height; ++i)
+         writer.writeScanline(i, (*hdr)[i]);
+   } else {
+      std::vector<RgbaHDR> row(width);
+      
+      for(unsigned i = 0; i < height; ++i) {
+         for(unsigned j = width; j--;)
+            row[j] = image->getPixel<RgbaHDR>(i, j);
+         
+         writer.writeScanline(i, &row[0]);
+      }
+   }
+   
+   return writer.close();
+}
+
 HDRImage *HDRUtils::loadHDR(const string &filename) {
-   FILE *f = fopen(filename.c_str(), "r");
+   FILE *f = fopen(filename.c_str(), "rb");
    unsigned width = 0, height = 0;
    
    if (NULL == f)
@@ -43,29 +163,31 @@ HDRImage *HDRUtils::loadHDR(const string &filename) {
    if (RGBE_ReadHeader(f, (int*)&width, (int*)&height, NULL) || 
        width == 0 || height == 0)
    {
+      fclose(f);
       return NULL;
    }
    
    HDRImage *image = new HDRImage(width, height);
-   float   *buffer = new float[3 * width];
+   std::vector<unsigned char> buffer(4 * width);
+   
+   // whether the file is run length encoded is determined once from its 
+   // first scanline
+   int rle = -1;
    
+   // decode each scanline directly into the image's underlying data
    for(unsigned i = 0; i < height; ++i) {
-      if (RGBE_ReadPixels_RLE(f, buffer, width, 1)) {
+      if (RGBE_ReadBytes_RLE(f, &buffer[0], width, 1, &rle)) {
          safeDelete(image);
-         safeDeleteArray(buffer);
-         return NULL;
+         break;
       }
       
-      for(unsigned j = width; j--;) {
-         const float *q = buffer + j * 3;
-         
-         image->setPixel<RgbaHDR>(i, j, RgbaHDR(q[0], q[1], q[2]));
-      }
+      RgbaHDR *row = (*image)[i];
+      
+      for(unsigned j = width; j--;)
+         hdrUtilsFromRGBE(&buffer[4 * j], row[j]);
    }
    
    fclose(f);
-   safeDeleteArray(buffer);
-   
    return image;
 }
 
@@ -106,45 +228,65 @@ HDRImage *HDRUtils::loadEXR(const string &filename) {
 }
 
 HDRImage *HDRUtils::loadPFM(const string &filename) {
-   NYI(); // TODO
-   
-   return NULL;
-}
-
-bool HDRUtils::saveHDR(const string &filename, const Image *image) {
-   const string &filenameExt = HDRUtils::_toFullName(filename, ".hdr");
-   const unsigned width  = image->getWidth();
-   const unsigned height = image->getHeight();
-   FILE *f = fopen(filenameExt.c_str(), "wb");
+   FILE *f = fopen(filename.c_str(), "rb");
+   unsigned width = 0, height = 0;
+   char   type[3] = { 0 };
+   double scale   = 0;
    
    if (NULL == f)
-      return false;
+      return NULL;
    
-   if (RGBE_WriteHeader(f, width, height, NULL))
-      return false;
+   // header consists of "PF" (RGB) or "Pf" (grayscale), the dimensions, and 
+   // a scale whose sign denotes the byte order of the data (negative for 
+   // little endian), followed by a single whitespace character
+   if (fscanf(f, "%2s %u %u %lf", type, &width, &height, &scale) != 4 || 
+       type[0] != 'P' || (type[1] != 'F' && type[1] != 'f') || 
+       width == 0 || height == 0 || scale == 0 || 
+       !isspace(fgetc(f)))
+   {
+      fclose(f);
+      return NULL;
+   }
    
-   float *buffer = new float[3 * width];
+   const unsigned noChannels = (type[1] == 'F' ? 3 : 1);
+   const bool     swap       = ((scale < 0) != hdrUtilsIsLittleEndian());
    
-   for(unsigned i = 0; i < height; ++i) {
-      for(unsigned j = width; j--;) {
-         const RgbaHDR &p = image->getPixel<RgbaHDR>(i, j);
-         float *q = buffer + j * 3;
-         
-         q[0] = static_cast<float>(MAX(create_real(0), p.r));
-         q[1] = static_cast<float>(MAX(create_real(0), p.g));
-         q[2] = static_cast<float>(MAX(create_real(0), p.b));
+   HDRImage *image = new HDRImage(width, height);
+   std::vector<float> buffer(noChannels * width);
+   
+   // scanlines are stored from the bottom of the image to the top
+   for(unsigned i = height; i--;) {
+      if (fread(&buffer[0], sizeof(float) * buffer.size(), 1, f) < 1) {
+         safeDelete(image);
+         break;
       }
       
-      if (RGBE_WritePixels_RLE(f, buffer, width, 1)) {
-         safeDeleteArray(buffer);
-         return false;
+      if (swap) {
+         for(unsigned j = buffer.size(); j--;)
+            hdrUtilsSwapBytes(buffer[j]);
+      }
+      
+      RgbaHDR *row = (*image)[i];
+      
+      if (noChannels == 3) {
+         for(unsigned j = width; j--;) {
+            const float *q = &buffer[3 * j];
+            
+            row[j] = RgbaHDR(q[0], q[1], q[2]);
+         }
+      } else {
+         for(unsigned j = width; j--;)
+            row[j] = RgbaHDR(buffer[j], buffer[j], buffer[j]);
       }
    }
    
    fclose(f);
-   safeDeleteArray(buffer);
-   
-   return true;
+   return image;
+}
+
+bool HDRUtils::saveHDR(const string &filename, const Image *image) {
+   return hdrUtilsSave(HDRUtils::_toFullName(filename, ".hdr"), image, 
+                       HDRScanlineWriter::HDR_FORMAT_RGBE);
 }
 
 bool HDRUtils::saveEXR(const string &filename, const Image *image) {
@@ -179,9 +321,8 @@ bool HDRUtils::saveEXR(const string &filename, const Image *image) {
 }
 
 bool HDRUtils::savePFM(const string &filename, const Image *image) {
-   NYI(); // TODO
-   
-   return false;
+   return hdrUtilsSave(HDRUtils::_toFullName(filename, ".pfm"), image, 
+                       HDRScanlineWriter::HDR_FORMAT_PFM);
 }
 
 HDRImage  *HDRUtils::toHDRImage (const RgbaImage *in) {
@@ -221,5 +362,109 @@ void HDRUtils::_warnMissingEXR(const char *function,
         << endl;
 }
 
+
+HDRScanlineWriter::~HDRScanlineWriter() {
+   close();
+}
+
+bool HDRScanlineWriter::open(const std::string &filename, unsigned width, 
+                             unsigned height, Format format)
+{
+   close();
+   
+   if (width == 0 || height == 0)
+      return false;
+   
+   m_file = fopen(filename.c_str(), "wb");
+   if (NULL == m_file)
+      return false;
+   
+   m_format  = format;
+   m_width   = width;
+   m_height  = height;
+   m_nextRow = 0;
+   
+   if (m_format == HDR_FORMAT_RGBE) {
+      m_buffer.resize(4 * width);
+      m_success = !RGBE_WriteHeader(m_file, width, height, NULL);
+   } else {
+      m_buffer.resize(3 * sizeof(float) * width);
+      
+      // a negative scale denotes little endian data
+      m_success = (fprintf(m_file, "PF\n%u %u\n%s\n", width, height, 
+                           hdrUtilsIsLittleEndian() ? "-1.0" : "1.0") > 0);
+      
+      // reserve space for all scanlines s.t. they may be written in any 
+      // order by seeking
+      if (m_success) {
+         m_dataOffset = hdrUtilsTell(m_file);
+         m_success    = (m_dataOffset >= 0 && 
+                         hdrUtilsSeek(m_file, (int64_t) m_buffer.size() * 
+                                      height - 1, SEEK_CUR) && 
+                         EOF != fputc(0, m_file));
+      }
+   }
+   
+   if (!m_success)
+      close();
+   
+   return m_success;
+}
+
+bool HDRScanlineWriter::writeScanline(unsigned row, const RgbaHDR *data) {
+   ASSERT(data);
+   
+   if (NULL == m_file || row >= m_height)
+      return (m_success = false);
+   
+   if (m_format == HDR_FORMAT_RGBE) {
+      // RGBE scanlines are run length encoded, so they can't be seeked to
+      if (row != m_nextRow)
+         return (m_success = false);
+      
+      unsigned char *rgbe = &m_buffer[0];
+      for(unsigned j = m_width; j--;)
+         hdrUtilsToRGBE(data[j], rgbe + 4 * j);
+      
+      if (RGBE_WriteBytes_RLE(m_file, rgbe, m_width, 1))
+         return (m_success = false);
+   } else {
+      float *q = (float *) &m_buffer[0];
+      
+      for(unsigned j = m_width; j--;) {
+         q[3 * j + 0] = static_cast<float>(data[j].r);
+         q[3 * j + 1] = static_cast<float>(data[j].g);
+         q[3 * j + 2] = static_cast<float>(data[j].b);
+      }
+      
+      // scanlines are stored from the bottom of the image to the top
+      const int64_t offset = m_dataOffset + 
+         (int64_t) (m_height - 1 - row) * m_buffer.size();
+      
+      if (!hdrUtilsSeek(m_file, offset, SEEK_SET) || 
+          fwrite(q, m_buffer.size(), 1, m_file) < 1)
+      {
+         return (m_success = false);
+      }
+   }
+   
+   ++m_nextRow;
+   return true;
+}
+
+bool HDRScanlineWriter::close() {
+   if (NULL == m_file)
+      return false;
+   
+   // note: PFM scanlines may have been written more than once
+   m_success &= (m_nextRow >= m_height);
+   
+   m_success &= (0 == fclose(m_file));
+   m_file = NULL;
+   
+   std::vector<unsigned char>().swap(m_buffer);
+   return m_success;
+}
+
 }
 
@@ -6,6 +6,11 @@
    @brief
       Utilities for reading and writing HDR, OpenEXR, and PFM high dynamic 
    range image formats
+      HDR (RGBE) and PFM images are encoded and decoded directly from / to 
+   the rows of an HDRImage's underlying data, bypassing Image's per-pixel 
+   virtual accessors, and may be written incrementally, one scanline at a 
+   time, via HDRScanlineWriter s.t. large images never have to be copied in 
+   their entirety.
    
    @note
       This code is based on similar code found in exrtools, by Billy Biggs 
@@ -16,13 +21,16 @@
 #define HDR_UTILS_H_
 
 #include <common/common.h>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 namespace milton {
 
 class HDRImage;
 class RgbaImage;
 class Image;
+struct RgbaHDR;
 
 class MILTON_DLL_EXPORT HDRUtils {
    public:
@@ -45,6 +53,107 @@ class MILTON_DLL_EXPORT HDRUtils {
                                   const std::string &filename);
 };
 
+/**
+ * @brief 
+ *    Streaming writer for HDR (RGBE) and PFM images, which encodes and 
+ * writes one scanline at a time, s.t. the image being written never has to 
+ * be materialized in memory in its entirety
+ * 
+ * @note HDR scanlines must be written in order from top to bottom, whereas 
+ *    PFM scanlines may be written in any order
+ */
+class MILTON_DLL_EXPORT HDRScanlineWriter {
+   public:
+      enum Format {
+         /// Ward's run length encoded RGBE format (Radiance)
+         HDR_FORMAT_RGBE = 0, 
+         
+         /// Portable Float Map (32-bit floating-point RGB)
+         HDR_FORMAT_PFM
+      };
+      
+      
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline HDRScanlineWriter()
+         : m_file(NULL), m_format(HDR_FORMAT_RGBE), m_width(0), m_height(0), 
+           m_nextRow(0), m_dataOffset(0), m_success(false)
+      { }
+      
+      /// closes the underlying file if it's still open
+      virtual ~HDRScanlineWriter();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Creates the given file and writes the header of a @p width by 
+       * @p height image in the given format
+       * 
+       * @returns whether or not the file was opened successfully
+       */
+      bool open(const std::string &filename, unsigned width, 
+                unsigned height, Format format);
+      
+      /**
+       * @brief 
+       *    Encodes and writes the @p width pixels in @p data as the given 
+       * row of the image, where row 0 is the top of the image
+       * 
+       * @returns whether or not the scanline was written successfully
+       */
+      bool writeScanline(unsigned row, const RgbaHDR *data);
+      
+      /**
+       * @brief 
+       *    Closes the underlying file
+       * 
+       * @returns whether or not all scanlines were written successfully
+       */
+      bool close();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      inline bool isOpen() const {
+         return (m_file != NULL);
+      }
+      
+      inline unsigned getWidth() const {
+         return m_width;
+      }
+      
+      inline unsigned getHeight() const {
+         return m_height;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      FILE    *m_file;
+      Format   m_format;
+      unsigned m_width;
+      unsigned m_height;
+      
+      /// number of scanlines written thus far (and the next row expected 
+      /// by the RGBE format)
+      unsigned m_nextRow;
+      
+      /// offset of the first PFM scanline in the file
+      int64_t  m_dataOffset;
+      bool     m_success;
+      
+      /// encoded scanline (4 bytes per pixel for RGBE, 3 floats for PFM)
+      std::vector<unsigned char> m_buffer;
+};
+
 }
 
 #endif // HDR_UTILS_H_
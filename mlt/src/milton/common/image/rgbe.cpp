@@ -258,7 +258,7 @@ int RGBE_ReadPixels(FILE *fp, float *data, int numpixels)
 /* save some space.  For each scanline, each channel (r,g,b,e) is */
 /* encoded separately for better compression. */
 
-static int RGBE_WriteBytes_RLE(FILE *fp, unsigned char *data, int numbytes)
+static int RGBE_WriteChannel_RLE(FILE *fp, unsigned char *data, int numbytes)
 {
 #define MINRUNLENGTH 4
    int cur, beg_run, run_count, old_run_count, nonrun_count;
@@ -345,7 +345,7 @@ int RGBE_WritePixels_RLE(FILE *fp, float *data, int scanline_width,
       /* write out each of the four channels separately run length encoded */
       /* first red, then green, then blue, then exponent */
       for(i=0;i<4;i++) {
-         if ((err = RGBE_WriteBytes_RLE(fp,&buffer[i*scanline_width],
+         if ((err = RGBE_WriteChannel_RLE(fp,&buffer[i*scanline_width],
                                         scanline_width)) != RGBE_RETURN_SUCCESS) {
             free(buffer);
             return err;
@@ -447,5 +447,166 @@ int RGBE_ReadPixels_RLE(FILE *fp, float *data, int scanline_width,
    return RGBE_RETURN_SUCCESS;
 }
 
+
+/* same as RGBE_WritePixels_RLE, except that the pixels have already been */
+/* converted to rgbe by the caller (four consecutive bytes per pixel)     */
+int RGBE_WriteBytes_RLE(FILE *fp, const unsigned char *rgbe, 
+                        int scanline_width, int num_scanlines)
+{
+   unsigned char header[4];
+   unsigned char *buffer;
+   int i, j, err;
+
+   if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
+      /* run length encoding is not allowed so write flat*/
+      if (fwrite(rgbe, 4*scanline_width, num_scanlines, fp) < 
+          (size_t)num_scanlines)
+         return rgbe_error(rgbe_write_error,NULL);
+      return RGBE_RETURN_SUCCESS;
+   }
+   buffer = (unsigned char *)malloc(sizeof(unsigned char)*4*scanline_width);
+   if (buffer == NULL) 
+      return rgbe_error(rgbe_memory_error,
+                        (char*)"unable to allocate buffer space");
+   while(num_scanlines-- > 0) {
+      header[0] = 2;
+      header[1] = 2;
+      header[2] = scanline_width >> 8;
+      header[3] = scanline_width & 0xFF;
+      if (fwrite(header, sizeof(header), 1, fp) < 1) {
+         free(buffer);
+         return rgbe_error(rgbe_write_error,NULL);
+      }
+      /* separate the channels s.t. each may be run length encoded */
+      for(i=0;i<scanline_width;i++) {
+         for(j=0;j<4;j++)
+            buffer[i+j*scanline_width] = rgbe[j];
+         rgbe += 4;
+      }
+      for(i=0;i<4;i++) {
+         if ((err = RGBE_WriteChannel_RLE(fp,&buffer[i*scanline_width],
+                                          scanline_width)) != RGBE_RETURN_SUCCESS) {
+            free(buffer);
+            return err;
+         }
+      }
+   }
+   free(buffer);
+   return RGBE_RETURN_SUCCESS;
+}
+
+/* same as RGBE_ReadPixels_RLE, except that the pixels are left in rgbe */
+/* (four consecutive bytes per pixel) for the caller to convert, and    */
+/* that whether the file is run length encoded may be carried across    */
+/* calls via is_rle                                                     */
+int RGBE_ReadBytes_RLE(FILE *fp, unsigned char *rgbe, int scanline_width,
+                       int num_scanlines, int *is_rle)
+{
+   unsigned char header[4], *scanline_buffer, *ptr, *ptr_end;
+   int i, j, count, rle;
+   unsigned char buf[2];
+
+   rle = (is_rle ? *is_rle : -1);
+   if ((scanline_width < 8)||(scanline_width > 0x7fff))
+      rle = 0;
+   if (is_rle && rle >= 0)
+      *is_rle = rle;
+   if (rle == 0) {
+      /* run length encoding is not allowed (or not used) so read flat */
+      if (fread(rgbe, 4*scanline_width, num_scanlines, fp) < 
+          (size_t)num_scanlines)
+         return rgbe_error(rgbe_read_error,NULL);
+      return RGBE_RETURN_SUCCESS;
+   }
+   scanline_buffer = NULL;
+   /* read in each successive scanline */
+   while(num_scanlines > 0) {
+      if (fread(header,sizeof(header),1,fp) < 1) {
+         free(scanline_buffer);
+         return rgbe_error(rgbe_read_error,NULL);
+      }
+      if ((header[0] != 2)||(header[1] != 2)||(header[2] & 0x80)) {
+         if (rle > 0) {
+            /* a flat pixel can't follow run length encoded scanlines */
+            free(scanline_buffer);
+            return rgbe_error(rgbe_format_error,
+                              (char*)"bad scanline header");
+         }
+         /* this file is not run length encoded */
+         if (is_rle)
+            *is_rle = 0;
+         free(scanline_buffer);
+         memcpy(rgbe, header, sizeof(header));
+         count = scanline_width*num_scanlines-1;
+         if (count > 0 && fread(rgbe + 4, 4*count, 1, fp) < 1)
+            return rgbe_error(rgbe_read_error,NULL);
+         return RGBE_RETURN_SUCCESS;
+      }
+      rle = 1;
+      if (is_rle)
+         *is_rle = 1;
+      if ((((int)header[2])<<8 | header[3]) != scanline_width) {
+         free(scanline_buffer);
+         return rgbe_error(rgbe_format_error,
+                           (char*)"wrong scanline width");
+      }
+      if (scanline_buffer == NULL)
+         scanline_buffer = (unsigned char *)
+            malloc(sizeof(unsigned char)*4*scanline_width);
+      if (scanline_buffer == NULL) 
+         return rgbe_error(rgbe_memory_error,
+                           (char*)"unable to allocate buffer space");
+
+      ptr = &scanline_buffer[0];
+      /* read each of the four channels for the scanline into the buffer */
+      for(i=0;i<4;i++) {
+         ptr_end = &scanline_buffer[(i+1)*scanline_width];
+         while(ptr < ptr_end) {
+            if (fread(buf,sizeof(buf[0])*2,1,fp) < 1) {
+               free(scanline_buffer);
+               return rgbe_error(rgbe_read_error,NULL);
+            }
+            if (buf[0] > 128) {
+               /* a run of the same value */
+               count = buf[0]-128;
+               if ((count == 0)||(count > ptr_end - ptr)) {
+                  free(scanline_buffer);
+                  return rgbe_error(rgbe_format_error,
+                                    (char*)"bad scanline data");
+               }
+               memset(ptr, buf[1], count);
+               ptr += count;
+            }
+            else {
+               /* a non-run */
+               count = buf[0];
+               if ((count == 0)||(count > ptr_end - ptr)) {
+                  free(scanline_buffer);
+                  return rgbe_error(rgbe_format_error,
+                                    (char*)"bad scanline data");
+               }
+               *ptr++ = buf[1];
+               if (--count > 0) {
+                  if (fread(ptr,sizeof(*ptr)*count,1,fp) < 1) {
+                     free(scanline_buffer);
+                     return rgbe_error(rgbe_read_error,NULL);
+                  }
+                  ptr += count;
+               }
+            }
+         }
+      }
+      /* now interleave the channels into the output */
+      for(i=0;i<scanline_width;i++) {
+         for(j=0;j<4;j++)
+            rgbe[j] = scanline_buffer[i+j*scanline_width];
+         rgbe += 4;
+      }
+      num_scanlines--;
+   }
+   free(scanline_buffer);
+   return RGBE_RETURN_SUCCESS;
+}
+
 }
 
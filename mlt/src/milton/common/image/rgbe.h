@@ -102,6 +102,33 @@ int RGBE_WritePixels_RLE(FILE *fp, float *data, int scanline_width,
 int RGBE_ReadPixels_RLE(FILE *fp, float *data, int scanline_width,
                         int num_scanlines);
 
+/** 
+ * @brief
+ *    writes run length encoded files from pixels which have already been 
+ * converted to rgbe (four consecutive bytes per pixel)
+ * 
+ * @note
+ *    must be called to write whole scanlines
+ */
+int RGBE_WriteBytes_RLE(FILE *fp, const unsigned char *rgbe, 
+                        int scanline_width, int num_scanlines);
+
+/** 
+ * @brief
+ *    reads run length encoded files into pixels which are left in rgbe 
+ * (four consecutive bytes per pixel)
+ * 
+ * @param is_rle if non-NULL and negative, whether the file is run length 
+ *    encoded is determined from the first scanline read and stored in 
+ *    @p is_rle, s.t. subsequent calls for the same file don't mistake a 
+ *    flat scanline beginning with a (2, 2, <128) pixel for an encoded one
+ * 
+ * @note
+ *    must be called to read whole scanlines
+ */
+int RGBE_ReadBytes_RLE(FILE *fp, unsigned char *rgbe, int scanline_width,
+                       int num_scanlines, int *is_rle);
+
 }
 
 #endif /* RGBE_H_ */
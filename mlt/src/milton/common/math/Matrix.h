@@ -288,6 +288,9 @@ MILTON_DLL_EXPORT
 /* Include inline implementations */
 #include <common/math/Matrix.inl>
 
+/* Include SIMD specializations of common transformations (if enabled) */
+#include <common/math/simd/MatrixSIMD.inl>
+
 namespace milton {
 
 /* The following global functions are not templated, so they will be found in 
@@ -0,0 +1,200 @@
+/**<!-------------------------------------------------------------------->
+   @file   MatrixSIMD.inl
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Fall 2008
+   
+   @brief
+      SIMD-accelerated specializations of Matrix4x4 * Point3 and
+   Matrix4x4 * Vector3, which dominate ray transformations into object space
+   (see Transformable::_transformRayWorldToObj).  The backend is selected via
+   MILTON_SIMD independently of floating-point precision:  single precision
+   uses __m128, whereas double precision uses either pairs of __m128d (SSE2)
+   or __m256d (AVX).
+   
+   @note this file is not meant to be #included directly
+   @see Matrix.h for more details
+   <!-------------------------------------------------------------------->**/
+
+#ifndef MATRIX_SIMD_INL_
+#define MATRIX_SIMD_INL_
+
+#if (MILTON_SIMD != MILTON_SIMD_NONE)
+
+#include <emmintrin.h> // SSE2
+#if (MILTON_SIMD == MILTON_SIMD_AVX) && MILTON_DOUBLE_PRECISION
+#  include <immintrin.h> // AVX
+#endif
+
+namespace milton {
+
+///@name SIMD transformation kernels
+//@{-----------------------------------------------------------------------------
+
+/**
+ * @brief 
+ *    Computes out = m * v, where @p m is a row-major 4x4 matrix and @p v
+ * and @p out are 4-vectors
+ * @note none of the arguments are required to be aligned
+ */
+inline void simdTransform4(const real_t *m, const real_t *v, real_t *out);
+
+/**
+ * @brief 
+ *    Computes out = m * v, where @p m is a row-major 4x4 matrix of which
+ * only the upper 3x3 is used, and @p v and @p out are 3-vectors
+ * @note none of the arguments are required to be aligned
+ */
+inline void simdTransform3(const real_t *m, const real_t *v, real_t *out);
+
+//@}-----------------------------------------------------------------------------
+
+#if MILTON_SINGLE_PRECISION
+
+inline void simdTransform4(const real_t *m, const real_t *v, real_t *out) {
+   const __m128 vv = _mm_loadu_ps(v);
+   
+   __m128 r0 = _mm_mul_ps(_mm_loadu_ps(m +  0), vv);
+   __m128 r1 = _mm_mul_ps(_mm_loadu_ps(m +  4), vv);
+   __m128 r2 = _mm_mul_ps(_mm_loadu_ps(m +  8), vv);
+   __m128 r3 = _mm_mul_ps(_mm_loadu_ps(m + 12), vv);
+   
+   // sum the products along each row
+   _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+   
+   _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+}
+
+inline void simdTransform3(const real_t *m, const real_t *v, real_t *out) {
+   const __m128 vv = _mm_set_ps(0, v[2], v[1], v[0]);
+   
+   __m128 r0 = _mm_mul_ps(_mm_loadu_ps(m +  0), vv);
+   __m128 r1 = _mm_mul_ps(_mm_loadu_ps(m +  4), vv);
+   __m128 r2 = _mm_mul_ps(_mm_loadu_ps(m +  8), vv);
+   __m128 r3 = _mm_setzero_ps();
+   
+   _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+   
+   float result[4];
+   _mm_storeu_ps(result, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+   
+   out[0] = result[0];
+   out[1] = result[1];
+   out[2] = result[2];
+}
+
+#elif (MILTON_SIMD == MILTON_SIMD_AVX)
+
+inline void simdTransform4(const real_t *m, const real_t *v, real_t *out) {
+   const __m256d vv = _mm256_loadu_pd(v);
+   
+   const __m256d r0 = _mm256_mul_pd(_mm256_loadu_pd(m +  0), vv);
+   const __m256d r1 = _mm256_mul_pd(_mm256_loadu_pd(m +  4), vv);
+   const __m256d r2 = _mm256_mul_pd(_mm256_loadu_pd(m +  8), vv);
+   const __m256d r3 = _mm256_mul_pd(_mm256_loadu_pd(m + 12), vv);
+   
+   // t0 = [r0.01, r1.01, r0.23, r1.23], t1 = [r2.01, r3.01, r2.23, r3.23]
+   const __m256d t0 = _mm256_hadd_pd(r0, r1);
+   const __m256d t1 = _mm256_hadd_pd(r2, r3);
+   
+   // [r0.23, r1.23, r2.01, r3.01] + [r0.01, r1.01, r2.23, r3.23]
+   const __m256d swapped = _mm256_permute2f128_pd(t0, t1, 0x21);
+   const __m256d blended = _mm256_blend_pd(t0, t1, 0xC);
+   
+   _mm256_storeu_pd(out, _mm256_add_pd(swapped, blended));
+}
+
+inline void simdTransform3(const real_t *m, const real_t *v, real_t *out) {
+   const __m256d vv = _mm256_set_pd(0, v[2], v[1], v[0]);
+   
+   const __m256d r0 = _mm256_mul_pd(_mm256_loadu_pd(m + 0), vv);
+   const __m256d r1 = _mm256_mul_pd(_mm256_loadu_pd(m + 4), vv);
+   const __m256d r2 = _mm256_mul_pd(_mm256_loadu_pd(m + 8), vv);
+   
+   const __m256d t0 = _mm256_hadd_pd(r0, r1);
+   const __m256d t1 = _mm256_hadd_pd(r2, _mm256_setzero_pd());
+   
+   const __m256d swapped = _mm256_permute2f128_pd(t0, t1, 0x21);
+   const __m256d blended = _mm256_blend_pd(t0, t1, 0xC);
+   
+   double result[4];
+   _mm256_storeu_pd(result, _mm256_add_pd(swapped, blended));
+   
+   out[0] = result[0];
+   out[1] = result[1];
+   out[2] = result[2];
+}
+
+#else // MILTON_SIMD_SSE2 && MILTON_DOUBLE_PRECISION
+
+/// @returns [a.0 + a.1, b.0 + b.1]
+static inline __m128d simdHAdd(const __m128d &a, const __m128d &b) {
+   return _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+}
+
+inline void simdTransform4(const real_t *m, const real_t *v, real_t *out) {
+   const __m128d v01 = _mm_loadu_pd(v);
+   const __m128d v23 = _mm_loadu_pd(v + 2);
+   
+   // partial dot products of each row with v, two lanes at a time
+   const __m128d r0 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m +  0), v01), 
+                                 _mm_mul_pd(_mm_loadu_pd(m +  2), v23));
+   const __m128d r1 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m +  4), v01), 
+                                 _mm_mul_pd(_mm_loadu_pd(m +  6), v23));
+   const __m128d r2 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m +  8), v01), 
+                                 _mm_mul_pd(_mm_loadu_pd(m + 10), v23));
+   const __m128d r3 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 12), v01), 
+                                 _mm_mul_pd(_mm_loadu_pd(m + 14), v23));
+   
+   _mm_storeu_pd(out,     simdHAdd(r0, r1));
+   _mm_storeu_pd(out + 2, simdHAdd(r2, r3));
+}
+
+inline void simdTransform3(const real_t *m, const real_t *v, real_t *out) {
+   const __m128d v01 = _mm_loadu_pd(v);
+   const __m128d v2_ = _mm_load_sd(v + 2); // [v.2, 0]
+   
+   const __m128d r0 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 0), v01), 
+                                 _mm_mul_pd(_mm_load_sd(m + 2),  v2_));
+   const __m128d r1 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 4), v01), 
+                                 _mm_mul_pd(_mm_load_sd(m + 6),  v2_));
+   const __m128d r2 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 8), v01), 
+                                 _mm_mul_pd(_mm_load_sd(m + 10), v2_));
+   
+   _mm_storeu_pd(out, simdHAdd(r0, r1));
+   _mm_store_sd (out + 2, _mm_add_sd(r2, _mm_unpackhi_pd(r2, r2)));
+}
+
+#endif // MILTON_SINGLE_PRECISION
+
+
+///@name Matrix4x4 specializations
+//@{-----------------------------------------------------------------------------
+
+template <>
+inline Point<4, real_t> Matrix<4, 4, real_t>::operator* (
+   const Point<4, real_t> &rhs) const
+{
+   Point<4, real_t> ret;
+   
+   simdTransform4(rows[0].data, rhs.data, ret.data);
+   return ret;
+}
+
+template <>
+inline Vector<3, real_t> Matrix<4, 4, real_t>::operator* (
+   const Vector<3, real_t> &rhs) const
+{
+   Vector<3, real_t> ret;
+   
+   simdTransform3(rows[0].data, rhs.data, ret.data);
+   return ret;
+}
+
+//@}-----------------------------------------------------------------------------
+
+}
+
+#endif // MILTON_SIMD != MILTON_SIMD_NONE
+
+#endif // MATRIX_SIMD_INL_
+
@@ -14,9 +14,9 @@
 namespace milton {
 
 void GaussianFilter::init() {
-   KernelFilter::init();
-   
    m_sigma = getValue<real_t>("sigma", m_sigma);
+   
+   KernelFilter::init();
 }
 
 real_t GaussianFilter::evaluate(const Vector2 &pt) {
@@ -30,5 +30,16 @@ real_t GaussianFilter::evaluate(const Vector2 &pt) {
    return MAX(0.0, (1.0 / (sqrt(2.0 * M_PI) * m_sigma)) * exp(weight));
 }
 
+real_t GaussianFilter::evaluate1D(real_t x) {
+   ASSERT(m_sigma > 0);
+   
+   // square root of the 2D normalization s.t. the product of the two 1D 
+   // factors equals evaluate
+   const real_t coeff  = (-0.5) / (m_sigma * m_sigma);
+   const real_t norm   = sqrt(1.0 / (sqrt(2.0 * M_PI) * m_sigma));
+   
+   return MAX(0.0, norm * exp(coeff * x * x));
+}
+
 }
 
@@ -4,9 +4,9 @@
    @date   Fall 2008
    
    @brief
-      2D discrete, symmetric gaussian filter (separable like most of the 
-   other filters, but we're not taking advantage of this to make the 
-   filter framework cleaner and more cohesive), centered at the origin
+      2D discrete, symmetric gaussian filter centered at the origin, which 
+   is separable s.t. it may be tabulated along a single dimension (see 
+   KernelFilter::isSeparable)
    <!-------------------------------------------------------------------->**/
 
 #ifndef GAUSSIAN_FILTER_H_
@@ -46,6 +46,15 @@ class MILTON_DLL_EXPORT GaussianFilter : public KernelFilter {
        */
       virtual real_t evaluate(const Vector2 &pt);
       
+      /// @returns true (this filter is separable)
+      virtual bool isSeparable() const {
+         return true;
+      }
+      
+      /// @returns the value of the 1D factor of this filter evaluated at 
+      ///    the given offset
+      virtual real_t evaluate1D(real_t x);
+      
       
       //@}-----------------------------------------------------------------
       ///@name Accessors / Mutators
@@ -11,10 +11,115 @@
 #include "KernelFilter.h"
 #include <Image.h>
 #include <filters.h>
+#include <System.h>
+#include <QtCore/QtCore>
 using namespace std;
 
 namespace milton {
 
+/**
+ * @brief 
+ *    Worker thread which convolves a contiguous band of rows of an image 
+ * with a separable kernel in either of KernelFilter's two 1D passes
+ */
+class kernelFilterApplyThread : public QThread {
+   public:
+      inline kernelFilterApplyThread(Image *image, RgbaHDR *temp, 
+                                     const real_t *kernel, int kernelWidth, 
+                                     int begin, int end)
+         : QThread(), m_image(image), m_temp(temp), m_kernel(kernel), 
+           m_kernelWidth(kernelWidth), m_begin(begin), m_end(end), 
+           m_vertical(false)
+      { }
+      
+      virtual ~kernelFilterApplyThread()
+      { }
+      
+      /// convolves each row of this band horizontally into m_temp
+      void horizontal() {
+         const int width = m_image->getWidth();
+         const int half  = (m_kernelWidth >> 1);
+         std::vector<RgbaHDR> line(width + 2 * half);
+         
+         for(int i = m_begin; i < m_end; ++i) {
+            // copy the current row, padded by replicating its border pixels
+            for(int j = -half; j < width + half; ++j) {
+               const int col = CLAMP(j, 0, width - 1);
+               
+               line[j + half] = m_image->getPixel<RgbaHDR>(i, col);
+            }
+            
+            RgbaHDR *out = m_temp + i * width;
+            
+            for(int j = 0; j < width; ++j) {
+               const RgbaHDR *in = &line[j];
+               real_t r = 0, g = 0, b = 0;
+               
+               for(int k = 0; k < m_kernelWidth; ++k) {
+                  const real_t weight = m_kernel[k];
+                  
+                  r += in[k].r * weight;
+                  g += in[k].g * weight;
+                  b += in[k].b * weight;
+               }
+               
+               out[j] = RgbaHDR(r, g, b);
+            }
+         }
+      }
+      
+      /// convolves m_temp vertically into each row of this band, one tile 
+      /// of KERNEL_FILTER_TILE_WIDTH pixels at a time
+      void vertical() {
+         const int width  = m_image->getWidth();
+         const int height = m_image->getHeight();
+         const int half   = (m_kernelWidth >> 1);
+         RgbaHDR tile[KERNEL_FILTER_TILE_WIDTH];
+         
+         for(int i = m_begin; i < m_end; ++i) {
+            for(int x = 0; x < width; x += KERNEL_FILTER_TILE_WIDTH) {
+               const int n = MIN(KERNEL_FILTER_TILE_WIDTH, width - x);
+               
+               for(int j = n; j--;)
+                  tile[j] = RgbaHDR(0, 0, 0);
+               
+               for(int k = 0; k < m_kernelWidth; ++k) {
+                  const int row = CLAMP(i + k - half, 0, height - 1);
+                  const RgbaHDR *in = m_temp + row * width + x;
+                  const real_t weight = m_kernel[k];
+                  
+                  for(int j = 0; j < n; ++j) {
+                     tile[j].r += in[j].r * weight;
+                     tile[j].g += in[j].g * weight;
+                     tile[j].b += in[j].b * weight;
+                  }
+               }
+               
+               for(int j = 0; j < n; ++j)
+                  m_image->setPixel<RgbaHDR>(i, x + j, tile[j]);
+            }
+         }
+      }
+      
+      virtual void run() {
+         if (m_vertical)
+            vertical();
+         else 
+            horizontal();
+      }
+   
+   public:
+      Image        *m_image;
+      RgbaHDR      *m_temp;
+      const real_t *m_kernel;
+      int           m_kernelWidth;
+      int           m_begin;
+      int           m_end;
+      
+      /// whether this thread performs the vertical or horizontal pass
+      bool          m_vertical;
+};
+
 KernelFilter *KernelFilter::create(const std::string &type, PropertyMap &p) {
    // Parse filter from PropertyMap (or defaults)
    const unsigned support = p.getValue<unsigned>("support", 2);
@@ -55,6 +160,8 @@ void KernelFilter::init() {
       _computeKernel();
       ASSERT(m_kernel);
    }
+   
+   _computeTable();
 }
 
 /*
@@ -83,9 +190,13 @@ void KernelFilter::apply(Image *image) {
       ASSERT(m_kernel);
    }
    
+   if (!m_kernel1D.empty()) {
+      _applySeparable(image);
+      return;
+   }
+   
    const int width  = image->getWidth();
    const int height = image->getHeight();
-   const int size   = image->getSize();
    const int half   = (m_width >> 1);
    Image *temp = image->clone();
    
@@ -94,7 +205,6 @@ void KernelFilter::apply(Image *image) {
       for(int j = width; j--;) {
          real_t *kernel = m_kernel;
          RgbaHDR rgb(0, 0, 0);
-         real_t sum = 0;
          
          // Convolve kernel with current pixel of input image
          for(int y = -half; y <= half; ++y) {
@@ -105,7 +215,6 @@ void KernelFilter::apply(Image *image) {
                
                const RgbaHDR &d = image->getPixel<RgbaHDR>(row, col);
                real_t weight = *kernel++;
-               sum   += weight;
                
                rgb.r += d.r * weight;
                rgb.g += d.g * weight;
@@ -113,7 +222,7 @@ void KernelFilter::apply(Image *image) {
             }
          }
          
-         temp->setPixel<RgbaHDR>(i, j, rgb / sum);
+         temp->setPixel<RgbaHDR>(i, j, rgb / m_kernelSum);
       }
    }
    
@@ -136,7 +245,6 @@ RgbaHDR KernelFilter::apply(Image *image, real_t x_, real_t y_) {
    
    real_t *kernel = m_kernel;
    RgbaHDR rgb(0, 0, 0);
-   real_t sum = 0;
    
    // Convolve kernel at a single location in input image
    for(int i = -half; i <= half; ++i) {
@@ -147,7 +255,6 @@ RgbaHDR KernelFilter::apply(Image *image, real_t x_, real_t y_) {
          
          const RgbaHDR &d = image->getPixel<RgbaHDR>(row, col);
          real_t weight = *kernel++;
-         sum   += weight;
          
          rgb.r += d.r * weight;
          rgb.g += d.g * weight;
@@ -155,7 +262,7 @@ RgbaHDR KernelFilter::apply(Image *image, real_t x_, real_t y_) {
       }
    }
    
-   rgb /= sum;
+   rgb /= m_kernelSum;
    return rgb;
 }
 
@@ -166,14 +273,120 @@ void KernelFilter::_computeKernel() {
    safeDeleteArray(m_kernel);
    m_kernel = new real_t[getSize()];
    
+   m_kernelSum = 0;
+   
    for(unsigned i = m_width; i--;) {
       for(unsigned j = m_width; j--;) {
          const real_t val = evaluate(Vector2(i - half, j - half));
          
          m_kernel[i * m_width + j] = val;
+         m_kernelSum += val;
+      }
+   }
+   
+   // note: clamping at the image's borders ensures all of the kernel's 
+   // weights are used at every pixel, s.t. apply may normalize by 
+   // m_kernelSum instead of re-summing the weights for every lookup
+   m_kernel1D.clear();
+   
+   if (isSeparable()) {
+      m_kernel1D.resize(m_width);
+      real_t sum = 0;
+      
+      for(unsigned i = m_width; i--;) {
+         m_kernel1D[i] = evaluate1D(i - half);
+         sum += m_kernel1D[i];
+      }
+      
+      if (sum != 0) {
+         for(unsigned i = m_width; i--;)
+            m_kernel1D[i] /= sum;
+      } else {
+         m_kernel1D.clear();
       }
    }
 }
 
+void KernelFilter::_applySeparable(Image *image) {
+   const unsigned height = image->getHeight();
+   const unsigned n      = image->getSize();
+   
+   if (n == 0)
+      return;
+   
+   // result of the horizontal pass
+   std::vector<RgbaHDR> temp(n);
+   
+   // split the image into bands of rows, only using as many threads as 
+   // there are bands large enough to be worth processing in parallel
+   unsigned noThreads = 
+      getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+   noThreads = MIN(noThreads, n / KERNEL_FILTER_MIN_PIXELS_PER_THREAD);
+   noThreads = CLAMP(noThreads, 1u, height);
+   
+   std::vector<kernelFilterApplyThread *> threads;
+   threads.reserve(noThreads);
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      const unsigned begin = (unsigned)(((uint64_t)height * i) / noThreads);
+      const unsigned end   = 
+         (unsigned)(((uint64_t)height * (i + 1)) / noThreads);
+      
+      threads.push_back(new kernelFilterApplyThread( 
+         image, &temp[0], &m_kernel1D[0], m_width, begin, end));
+   }
+   
+   // note: the last band is always processed on the calling thread, and 
+   // the vertical pass may only begin once every band has been convolved 
+   // horizontally, since it reads rows of neighboring bands
+   kernelFilterApplyThread *last = threads.back();
+   
+   for(unsigned i = 0; i + 1 < noThreads; ++i)
+      threads[i]->start();
+   
+   last->horizontal();
+   
+   for(unsigned i = 0; i + 1 < noThreads; ++i)
+      while(!threads[i]->wait());
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      threads[i]->m_vertical = true;
+      
+      if (threads[i] != last)
+         threads[i]->start();
+   }
+   
+   last->vertical();
+   
+   for(unsigned i = 0; i + 1 < noThreads; ++i)
+      while(!threads[i]->wait());
+   
+   FOREACH(std::vector<kernelFilterApplyThread *>::iterator, threads, iter) {
+      safeDelete(*iter);
+   }
+}
+
+void KernelFilter::_computeTable() {
+   m_table.clear();
+   
+   if (!isSeparable())
+      return;
+   
+   // offsets between a sample and the pixels it contributes to range over 
+   // (-(half + 1), half], where half is the half-width of the kernel
+   m_tableRadius = (m_width >> 1) + 1;
+   
+   const unsigned size = 
+      (unsigned)(2 * m_tableRadius * KERNEL_FILTER_TABLE_RESOLUTION) + 1;
+   m_table.resize(size);
+   
+   for(unsigned i = size; i--;) {
+      const real_t x = 
+         ((real_t) i) / KERNEL_FILTER_TABLE_RESOLUTION - m_tableRadius;
+      
+      m_table[i] = evaluate1D(x);
+   }
+}
+
 }
 
@@ -6,6 +6,11 @@
    @brief
       2D discrete, symmetric filter which can be compactly / efficiently 
    stored / applied using a 2D kernel (array)
+      Separable filters are additionally tabulated along one dimension upon 
+   initialization, s.t. they may be evaluated at arbitrary offsets via two 
+   table lookups (see evaluateTable) instead of evaluating the underlying, 
+   potentially expensive filter function, and images are convolved with 
+   them via two 1D passes (see apply).
    <!-------------------------------------------------------------------->**/
 
 #ifndef KERNEL_FILTER_H_
@@ -13,6 +18,17 @@
 
 #include <filters/Filter.h>
 #include <common/image/Rgba.h>
+#include <vector>
+
+/// number of entries per unit (pixel) in a separable KernelFilter's table
+#define KERNEL_FILTER_TABLE_RESOLUTION   (1024)
+
+/// number of pixels per row of a tile in the vertical pass of a separable 
+/// convolution, s.t. a tile's accumulators remain in cache
+#define KERNEL_FILTER_TILE_WIDTH         (64)
+
+/// minimum number of pixels each thread is given when convolving an image
+#define KERNEL_FILTER_MIN_PIXELS_PER_THREAD   (1 << 15)
 
 namespace milton {
 
@@ -26,7 +42,8 @@ class MILTON_DLL_EXPORT KernelFilter : public Filter2D {
       inline KernelFilter(real_t support = 2)
          : Filter2D(support), 
            m_width(((unsigned)ceil(support)) | 1), 
-           m_kernel(NULL), m_isNormalized(false)
+           m_kernel(NULL), m_kernelSum(0), m_isNormalized(false), 
+           m_tableRadius(0)
       {
          // Note: cannot call _computeKernel in constructor because 
          // both it and evaluate (which the default implementation of 
@@ -61,11 +78,57 @@ class MILTON_DLL_EXPORT KernelFilter : public Filter2D {
        */
       virtual real_t evaluate(const Vector2 &pt) = 0;
       
+      /**
+       * @returns whether or not this filter is separable, s.t. 
+       *    evaluate(pt) == evaluate1D(pt[0]) * evaluate1D(pt[1])
+       * 
+       * @note default implementation returns false
+       */
+      virtual bool isSeparable() const {
+         return false;
+      }
+      
+      /**
+       * @returns the value of the 1D factor of this separable filter 
+       *    evaluated at the given offset
+       * 
+       * @note only meaningful if isSeparable returns true; default 
+       *    implementation returns zero
+       */
+      virtual real_t evaluate1D(real_t /* x */) {
+         return 0;
+      }
+      
+      /**
+       * @returns the value of the 1D factor of this separable filter at the 
+       *    given offset, linearly interpolated from the table computed by 
+       *    init, or zero if @p x lies outside of the table's domain
+       * 
+       * @note only valid if hasTable returns true; thread-safe
+       */
+      inline real_t evaluateTable(real_t x) const {
+         const real_t t = 
+            (x + m_tableRadius) * KERNEL_FILTER_TABLE_RESOLUTION;
+         
+         if (!(t >= 0) || t >= m_table.size() - 1)
+            return 0;
+         
+         // linearly interpolate between the two nearest entries
+         const unsigned i = (unsigned) t;
+         const real_t   f = t - i;
+         
+         return m_table[i] + (m_table[i + 1] - m_table[i]) * f;
+      }
+      
       /**
        * @brief
        *    Applies this filter to the given image, (performs discrete 
        * convolution with the given image and this 2D filter)
        * 
+       * @note if this filter is separable, the image is convolved with its 
+       *    1D kernel horizontally and then vertically, in parallel over 
+       *    bands of rows on up to 'noRenderThreads' threads; otherwise, the 
+       *    full 2D kernel is applied at every pixel
        * @note this involves allocating a temporary intermediate image
        */
       void apply(Image *image);
@@ -97,18 +160,43 @@ class MILTON_DLL_EXPORT KernelFilter : public Filter2D {
          return m_width * m_width;
       }
       
+      /// @returns whether or not this filter has been tabulated (only 
+      ///    separable filters are tabulated)
+      inline bool hasTable() const {
+         return !m_table.empty();
+      }
+      
       //@}-----------------------------------------------------------------
       
    protected:
-      /// Allocates and initializes m_kernel
+      /// Allocates and initializes m_kernel (and m_kernel1D if this filter 
+      /// is separable)
       virtual void _computeKernel();
       
+      /// Convolves the given image with m_kernel1D along both dimensions
+      void _applySeparable(Image *image);
+      
+      /**
+       * @brief
+       *    Tabulates evaluate1D over all offsets from a pixel which may lie 
+       * within this filter's kernel, if this filter is separable
+       */
+      virtual void _computeTable();
+      
    protected:
       unsigned m_width;
       real_t  *m_kernel;
+      real_t   m_kernelSum;
+      
+      /// normalized 1D factor of m_kernel (empty if not separable)
+      std::vector<real_t> m_kernel1D;
       
       /// whether or not 'apply' should assume the kernel is normalized
       bool     m_isNormalized;
+      
+      /// values of evaluate1D over [-m_tableRadius, m_tableRadius]
+      std::vector<real_t> m_table;
+      real_t   m_tableRadius;
 };
 
 }
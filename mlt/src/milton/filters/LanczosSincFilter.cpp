@@ -18,15 +18,19 @@
 namespace milton {
 
 void LanczosSincFilter::init() {
-   KernelFilter::init();
-   
    m_tau = getValue<real_t>("tau", m_tau);
+   
+   KernelFilter::init();
 }
 
 real_t LanczosSincFilter::evaluate(const Vector2 &pt) {
    return _evaluate(pt[0]) * _evaluate(pt[1]);
 }
 
+real_t LanczosSincFilter::evaluate1D(real_t x) {
+   return _evaluate(x);
+}
+
 real_t LanczosSincFilter::_evaluate(real_t x) const {
    x = fabs(x / m_support);
    
@@ -18,16 +18,22 @@
 namespace milton {
 
 void MitchellFilter::init() {
-   KernelFilter::init();
-   
    m_B = getValue<real_t>("B", m_B);
    m_C = getValue<real_t>("C", m_C);
+   
+   // parameters are parsed first s.t. the kernel and table computed by 
+   // KernelFilter::init reflect them
+   KernelFilter::init();
 }
 
 real_t MitchellFilter::evaluate(const Vector2 &pt) {
    return _evaluate(pt[0]) * _evaluate(pt[1]);
 }
 
+real_t MitchellFilter::evaluate1D(real_t x) {
+   return _evaluate(x);
+}
+
 real_t MitchellFilter::_evaluate(real_t x) const {
    x = ABS(2.0 * x / m_support);
    
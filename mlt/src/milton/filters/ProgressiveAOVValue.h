@@ -0,0 +1,94 @@
+/**<!-------------------------------------------------------------------->
+   @class  ProgressiveAOVValue
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Progressive, weighted sums of the auxiliary outputs (AOVs) of all 
+   samples which contributed to a pixel, accumulated alongside a 
+   ProgressiveFilterValue with the same reconstruction filter weights. 
+      Normals and albedos are averaged over all samples s.t. they're 
+   antialiased in the same way as the rendered image, whereas depth is only 
+   averaged over samples which intersected a surface.  Object and material 
+   IDs can't be meaningfully averaged, so the IDs of the sample with the 
+   largest weight (ie. the one nearest the pixel's center) are kept.
+   <!-------------------------------------------------------------------->**/
+
+#ifndef PROGRESSIVE_AOV_VALUE_H_
+#define PROGRESSIVE_AOV_VALUE_H_
+
+#include <renderers/PointSample.h>
+
+namespace milton {
+
+struct MILTON_DLL_EXPORT ProgressiveAOVValue {
+   /// weighted sum of the depths of samples which intersected a surface, 
+   /// and the sum of their weights
+   real_t   depth;
+   real_t   depthWeight;
+   
+   /// weighted sums of the normals and albedos of all samples, and the sum 
+   /// of their weights
+   Vector3  normal;
+   Vector3  albedo;
+   real_t   weight;
+   
+   /// IDs of the sample with the largest weight thus far, and its weight
+   unsigned objectId;
+   unsigned materialId;
+   real_t   idWeight;
+   
+   inline ProgressiveAOVValue()
+      : depth(0), depthWeight(0), normal(), albedo(), weight(0), 
+        objectId(0), materialId(0), idWeight(0)
+   { }
+   
+   inline void addSample(const PointSampleAOV &aov, real_t weight_) {
+      if (aov.depth < INFINITY) {
+         depth       += aov.depth * weight_;
+         depthWeight += weight_;
+      }
+      
+      normal += aov.normal * weight_;
+      albedo += aov.albedo * weight_;
+      weight += weight_;
+      
+      if (weight_ > idWeight) {
+         objectId   = aov.objectId;
+         materialId = aov.materialId;
+         idWeight   = weight_;
+      }
+   }
+   
+   /**
+    * @returns the filtered AOVs of all samples thus far, where the depth of 
+    *    pixels without any samples that intersected a surface is INFINITY, 
+    *    and the averaged normal is renormalized
+    */
+   inline PointSampleAOV getValue() const {
+      PointSampleAOV aov;
+      
+      if (depthWeight > 0)
+         aov.depth = depth / depthWeight;
+      
+      if (weight > 0) {
+         aov.normal = normal / weight;
+         aov.albedo = albedo / weight;
+         
+         const real_t length = aov.normal.getMagnitude();
+         if (length > 0)
+            aov.normal /= length;
+      }
+      
+      aov.objectId   = objectId;
+      aov.materialId = materialId;
+      aov.valid      = (weight > 0);
+      
+      return aov;
+   }
+};
+
+}
+
+#endif // PROGRESSIVE_AOV_VALUE_H_
+
@@ -0,0 +1,100 @@
+/**<!-------------------------------------------------------------------->
+   @class  ProgressiveVarianceValue
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Running, weighted first and second moments of a scalar quantity, from 
+   which the variance of its normalized (weighted mean) estimate may be 
+   computed progressively, alongside a ProgressiveFilterValue
+   <!-------------------------------------------------------------------->**/
+
+#ifndef PROGRESSIVE_VARIANCE_VALUE_H_
+#define PROGRESSIVE_VARIANCE_VALUE_H_
+
+#include <common/common.h>
+
+namespace milton {
+
+struct MILTON_DLL_EXPORT ProgressiveVarianceValue {
+   /// weighted sums of the contributions and their squares
+   real_t sum;
+   real_t sumSquares;
+   
+   /// sums of the weights and their squares
+   real_t sumWeights;
+   real_t sumSquaredWeights;
+   
+   /// number of contributions, regardless of their weights
+   unsigned long noSamples;
+   
+   inline ProgressiveVarianceValue()
+      : sum(0), sumSquares(0), sumWeights(0), sumSquaredWeights(0), 
+        noSamples(0)
+   { }
+   
+   inline void addSample(real_t value, real_t weight) {
+      sum               += value * weight;
+      sumSquares        += value * value * weight;
+      sumWeights        += weight;
+      sumSquaredWeights += weight * weight;
+      ++noSamples;
+   }
+   
+   /// @returns the weighted mean of all contributions
+   inline real_t getMean() const {
+      return (sumWeights > 0 ? sum / sumWeights : 0);
+   }
+   
+   /**
+    * @returns Kish's effective sample size (sum(w))^2 / sum(w^2), which 
+    *    equals the number of contributions if all weights are equal
+    */
+   inline real_t getNoEffectiveSamples() const {
+      return (sumSquaredWeights > 0 ? 
+              sumWeights * sumWeights / sumSquaredWeights : 0);
+   }
+   
+   /**
+    * @returns an estimate of the variance of the weighted mean, or INFINITY 
+    *    if fewer than two effective samples have been added
+    */
+   inline real_t getVariance() const {
+      const real_t n = getNoEffectiveSamples();
+      
+      if (n <= 1)
+         return INFINITY;
+      
+      const real_t mean     = getMean();
+      const real_t variance = sumSquares / sumWeights - mean * mean;
+      
+      // unbiased sample variance, divided by n for the variance of the mean
+      return MAX(variance, 0) / (n - 1);
+   }
+   
+   /**
+    * @returns the standard error of the weighted mean relative to its 
+    *    magnitude (INFINITY if it can't be estimated yet), where a mean 
+    *    of zero is never considered to have converged, since every sample 
+    *    so far having been black says little about rare non-zero 
+    *    contributions (e.g., sparse caustics)
+    */
+   inline real_t getRelativeError() const {
+      const real_t variance = getVariance();
+      
+      if (variance >= INFINITY)
+         return INFINITY;
+      
+      const real_t mean = fabs(getMean());
+      
+      if (mean <= 0)
+         return INFINITY;
+      
+      return sqrt(variance) / mean;
+   }
+};
+
+}
+
+#endif // PROGRESSIVE_VARIANCE_VALUE_H_
+
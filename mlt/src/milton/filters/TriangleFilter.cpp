@@ -12,9 +12,13 @@
 namespace milton {
 
 real_t TriangleFilter::evaluate(const Vector2 &pt) {
+   return evaluate1D(pt[0]) * evaluate1D(pt[1]);
+}
+
+real_t TriangleFilter::evaluate1D(real_t x) {
    const real_t radius = m_support / 2.0;
    
-   return MAX(0.0, 1.0 - pt[0] / radius) * MAX(0.0, 1.0 - pt[1] / radius);
+   return MAX(0.0, 1.0 - ABS(x) / radius);
 }
 
 }
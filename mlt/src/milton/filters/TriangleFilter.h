@@ -37,6 +37,15 @@ class MILTON_DLL_EXPORT TriangleFilter : public KernelFilter {
        */
       virtual real_t evaluate(const Vector2 &pt);
       
+      /// @returns true (this filter is separable)
+      virtual bool isSeparable() const {
+         return true;
+      }
+      
+      /// @returns the value of the 1D factor of this filter evaluated at 
+      ///    the given offset
+      virtual real_t evaluate1D(real_t x);
+      
       
       //@}-----------------------------------------------------------------
 };
@@ -19,6 +19,8 @@
 #include <filters/LanczosSincFilter.h>
 
 #include <filters/ProgressiveFilterValue.h>
+#include <filters/ProgressiveVarianceValue.h>
+#include <filters/ProgressiveAOVValue.h>
 
 #endif // FILTERS_H_
 
@@ -509,39 +509,34 @@ bool MiltonJSONSceneLoader::_parse_shape(const JSONVariant &v,
             PARSE_ERROR("missing required key 'path' in 'mesh' (path to mesh data file)");
          
          const std::string &path = properties.getValue<const std::string>("path");
+         const bool normalize = (properties.contains("normalize") && 
+                                 properties.getValue<bool>("normalize"));
          data << "loading mesh '" << path << "'" << endl;
-         Mesh *mesh;
          
-         if (NULL == (mesh = MeshLoader::load(path)))
-            PARSE_ERROR(std::string("mesh '") + path + std::string("' failed to load"));
-         
-         mesh->inherit(properties);
-         shape = mesh;
-         
-         if (properties.contains("normalize") && 
-             properties.getValue<bool>("normalize"))
-         {
-            // normalize mesh to reside within the unit cube 
-            // [-.5,-.5,-.5] to [.5,.5,.5]
+         if (obj.find("spatialAccel") == obj.end()) {
+            // share geometry and SpatialAccel between all meshes which 
+            // reference the same file, each with their own transform/material
+            MeshPtr mesh = ResourceManager::getMesh(path, normalize);
             
-            unsigned noVertices = 0;
-            Vector3 *vertices = mesh->getVertices(noVertices);
-            AABB aabb;
+            if (!mesh)
+               PARSE_ERROR(std::string("mesh '") + path + std::string("' failed to load"));
             
-            for(unsigned i = noVertices; i--;)
-               aabb.add(vertices[i]);
+            shape = new InstancedShape(mesh);
+         } else {
+            // mesh-specific SpatialAccel parameters require a private copy
+            Mesh *mesh;
             
-            const Vector3 &center = Vector3(aabb.getCenter().data);
-            Vector3 diag   = aabb.getDiagonal();
-            for(unsigned j = 3; j--;)
-               diag[j] += (diag[j] == 0);
+            if (NULL == (mesh = MeshLoader::load(path)))
+               PARSE_ERROR(std::string("mesh '") + path + std::string("' failed to load"));
             
-            for(unsigned i = noVertices; i--;) {
-               vertices[i] -= center;
-               
-               for(unsigned j = 3; j--;)
-                  vertices[i][j] /= diag[j];
+            if (normalize) {
+               // normalize mesh to reside within the unit cube 
+               // [-.5,-.5,-.5] to [.5,.5,.5]
+               mesh->normalize();
             }
+            
+            mesh->inherit(properties);
+            shape = mesh;
          }
       } else if (type == "triangle") {
          // defaults
@@ -703,6 +698,10 @@ bool MiltonJSONSceneLoader::_parse_renderer(const JSONVariant &v,
    req["noSuperSamples"]  = "uint";
    req["directSampleGenerator"] = "string";
    req["generator"]       = "string";
+   req["adaptiveMinSamples"] = "uint";
+   req["adaptiveMaxSamples"] = "uint";
+   req["adaptiveThreshold"]  = "real_t";
+   req["adaptiveMaxSeconds"] = "real_t";
    
    if (type == "preview" || type == "OpenGL") {
       data.renderer = new OpenGLRenderer();
@@ -716,6 +715,14 @@ bool MiltonJSONSceneLoader::_parse_renderer(const JSONVariant &v,
       req["maxDepth"] = "uint";
       req["ambient"]  = "spectrum";
    } else if (type == "pathTracer") {
+      req["irradianceCache"] = "bool";
+      req["irradianceCacheError"] = "real_t";
+      req["irradianceCacheSamples"] = "uint";
+      req["irradianceCacheMinSpacing"] = "real_t";
+      req["irradianceCacheMaxSpacing"] = "real_t";
+      req["irradianceCachePrecompute"] = "bool";
+      req["irradianceCachePrecomputeStride"] = "uint";
+      
       data.renderer = new PathTracer();
    } else if (type == "bidirectionalPathTracer" || type == "bidirPathTracer") {
       data.renderer = new BidirectionalPathTracer();
@@ -728,12 +735,34 @@ bool MiltonJSONSceneLoader::_parse_renderer(const JSONVariant &v,
       req["causticGatherRadius"]    = "real_t";
       req["diffuseNoPhotons"]       = "uint";
       req["causticNoPhotons"]       = "uint";
-   }*/ else if (type == "mlt" || type == "MLT") {
+   }*/ else if (type == "progressivePhotonMapper" || type == "sppm") {
+      req["maxDepth"] = "uint";
+      req["sppmNoPasses"] = "uint";
+      req["sppmPhotonsPerPass"] = "uint";
+      req["sppmInitialRadius"] = "real_t";
+      req["sppmAlpha"] = "real_t";
+      req["sppmMaxSeconds"] = "real_t";
+      
+      data.renderer = new ProgressivePhotonMapper();
+   } else if (type == "mlt" || type == "MLT") {
       req["maxDepth"] = "uint";
       req["maxConsequtiveRejections"] = "uint";
       req["mltBidirPathMutationProb"] = "real_t";
       req["mltLensSubpathMutationProb"] = "real_t";
       req["mltPerturbationPathMutationProb"] = "real_t";
+      req["mltMode"] = "string";
+      req["mltPSSLargeStepProb"] = "real_t";
+      req["mltPSSSigma"] = "real_t";
+      req["mltMutationsPerPixel"] = "real_t";
+      req["mltMaxSeconds"] = "real_t";
+      req["mltCheckpointFile"] = "string";
+      req["mltCheckpointPeriod"] = "real_t";
+      req["mltChainsPerThread"] = "uint";
+      req["mltNoTemperatures"] = "uint";
+      req["mltMaxTemperature"] = "real_t";
+      req["mltSwapInterval"] = "uint";
+      req["mltFilterProposed"] = "bool";
+      req["mltFilterProposedRadius"] = "uint";
       
       data.renderer = new MLTRenderer();
    } else if (type == "dynamic") {
@@ -781,6 +810,16 @@ bool MiltonJSONSceneLoader::_parse_output(const JSONVariant &v,
       
       data << type << endl;
       req["tonemap"] = "string";
+      req["tonemapExposure"]   = "real_t";
+      req["tonemapWhitePoint"] = "real_t";
+      req["tonemapGamma"]      = "real_t";
+      req["tonemapSRGB"]       = "bool";
+      req["filterTable"]       = "bool";
+      req["checkpointFile"]    = "string";
+      req["checkpointPeriod"]  = "real_t";
+      req["resume"]            = "bool";
+      req["rawFilm"]           = "string";
+      req["aov"]               = "bool";
       
       if (type == "naive") {
          data.output = new RenderOutput();
@@ -1678,6 +1717,14 @@ bool MiltonJSONSceneLoader::_parse_spatialAccel(const JSONVariant &v,
       req["kdCostTraversal"]  = "real_t";
       req["kdCostIntersect"]  = "real_t";
       req["kdEmptyBias"]      = "real_t";
+   } else if (type == "bvh") {
+      properties->insert("spatialAccel", type);
+      
+      req["bvhMaxPrimitives"]  = "uint";
+      req["bvhNoBins"]         = "uint";
+      req["bvhCostTraversal"]  = "real_t";
+      req["bvhCostIntersect"]  = "real_t";
+      req["bvhRefitThreshold"] = "real_t";
    } else if (type == "dynamic") {
       
       NYI(); // TODO
@@ -162,6 +162,21 @@ class MILTON_DLL_EXPORT BSDF : public Sampler, public SSEAligned {
        */
       virtual real_t getPd(const Event &event) = 0;
       
+      /**
+       * @returns the probability density with which sample would generate 
+       *    the exitant vector @p wo, summed over all types of scattering 
+       *    (lobes) it may choose from and weighted by the probabilities of 
+       *    choosing them, regardless of which lobe generated @p wo
+       * 
+       * @note probability density is with respect to projected solid angle, 
+       *    as in getPd
+       * @note the default implementation is correct for BSDFs whose getPd 
+       *    doesn't depend on the type of scattering stored in its event
+       */
+      virtual real_t getMarginalPd(const Vector3 &wo) {
+         return getPd(Event(wo, this));
+      }
+      
       /**
        * @brief
        *    Evaluates the spectral BSDF at the given surface point with respect 
@@ -222,6 +237,19 @@ class MILTON_DLL_EXPORT BSDF : public Sampler, public SSEAligned {
          return false;
       }
       
+      /**
+       * @returns the albedo of this BSDF (the fraction of incident light 
+       *    which is scattered in any direction), which is independent of 
+       *    the current incident vector and inexpensive to compute, s.t. it 
+       *    may be recorded as an auxiliary output of a render
+       * 
+       * @note the default implementation returns black, which is correct 
+       *    for purely absorbent BSDFs
+       */
+      virtual SpectralSampleSet getAlbedo() {
+         return SpectralSampleSet::black();
+      }
+      
       /**
        * @brief
        *    Sets up OpenGL material state (color properties, etc.) to enable 
@@ -71,6 +71,21 @@ real_t AggregateBSDF::getPd(const Event &event) {
    return m_bsdfs[m_bsdf].bsdf->getPd(event) / m_bsdfs[m_bsdf].pdf;
 }
 
+real_t AggregateBSDF::getMarginalPd(const Vector3 &wo) {
+   // mixture density over all children, independent of which one happens 
+   // to be selected for sampling
+   real_t pd = 0;
+   
+   FOREACH(BSDFListIter, m_bsdfs, iter) {
+      ASSERT(iter->bsdf);
+      
+      iter->bsdf->setWi(m_wi);
+      pd += iter->pdf * iter->bsdf->getMarginalPd(wo);
+   }
+   
+   return pd;
+}
+
 SpectralSampleSet AggregateBSDF::evaluate(const Vector3 &wi, const Vector3 &wo) {
    return m_bsdfs[m_bsdf].bsdf->evaluate(wi, wo);
 }
@@ -79,5 +94,14 @@ bool AggregateBSDF::isSpecular(Event &event) const {
    return m_bsdfs[m_bsdf].bsdf->isSpecular(event);
 }
 
+SpectralSampleSet AggregateBSDF::getAlbedo() {
+   SpectralSampleSet albedo;
+   
+   FOREACH(BSDFListIter, m_bsdfs, iter)
+      albedo += iter->bsdf->getAlbedo() * iter->pdf;
+   
+   return albedo;
+}
+
 }
 
@@ -60,10 +60,16 @@ class MILTON_DLL_EXPORT AggregateBSDF : public BSDF {
       
       virtual real_t getPd(const Event &event);
       
+      virtual real_t getMarginalPd(const Vector3 &wo);
+      
       virtual SpectralSampleSet evaluate(const Vector3 &wi, const Vector3 &wo);
       
       virtual bool isSpecular(Event &event) const;
       
+      /// @returns the albedos of all child BSDFs weighted by their 
+      ///    coefficients, independent of which child was selected
+      virtual SpectralSampleSet getAlbedo();
+      
       
       //@}-----------------------------------------------------------------
       
@@ -156,5 +156,10 @@ SpectralSampleSet DielectricBSDF::evaluate(const Vector3 &wi, const Vector3 &wo)
    return ks * (wo == wi.reflectVector(N));
 }
 
+SpectralSampleSet DielectricBSDF::getAlbedo() {
+   return m_parent->getSpectralSampleSet("ks", SpectralSampleSet::fill(1.0), 
+                                         m_pt);
+}
+
 }
 
@@ -61,6 +61,8 @@ class MILTON_DLL_EXPORT DielectricBSDF : public BSDF {
       
       virtual SpectralSampleSet evaluate(const Vector3 &wi, const Vector3 &wo);
       
+      virtual SpectralSampleSet getAlbedo();
+      
       virtual bool isSpecular(Event &/* event unused*/) const {
          return true;
       }
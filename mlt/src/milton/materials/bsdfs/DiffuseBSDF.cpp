@@ -47,5 +47,10 @@ SpectralSampleSet DiffuseBSDF::evaluate(const Vector3 &wi, const Vector3 &wo) {
    return kd / M_PI;
 }
 
+SpectralSampleSet DiffuseBSDF::getAlbedo() {
+   return m_parent->getSpectralSampleSet("kd", SpectralSampleSet::fill(0.5), 
+                                         m_pt);
+}
+
 }
 
@@ -42,6 +42,8 @@ class MILTON_DLL_EXPORT DiffuseBSDF : public BSDF {
       
       virtual SpectralSampleSet evaluate(const Vector3 &wi, const Vector3 &wo);
       
+      virtual SpectralSampleSet getAlbedo();
+      
       
       //@}-----------------------------------------------------------------
 };
@@ -180,5 +180,29 @@ SpectralSampleSet ModifiedPhongBSDF::evaluate(const Vector3 &wi, const Vector3 &
    return m_kd * fs_d + m_ks * fs_s;
 }
 
+real_t ModifiedPhongBSDF::getMarginalPd(const Vector3 &wo) {
+   // mixture of the diffuse and specular lobes, weighted by the 
+   // probabilities with which sample selects them
+   real_t pdf = 0;
+   
+   if (m_kda > 0) {
+      const unsigned index = MODIFIED_PHONG_EVENT_DIFFUSE;
+      
+      pdf += m_kda * getPd(Event(wo, this, index));
+   }
+   
+   if (m_ksa > 0) {
+      const unsigned index = MODIFIED_PHONG_EVENT_SPECULAR;
+      
+      pdf += m_ksa * getPd(Event(wo, this, index));
+   }
+   
+   return pdf;
+}
+
+SpectralSampleSet ModifiedPhongBSDF::getAlbedo() {
+   return m_kd + m_ks;
+}
+
 }
 
@@ -69,8 +69,12 @@ class MILTON_DLL_EXPORT ModifiedPhongBSDF : public BSDF {
        
       virtual real_t getPd(const Event &event);
       
+      virtual real_t getMarginalPd(const Vector3 &wo);
+      
       virtual SpectralSampleSet evaluate(const Vector3 &wi, const Vector3 &wo);
       
+      virtual SpectralSampleSet getAlbedo();
+      
       
       //@}-----------------------------------------------------------------
       
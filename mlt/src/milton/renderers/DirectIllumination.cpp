@@ -17,6 +17,7 @@
 #include <Material.h>
 #include <Renderer.h>
 #include <ShapeSet.h>
+#include <Random.h>
 #include <Scene.h>
 #include <BSDF.h>
 #include <Ray.h>
@@ -37,6 +38,9 @@ void DirectIllumination::init() {
    
    m_generator = SampleGenerator::create(directSampleGenerator);
    m_generator->init();
+   
+   m_randomSingleSample = (directSampleGenerator == "jittered" || 
+                           directSampleGenerator == "stochastic");
 }
 
 SpectralSampleSet DirectIllumination::evaluate(SurfacePoint &pt) {
@@ -45,6 +49,17 @@ SpectralSampleSet DirectIllumination::evaluate(SurfacePoint &pt) {
 
 SpectralSampleSet DirectIllumination::evaluate(SurfacePoint &pt, 
                                       unsigned reqNoDirectSamples)
+{
+   return _evaluate(pt, reqNoDirectSamples, false);
+}
+
+SpectralSampleSet DirectIllumination::evaluateMIS(SurfacePoint &pt) {
+   return _evaluate(pt, m_noDirectSamples, true);
+}
+
+SpectralSampleSet DirectIllumination::_evaluate(SurfacePoint &pt, 
+                                                unsigned reqNoDirectSamples, 
+                                                bool mis)
 {
    ASSERT(reqNoDirectSamples > 0);
    
@@ -99,15 +114,24 @@ SpectralSampleSet DirectIllumination::evaluate(SurfacePoint &pt,
       const bool isPoint = (lightSurfaceArea <= EPSILON);
       unsigned noDirectSamples = (isPoint ? 1 : reqNoDirectSamples);
       
+      // a single jittered or stochastic sample is uniformly random, in 
+      // which case the common case doesn't need to allocate
+      const bool useGenerator = (noDirectSamples > 1 || !m_randomSingleSample);
       PointSampleList samples;
-      m_generator->generate(samples, Viewport(noDirectSamples));
-      ASSERT(samples.size() == noDirectSamples);
+      
+      if (useGenerator) {
+         m_generator->generate(samples, Viewport(noDirectSamples));
+         ASSERT(samples.size() == noDirectSamples);
+      }
       
       // average incident radiance from current light source over N samples
-      FOREACH(PointSampleListIter, samples, sample) {
+      for(unsigned j = 0; j < noDirectSamples; ++j) {
+         const UV &uv = (useGenerator ? 
+                         UV(samples[j].position[0], samples[j].position[1]) : 
+                         UV(Random::sample(), Random::sample()));
+         
          SurfacePoint lightPt;
-         light->getPoint(lightPt, UV(sample->position[0], 
-                                     sample->position[1]));
+         light->getPoint(lightPt, uv);
          ASSERT(lightPt.emitter);
          
          Vector3 wo     = (lightPt.position - pt.position);
@@ -124,7 +148,17 @@ SpectralSampleSet DirectIllumination::evaluate(SurfacePoint &pt,
          {
             const SpectralSampleSet &frLi = fr * lightPt.emitter->getLe(-wo);
             
-            direct += (frLi * cosWo * cosWi) / (t * t);
+            // weight against BSDF sampling (which can't find point lights), 
+            // whose density is converted to solid angle
+            real_t weight = 1;
+            
+            if (mis && !isPoint) {
+               weight = getMISWeight(
+                  getLightPd(lightSurfaceArea, cosWi, t), 
+                  pt.bsdf->getMarginalPd(wo) * cosWo);
+            }
+            
+            direct += (frLi * (weight * cosWo * cosWi)) / (t * t);
          }
       }
       
@@ -66,6 +66,44 @@ class MILTON_DLL_EXPORT DirectIllumination : public PropertyMap {
        */
       virtual SpectralSampleSet evaluate(SurfacePoint &pt, unsigned noDirectSamples);
       
+      /**
+       * @brief
+       *    Estimates the direct illumination contribution from all emitters 
+       * in the scene to the given surface point as evaluate does, weighting 
+       * each light sample against the density with which sampling the 
+       * point's BSDF would have generated the same direction (power 
+       * heuristic)
+       * 
+       * @note intended for renderers which also add emitted radiance found 
+       *    via BSDF sampling, weighted by getMISWeight(pdfB, getLightPd(...))
+       * @see BSDF::getMarginalPd
+       */
+      virtual SpectralSampleSet evaluateMIS(SurfacePoint &pt);
+      
+      /**
+       * @returns the density (w.r.t. solid angle at the receiving point) 
+       *    with which evaluateMIS samples a given direction towards a light 
+       *    with the given surface area, where @p cosL is the cosine at the 
+       *    light and @p t the distance to it
+       */
+      inline real_t getLightPd(real_t lightSurfaceArea, real_t cosL, 
+                               real_t t) const
+      {
+         return m_noDirectSamples * (t * t) / (lightSurfaceArea * cosL);
+      }
+      
+      /**
+       * @returns the multiple importance sampling weight of a sample drawn 
+       *    with density @p pdfA against a second strategy which would have 
+       *    drawn it with density @p pdfB (power heuristic with beta=2)
+       */
+      static inline real_t getMISWeight(real_t pdfA, real_t pdfB) {
+         const real_t a = pdfA * pdfA;
+         const real_t b = pdfB * pdfB;
+         
+         return (a + b > 0 ? a / (a + b) : 0);
+      }
+      
       
       //@}-----------------------------------------------------------------
       ///@name Accessors / Mutators
@@ -82,11 +120,20 @@ class MILTON_DLL_EXPORT DirectIllumination : public PropertyMap {
       
       //@}-----------------------------------------------------------------
       
+   protected:
+      /// shared implementation of evaluate and evaluateMIS
+      virtual SpectralSampleSet _evaluate(SurfacePoint &pt, 
+                                          unsigned noDirectSamples, bool mis);
+      
    protected:
       Renderer        *m_renderer;
       
       SampleGenerator *m_generator;
       unsigned         m_noDirectSamples;
+      
+      // whether a single sample from m_generator is uniformly random, s.t. 
+      // single-sample estimates may bypass it (and its allocations)
+      bool             m_randomSingleSample;
 };
 
 }
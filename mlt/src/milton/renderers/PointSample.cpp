@@ -5,7 +5,8 @@
    
    @brief
       Represents the value of a generic function ({x,y} -> any) evaluated at a 
-   particular 2D point
+   particular 2D point, along with optional auxiliary outputs (AOVs) 
+   describing the first surface seen by the sample (see PointSampleAOV)
    <!-------------------------------------------------------------------->**/
 
 #include "PointSample.h"
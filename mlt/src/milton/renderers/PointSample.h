@@ -5,7 +5,8 @@
    
    @brief
       Represents the value of a generic function ({x,y} -> any) evaluated at a 
-   particular 2D point
+   particular 2D point, along with optional auxiliary outputs (AOVs) 
+   describing the first surface seen by the sample (see PointSampleAOV)
    <!-------------------------------------------------------------------->**/
 
 #ifndef POINT_SAMPLE_H_
@@ -17,6 +18,39 @@
 
 namespace milton {
 
+/**
+ * @brief 
+ *    Auxiliary outputs (AOVs) of a single point sample, recorded at the 
+ * first surface intersected by its primary ray, which are commonly used 
+ * to guide denoising or compositing of the rendered image
+ * 
+ * @note AOVs are only recorded by renderers which support them, and only if 
+ *    the RenderOutput requests them (see RenderOutput::hasAOVs)
+ */
+struct MILTON_DLL_EXPORT PointSampleAOV {
+   /// distance along the primary ray to the first surface intersected, or 
+   /// INFINITY if the ray escaped the scene
+   real_t   depth;
+   
+   /// shading normal and RGB albedo of the first surface intersected (zero 
+   /// if the ray escaped the scene)
+   Vector3  normal;
+   Vector3  albedo;
+   
+   /// one-based indices of the top-level shape and material of the first 
+   /// surface intersected within the scene, or zero if the ray escaped it
+   unsigned objectId;
+   unsigned materialId;
+   
+   /// whether or not these outputs have been recorded by the renderer
+   bool     valid;
+   
+   inline PointSampleAOV()
+      : depth(INFINITY), normal(), albedo(), objectId(0), materialId(0), 
+        valid(false)
+   { }
+};
+
 struct MILTON_DLL_EXPORT PointSample {
    
    ///@name Public data
@@ -27,6 +61,11 @@ struct MILTON_DLL_EXPORT PointSample {
    bool   update;
    bool   save;
    
+   /// auxiliary outputs, which are NULL unless recorded by the renderer 
+   /// (stored out of line s.t. samples stay small when no AOVs are 
+   /// requested; see getAOV)
+   PointSampleAOV *aov;
+   
    
    //@}-----------------------------------------------------------------
    ///@name Constructors
@@ -34,28 +73,87 @@ struct MILTON_DLL_EXPORT PointSample {
    
    inline PointSample(const Point2 &position_, const Event &value_, 
                       bool update_ = false, bool save_ = false)
-      : position(position_), value(value_), update(update_), save(save_)
+      : position(position_), value(value_), update(update_), save(save_), 
+        aov(NULL)
    { }
    
    inline PointSample(const Point2 &position_, 
                       bool update_ = false, bool save_ = false)
-      : position(position_), value(), update(update_), save(save_)
+      : position(position_), value(), update(update_), save(save_), 
+        aov(NULL)
    { }
    
    inline PointSample(const real_t x, const real_t y, const Event &value_, 
                       bool update_ = false, bool save_ = false)
-      : position(x, y), value(value_), update(update_), save(save_)
+      : position(x, y), value(value_), update(update_), save(save_), 
+        aov(NULL)
    { }
    
    inline PointSample(const real_t x, const real_t y, 
                       bool update_ = false, bool save_ = false)
-      : position(x, y), value(), update(update_), save(save_)
+      : position(x, y), value(), update(update_), save(save_), aov(NULL)
    { }
    
    inline PointSample()
-      : value(), update(false), save(false)
+      : value(), update(false), save(false), aov(NULL)
    { }
    
+   inline PointSample(const PointSample &rhs)
+      : position(rhs.position), value(rhs.value), update(rhs.update), 
+        save(rhs.save), aov(rhs.aov ? new PointSampleAOV(*rhs.aov) : NULL)
+   { }
+   
+   inline ~PointSample() {
+      safeDelete(aov);
+   }
+   
+   
+   //@}-----------------------------------------------------------------
+   ///@name Operators
+   //@{-----------------------------------------------------------------
+   
+   inline PointSample &operator=(const PointSample &rhs) {
+      if (this != &rhs) {
+         position = rhs.position;
+         value    = rhs.value;
+         update   = rhs.update;
+         save     = rhs.save;
+         
+         // note: an existing allocation is kept (and invalidated) for reuse, 
+         // s.t. render threads assigning each new sample to the same 
+         // PointSample don't allocate its AOVs over and over
+         if (rhs.aov) {
+            if (aov)
+               *aov = *rhs.aov;
+            else 
+               aov = new PointSampleAOV(*rhs.aov);
+         } else if (aov) {
+            *aov = PointSampleAOV();
+         }
+      }
+      
+      return *this;
+   }
+   
+   
+   //@}-----------------------------------------------------------------
+   ///@name Accessors
+   //@{-----------------------------------------------------------------
+   
+   /**
+    * @returns the auxiliary outputs of this sample, allocating them first 
+    *    if they haven't been recorded yet
+    * 
+    * @note should only be called if the RenderOutput requests AOVs (see 
+    *    RenderOutput::hasAOVs)
+    */
+   inline PointSampleAOV &getAOV() {
+      if (NULL == aov)
+         aov = new PointSampleAOV();
+      
+      return *aov;
+   }
+   
    
    //@}-----------------------------------------------------------------
 };
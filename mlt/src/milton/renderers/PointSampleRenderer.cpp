@@ -9,18 +9,89 @@
    samples across this domain (SampleGenerator), evaluating the samples 
    (PointSampleRenderer/SampleConsumer), and storing/using the evaluated 
    samples (RenderOutput) have been abstracted from each other.
+      If the output specifies a 'checkpointFile', the film's raw 
+   accumulators, the position of the sample generator, the state of the 
+   shared random number generator, and a hash of the scene are written to 
+   it every 'checkpointPeriod' seconds (default 600) while sampling 
+   continues, as well as once rendering completes.  If the output's 
+   'resume' flag is set, rendering continues accumulating into the film 
+   stored in an existing, compatible checkpoint.
+      If the output records auxiliary outputs (see RenderOutput::hasAOVs), 
+   renderers which support them record the AOVs of each sample at the first 
+   surface its primary ray intersects via _recordAOV, where object and 
+   material IDs are assigned up front s.t. recording them only requires a 
+   lookup.
    <!-------------------------------------------------------------------->**/
 
 #include "PointSampleRenderer.h"
 #include "RenderOutput.h"
 #include "System.h"
 
+#include <ResourceManager.h>
+#include <Serialization.h>
+#include <SurfacePoint.h>
 #include <generators.h>
+#include <ShapeSet.h>
+#include <Material.h>
+#include <BSDF.h>
+#include <Camera.h>
+#include <Random.h>
+#include <Scene.h>
 #include <QtCore/QtCore>
+#include <fstream>
+#include <cstdio>
 using namespace std;
 
+// identifies film checkpoint files ('PSRC') and their format, which consists 
+// of the magic number, version, scene hash, render time, sample generator 
+// position, and RenderOutput::saveState, in that order (as of version 3, 
+// the random number generator's state is no longer stored)
+#define POINT_SAMPLE_RENDERER_CHECKPOINT_MAGIC     (0x43525350u)
+#define POINT_SAMPLE_RENDERER_CHECKPOINT_VERSION   (3)
+
 namespace milton {
 
+/// folds the bytes of @p value into the 64-bit FNV-1a hash @p hash
+template <typename T>
+static inline uint64_t pointSampleRendererHash(uint64_t hash, const T &value) {
+   const unsigned char *bytes = (const unsigned char *) &value;
+   
+   for(unsigned i = 0; i < sizeof(T); ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+   }
+   
+   return hash;
+}
+
+/// assigns consecutive one-based IDs to the primitives of @p shapes and to 
+/// their materials if they haven't been assigned one already, recursing 
+/// into nested shape sets
+static void pointSampleRendererAssignIds( 
+   ShapeSet *shapes, std::map<const Shape *, unsigned> &objectIds, 
+   std::map<const Material *, unsigned> &materialIds)
+{
+   PrimitiveList &primitives = shapes->getPrimitives();
+   
+   FOREACH(PrimitiveListIter, primitives, iter) {
+      ShapeSet *child = dynamic_cast<ShapeSet*>(*iter);
+      
+      if (child) {
+         pointSampleRendererAssignIds(child, objectIds, materialIds);
+         continue;
+      }
+      
+      const unsigned objectId = objectIds.size() + 1;
+      objectIds[*iter] = objectId;
+      
+      const Material *material = (*iter)->getMaterial();
+      if (material && materialIds.find(material) == materialIds.end()) {
+         const unsigned materialId = materialIds.size() + 1;
+         materialIds[material] = materialId;
+      }
+   }
+}
+
 void PointSampleRenderer::render() {
    ASSERT(m_output);
    
@@ -31,10 +102,27 @@ void PointSampleRenderer::render() {
    m_output->setParent(this);
    m_output->init();
    
+   if (m_output->hasAOVs())
+      _initAOVs();
+   
    // parse parameters
    unsigned noConsumers = getValue<unsigned>("noRenderThreads", System::getNoCPUs());
    ASSERT(noConsumers > 0);
    
+   // checkpointing is configured via the output
+   const std::string checkpointFile = 
+      m_output->getValue<std::string>("checkpointFile", "");
+   const real_t checkpointPeriod = 
+      m_output->getValue<real_t>("checkpointPeriod", 600);
+   const bool   resume = m_output->getValue<bool>("resume", false);
+   
+   m_noConsumedSamples = 0;
+   m_noSkippedSamples  = 0;
+   m_resumedTime       = 0;
+   
+   if (resume && !checkpointFile.empty())
+      _loadFilmCheckpoint(checkpointFile);
+   
    // initialize timer to begin counting
    m_timer.reset();
    
@@ -45,6 +133,7 @@ void PointSampleRenderer::render() {
    // create and start sample generator
    SampleGeneratorThread *generator = _getGenerator();
    generator->init();
+   generator->setNoSkippedSamples(m_noSkippedSamples);
    generator->start();
    
    // create and start sample consumers (render threads)
@@ -60,8 +149,24 @@ void PointSampleRenderer::render() {
    
    //cout << "waiting on generator" << endl;
    
-   // join with generator thread (wait until it has completed execution)
-   while(!generator->wait());
+   // join with generator thread (wait until it has completed execution), 
+   // periodically writing checkpoints in the meantime
+   if (checkpointFile.empty() || checkpointPeriod <= 0) {
+      while(!generator->wait());
+   } else {
+      double lastCheckpoint = m_timer.elapsed();
+      
+      while(!generator->wait(POINT_SAMPLE_RENDERER_MONITOR_INTERVAL)) {
+         const double elapsed = m_timer.elapsed();
+         
+         if (elapsed >= lastCheckpoint + checkpointPeriod) {
+            _saveFilmCheckpoint(checkpointFile);
+            
+            lastCheckpoint = elapsed;
+         }
+      }
+   }
+   
    safeDelete(generator);
    
    // join with consumer threads (wait until they have all completed execution)
@@ -74,6 +179,10 @@ void PointSampleRenderer::render() {
       safeDelete(consumer);
    }
    
+   // all samples have been rendered, s.t. the render may be extended later on
+   if (!checkpointFile.empty())
+      _saveFilmCheckpoint(checkpointFile);
+   
    m_output->finalize();
    finalize();
    
@@ -125,6 +234,7 @@ bool PointSampleRenderer::getSharedSample(PointSample &outSample) {
    
    outSample = m_sharedShamples.front();
    m_sharedShamples.pop_front();
+   ++m_noConsumedSamples;
    
    m_producer.wakeAll();
    
@@ -165,5 +275,211 @@ SampleConsumer  *PointSampleRenderer::_getConsumer() {
    return new SampleConsumer(this);
 }
 
+
+bool PointSampleRenderer::_saveFilmCheckpoint(const std::string &fileName) {
+   ASSERT(m_output);
+   
+   // write to a temporary file first s.t. preemption during the write 
+   // never corrupts the previous checkpoint
+   const std::string &tempFileName = fileName + ".temp";
+   std::ofstream out(tempFileName.c_str(), 
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+   bool success = out.is_open();
+   
+   if (success) {
+      uint64_t position = 0;
+      
+      { // position of the generator in its sequence of samples
+         QMutexLocker lock(&m_mutex);
+         
+         position = m_noSkippedSamples + m_noConsumedSamples;
+      }
+      
+      writeBinary<uint32_t>(out, POINT_SAMPLE_RENDERER_CHECKPOINT_MAGIC);
+      writeBinary<uint32_t>(out, POINT_SAMPLE_RENDERER_CHECKPOINT_VERSION);
+      writeBinary<uint64_t>(out, _getSceneHash());
+      writeBinary<double>  (out, m_resumedTime + m_timer.elapsed());
+      writeBinary<uint64_t>(out, position);
+      
+      success = m_output->saveState(out);
+      
+      out.close();
+      success &= !out.fail();
+   }
+   
+   if (success) {
+      // rename doesn't replace existing files on all platforms
+      if (0 != std::rename(tempFileName.c_str(), fileName.c_str())) {
+         std::remove(fileName.c_str());
+         
+         success = (0 == std::rename(tempFileName.c_str(), fileName.c_str()));
+      }
+   }
+   
+   if (!success) {
+      std::remove(tempFileName.c_str());
+      
+      ResourceManager::log.error << "error saving checkpoint to '" 
+         << fileName << "'" << endl;
+   } else {
+      ResourceManager::log.info  << "saved checkpoint to '" 
+         << fileName << "'" << endl;
+   }
+   
+   return success;
+}
+
+bool PointSampleRenderer::_loadFilmCheckpoint(const std::string &fileName) {
+   ASSERT(m_output);
+   std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+   
+   if (!in.is_open()) {
+      ResourceManager::log.info << "no checkpoint found at '" << fileName 
+         << "'; starting a new render" << endl;
+      
+      return false;
+   }
+   
+   uint32_t magic = 0, version = 0;
+   uint64_t hash = 0, position = 0;
+   double   renderTime = 0;
+   
+   // note: the film is only modified if it could be restored completely
+   const bool success = 
+      (readBinary(in, magic)   && 
+       magic   == POINT_SAMPLE_RENDERER_CHECKPOINT_MAGIC   && 
+       readBinary(in, version) && 
+       version == POINT_SAMPLE_RENDERER_CHECKPOINT_VERSION && 
+       readBinary(in, hash)    && hash == _getSceneHash()  && 
+       readBinary(in, renderTime) && 
+       readBinary(in, position)   && 
+       m_output->loadState(in));
+   
+   if (!success) {
+      ResourceManager::log.warning << "ignoring invalid or incompatible "
+         << "checkpoint '" << fileName << "'" << endl;
+      
+      return false;
+   }
+   
+   // note: the state of the shared generator isn't checkpointed, since the 
+   // render threads draw from it concurrently; skipping the sample 
+   // generator re-establishes the sequence of samples, and reseeding with a 
+   // substream keyed on the position keeps the resumed render's random 
+   // numbers independent of those which produced the restored film; both 
+   // halves of the 64-bit position are hashed s.t. substreams don't repeat 
+   // every 2^32 samples
+   Random::s_generator.seed(Random::getSubstreamSeed( 
+      Random::getSubstreamSeed(Random::s_seed, (unsigned) (position >> 32)), 
+      (unsigned) position));
+   
+   m_noSkippedSamples  = position;
+   m_resumedTime       = renderTime;
+   
+   ResourceManager::log.info << "resuming render from checkpoint '" 
+      << fileName << "' after " << renderTime << " seconds and " 
+      << position << " samples" << endl;
+   
+   return true;
+}
+
+uint64_t PointSampleRenderer::_getSceneHash() {
+   ASSERT(m_output);
+   
+   const Viewport &viewport = m_output->getViewport();
+   uint64_t hash = 14695981039346656037ull;
+   
+   hash = pointSampleRendererHash(hash, (uint32_t) viewport.getWidth());
+   hash = pointSampleRendererHash(hash, (uint32_t) viewport.getHeight());
+   
+   if (m_scene) {
+      ShapeSet *shapes = m_scene->getShapes();
+      ShapeSet *lights = m_scene->getLights();
+      
+      if (shapes) {
+         const AABB &bounds = shapes->getAABB();
+         
+         hash = pointSampleRendererHash(hash, 
+                                        (uint32_t) shapes->getPrimitives().size());
+         
+         for(unsigned i = 0; i < 3; ++i) {
+            hash = pointSampleRendererHash(hash, (real_t) bounds.min[i]);
+            hash = pointSampleRendererHash(hash, (real_t) bounds.max[i]);
+         }
+         
+         // the camera is identified by where it projects the scene's bounds
+         if (m_camera) {
+            const Point2 &pMin = m_camera->getProjection( 
+               Point3(bounds.min[0], bounds.min[1], bounds.min[2]));
+            const Point2 &pMax = m_camera->getProjection( 
+               Point3(bounds.max[0], bounds.max[1], bounds.max[2]));
+            
+            for(unsigned i = 0; i < 2; ++i) {
+               hash = pointSampleRendererHash(hash, (real_t) pMin[i]);
+               hash = pointSampleRendererHash(hash, (real_t) pMax[i]);
+            }
+         }
+      }
+      
+      if (lights)
+         hash = pointSampleRendererHash(hash, (uint32_t) lights->size());
+      
+      hash = pointSampleRendererHash(hash, 
+                                     (uint32_t) m_scene->getMaterials().size());
+   }
+   
+   return hash;
+}
+
+void PointSampleRenderer::_initAOVs() {
+   m_objectIds.clear();
+   m_materialIds.clear();
+   
+   if (NULL == m_scene)
+      return;
+   
+   // materials are numbered in the order in which they were declared, 
+   // followed by any others which are only referenced by shapes
+   MaterialList &materials = m_scene->getMaterials();
+   
+   for(unsigned i = 0; i < materials.size(); ++i) {
+      if (m_materialIds.find(materials[i]) == m_materialIds.end()) {
+         const unsigned materialId = m_materialIds.size() + 1;
+         m_materialIds[materials[i]] = materialId;
+      }
+   }
+   
+   if (m_scene->getShapes()) {
+      pointSampleRendererAssignIds(m_scene->getShapes(), m_objectIds, 
+                                   m_materialIds);
+   }
+}
+
+void PointSampleRenderer::_recordAOV(const SurfacePoint *pt, real_t t, 
+                                     PointSampleAOV &outAOV) const
+{
+   outAOV = PointSampleAOV();
+   outAOV.valid = true;
+   
+   if (NULL == pt)
+      return;
+   
+   outAOV.depth  = t;
+   outAOV.normal = pt->normalS;
+   outAOV.albedo = pt->bsdf->getAlbedo().getRGB();
+   
+   std::map<const Shape *, unsigned>::const_iterator objectIter = 
+      m_objectIds.find(pt->shape);
+   
+   if (objectIter != m_objectIds.end())
+      outAOV.objectId = objectIter->second;
+   
+   std::map<const Material *, unsigned>::const_iterator materialIter = 
+      m_materialIds.find(pt->shape->getMaterial());
+   
+   if (materialIter != m_materialIds.end())
+      outAOV.materialId = materialIter->second;
+}
+
 }
 
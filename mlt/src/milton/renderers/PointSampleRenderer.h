@@ -9,6 +9,21 @@
    samples across this domain (SampleGenerator), evaluating the samples 
    (PointSampleRenderer/SampleConsumer), and storing/using the evaluated 
    samples (RenderOutput) have been abstracted from each other.
+      If the output specifies a 'checkpointFile', the film's raw 
+   accumulators, the position of the sample generator, the elapsed render 
+   time, and a hash of the scene are written to it every 
+   'checkpointPeriod' seconds (default 600) while sampling continues, as 
+   well as once rendering completes.  If the output's 'resume' flag is 
+   set, rendering continues accumulating into the film stored in an 
+   existing, compatible checkpoint.  The state of the random number 
+   generator is not stored; a resumed render reseeds it from a substream 
+   keyed on the generator's position instead, s.t. it is statistically 
+   independent of, but not bit-identical to, an uninterrupted render.
+      If the output records auxiliary outputs (see RenderOutput::hasAOVs), 
+   renderers which support them record the AOVs of each sample at the first 
+   surface its primary ray intersects via _recordAOV, where object and 
+   material IDs are assigned up front s.t. recording them only requires a 
+   lookup.
    <!-------------------------------------------------------------------->**/
 
 #ifndef POINT_SAMPLE_RENDERER_H_
@@ -21,13 +36,21 @@
 #include <QtCore/QMutexLocker>
 #include <QtCore/QThread>
 #include <QtCore/QMutex>
+#include <map>
 
 #define MAX_SHARED_SAMPLES_SIZE     (512)
 
+/// interval in milliseconds at which checkpoints are polled
+#define POINT_SAMPLE_RENDERER_MONITOR_INTERVAL   (250)
+
 namespace milton {
 
 struct PointSample;
+struct SurfacePoint;
 class  RenderOutput;
+class  ShapeSet;
+class  Material;
+class  Shape;
 
 class  SampleGeneratorThread;
 class  SampleConsumer;
@@ -43,7 +66,9 @@ class MILTON_DLL_EXPORT PointSampleRenderer : public Renderer {
       inline PointSampleRenderer(RenderOutput *output = NULL, 
                                  Camera *camera = NULL, 
                                  Scene *scene   = NULL)
-         : Renderer(camera, scene), m_noProducers(0), m_output(output)
+         : Renderer(camera, scene), m_noProducers(0), 
+           m_noConsumedSamples(0), m_noSkippedSamples(0), m_resumedTime(0), 
+           m_output(output)
       { }
       
       virtual ~PointSampleRenderer()
@@ -118,6 +143,64 @@ class MILTON_DLL_EXPORT PointSampleRenderer : public Renderer {
        */
       virtual SampleConsumer  *_getConsumer();
       
+      
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Writes the film and the renderer's progress to @p fileName, 
+       * replacing any previous checkpoint only once the new one has been 
+       * written completely
+       * 
+       * @note may be called while samples are being rendered, in which case 
+       *    the few samples being evaluated at the time may be omitted from 
+       *    the checkpoint
+       */
+      virtual bool _saveFilmCheckpoint(const std::string &fileName);
+      
+      /**
+       * @brief
+       *    Restores the film and the renderer's progress from the 
+       * checkpoint in @p fileName
+       * 
+       * @returns false if no valid checkpoint compatible with the current 
+       *    scene and output exists, in which case rendering starts anew
+       */
+      virtual bool _loadFilmCheckpoint(const std::string &fileName);
+      
+      /**
+       * @returns a hash of the scene, camera, and output dimensions, used 
+       *    to reject checkpoints written while rendering a different scene
+       */
+      virtual uint64_t _getSceneHash();
+      
+      //@}-----------------------------------------------------------------
+      ///@name Auxiliary outputs
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Assigns one-based IDs to all shapes and materials in the scene, 
+       * s.t. the IDs of intersected surfaces may be recorded as AOVs
+       * 
+       * @note called before rendering iff the output records AOVs
+       */
+      virtual void _initAOVs();
+      
+      /**
+       * @brief
+       *    Records the auxiliary outputs of a sample whose primary ray first 
+       * intersected the given (initialized) surface point at distance @p t, 
+       * or escaped the scene if @p pt is NULL
+       * 
+       * @note thread-safe
+       */
+      void _recordAOV(const SurfacePoint *pt, real_t t, 
+                      PointSampleAOV &outAOV) const;
+      
+      //@}-----------------------------------------------------------------
+      
    protected:
       /// Provides mutual exclusion to 'render' method
       QMutex              m_renderMutex;
@@ -134,8 +217,21 @@ class MILTON_DLL_EXPORT PointSampleRenderer : public Renderer {
       PointSampleQueue    m_sharedShamples;
       unsigned            m_noProducers;
       
+      /// number of samples taken from the shared queue thus far, and the 
+      /// number of samples skipped when resuming from a checkpoint
+      uint64_t            m_noConsumedSamples;
+      uint64_t            m_noSkippedSamples;
+      
+      /// render time accumulated before being resumed from a checkpoint
+      double              m_resumedTime;
+      
       /// Abstract class which aggregates point samples (eg, an Image wrapper)
       RenderOutput       *m_output;
+      
+      /// one-based IDs of all shapes and materials in the scene, which are 
+      /// only assigned if the output records AOVs
+      std::map<const Shape *,    unsigned> m_objectIds;
+      std::map<const Material *, unsigned> m_materialIds;
 };
 
 }
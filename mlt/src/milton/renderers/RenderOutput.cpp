@@ -6,6 +6,9 @@
    @brief
       Records point samples from a renderer which may be used to construct 
    an output image on a local or distributed machine
+      If the 'aov' flag is set, the auxiliary outputs of each sample (see 
+   PointSampleAOV) are filtered into separate per-pixel buffers with the 
+   same weights as the samples' values.
    <!-------------------------------------------------------------------->**/
 
 #include "RenderOutput.h"
@@ -13,20 +16,198 @@
 #include "Renderer.h"
 
 #include <SpectralSampleSet.h>
+#include <Serialization.h>
 #include <ToneMap.h>
+#include <System.h>
 #include <miltonimage.h>
+#include <third-party/median/ctmf.h>
 #include <QtCore/QtCore>
+#include <algorithm>
+
+/// amount of memory each invocation of ctmf may use for its histograms, 
+/// which should roughly match the size of the L2 cache (see ctmf)
+#define RENDER_OUTPUT_MEDIAN_MEMSIZE      (512 * 1024)
+
+/// minimum number of pixels median filtered by each thread
+#define RENDER_OUTPUT_MEDIAN_MIN_PIXELS   (1 << 15)
 
 namespace milton {
 
+/**
+ * @brief 
+ *    Median filters a contiguous band of rows of an 8-bit image, reading 
+ * up to 'radius' extra rows above and below the band s.t. the result is 
+ * identical to filtering the whole image at once
+ */
+class renderOutputMedianThread : public QThread {
+   public:
+      inline renderOutputMedianThread(const unsigned char *src, 
+                                      unsigned char *dst, unsigned width, 
+                                      unsigned height, unsigned begin, 
+                                      unsigned end, unsigned radius)
+         : QThread(), m_src(src), m_dst(dst), m_width(width), 
+           m_height(height), m_begin(begin), m_end(end), m_radius(radius)
+      { }
+      
+      virtual ~renderOutputMedianThread()
+      { }
+      
+      virtual void run() {
+         const unsigned first  = 
+            (m_begin > m_radius ? m_begin - m_radius : 0);
+         const unsigned last   = MIN(m_end + m_radius, m_height);
+         const unsigned noRows = last - first;
+         
+         // note: rows within 'radius' of the edges of the band's padded 
+         // extent are replicated by ctmf, which is only correct for rows 
+         // along the image's edges, so only the band itself is copied back
+         std::vector<unsigned char> band(noRows * m_width);
+         
+         ctmf(m_src + first * m_width, &band[0], m_width, noRows, 
+              m_width, m_width, m_radius, 1, RENDER_OUTPUT_MEDIAN_MEMSIZE);
+         
+         memcpy(m_dst + m_begin * m_width, &band[(m_begin - first) * m_width], 
+                (m_end - m_begin) * m_width);
+      }
+   
+   protected:
+      const unsigned char *m_src;
+      unsigned char       *m_dst;
+      unsigned             m_width;
+      unsigned             m_height;
+      unsigned             m_begin;
+      unsigned             m_end;
+      unsigned             m_radius;
+};
+
+/**
+ * @brief 
+ *    Computes the median of the (2 * radius + 1)^2 neighborhood of every 
+ * pixel in the given histogram of proposed MLT samples, with pixels along 
+ * the image's edges replicated
+ * 
+ * @note counts are quantized to 8 bits s.t. the constant-time median filter 
+ *    (ctmf) may be used; the result is exact if there are at most 256 
+ *    distinct counts, and otherwise counts are grouped into 256 levels of 
+ *    roughly equal population, each represented by its median count
+ */
+static void renderOutputFilterProposed(const std::vector<unsigned long> &proposed, 
+                                       unsigned width, unsigned height, 
+                                       unsigned radius, unsigned noThreads, 
+                                       std::vector<real_t> &outMedian)
+{
+   const unsigned size = width * height;
+   outMedian.resize(size);
+   
+   if (size == 0)
+      return;
+   
+   // ctmf requires the kernel to fit within the image and its 16-bit 
+   // histogram bins not to overflow
+   radius = MIN(radius, (MIN(width, height) - 1) / 2);
+   radius = MIN(radius, 127u);
+   
+   if (radius == 0) {
+      for(unsigned i = size; i--;)
+         outMedian[i] = proposed[i];
+      
+      return;
+   }
+   
+   std::vector<unsigned long> sorted(proposed);
+   std::sort(sorted.begin(), sorted.end());
+   
+   // bounds[i] holds the smallest count which belongs to level i + 1, and 
+   // values[i] holds the count which represents level i
+   std::vector<unsigned long> bounds;
+   std::vector<real_t> values(256, 0);
+   
+   std::vector<unsigned long> distinct(sorted);
+   distinct.erase(std::unique(distinct.begin(), distinct.end()), 
+                  distinct.end());
+   
+   if (distinct.size() <= 256) {
+      for(unsigned i = 0; i < distinct.size(); ++i) {
+         values[i] = distinct[i];
+         
+         if (i + 1 < distinct.size())
+            bounds.push_back(distinct[i + 1]);
+      }
+   } else {
+      unsigned begin = 0;
+      
+      for(unsigned i = 0; i < 256 && begin < size; ++i) {
+         unsigned end = (unsigned)(((uint64_t)size * (i + 1)) / 256);
+         end = MAX(end, begin + 1);
+         
+         // never split a run of equal counts between two levels
+         while(end < size && sorted[end] == sorted[end - 1])
+            ++end;
+         
+         values[i] = sorted[begin + (end - begin) / 2];
+         
+         if (end < size)
+            bounds.push_back(sorted[end]);
+         
+         begin = end;
+      }
+   }
+   
+   std::vector<unsigned char> src(size), dst(size);
+   
+   for(unsigned i = size; i--;) {
+      src[i] = (unsigned char)(std::upper_bound(bounds.begin(), bounds.end(), 
+                                                proposed[i]) - bounds.begin());
+   }
+   
+   // filter bands of rows in parallel, where each band must be at least as 
+   // tall as the filter's kernel
+   unsigned noBands = MIN(noThreads, height / (2 * radius + 1));
+   noBands = MIN(noBands, size / RENDER_OUTPUT_MEDIAN_MIN_PIXELS);
+   noBands = MAX(noBands, 1u);
+   
+   std::vector<renderOutputMedianThread *> threads;
+   threads.reserve(noBands);
+   
+   for(unsigned i = 0; i < noBands; ++i) {
+      const unsigned begin = (unsigned)(((uint64_t)height * i) / noBands);
+      const unsigned end   = 
+         (unsigned)(((uint64_t)height * (i + 1)) / noBands);
+      
+      threads.push_back(new renderOutputMedianThread(&src[0], &dst[0], width, 
+                                                     height, begin, end, 
+                                                     radius));
+   }
+   
+   // note: the last band is always filtered on the calling thread
+   for(unsigned i = 0; i + 1 < noBands; ++i)
+      threads[i]->start();
+   
+   threads.back()->run();
+   
+   for(unsigned i = 0; i < noBands; ++i) {
+      if (i + 1 < noBands)
+         while(!threads[i]->wait());
+      
+      safeDelete(threads[i]);
+   }
+   
+   for(unsigned i = size; i--;)
+      outMedian[i] = values[dst[i]];
+}
+
 RenderOutput::~RenderOutput() {
    safeDelete(m_output);
    safeDelete(m_tonemap);
    
    safeDeleteArray(m_progressiveValues);
+   safeDeleteArray(m_variances);
+   safeDeleteArray(m_aovs);
    safeDeleteArray(m_proposed);
    safeDeleteArray(m_locks);
    safeDeleteArray(m_noSamples);
+   safeDeleteArray(m_splats);
+   safeDelete(m_splatLock);
 }
 
 void RenderOutput::init() {
@@ -44,11 +225,20 @@ void RenderOutput::init() {
    
    safeDelete(m_tonemap);
    safeDeleteArray(m_progressiveValues);
+   safeDeleteArray(m_variances);
+   safeDeleteArray(m_aovs);
    safeDeleteArray(m_proposed);
    safeDeleteArray(m_locks);
    safeDeleteArray(m_noSamples);
+   safeDeleteArray(m_splats);
+   safeDelete(m_splatLock);
    
    m_progressiveValues = new ProgressiveFilterValue<SpectralSampleSet>[size];
+   m_variances         = new ProgressiveVarianceValue[size];
+   
+   if (getValue<bool>("aov", false))
+      m_aovs = new ProgressiveAOVValue[size];
+   
    const std::string &tonemap = getValue<std::string>(
       "tonemap", std::string("default")
    );
@@ -59,10 +249,18 @@ void RenderOutput::init() {
    m_locks     = new QMutex[width];
    m_noSamples = new unsigned long[width];
    
+   m_splatLock    = new QMutex();
+   m_noSplatPaths = 0;
+   
    m_isMLT          = (m_parent ? m_parent->isMLT() : false);
    m_filterProposed = (m_parent ? m_parent->getValue<bool>("mltFilterProposed", true) : true);
+   m_filterRadius   = (m_parent ? m_parent->getValue<unsigned>("mltFilterProposedRadius", 1u) : 1u);
    
-   m_seconds = 0;
+   m_noFilterThreads  = (m_parent ? m_parent->getValue<unsigned>("noRenderThreads", System::getNoCPUs()) : System::getNoCPUs());
+   m_noFilterThreads += (m_noFilterThreads == 0);
+   
+   m_seconds  = 0;
+   m_mltScale = 1;
    memset(m_proposed, 0, sizeof(unsigned long) * size);
 }
 
@@ -91,7 +289,13 @@ void RenderOutput::_addSample(const unsigned row, const unsigned col,
    ProgressiveFilterValue<SpectralSampleSet> &p = 
       m_progressiveValues[row * width + col];
    
-   p.addSample(sample.value.getValue<SpectralSampleSet>(), weight);
+   const SpectralSampleSet &value = sample.value.getValue<SpectralSampleSet>();
+   
+   p.addSample(value, weight);
+   m_variances[row * width + col].addSample(value.getAverage(), weight);
+   
+   if (m_aovs && sample.aov && sample.aov->valid)
+      m_aovs[row * width + col].addSample(*sample.aov, weight);
    m_output->setPixel(row, col, p.getValue());
    
    ++m_noSamples[col % width];
@@ -100,6 +304,61 @@ void RenderOutput::_addSample(const unsigned row, const unsigned col,
       _unlockPixel(row, col);
 }
 
+void RenderOutput::addSplats(const PointSampleList &splats) {
+   ASSERT(m_splatLock);
+   
+   SpectralSampleSet *splatSums = NULL;
+   
+   // only renderers which actually splat pay for the per-pixel splat sums
+   if (!splats.empty()) {
+      m_splatLock->lock();
+      
+      if (NULL == m_splats)
+         m_splats = new SpectralSampleSet[m_output->getSize()];
+      
+      splatSums = m_splats;
+      m_splatLock->unlock();
+   }
+   
+   FOREACH(PointSampleListConstIter, splats, iter) {
+      const Point2 &p = iter->position;
+      
+      // contributions which project outside of the film are dropped
+      if (p[0] < 0 || p[0] >= 1 || p[1] < 0 || p[1] >= 1)
+         continue;
+      
+      unsigned row, col;
+      m_viewport.getBin(p, col, row);
+      
+      _lockPixel(row, col);
+      splatSums[row * m_viewport.getWidth() + col] += 
+         iter->value.getValue<SpectralSampleSet>();
+      _unlockPixel(row, col);
+   }
+   
+   m_splatLock->lock();
+   ++m_noSplatPaths;
+   m_splatLock->unlock();
+}
+
+real_t RenderOutput::getMLTScale() const {
+   ASSERT(m_splatLock);
+   
+   m_splatLock->lock();
+   const real_t scale = m_mltScale;
+   m_splatLock->unlock();
+   
+   return scale;
+}
+
+void RenderOutput::setMLTScale(real_t scale) {
+   ASSERT(m_splatLock);
+   
+   m_splatLock->lock();
+   m_mltScale = scale;
+   m_splatLock->unlock();
+}
+
 void RenderOutput::addPropposed(const PointSample &sample) {
    unsigned row, col;
    const unsigned width = m_viewport.getWidth();
@@ -110,6 +369,232 @@ void RenderOutput::addPropposed(const PointSample &sample) {
    _unlockPixel(row, col);
 }
 
+void RenderOutput::getRelativeErrors(std::vector<real_t> &outErrors) {
+   ASSERT(m_variances);
+   
+   const unsigned width  = m_viewport.getWidth();
+   const unsigned height = m_viewport.getHeight();
+   
+   outErrors.resize(width * height);
+   
+   // note: each column is guarded by its own lock
+   for(unsigned col = 0; col < width; ++col) {
+      _lockPixel(0, col);
+      
+      for(unsigned row = 0; row < height; ++row) {
+         const unsigned offset = row * width + col;
+         
+         outErrors[offset] = m_variances[offset].getRelativeError();
+      }
+      
+      _unlockPixel(0, col);
+   }
+}
+
+/// serializes the wavelengths and values of the given spectrum
+static void renderOutputWriteSpectrum(std::ostream &out, 
+                                      const SpectralSampleSet &spectrum)
+{
+   const unsigned n = spectrum.getN();
+   
+   writeBinary<uint32_t>(out, n);
+   
+   for(unsigned j = 0; j < n; ++j) {
+      writeBinary<uint32_t>(out, spectrum[j].wavelength);
+      writeBinary<real_t>  (out, spectrum[j].value);
+   }
+}
+
+/// deserializes a spectrum written by renderOutputWriteSpectrum, which must 
+/// have been sampled at the same wavelengths as @p outSpectrum
+static bool renderOutputReadSpectrum(std::istream &in, 
+                                     SpectralSampleSet &outSpectrum)
+{
+   const unsigned n = outSpectrum.getN();
+   uint32_t noSamples = 0;
+   
+   if (!readBinary(in, noSamples) || noSamples != n)
+      return false;
+   
+   for(unsigned j = 0; j < n; ++j) {
+      uint32_t wavelength = 0;
+      
+      if (!readBinary(in, wavelength) || 
+          !readBinary(in, outSpectrum[j].value) || 
+          wavelength != outSpectrum[j].wavelength)
+      {
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+bool RenderOutput::saveState(std::ostream &out) {
+   ASSERT(m_progressiveValues);
+   ASSERT(m_variances);
+   ASSERT(m_output);
+   
+   const unsigned width  = m_output->getWidth();
+   const unsigned height = m_output->getHeight();
+   const unsigned size   = width * height;
+   
+   std::vector<ProgressiveFilterValue<SpectralSampleSet> > values(size);
+   std::vector<ProgressiveVarianceValue> variances(size);
+   std::vector<unsigned long>            proposed(size);
+   std::vector<unsigned long>            noSamples(width);
+   
+   m_splatLock->lock();
+   const unsigned long noSplatPaths = m_noSplatPaths;
+   const SpectralSampleSet *splatSums = m_splats;
+   m_splatLock->unlock();
+   
+   std::vector<SpectralSampleSet>        splats(splatSums ? size : 0);
+   
+   // copy all accumulators while holding every column's lock (acquired in 
+   // the same order as in getSnapshot), s.t. a consistent state may be 
+   // written without stalling sample threads for the duration of the write
+   for(unsigned i = width; i--;)
+      m_locks[i].lock();
+   
+   for(unsigned i = size; i--;) {
+      values[i]    = m_progressiveValues[i];
+      variances[i] = m_variances[i];
+      proposed[i]  = m_proposed[i];
+   }
+   
+   for(unsigned i = splats.size(); i--;)
+      splats[i] = splatSums[i];
+   
+   for(unsigned i = width; i--;)
+      noSamples[i] = m_noSamples[i];
+   
+   for(unsigned i = width; i--;)
+      m_locks[i].unlock();
+   
+   writeBinary<uint32_t>(out, width);
+   writeBinary<uint32_t>(out, height);
+   
+   for(unsigned i = 0; i < size; ++i) {
+      renderOutputWriteSpectrum(out, values[i].numerator);
+      writeBinary<real_t>(out, values[i].denominator);
+   }
+   
+   for(unsigned i = 0; i < size; ++i) {
+      const ProgressiveVarianceValue &v = variances[i];
+      
+      writeBinary<real_t>(out, v.sum);
+      writeBinary<real_t>(out, v.sumSquares);
+      writeBinary<real_t>(out, v.sumWeights);
+      writeBinary<real_t>(out, v.sumSquaredWeights);
+      writeBinary<uint64_t>(out, v.noSamples);
+   }
+   
+   for(unsigned i = 0; i < size; ++i)
+      writeBinary<uint64_t>(out, proposed[i]);
+   
+   for(unsigned i = 0; i < width; ++i)
+      writeBinary<uint64_t>(out, noSamples[i]);
+   
+   writeBinary<uint64_t>(out, noSplatPaths);
+   writeBinary<uint32_t>(out, splats.size());
+   
+   for(unsigned i = 0; i < splats.size(); ++i)
+      renderOutputWriteSpectrum(out, splats[i]);
+   
+   return !out.fail();
+}
+
+bool RenderOutput::loadState(std::istream &in) {
+   ASSERT(m_progressiveValues);
+   ASSERT(m_variances);
+   ASSERT(m_output);
+   
+   const unsigned width  = m_output->getWidth();
+   const unsigned height = m_output->getHeight();
+   const unsigned size   = width * height;
+   uint32_t w = 0, h = 0;
+   
+   if (!readBinary(in, w) || !readBinary(in, h) || w != width || h != height)
+      return false;
+   
+   // deserialize into temporary storage s.t. this output is left unchanged 
+   // if the serialized state turns out to be truncated
+   ProgressiveFilterValue<SpectralSampleSet> *values = 
+      new ProgressiveFilterValue<SpectralSampleSet>[size];
+   ProgressiveVarianceValue *variances = new ProgressiveVarianceValue[size];
+   SpectralSampleSet *splats = NULL;
+   unsigned long *proposed   = new unsigned long[size];
+   unsigned long *noSamples  = new unsigned long[width];
+   uint64_t noSplatPaths     = 0;
+   uint32_t noSplats         = 0;
+   bool success = true;
+   
+   for(unsigned i = 0; success && i < size; ++i) {
+      success = (renderOutputReadSpectrum(in, values[i].numerator) && 
+                 readBinary(in, values[i].denominator));
+   }
+   
+   for(unsigned i = 0; success && i < size; ++i) {
+      ProgressiveVarianceValue &v = variances[i];
+      uint64_t noPixelSamples = 0;
+      
+      success = (readBinary(in, v.sum)        && 
+                 readBinary(in, v.sumSquares) && 
+                 readBinary(in, v.sumWeights) && 
+                 readBinary(in, v.sumSquaredWeights) && 
+                 readBinary(in, noPixelSamples));
+      
+      v.noSamples = noPixelSamples;
+   }
+   
+   for(unsigned i = 0; success && i < size; ++i) {
+      uint64_t value = 0;
+      
+      success     = readBinary(in, value);
+      proposed[i] = value;
+   }
+   
+   for(unsigned i = 0; success && i < width; ++i) {
+      uint64_t value = 0;
+      
+      success      = readBinary(in, value);
+      noSamples[i] = value;
+   }
+   
+   success = (success && readBinary(in, noSplatPaths) && 
+              readBinary(in, noSplats) && (noSplats == 0 || noSplats == size));
+   
+   if (success && noSplats > 0)
+      splats = new SpectralSampleSet[size];
+   
+   for(unsigned i = 0; success && i < noSplats; ++i)
+      success = renderOutputReadSpectrum(in, splats[i]);
+   
+   if (success) {
+      for(unsigned i = 0; i < size; ++i)
+         m_output->setPixel(i / width, i % width, values[i].getValue());
+      
+      std::swap(m_progressiveValues, values);
+      std::swap(m_variances, variances);
+      std::swap(m_proposed,  proposed);
+      std::swap(m_noSamples, noSamples);
+      std::swap(m_splats,    splats);
+      
+      m_splatLock->lock();
+      m_noSplatPaths = noSplatPaths;
+      m_splatLock->unlock();
+   }
+   
+   safeDeleteArray(values);
+   safeDeleteArray(variances);
+   safeDeleteArray(splats);
+   safeDeleteArray(proposed);
+   safeDeleteArray(noSamples);
+   
+   return success;
+}
+
 void RenderOutput::setImage(Image *image) {
    ASSERT(image);
    
@@ -117,6 +602,7 @@ void RenderOutput::setImage(Image *image) {
       return;
    
    safeDeleteArray(m_progressiveValues);
+   safeDeleteArray(m_variances);
    safeDelete(m_output);
    
    m_output = image;
@@ -124,86 +610,138 @@ void RenderOutput::setImage(Image *image) {
    
    const unsigned size = m_output->getSize();
    m_progressiveValues = new ProgressiveFilterValue<SpectralSampleSet>[size];
+   m_variances         = new ProgressiveVarianceValue[size];
+   
+   if (m_aovs) {
+      safeDeleteArray(m_aovs);
+      m_aovs = new ProgressiveAOVValue[size];
+   }
+   
+   if (m_splats) {
+      safeDeleteArray(m_splats);
+      m_splats = new SpectralSampleSet[size];
+   }
 }
 
 RgbaImage *RenderOutput::getFinalizedOutput() {
+   RenderOutputSnapshot snapshot;
+   
+   getSnapshot(snapshot);
+   return develop(snapshot);
+}
+
+void RenderOutput::getSnapshot(RenderOutputSnapshot &outSnapshot) {
    ASSERT(m_progressiveValues);
    ASSERT(m_output);
    
    const unsigned width  = m_output->getWidth();
    const unsigned height = m_output->getHeight();
+   const unsigned size   = width * height;
    
-   HDRImage *hdrOutput = new HDRImage(width, height);
-   RgbaHDR *dest = hdrOutput->getData();
+   outSnapshot.width          = width;
+   outSnapshot.height         = height;
+   outSnapshot.isMLT          = m_isMLT;
+   outSnapshot.filterProposed = m_filterProposed;
+   outSnapshot.filterRadius   = m_filterRadius;
+   
+   outSnapshot.values.resize(size);
+   outSnapshot.weights.resize(size);
+   outSnapshot.pixelSamples.resize(size);
+   outSnapshot.proposed.resize(m_isMLT ? size : 0);
+   outSnapshot.aovs.resize(m_aovs ? size : 0);
+   
+   m_splatLock->lock();
+   outSnapshot.noSplatPaths = m_noSplatPaths;
+   outSnapshot.mltScale     = m_mltScale;
+   const SpectralSampleSet *splatSums = m_splats;
+   m_splatLock->unlock();
+   
+   outSnapshot.splats.resize(splatSums ? size : 0);
    
    // accumulate samples
-   unsigned noSamples = 0;
+   unsigned long noSamples = 0;
    for(unsigned i = width; i--;) {
       m_locks[i].lock();
       noSamples += m_noSamples[i];
    }
 // TODO:  "possible deadlock acquiring locks in inconsistent order here and in ReconstructionRenderOutput"
    
+   outSnapshot.noSamples = noSamples;
+   
+   if (m_isMLT) {
+      for(unsigned i = size; i--;) {
+         outSnapshot.values[i]   = m_progressiveValues[i].numerator;
+         outSnapshot.proposed[i] = m_proposed[i];
+      }
+   } else {
+      for(unsigned i = size; i--;)
+         outSnapshot.values[i] = m_progressiveValues[i].getValue();
+   }
+   
+   for(unsigned i = size; i--;) {
+      outSnapshot.weights[i]      = m_progressiveValues[i].denominator;
+      outSnapshot.pixelSamples[i] = m_variances[i].noSamples;
+   }
+   
+   for(unsigned i = outSnapshot.splats.size(); i--;)
+      outSnapshot.splats[i] = splatSums[i];
+   
+   for(unsigned i = outSnapshot.aovs.size(); i--;)
+      outSnapshot.aovs[i] = m_aovs[i];
+   
+   for(unsigned i = width; i--;)
+      m_locks[i].unlock();
+}
+
+RgbaImage *RenderOutput::develop(const RenderOutputSnapshot &snapshot) {
+   HDRImage *hdrOutput = developLinear(snapshot);
+   
+   // perform tonemapping
+   RgbaImage *output = m_tonemap->map(hdrOutput);
+   safeDelete(hdrOutput);
+   
+   return output;
+}
+
+HDRImage *RenderOutput::developLinear(const RenderOutputSnapshot &snapshot) {
+   const unsigned width  = snapshot.width;
+   const unsigned height = snapshot.height;
+   
+   HDRImage *hdrOutput = new HDRImage(width, height);
+   RgbaHDR *dest = hdrOutput->getData();
+   
    // differences in pixel intensities when rendering with MLT occur with 
    // respect to the relative number of samples which occur in a given pixel.
    // when rendering with MLT, we therefore need to divide each estimated 
    // pixel's value by the total number of samples taken so far, in effect, 
    // creating a histogram of intensities based on their relative contribution
    // to the radiant flux incident on all of the film plane
-   if (m_isMLT) {
+   if (snapshot.isMLT) {
       // 2 samples (tentative and real) for each actual Xi sample in the random walk
-      const real_t invNoSamples = (2.0) / noSamples; // divided by 25
+      const real_t invNoSamples = 
+         (2.0 * snapshot.mltScale) / snapshot.noSamples; // divided by 25
       
-      if (m_filterProposed) {
-         const int half    = 1;
-         const int support = 2 * half + 1;
+      if (snapshot.filterProposed) {
+         // scale each pixel by the ratio of the median number of samples 
+         // proposed in its neighborhood to the number proposed in it
+         std::vector<real_t> median;
          
-         unsigned long *temp = new unsigned long[support * support];
+         renderOutputFilterProposed(snapshot.proposed, width, height, 
+                                    snapshot.filterRadius, m_noFilterThreads, 
+                                    median);
          
-         for(int i = height; i--;) {
-            for(int j = width; j--;) {
-               //real_t sum = 0, mid = 0;
-               unsigned n = 0;
-               
-               // median filter
-               for(int y = -half; y <= half; ++y) {
-                  int row = CLAMP(i + y, 0, (int)height - 1);
-                  
-                  for(int x = -half; x <= half; ++x) {
-                     int col = CLAMP(j + x, 0, (int)width - 1);
-                     
-                     temp[n++] = m_proposed[row * width + col];
-                     //sum += 1;
-                     //mid += 1 * m_proposed[row * width + col];
-                  }
-               }
-               
-               //avg /= sum;
-               
-               real_t mid = 0;
-               if (n > 0) {
-                  std::sort(temp, temp + n);
-                  
-                  mid = temp[n / 2];
-                  
-                  if ((n & 1) == 0)
-                     mid = temp[n / 2 - 1];//0.5 * (mid + temp[n / 2 - 1]);
-               }
-               
-               const unsigned offset = i * width + j;
-               const unsigned long proposed = m_proposed[offset];
-               const real_t scale = 
-                  (mid > 0 && proposed > 0 ? mid / proposed : 1);
-               
-               const SpectralSampleSet &val = m_progressiveValues[offset].numerator;
-               dest[offset] = (val * (scale * invNoSamples)).getRGB();
-            }
+         for(unsigned i = hdrOutput->getSize(); i--;) {
+            const unsigned long proposed = snapshot.proposed[i];
+            const real_t mid   = median[i];
+            const real_t scale = 
+               (mid > 0 && proposed > 0 ? mid / proposed : 1);
+            
+            const SpectralSampleSet &val = snapshot.values[i];
+            dest[i] = (val * (scale * invNoSamples)).getRGB();
          }
-         
-         safeDeleteArray(temp);
       } else {
          for(unsigned i = hdrOutput->getSize(); i--;) {
-            const SpectralSampleSet &val = m_progressiveValues[i].numerator;
+            const SpectralSampleSet &val = snapshot.values[i];
             
             /*if ((i / m_output->getWidth()) == m_output->getHeight() / 2) {
                const real_t v = ((val * invNoSamples)[0].value + (val * invNoSamples)[1].value + (val * invNoSamples)[2].value) / 3.0;
@@ -215,20 +753,23 @@ RgbaImage *RenderOutput::getFinalizedOutput() {
          }
       }
    } else {
+      // each splat estimates the flux incident on the whole film plane, 
+      // whereas each sample estimates the radiance incident on one pixel
+      const real_t splatScale = 
+         (snapshot.noSplatPaths > 0 && !snapshot.splats.empty() ? 
+         ((real_t) hdrOutput->getSize()) / snapshot.noSplatPaths : 0);
+      
       for(unsigned i = hdrOutput->getSize(); i--;) {
-         const SpectralSampleSet &val = m_progressiveValues[i].getValue();
-         dest[i] = val.getRGB();
+         const SpectralSampleSet &val = snapshot.values[i];
+         
+         if (splatScale > 0)
+            dest[i] = (val + snapshot.splats[i] * splatScale).getRGB();
+         else 
+            dest[i] = val.getRGB();
       }
    }
    
-   for(unsigned i = width; i--;)
-      m_locks[i].unlock();
-   
-   // perform tonemapping
-   RgbaImage *output = m_tonemap->map(hdrOutput);
-   safeDelete(hdrOutput);
-   
-   return output;
+   return hdrOutput;
 }
 
 void RenderOutput::_lockPixel  (unsigned row, unsigned col) {
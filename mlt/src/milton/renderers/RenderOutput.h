@@ -6,23 +6,91 @@
    @brief
       Records point samples from a renderer which may be used to construct 
    an output image on a local or distributed machine
+      If the 'aov' flag is set, the auxiliary outputs of each sample (see 
+   PointSampleAOV) are filtered into separate per-pixel buffers with the 
+   same weights as the samples' values.
    <!-------------------------------------------------------------------->**/
 
 #ifndef RENDER_OUTPUT_H_
 #define RENDER_OUTPUT_H_
 
 #include <common/image/RgbaImage.h>
+#include <renderers/PointSample.h>
 #include <utils/PropertyMap.h>
 #include <filters/filters.h>
 #include <core/Viewport.h>
+#include <iosfwd>
 
 class  QMutex;
 
 namespace milton {
 
-struct PointSample;
 class  ToneMap;
 class  Renderer;
+class  HDRImage;
+
+/**
+ * @brief 
+ *    Copy of all samples accumulated by a RenderOutput at a given instant, 
+ * from which a finalized image may be developed without holding any of the 
+ * output's locks
+ * 
+ * @see RenderOutput::getSnapshot
+ * @see RenderOutput::develop
+ */
+struct MILTON_DLL_EXPORT RenderOutputSnapshot {
+   unsigned width, height;
+   
+   /// per-pixel sample averages (or sums of samples when rendering with MLT)
+   std::vector<SpectralSampleSet> values;
+   
+   /// per-pixel sums of splats (empty if nothing has been splatted)
+   std::vector<SpectralSampleSet> splats;
+   
+   /// per-pixel sums of reconstruction filter weights and numbers of 
+   /// samples which contributed to each pixel
+   std::vector<real_t>            weights;
+   std::vector<unsigned long>     pixelSamples;
+   
+   /// per-pixel number of proposed samples (MLT only)
+   std::vector<unsigned long>     proposed;
+   
+   /// per-pixel auxiliary outputs (empty unless AOVs were requested)
+   std::vector<ProgressiveAOVValue> aovs;
+   
+   unsigned long noSamples;
+   unsigned long noSplatPaths;
+   
+   bool     isMLT;
+   bool     filterProposed;
+   unsigned filterRadius;
+   real_t   mltScale;
+   
+   inline RenderOutputSnapshot()
+      : width(0), height(0), noSamples(0), noSplatPaths(0), isMLT(false), 
+        filterProposed(false), filterRadius(1), mltScale(1)
+   { }
+   
+   /// swaps the contents of this snapshot with @p rhs without copying
+   inline void swap(RenderOutputSnapshot &rhs) {
+      std::swap(width,  rhs.width);
+      std::swap(height, rhs.height);
+      
+      values.swap(rhs.values);
+      splats.swap(rhs.splats);
+      weights.swap(rhs.weights);
+      pixelSamples.swap(rhs.pixelSamples);
+      proposed.swap(rhs.proposed);
+      aovs.swap(rhs.aovs);
+      
+      std::swap(noSamples,      rhs.noSamples);
+      std::swap(noSplatPaths,   rhs.noSplatPaths);
+      std::swap(isMLT,          rhs.isMLT);
+      std::swap(filterProposed, rhs.filterProposed);
+      std::swap(filterRadius,   rhs.filterRadius);
+      std::swap(mltScale,       rhs.mltScale);
+   }
+};
 
 class MILTON_DLL_EXPORT RenderOutput : public PropertyMap {
    public:
@@ -31,16 +99,20 @@ class MILTON_DLL_EXPORT RenderOutput : public PropertyMap {
       
       inline RenderOutput(const Viewport &d)
          : PropertyMap(), m_viewport(d), m_isMLT(false), 
-           m_output(NULL), m_progressiveValues(NULL), m_tonemap(NULL), 
-           m_proposed(NULL), m_noSamples(NULL), m_locks(NULL), 
-           m_parent(NULL), m_seconds(0)
+           m_filterRadius(1), m_noFilterThreads(1), 
+           m_output(NULL), m_progressiveValues(NULL), m_variances(NULL), 
+           m_aovs(NULL), m_tonemap(NULL), m_proposed(NULL), m_noSamples(NULL), 
+           m_locks(NULL), m_splats(NULL), m_noSplatPaths(0), 
+           m_splatLock(NULL), m_parent(NULL), m_seconds(0), m_mltScale(1)
       { }
       
       inline RenderOutput(Image *output = NULL)
          : PropertyMap(), m_viewport(480, 480), m_isMLT(false), 
-           m_output(output), m_progressiveValues(NULL), m_tonemap(NULL), 
-           m_proposed(NULL), m_noSamples(0), m_locks(NULL), 
-           m_parent(NULL), m_seconds(0)
+           m_filterRadius(1), m_noFilterThreads(1), 
+           m_output(output), m_progressiveValues(NULL), m_variances(NULL), 
+           m_aovs(NULL), m_tonemap(NULL), m_proposed(NULL), m_noSamples(0), 
+           m_locks(NULL), m_splats(NULL), m_noSplatPaths(0), 
+           m_splatLock(NULL), m_parent(NULL), m_seconds(0), m_mltScale(1)
       {
          if (output) {
             const unsigned width  = output->getWidth();
@@ -93,6 +165,52 @@ class MILTON_DLL_EXPORT RenderOutput : public PropertyMap {
        */
       virtual void addSample(PointSample &sample);
       
+      /**
+       * @brief
+       *    Splats the contributions of a single path traced from the light 
+       * sources (eg. via light tracing), each of which is added unfiltered 
+       * to the pixel containing its position
+       * 
+       * @note splats are accumulated separately from samples; the finalized 
+       *    output adds the sum of all splats in each pixel, divided by the 
+       *    number of paths splatted thus far (including those which didn't 
+       *    contribute any splats) and scaled by the number of pixels, to 
+       *    the average of the samples in that pixel
+       * @note thread-safe
+       */
+      virtual void addSplats(const PointSampleList &splats);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Serializes all samples accumulated thus far, including their 
+       * error estimates and splats, s.t. they may later be restored via 
+       * loadState (eg. to resume an interrupted render)
+       * 
+       * @note thread-safe; this output's locks are only held long enough to 
+       *    copy its accumulators, s.t. sampling may continue while the 
+       *    state is being written
+       * @note auxiliary outputs aren't serialized; those of a resumed render 
+       *    are filtered from the samples taken after it was resumed
+       */
+      virtual bool saveState(std::ostream &out);
+      
+      /**
+       * @brief
+       *    Restores samples previously serialized via saveState, replacing 
+       * any samples accumulated thus far
+       * 
+       * @returns false if the serialized state is invalid or its dimensions 
+       *    differ from those of this output, in which case this output is 
+       *    left unchanged
+       * @note assumes init has already been called
+       */
+      virtual bool loadState(std::istream &in);
+      
       
       //@}-----------------------------------------------------------------
       ///@name Accessors / Mutators
@@ -114,16 +232,89 @@ class MILTON_DLL_EXPORT RenderOutput : public PropertyMap {
          return m_output;
       }
       
+      /**
+       * @returns whether or not this output records the auxiliary outputs 
+       *    of samples (see PointSampleAOV), s.t. renderers only compute them 
+       *    when requested
+       * 
+       * @note only valid after init has been called
+       */
+      inline bool hasAOVs() const {
+         return (m_aovs != NULL);
+      }
+      
       virtual void setImage(Image *image);
       
       inline void setParent(Renderer *renderer) {
          m_parent = renderer;
       }
       
+      /**
+       * @returns a tonemapped image of all samples accumulated thus far, 
+       *    which is owned by the caller
+       * 
+       * @note equivalent to develop(getSnapshot())
+       */
       virtual RgbaImage *getFinalizedOutput();
       
+      /**
+       * @brief
+       *    Copies all samples accumulated thus far into @p outSnapshot, 
+       * reusing its storage where possible
+       * 
+       * @note thread-safe; only holds this output's locks long enough to 
+       *    copy its accumulators s.t. sample threads are stalled briefly
+       */
+      virtual void getSnapshot(RenderOutputSnapshot &outSnapshot);
+      
+      /**
+       * @returns a tonemapped image of the given snapshot, which is owned by 
+       *    the caller
+       * 
+       * @note doesn't acquire any of this output's locks, s.t. the expensive 
+       *    parts of finalization (MLT's median pass and tonemapping) may be 
+       *    performed off of the render threads
+       */
+      virtual RgbaImage *develop(const RenderOutputSnapshot &snapshot);
+      
+      /**
+       * @returns a linear (not tonemapped) HDR image of the given snapshot, 
+       *    which is owned by the caller
+       * 
+       * @note doesn't acquire any of this output's locks
+       */
+      virtual HDRImage *developLinear(const RenderOutputSnapshot &snapshot);
+      
+      /**
+       * @returns the scale applied to all samples when rendering with MLT
+       * @note safe to call concurrently with setMLTScale
+       */
+      real_t getMLTScale() const;
+      
+      /**
+       * @brief
+       *    Sets the scale applied to all samples when rendering with MLT, 
+       * allowing samples to be splatted relative to an initial estimate of 
+       * the image's brightness which is refined later on
+       * 
+       * @note guarded by the splat lock, s.t. the scale may be updated 
+       *    (e.g., by MLTRenderer's monitor thread) while snapshots are taken
+       */
+      void setMLTScale(real_t scale);
+      
       void addPropposed(const PointSample &);
       
+      /**
+       * @brief
+       *    Fills @p outErrors with the estimated relative error (standard 
+       * error of the mean relative to the mean) of every pixel's average 
+       * spectral intensity, in row-major order
+       * 
+       * @note thread-safe
+       * @see ProgressiveVarianceValue::getRelativeError
+       */
+      virtual void getRelativeErrors(std::vector<real_t> &outErrors);
+      
       
       //@}-----------------------------------------------------------------
       
@@ -140,16 +331,37 @@ class MILTON_DLL_EXPORT RenderOutput : public PropertyMap {
       Viewport m_viewport;
       bool     m_isMLT, m_filterProposed;
       
+      /// radius of the median filter applied to m_proposed and the number 
+      /// of threads it's computed with
+      unsigned m_filterRadius;
+      unsigned m_noFilterThreads;
+      
       Image   *m_output;
       ProgressiveFilterValue<SpectralSampleSet> *m_progressiveValues;
+      
+      /// per-pixel moments of the average intensity of all samples, used 
+      /// to estimate per-pixel error (eg. for adaptive sampling)
+      ProgressiveVarianceValue *m_variances;
+      
+      /// per-pixel filtered auxiliary outputs (NULL unless 'aov' is set)
+      ProgressiveAOVValue      *m_aovs;
       ToneMap *m_tonemap;
       
       unsigned long *m_proposed;
       unsigned long *m_noSamples;
       QMutex        *m_locks;
       
+      /// sums of all splats per pixel (NULL until the first non-empty call 
+      /// to addSplats), the number of paths splatted, and a lock guarding 
+      /// the latter, the allocation of m_splats, and m_mltScale (the sums 
+      /// themselves are guarded by m_locks)
+      SpectralSampleSet *m_splats;
+      unsigned long      m_noSplatPaths;
+      QMutex            *m_splatLock;
+      
       Renderer      *m_parent;
       unsigned long  m_seconds;
+      real_t         m_mltScale;
 };
 
 }
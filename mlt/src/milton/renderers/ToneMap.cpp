@@ -30,5 +30,33 @@ ToneMap *ToneMap::create(const std::string &type, PropertyMap &p) {
    return tonemap;
 }
 
+void ToneMap::init() {
+   const real_t gamma = getValue<real_t>("tonemapGamma", 2.22);
+   const bool   sRGB  = getValue<bool>("tonemapSRGB", false);
+   
+   _initEncoding((gamma > 0 ? gamma : 2.22), sRGB);
+}
+
+void ToneMap::_initEncoding(real_t gamma, bool sRGB) {
+   const real_t correction = 1.0 / gamma;
+   const real_t invSize    = 1.0 / (TONE_MAP_ENCODING_TABLE_SIZE - 1);
+   
+   m_encoding.resize(TONE_MAP_ENCODING_TABLE_SIZE);
+   
+   for(unsigned i = TONE_MAP_ENCODING_TABLE_SIZE; i--;) {
+      const real_t v = i * invSize;
+      real_t encoded;
+      
+      if (sRGB) {
+         encoded = (v <= 0.0031308 ? 12.92 * v : 
+                    1.055 * pow(v, 1.0 / 2.4) - 0.055);
+      } else {
+         encoded = pow(v, correction);
+      }
+      
+      m_encoding[i] = (unsigned char) CLAMP(255 * encoded, 0, 255);
+   }
+}
+
 }
 
@@ -6,12 +6,20 @@
    @brief
       A ToneMap converts radiance values stored in an HDRImage to displayable 
    sRGB pixels in an RgbaImage.
+      Display encoding (gamma correction and quantization to 8 bits) is 
+   shared by all ToneMaps and is performed via a precomputed lookup table 
+   indexed by linear intensity, rather than evaluating pow per channel.
    <!-------------------------------------------------------------------->**/
 
 #ifndef MILTON_TONE_MAP_H_
 #define MILTON_TONE_MAP_H_
 
 #include <utils/PropertyMap.h>
+#include <vector>
+
+/// number of entries in a ToneMap's display encoding table, which 
+/// quantizes linear intensities in [0, 1] to 16 bits
+#define TONE_MAP_ENCODING_TABLE_SIZE   (1 << 16)
 
 namespace milton {
 
@@ -53,10 +61,13 @@ class MILTON_DLL_EXPORT ToneMap : public PropertyMap {
        * PropertyMap
        * 
        * @note
-       *    Default implementation is empty
+       *    Default implementation builds the display encoding table from the 
+       * following parameters, and should be called by all subclasses: 
+       *    tonemapGamma - display gamma (default 2.22) 
+       *    tonemapSRGB  - whether to use the piecewise sRGB transfer curve 
+       *                   instead of a pure power curve (default false)
        */
-      virtual void init()
-      { }
+      virtual void init();
       
       
       //@}-----------------------------------------------------------------
@@ -70,6 +81,35 @@ class MILTON_DLL_EXPORT ToneMap : public PropertyMap {
       
       
       //@}-----------------------------------------------------------------
+   
+   protected:
+      /**
+       * @brief
+       *    Fills m_encoding with the 8-bit display value of every quantized 
+       * linear intensity, according to the given display gamma or the sRGB 
+       * transfer curve
+       */
+      void _initEncoding(real_t gamma, bool sRGB);
+      
+      /**
+       * @returns the 8-bit display value of the given linear intensity, 
+       *    which is clamped to [0, 1]
+       */
+      inline unsigned char _encode(real_t v) const {
+         ASSERT(!m_encoding.empty());
+         
+         // note: negated comparison s.t. NaNs map to black
+         if (!(v > 0))
+            return m_encoding[0];
+         if (v >= 1)
+            return m_encoding[TONE_MAP_ENCODING_TABLE_SIZE - 1];
+         
+         return m_encoding[
+            (unsigned)(v * (TONE_MAP_ENCODING_TABLE_SIZE - 1) + 0.5)];
+      }
+   
+   protected:
+      std::vector<unsigned char> m_encoding;
 };
 
 }
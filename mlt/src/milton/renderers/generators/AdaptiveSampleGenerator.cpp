@@ -0,0 +1,134 @@
+/**<!-------------------------------------------------------------------->
+   @file   AdaptiveSampleGenerator.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Adaptive super sampling, which generates passes of one jittered 
+   sample per pixel, where after an initial number of passes over every 
+   pixel, subsequent passes only revisit those pixels whose estimated 
+   relative error (see RenderOutput::getRelativeErrors) still exceeds a 
+   given threshold.  Sample generation stops once every pixel has 
+   converged, a maximum number of samples per pixel has been reached, or 
+   a time budget has run out, s.t. smooth regions of the image which 
+   converge quickly don't pay for the noisiest pixels.
+   <!-------------------------------------------------------------------->**/
+
+#include "AdaptiveSampleGenerator.h"
+#include <PointSampleRenderer.h>
+#include <RenderOutput.h>
+#include <Random.h>
+#include <QtCore/QtCore>
+using namespace std;
+
+namespace milton {
+
+template <class SG>
+void AdaptiveSG<SG>::init() {
+   SG::init();
+   
+   m_minSamples = 
+      boost::any_cast<unsigned>(SG::getValue("adaptiveMinSamples", 4u));
+   m_maxSamples = 
+      boost::any_cast<unsigned>(SG::getValue("adaptiveMaxSamples", 64u));
+   m_threshold  = 
+      boost::any_cast<real_t>(SG::getValue("adaptiveThreshold", (real_t) 0.05));
+   m_maxSeconds = 
+      boost::any_cast<real_t>(SG::getValue("adaptiveMaxSeconds", (real_t) 0));
+   
+   // at least two samples are needed to estimate a pixel's variance
+   m_minSamples = MAX(m_minSamples, 2u);
+   m_maxSamples = MAX(m_maxSamples, m_minSamples);
+   
+   cerr << "samples per pixel: " << m_minSamples << " to " << m_maxSamples 
+        << " (relative error threshold " << m_threshold << ")" << endl;
+}
+
+template <class SG>
+void AdaptiveSG<SG>::generate(PointSampleList &outSamples, 
+                              const Viewport &viewport)
+{
+   PointSampleRenderer *renderer = SG::getRenderer();
+   ASSERT(renderer);
+   
+   RenderOutput *output = renderer->getOutput();
+   ASSERT(output);
+   
+   const unsigned width   = viewport.getWidth();
+   const unsigned height  = viewport.getHeight();
+   const unsigned size    = width * height;
+   
+   const real_t binWidth  = viewport.getInvWidth();
+   const real_t binHeight = viewport.getInvHeight();
+   
+   // indices of all pixels which haven't converged yet, in row-major order
+   std::vector<unsigned> active(size);
+   std::vector<real_t>   errors;
+   
+   for(unsigned i = size; i--;)
+      active[i] = i;
+   
+   unsigned s = 0;
+   
+   while(!active.empty()) {
+      const unsigned noActive = active.size();
+      
+      for(unsigned k = 0; k < noActive; ++k) {
+         const unsigned index = active[k];
+         const unsigned i = index / width;
+         const unsigned j = index % width;
+         
+         const real_t x = (j + Random::sample(0, 1)) * binWidth;
+         const real_t y = (i + Random::sample(0, 1)) * binHeight;
+         
+         // update after the last active pixel in each row
+         const bool last   = (k + 1 == noActive);
+         const bool update = (last || active[k + 1] / width != i);
+         
+         SG::_addSample(PointSample(x, y, update, last), outSamples);
+      }
+      
+      ++s;
+      
+      if (s >= m_maxSamples)
+         break;
+      
+      if (m_maxSeconds > 0 && renderer->getTimer().elapsed() >= m_maxSeconds) {
+         cerr << "adaptive sampling: time budget exhausted with " 
+              << noActive << " pixels unconverged" << endl;
+         break;
+      }
+      
+      if (s < m_minSamples)
+         continue;
+      
+      // only revisit pixels whose error is still above the threshold
+      output->getRelativeErrors(errors);
+      unsigned noRemaining = 0;
+      
+      for(unsigned k = 0; k < noActive; ++k) {
+         if (errors[active[k]] > m_threshold)
+            active[noRemaining++] = active[k];
+      }
+      
+      active.resize(noRemaining);
+      
+      cerr << "pass " << s << ": " << noRemaining << " / " << size 
+           << " pixels unconverged (" 
+           << (unsigned)(100 * ((real_t)(size - noRemaining) / size)) 
+           << "% complete); " << renderer->getElapsedTime() << " elapsed" 
+           << endl;
+   }
+}
+
+}
+
+// force explicit template specialization of AdaptiveSampleGeneratorThread
+#include <generators.h>
+
+namespace milton {
+   // Only declare threaded version of adaptive sample generator, since it 
+   // depends on the renderer's output for its error estimates
+   template class AdaptiveSG<SampleGeneratorThread>;
+}
+
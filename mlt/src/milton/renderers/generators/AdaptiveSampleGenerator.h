@@ -0,0 +1,83 @@
+/**<!-------------------------------------------------------------------->
+   @class  AdaptiveSampleGenerator
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Adaptive super sampling, which generates passes of one jittered 
+   sample per pixel, where after an initial number of passes over every 
+   pixel, subsequent passes only revisit those pixels whose estimated 
+   relative error (see RenderOutput::getRelativeErrors) still exceeds a 
+   given threshold.  Sample generation stops once every pixel has 
+   converged, a maximum number of samples per pixel has been reached, or 
+   a time budget has run out, s.t. smooth regions of the image which 
+   converge quickly don't pay for the noisiest pixels.
+   
+   @note
+      Error estimates are read from the renderer's RenderOutput while 
+   samples from the previous pass may still be pending evaluation, s.t. 
+   they may lag slightly behind; pixels with fewer than two evaluated 
+   samples are always revisited, as are pixels whose samples have all been 
+   zero so far, which therefore only stop at adaptiveMaxSamples.
+   <!-------------------------------------------------------------------->**/
+
+#ifndef ADAPTIVE_SAMPLE_GENERATOR_H_
+#define ADAPTIVE_SAMPLE_GENERATOR_H_
+
+#include <renderers/generators/SampleGenerator.h>
+
+namespace milton {
+
+template <class SG>
+class MILTON_DLL_EXPORT AdaptiveSG : public SG {
+   
+   public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline AdaptiveSG()
+         : SG(), m_minSamples(4), m_maxSamples(64), m_threshold(0.05), 
+           m_maxSeconds(0)
+      { }
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Initialization
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Parses the following parameters: 
+       *    adaptiveMinSamples - number of initial passes over every pixel 
+       *                         (default 4, at least 2) 
+       *    adaptiveMaxSamples - maximum number of samples per pixel 
+       *                         (default 64) 
+       *    adaptiveThreshold  - relative error below which a pixel is 
+       *                         considered to have converged (default 0.05) 
+       *    adaptiveMaxSeconds - time after which no more passes are started 
+       *                         (default 0, unlimited)
+       */
+      virtual void init();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      virtual void generate(PointSampleList &outSamples, 
+                            const Viewport &viewport);
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      unsigned m_minSamples;
+      unsigned m_maxSamples;
+      real_t   m_threshold;
+      real_t   m_maxSeconds;
+};
+
+}
+
+#endif // ADAPTIVE_SAMPLE_GENERATOR_H_
+
@@ -36,6 +36,11 @@ void SampleGeneratorThread::run() {
 void SampleGeneratorThread::_addSample(const PointSample &s, 
                                        PointSampleList &/* unused */)
 {
+   if (m_noSkippedSamples > 0) {
+      --m_noSkippedSamples;
+      return;
+   }
+   
    m_renderer->addSharedSample(s);
 }
 
@@ -57,6 +62,8 @@ SampleGeneratorThread *SampleGeneratorThread::create(const std::string &type) {
       return new DissolveSampleGeneratorThread();
    } else if (type == "hilbert") {
       return new HilbertSampleGeneratorThread();
+   } else if (type == "adaptive") {
+      return new AdaptiveSampleGeneratorThread();
    } else if (type == "super" || type == "default") {
       return new SuperSampleGeneratorThread("jittered");
    } else {
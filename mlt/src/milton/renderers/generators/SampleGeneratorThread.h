@@ -30,7 +30,7 @@ class MILTON_DLL_EXPORT SampleGeneratorThread : public SampleGenerator, public Q
       
       inline   SampleGeneratorThread(PointSampleRenderer *renderer = NULL)
          : SampleGenerator(), QThread(), 
-           m_renderer(renderer)
+           m_renderer(renderer), m_noSkippedSamples(0)
       { }
       
       virtual ~SampleGeneratorThread();
@@ -71,6 +71,16 @@ class MILTON_DLL_EXPORT SampleGeneratorThread : public SampleGenerator, public Q
          m_viewport = v;
       }
       
+      /**
+       * @brief
+       *    Discards the first @p noSamples samples generated instead of 
+       * passing them on to the renderer (eg. s.t. a render resumed from a 
+       * checkpoint continues where it left off)
+       */
+      inline void setNoSkippedSamples(uint64_t noSamples) {
+         m_noSkippedSamples = noSamples;
+      }
+      
       
       //@}-----------------------------------------------------------------
       
@@ -80,6 +90,9 @@ class MILTON_DLL_EXPORT SampleGeneratorThread : public SampleGenerator, public Q
    protected:
       Viewport             m_viewport;
       PointSampleRenderer *m_renderer;
+      
+      /// number of samples which remain to be discarded
+      uint64_t             m_noSkippedSamples;
 };
 
 }
@@ -19,6 +19,7 @@
 #include <renderers/generators/DissolveSampleGenerator.h>
 #include <renderers/generators/HilbertSampleGenerator.h>
 #include <renderers/generators/SuperSampleGenerator.h>
+#include <renderers/generators/AdaptiveSampleGenerator.h>
 
 // Separate SampleGenerator and SampleGeneratorThread interfaces
 #include <renderers/generators/SampleGenerator.h>
@@ -43,6 +44,7 @@ namespace milton {
    // Only declare threaded versions of some sample generators
    typedef SuperSG<SampleGeneratorThread>    SuperSampleGeneratorThread;
    typedef DissolveSG<SampleGeneratorThread> DissolveSampleGeneratorThread;
+   typedef AdaptiveSG<SampleGeneratorThread> AdaptiveSampleGeneratorThread;
    
 }
 
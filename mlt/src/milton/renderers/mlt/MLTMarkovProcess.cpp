@@ -8,12 +8,16 @@
    as a Markov process (where state transitions are "memoryless" in that they 
    only depend on the previous state), with state transitions governed by 
    the Metropolis-Hastings algorithm (states are specific paths of light). 
+      A chain terminates once it has performed its maximum number of 
+   mutations (if any) or its renderer has been stopped, and pauses at 
+   iteration boundaries while its renderer writes a checkpoint.
    
    @see MLTPathMutation
    <!-------------------------------------------------------------------->**/
 
 #include "MLTMarkovProcess.h"
 #include <RenderOutput.h>
+#include <Serialization.h>
 #include <ColorUtils.h>
 #include <Camera.h>
 #include <QtCore/QtCore>
@@ -45,7 +49,7 @@ void MLTMarkovProcess::run() {
    
    _initSample(m_path, sample);
    
-   do {
+   while(_continue()) {
       // sample a new path
       real_t alpha = m_mutation->mutate(m_path, pathY);
       real_t theta = 1;
@@ -120,11 +124,40 @@ void MLTMarkovProcess::run() {
          sample = tentative;
          ASSERT(!sample.value.getValue<SpectralSampleSet>().isZero());
       }
-   } while(1);
+      
+      ++m_noMutations;
+   }
+   
+   m_renderer->_finishChain(this);
+}
+
+bool MLTMarkovProcess::saveState(std::ostream &out) const {
+   writeBinary<uint64_t>(out, m_noMutations);
+   
+   return !out.fail();
+}
+
+bool MLTMarkovProcess::loadState(std::istream &in) {
+   return readBinary(in, m_noMutations);
+}
+
+bool MLTMarkovProcess::_continue() {
+   if (m_renderer->isPauseRequested())
+      m_renderer->_pauseChain(this);
+   
+   return (!m_renderer->isStopped() && 
+           (m_maxMutations == 0 || m_noMutations < m_maxMutations));
 }
 
 void MLTMarkovProcess::_initSample(Path &path, PointSample &sample) {
-   SpectralSampleSet radiance = path.getRadiance();
+   _initSample(path, path.getRadiance(), sample);
+}
+
+void MLTMarkovProcess::_initSample(const Path &path, 
+                                   const SpectralSampleSet &pathRadiance, 
+                                   PointSample &sample)
+{
+   SpectralSampleSet radiance = pathRadiance;
    const Camera *camera = m_renderer->getCamera();
    
    if (path.length() < 2 || radiance.isZero()) {
@@ -8,6 +8,9 @@
    as a Markov process (where state transitions are "memoryless" in that they 
    only depend on the previous state), with state transitions governed by 
    the Metropolis-Hastings algorithm (states are specific paths of light). 
+      A chain terminates once it has performed its maximum number of 
+   mutations (if any) or its renderer has been stopped, and pauses at 
+   iteration boundaries while its renderer writes a checkpoint.
    
    @see MLTPathMutation
    <!-------------------------------------------------------------------->**/
@@ -17,6 +20,7 @@
 
 #include <renderers/utils/Path.h>
 #include <QtCore/QThread>
+#include <iosfwd>
 
 namespace milton {
 
@@ -32,7 +36,8 @@ class MILTON_DLL_EXPORT MLTMarkovProcess : public QThread {
       inline MLTMarkovProcess(MLTRenderer *renderer, const Path &path, 
                               const real_t weight, bool primary = false)
          : QThread(), m_renderer(renderer), m_mutation(NULL), m_path(path), 
-           m_weight(weight), m_primary(primary)
+           m_weight(weight), m_primary(primary), 
+           m_noMutations(0), m_maxMutations(0)
       { }
       
       virtual ~MLTMarkovProcess();
@@ -58,6 +63,31 @@ class MILTON_DLL_EXPORT MLTMarkovProcess : public QThread {
       virtual void run();
       
       
+      //@}-----------------------------------------------------------------
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Serializes the state of this chain s.t. it may later be resumed 
+       * via loadState
+       * 
+       * @note the current path isn't serialized, since paths reference 
+       *    scene data directly; chains in path space are therefore resumed 
+       *    from a new seed path, retaining only their progress
+       * @note must only be called while this chain is paused or stopped
+       */
+      virtual bool saveState(std::ostream &out) const;
+      
+      /**
+       * @brief
+       *    Restores a state previously serialized via saveState
+       * 
+       * @note must be called after init and before this chain is started
+       */
+      virtual bool loadState(std::istream &in);
+      
+      
       //@}-----------------------------------------------------------------
       ///@name Accessors / Mutators
       //@{-----------------------------------------------------------------
@@ -90,11 +120,39 @@ class MILTON_DLL_EXPORT MLTMarkovProcess : public QThread {
          return m_primary;
       }
       
+      /// @returns the number of mutations this chain has performed
+      inline uint64_t getNoMutations() const {
+         return m_noMutations;
+      }
+      
+      inline uint64_t getMaxMutations() const {
+         return m_maxMutations;
+      }
+      
+      /// sets the number of mutations after which this chain terminates, 
+      /// where zero denotes no limit
+      inline void setMaxMutations(uint64_t maxMutations) {
+         m_maxMutations = maxMutations;
+      }
+      
       
       //@}-----------------------------------------------------------------
       
    protected:
+      /**
+       * @returns whether or not this chain should perform another mutation, 
+       *    blocking while the renderer is writing a checkpoint
+       */
+      bool _continue();
+      
       virtual void _initSample(Path &path, PointSample &sample);
+      
+      /// initializes @p sample from the given path, whose contribution is 
+      /// taken to be @p radiance
+      virtual void _initSample(const Path &path, 
+                               const SpectralSampleSet &radiance, 
+                               PointSample &sample);
+      
       virtual void _addSample (const PointSample &sample, real_t prob, 
                                bool tentative = false);
       
@@ -106,6 +164,9 @@ class MILTON_DLL_EXPORT MLTMarkovProcess : public QThread {
       unsigned         m_maxDepth;
       unsigned         m_maxConsequtiveRejections;
       bool             m_primary;
+      
+      uint64_t         m_noMutations;
+      uint64_t         m_maxMutations;
 };
 
 }
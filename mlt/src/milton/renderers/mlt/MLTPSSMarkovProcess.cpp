@@ -0,0 +1,308 @@
+/**<!-------------------------------------------------------------------->
+   @file   MLTPSSMarkovProcess.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Markov process which performs its random walk in primary sample space 
+   (Kelemen et al., 2002) instead of directly in path space.  States are 
+   vectors of uniform random numbers, which are mapped to paths by the MLT 
+   renderer's underlying bidirectional path tracer (see 
+   MLTRenderer::samplePrimarySpacePath), and proposals are generated by 
+   mutating these numbers via MLTPrimarySampleSpace.  Unlike the path space 
+   mutations used by MLTMarkovProcess, no transition probabilities need to 
+   be evaluated, since primary sample space mutations are symmetric.
+      Since each chain's state is small, a single process (thread) may run
+   many chains, interleaving their iterations ('mltChainsPerThread').
+   Chains are grouped into ladders of 'mltNoTemperatures' replicas, where
+   the replica at level k of a ladder targets the path luminance raised to
+   the power 1 / T_k, with temperatures T_k spaced geometrically between 1
+   and 'mltMaxTemperature'.  Hotter replicas traverse low-contribution
+   regions of path space easily, and replica exchange swaps between
+   adjacent levels ('mltSwapInterval') let the cold (T = 1) replicas, which
+   alone contribute to the image, escape from isolated modes (eg. caustic
+   paths) in which a single chain would otherwise get stuck.
+      Every large step proposal is an independent sample of the path
+   luminance, regardless of temperature, so all replicas also contribute to
+   a continuously refined estimate of the image's normalization
+   (see MLTRenderer::_addNormalizationSamples).
+   
+   @see MLTPrimarySampleSpace
+   @see MLTMarkovProcess
+   <!-------------------------------------------------------------------->**/
+
+#include "MLTPSSMarkovProcess.h"
+#include <renderers/mlt/MLTPrimarySampleSpace.h>
+#include <Serialization.h>
+#include <PointSample.h>
+
+namespace milton {
+
+// number of rounds (iterations of every chain) between passing large step 
+// samples on to the renderer's normalization estimate
+#define MLT_PSS_FLUSH_INTERVAL      (256)
+
+MLTPSSMarkovProcess::~MLTPSSMarkovProcess() {
+   FOREACH(mltPSSChainListIter, m_chains, iter) {
+      safeDelete(iter->state);
+   }
+}
+
+void MLTPSSMarkovProcess::init() {
+   ASSERT(m_weight >= 0);
+   
+   m_maxDepth = m_renderer->getMaxDepth();
+   m_maxConsequtiveRejections = m_renderer->getMaxConsequtiveRejections();
+   
+   m_largeStepProb = 
+      CLAMP(m_renderer->getValue<real_t>("mltPSSLargeStepProb", 0.3), 0, 1);
+   m_sigma = 
+      MAX(m_renderer->getValue<real_t>("mltPSSSigma", 0.01), EPSILON);
+   
+   const real_t maxTemperature = 
+      MAX(m_renderer->getValue<real_t>("mltMaxTemperature", 16), 1);
+   
+   m_swapInterval   = m_renderer->getValue<unsigned>("mltSwapInterval", 8u);
+   m_noTemperatures = MIN(m_renderer->getNoTemperatures(), m_seeds.size());
+   m_noTemperatures = MAX(m_noTemperatures, 1u);
+   
+   FOREACH(mltPSSChainListIter, m_chains, iter) {
+      safeDelete(iter->state);
+   }
+   
+   m_chains.resize(m_seeds.size());
+   
+   for(unsigned i = 0; i < m_chains.size(); ++i) {
+      mltPSSChain &chain = m_chains[i];
+      const unsigned level = i % m_noTemperatures;
+      
+      chain.state = new MLTPrimarySampleSpace(m_chainSeeds[i], m_seeds[i].seed, 
+                                              m_largeStepProb, m_sigma);
+      chain.sample.value = Event(SpectralSampleSet::black());
+      chain.I            = 0;
+      chain.noVisits     = 0;
+      
+      // temperatures are spaced geometrically between 1 and maxTemperature
+      chain.invTemperature = (level == 0 ? 1 : 
+         pow(maxTemperature, -create_real(level) / (m_noTemperatures - 1)));
+   }
+   
+   m_swapGenerator.seed(~m_chainSeeds[0]);
+   m_largeStepSum = 0;
+   m_noLargeSteps = 0;
+}
+
+void MLTPSSMarkovProcess::run() {
+   ASSERT(!m_chains.empty());
+   
+   const unsigned noChains = m_chains.size();
+   const unsigned noColdChains = 
+      (noChains + m_noTemperatures - 1) / m_noTemperatures;
+   
+   PointSample tentative;
+   Path pathY(m_renderer);
+   unsigned round = 0;
+   
+   // evaluating each chain's initial state replays the random numbers which 
+   // generated its seed path (or its current path if this process was 
+   // resumed from a checkpoint)
+   FOREACH(mltPSSChainListIter, m_chains, iter) {
+      _evaluate(*iter);
+   }
+   
+   while(_continue()) {
+      // interleave iterations of all chains
+      for(unsigned i = 0; i < noChains; ++i)
+         _iterate(m_chains[i], pathY, tentative);
+      
+      ++round;
+      
+      if (m_noTemperatures > 1 && m_swapInterval > 0 && 
+          0 == (round % m_swapInterval))
+      {
+         for(unsigned i = 0; i < noChains; i += m_noTemperatures)
+            _swap(i);
+      }
+      
+      if (0 == (round % MLT_PSS_FLUSH_INTERVAL))
+         _flushNormalization();
+      
+      // only cold chains contribute to the image
+      m_noMutations += noColdChains;
+   }
+   
+   _flushNormalization();
+   
+   Random::setThreadStream(NULL);
+   m_renderer->_finishChain(this);
+}
+
+void MLTPSSMarkovProcess::_evaluate(mltPSSChain &chain) {
+   MLTPrimarySampleSpace &state = *chain.state;
+   
+   // all random numbers consumed on this thread now come from (and are 
+   // recorded in) this chain's current state in primary sample space
+   Random::setThreadStream(&state);
+   state.rewind();
+   
+   const SpectralSampleSet &contribution = 
+      m_renderer->samplePrimarySpacePath(m_path);
+   
+   chain.I        = contribution.getRGB().luminance();
+   chain.noVisits = 0;
+   
+   if (chain.I > 0)
+      _initSample(m_path, contribution, chain.sample);
+   else
+      chain.sample.value = Event(SpectralSampleSet::black());
+}
+
+void MLTPSSMarkovProcess::_iterate(mltPSSChain &chain, Path &pathY, 
+                                   PointSample &tentative)
+{
+   MLTPrimarySampleSpace &state = *chain.state;
+   
+   Random::setThreadStream(&state);
+   state.startIteration();
+   
+   // propose a new state and map it to a path
+   const SpectralSampleSet &contributionY = 
+      m_renderer->samplePrimarySpacePath(pathY);
+   const real_t IY = contributionY.getRGB().luminance();
+   
+   // large step proposals are independent of the chain's current state and 
+   // therefore yield unbiased estimates of the image's normalization
+   if (state.isLargeStep()) {
+      m_largeStepSum += IY;
+      ++m_noLargeSteps;
+   }
+   
+   // mutations in primary sample space are symmetric, so the acceptance 
+   // probability only depends on the ratio of (tempered) target densities
+   real_t alpha = 1;
+   
+   if (chain.I > 0) {
+      const real_t ratio = IY / chain.I;
+      
+      alpha = MIN(create_real(1), (chain.invTemperature == 1 ? ratio : 
+                                   pow(ratio, chain.invTemperature)));
+   }
+   
+   if (IY <= 0) {
+      pathY.clear();
+      alpha = 0;
+      
+      tentative.value = Event(SpectralSampleSet::black());
+   } else {
+      _initSample(pathY, contributionY, tentative);
+   }
+   
+   ++chain.noVisits;
+   if (chain.invTemperature == 1 && 
+       (m_maxConsequtiveRejections <= 0 || 
+        chain.noVisits < m_maxConsequtiveRejections))
+   {
+      chain.sample.update = (m_primary && &chain == &m_chains[0]);
+      
+      _addSample(chain.sample, 1 - alpha, false);
+      _addSample(tentative,    alpha,     true);
+   }
+   
+   // transition with probability alpha; note Random::sample may not be 
+   // used here because it would consume a dimension of the current state
+   if (state.uniform() < alpha) {
+      state.accept();
+      
+      chain.noVisits = 0;
+      chain.sample   = tentative;
+      chain.I        = IY;
+   } else {
+      state.reject();
+   }
+}
+
+void MLTPSSMarkovProcess::_swap(unsigned ladder) {
+   const unsigned n = MIN(m_noTemperatures, m_chains.size() - ladder);
+   
+   if (n < 2)
+      return;
+   
+   Random::BoostContUniformSampler uniform(m_swapGenerator, 
+                                           Random::ContUniformDist(0, 1));
+   
+   // select a random pair of adjacent temperatures, where 'a' is colder
+   const unsigned k = MIN((unsigned) (uniform() * (n - 1)), n - 2);
+   mltPSSChain &a = m_chains[ladder + k];
+   mltPSSChain &b = m_chains[ladder + k + 1];
+   ASSERT(a.invTemperature > b.invTemperature);
+   
+   // accept the exchange with probability 
+   // min(1, (I_b / I_a) ^ (1 / T_a - 1 / T_b))
+   real_t alpha = 0;
+   
+   if (a.I <= 0)
+      alpha = (b.I > 0);
+   else if (b.I > 0)
+      alpha = pow(b.I / a.I, a.invTemperature - b.invTemperature);
+   
+   if (uniform() < alpha) {
+      std::swap(a.state, b.state);
+      std::swap(a.I, b.I);
+      
+      const PointSample temp = a.sample;
+      a.sample = b.sample;
+      b.sample = temp;
+      
+      a.noVisits = 0;
+      b.noVisits = 0;
+   }
+}
+
+void MLTPSSMarkovProcess::_flushNormalization() {
+   if (m_noLargeSteps > 0) {
+      m_renderer->_addNormalizationSamples(m_largeStepSum, m_noLargeSteps);
+      
+      m_largeStepSum = 0;
+      m_noLargeSteps = 0;
+   }
+}
+
+bool MLTPSSMarkovProcess::saveState(std::ostream &out) const {
+   if (!MLTMarkovProcess::saveState(out))
+      return false;
+   
+   writeBinary<uint32_t>(out, m_chains.size());
+   writeBinary<real_t>  (out, m_largeStepSum);
+   writeBinary<uint64_t>(out, m_noLargeSteps);
+   writeTextual(out, m_swapGenerator);
+   
+   // chains are stored in order of temperature, s.t. states which have been 
+   // exchanged are resumed at their current temperatures
+   FOREACH(mltPSSChainListConstIter, m_chains, iter) {
+      if (!iter->state->saveState(out))
+         return false;
+   }
+   
+   return !out.fail();
+}
+
+bool MLTPSSMarkovProcess::loadState(std::istream &in) {
+   uint32_t noChains = 0;
+   
+   if (!MLTMarkovProcess::loadState(in) || !readBinary(in, noChains) || 
+       noChains != m_chains.size() || !readBinary(in, m_largeStepSum) || 
+       !readBinary(in, m_noLargeSteps) || !readTextual(in, m_swapGenerator))
+   {
+      return false;
+   }
+   
+   FOREACH(mltPSSChainListIter, m_chains, iter) {
+      if (!iter->state->loadState(in))
+         return false;
+   }
+   
+   return true;
+}
+
+}
+
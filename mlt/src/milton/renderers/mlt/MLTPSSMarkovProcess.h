@@ -0,0 +1,174 @@
+/**<!-------------------------------------------------------------------->
+   @class  MLTPSSMarkovProcess
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Markov process which performs its random walk in primary sample space 
+   (Kelemen et al., 2002) instead of directly in path space.  States are 
+   vectors of uniform random numbers, which are mapped to paths by the MLT 
+   renderer's underlying bidirectional path tracer (see 
+   MLTRenderer::samplePrimarySpacePath), and proposals are generated by 
+   mutating these numbers via MLTPrimarySampleSpace.  Unlike the path space 
+   mutations used by MLTMarkovProcess, no transition probabilities need to 
+   be evaluated, since primary sample space mutations are symmetric.
+      Since each chain's state is small, a single process (thread) may run
+   many chains, interleaving their iterations ('mltChainsPerThread').
+   Chains are grouped into ladders of 'mltNoTemperatures' replicas, where
+   the replica at level k of a ladder targets the path luminance raised to
+   the power 1 / T_k, with temperatures T_k spaced geometrically between 1
+   and 'mltMaxTemperature'.  Hotter replicas traverse low-contribution
+   regions of path space easily, and replica exchange swaps between
+   adjacent levels ('mltSwapInterval') let the cold (T = 1) replicas, which
+   alone contribute to the image, escape from isolated modes (eg. caustic
+   paths) in which a single chain would otherwise get stuck.
+      Every large step proposal is an independent sample of the path
+   luminance, regardless of temperature, so all replicas also contribute to
+   a continuously refined estimate of the image's normalization
+   (see MLTRenderer::_addNormalizationSamples).
+   
+   @see MLTPrimarySampleSpace
+   @see MLTMarkovProcess
+   <!-------------------------------------------------------------------->**/
+
+#ifndef MLT_PSS_MARKOV_PROCESS_H_
+#define MLT_PSS_MARKOV_PROCESS_H_
+
+#include <renderers/mlt/MLTMarkovProcess.h>
+#include <renderers/mlt/MLTRenderer.h>
+#include <renderers/PointSample.h>
+
+namespace milton {
+
+class MLTPrimarySampleSpace;
+
+/// single replica run by an MLTPSSMarkovProcess
+struct MILTON_DLL_EXPORT mltPSSChain {
+   /// current state in primary sample space
+   MLTPrimarySampleSpace *state;
+   
+   /// contribution of the current state, if it is non-zero
+   PointSample            sample;
+   
+   /// luminance of the current state's contribution
+   real_t                 I;
+   
+   /// reciprocal of this replica's temperature
+   real_t                 invTemperature;
+   
+   /// number of iterations since the last accepted proposal
+   unsigned               noVisits;
+};
+
+DECLARE_STL_TYPEDEF(std::vector<mltPSSChain>, mltPSSChainList);
+
+class MILTON_DLL_EXPORT MLTPSSMarkovProcess : public MLTMarkovProcess {
+   public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @param seeds initial states of this process' chains, one per chain
+       * @param chainSeeds seeds of the random number generators used for 
+       *    mutations, one per chain, which should be unique for each chain
+       */
+      inline MLTPSSMarkovProcess(MLTRenderer *renderer, 
+                                 const mltSeedPathList &seeds, 
+                                 const std::vector<unsigned> &chainSeeds, 
+                                 const real_t weight, bool primary = false)
+         : MLTMarkovProcess(renderer, Path(renderer), weight, primary), 
+           m_seeds(seeds), m_chainSeeds(chainSeeds), m_noTemperatures(1), 
+           m_swapInterval(0), m_largeStepSum(0), m_noLargeSteps(0)
+      {
+         ASSERT(!m_seeds.empty() && m_seeds.size() == m_chainSeeds.size());
+      }
+      
+      virtual ~MLTPSSMarkovProcess();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Initialization
+      //@{-----------------------------------------------------------------
+      
+      virtual void init();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Begins a random walk throughout primary sample space for each of
+       * this process' chains, starting from the states corresponding to 
+       * their seed paths
+       */
+      virtual void run();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Serializes each chain's current state in primary sample space, 
+       * from which its current path is regenerated upon being resumed
+       */
+      virtual bool saveState(std::ostream &out) const;
+      
+      virtual bool loadState(std::istream &in);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      inline unsigned getNoChains() const {
+         return m_chains.size();
+      }
+      
+      /// @returns the number of replicas in each temperature ladder
+      inline unsigned getNoTemperatures() const {
+         return m_noTemperatures;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      /// advances the given chain by a single iteration
+      void _iterate(mltPSSChain &chain, Path &pathY, PointSample &tentative);
+      
+      /// attempts a replica exchange between two adjacent levels of the
+      /// ladder beginning at chain index @p ladder
+      void _swap(unsigned ladder);
+      
+      /// evaluates the given chain's current state from scratch
+      void _evaluate(mltPSSChain &chain);
+      
+      /// passes the large step samples gathered thus far on to the renderer
+      void _flushNormalization();
+   
+   protected:
+      mltSeedPathList       m_seeds;
+      std::vector<unsigned> m_chainSeeds;
+      real_t                m_largeStepProb;
+      real_t                m_sigma;
+      
+      mltPSSChainList       m_chains;
+      unsigned              m_noTemperatures;
+      unsigned              m_swapInterval;
+      
+      /// used exclusively for replica exchange
+      Random::Generator     m_swapGenerator;
+      
+      /// luminance of large step proposals not yet passed on to the renderer
+      real_t                m_largeStepSum;
+      uint64_t              m_noLargeSteps;
+};
+
+}
+
+#endif // MLT_PSS_MARKOV_PROCESS_H_
+
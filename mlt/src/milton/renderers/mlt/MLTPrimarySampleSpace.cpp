@@ -0,0 +1,178 @@
+/**<!-------------------------------------------------------------------->
+   @file   MLTPrimarySampleSpace.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      State of a Markov chain in primary sample space (Kelemen et al., 2002), 
+   represented as the vector of uniform random numbers consumed by a path
+   generator.  Installed as the calling thread's RandomStream, it replays
+   and mutates these numbers as they are consumed via Random::sample, such
+   that an ordinary path generator (eg. BidirectionalPathTracer) may be
+   driven by the Metropolis-Hastings algorithm without any knowledge of it.
+   <!-------------------------------------------------------------------->**/
+
+#include "MLTPrimarySampleSpace.h"
+#include <Serialization.h>
+
+namespace milton {
+
+MLTPrimarySampleSpace::MLTPrimarySampleSpace(unsigned seed, 
+                                             unsigned initialSeed, 
+                                             real_t largeStepProb, 
+                                             real_t sigma)
+   : RandomStream(), m_generator(seed), m_initialGenerator(initialSeed), 
+     m_normalSampler(m_generator, Random::NormalDist(0, 1)), 
+     m_largeStepProb(largeStepProb), m_sigma(sigma), m_iteration(0), 
+     m_lastLargeStep(0), m_index(0), m_largeStep(false)
+{ }
+
+void MLTPrimarySampleSpace::startIteration() {
+   ++m_iteration;
+   
+   m_largeStep = (uniform() < m_largeStepProb);
+   m_index     = 0;
+}
+
+void MLTPrimarySampleSpace::accept() {
+   if (m_largeStep)
+      m_lastLargeStep = m_iteration;
+}
+
+void MLTPrimarySampleSpace::reject() {
+   ASSERT(m_iteration > 0);
+   
+   FOREACH(mltPrimarySampleListIter, m_samples, iter) {
+      if (iter->modified == m_iteration) {
+         iter->value    = iter->backupValue;
+         iter->modified = iter->backupModified;
+      }
+   }
+   
+   // the rejected iteration never happened as far as lazily-evaluated 
+   // small steps are concerned
+   --m_iteration;
+}
+
+real_t MLTPrimarySampleSpace::next() {
+   if (m_index >= m_samples.size()) {
+      // dimension used for the first time; initialize it independently of 
+      // the rest of the state
+      mltPrimarySample sample;
+      
+      sample.value          = _uniform(m_initialGenerator);
+      sample.modified       = m_iteration;
+      sample.backupValue    = sample.value;
+      sample.backupModified = (m_iteration > 0 ? m_iteration - 1 : 0);
+      
+      m_samples.push_back(sample);
+      return m_samples[m_index++].value;
+   }
+   
+   mltPrimarySample &sample = m_samples[m_index++];
+   
+   if (sample.modified < m_iteration) {
+      // bring this dimension up to date with the last accepted large step
+      if (sample.modified < m_lastLargeStep) {
+         sample.value    = uniform();
+         sample.modified = m_lastLargeStep;
+      }
+      
+      sample.backupValue    = sample.value;
+      sample.backupModified = sample.modified;
+      
+      if (m_largeStep) {
+         sample.value = uniform();
+      } else {
+         // n consecutive Gaussian perturbations are equivalent to a single 
+         // perturbation with n times the variance
+         const unsigned n = m_iteration - sample.modified;
+         
+         sample.value += m_normalSampler() * m_sigma * sqrt((real_t) n);
+         sample.value -= floor(sample.value);
+         
+         if (sample.value >= 1)
+            sample.value = 0;
+      }
+      
+      sample.modified = m_iteration;
+   }
+   
+   ASSERT(sample.value >= 0 && sample.value < 1);
+   return sample.value;
+}
+
+real_t MLTPrimarySampleSpace::uniform() {
+   return _uniform(m_generator);
+}
+
+void MLTPrimarySampleSpace::rewind() {
+   m_index = 0;
+}
+
+bool MLTPrimarySampleSpace::saveState(std::ostream &out) const {
+   writeBinary<uint32_t>(out, m_iteration);
+   writeBinary<uint32_t>(out, m_lastLargeStep);
+   writeBinary<uint32_t>(out, m_samples.size());
+   
+   FOREACH(mltPrimarySampleListConstIter, m_samples, iter) {
+      writeBinary<real_t>  (out, iter->value);
+      writeBinary<uint32_t>(out, iter->modified);
+   }
+   
+   writeTextual(out, m_generator);
+   writeTextual(out, m_initialGenerator);
+   writeTextual(out, m_normalSampler.distribution());
+   
+   return !out.fail();
+}
+
+bool MLTPrimarySampleSpace::loadState(std::istream &in) {
+   uint32_t iteration = 0, lastLargeStep = 0, noSamples = 0;
+   
+   if (!readBinary(in, iteration) || !readBinary(in, lastLargeStep) || 
+       !readBinary(in, noSamples) || lastLargeStep > iteration)
+   {
+      return false;
+   }
+   
+   mltPrimarySampleList samples(noSamples);
+   
+   FOREACH(mltPrimarySampleListIter, samples, iter) {
+      uint32_t modified = 0;
+      
+      if (!readBinary(in, iter->value) || !readBinary(in, modified) || 
+          modified > iteration || !(iter->value >= 0 && iter->value < 1))
+      {
+         return false;
+      }
+      
+      iter->modified       = modified;
+      iter->backupValue    = iter->value;
+      iter->backupModified = modified;
+   }
+   
+   if (!readTextual(in, m_generator) || 
+       !readTextual(in, m_initialGenerator) || 
+       !readTextual(in, m_normalSampler.distribution()))
+   {
+      return false;
+   }
+   
+   m_samples.swap(samples);
+   m_iteration     = iteration;
+   m_lastLargeStep = lastLargeStep;
+   m_index         = 0;
+   m_largeStep     = false;
+   
+   return true;
+}
+
+inline real_t MLTPrimarySampleSpace::_uniform(Random::Generator &generator) const {
+   Random::BoostContUniformSampler sampler(generator, 
+                                           Random::ContUniformDist(0, 1));
+   
+   return sampler();
+}
+
+}
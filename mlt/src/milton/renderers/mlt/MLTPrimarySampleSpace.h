@@ -0,0 +1,173 @@
+/**<!-------------------------------------------------------------------->
+   @class  MLTPrimarySampleSpace
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      State of a Markov chain in primary sample space (Kelemen et al., 2002), 
+   represented as the vector of uniform random numbers consumed by a path
+   generator.  Installed as the calling thread's RandomStream, it replays
+   and mutates these numbers as they are consumed via Random::sample, such
+   that an ordinary path generator (eg. BidirectionalPathTracer) may be
+   driven by the Metropolis-Hastings algorithm without any knowledge of it.
+      Each iteration is either a large step, which replaces every number
+   consumed with an independent uniform sample, or a small step, which
+   perturbs each number by a (wrapped) Gaussian.  Mutations are applied
+   lazily when a number is actually consumed, s.t. dimensions which aren't
+   used by the current path cost nothing; since a dimension left untouched
+   for n iterations is perturbed once with n times the variance, this is
+   equivalent to having mutated every dimension every iteration.  Rejected
+   proposals restore only those numbers which were modified during the
+   current iteration instead of copying the entire state.
+   
+   @see MLTPSSMarkovProcess
+   <!-------------------------------------------------------------------->**/
+
+#ifndef MLT_PRIMARY_SAMPLE_SPACE_H_
+#define MLT_PRIMARY_SAMPLE_SPACE_H_
+
+#include <stats/Random.h>
+#include <iosfwd>
+
+namespace milton {
+
+/// single dimension of primary sample space
+struct MILTON_DLL_EXPORT mltPrimarySample {
+   real_t   value;
+   
+   /// iteration in which value was last modified
+   unsigned modified;
+   
+   /// state prior to the current iteration, restored upon rejection
+   real_t   backupValue;
+   unsigned backupModified;
+};
+
+DECLARE_STL_TYPEDEF(std::vector<mltPrimarySample>, mltPrimarySampleList);
+
+class MILTON_DLL_EXPORT MLTPrimarySampleSpace : public RandomStream {
+   public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @param seed seeds the generator used for mutations
+       * @param initialSeed seeds the generator from which new dimensions 
+       *    are initialized, s.t. the state before the first mutation
+       *    replays the random numbers Random::sample would have returned
+       *    had a Random::Generator seeded with @p initialSeed been installed
+       *    via Random::setThreadGenerator
+       * @param largeStepProb probability of each iteration being a large step
+       * @param sigma standard deviation of small step perturbations
+       */
+      MLTPrimarySampleSpace(unsigned seed, unsigned initialSeed, 
+                            real_t largeStepProb = 0.3, 
+                            real_t sigma = 0.01);
+      
+      virtual ~MLTPrimarySampleSpace()
+      { }
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Begins proposing a new state by mutating the current one, where
+       * mutations are applied lazily as dimensions are consumed via next
+       */
+      void startIteration();
+      
+      /// accepts the state proposed by the current iteration
+      void accept();
+      
+      /// rejects the state proposed by the current iteration, restoring
+      /// the previously accepted state
+      void reject();
+      
+      /**
+       * @returns the next dimension of the current state, mutating it 
+       *    first if it hasn't yet been mutated in the current iteration
+       */
+      virtual real_t next();
+      
+      /**
+       * @returns a uniform random number in [0, 1) which is independent of 
+       *    the current state (eg. for evaluating acceptance)
+       * @note this should be used instead of Random::sample on a thread 
+       *    which has this stream installed
+       */
+      real_t uniform();
+      
+      /**
+       * @brief
+       *    Restarts consumption of the current state from its first 
+       * dimension without mutating it, s.t. the path corresponding to the 
+       * current state may be regenerated (eg. after loadState)
+       * 
+       * @note must not be called during an iteration
+       */
+      void rewind();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Serializes the current state, including the states of all 
+       * underlying random number generators
+       * 
+       * @note must not be called during an iteration
+       */
+      bool saveState(std::ostream &out) const;
+      
+      /// restores a state previously serialized via saveState
+      bool loadState(std::istream &in);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      inline bool isLargeStep() const {
+         return m_largeStep;
+      }
+      
+      inline unsigned getIteration() const {
+         return m_iteration;
+      }
+      
+      /// @returns the number of dimensions used thus far
+      inline unsigned getNoDimensions() const {
+         return m_samples.size();
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      inline real_t _uniform(Random::Generator &generator) const;
+   
+   protected:
+      mltPrimarySampleList       m_samples;
+      
+      Random::Generator          m_generator;
+      Random::Generator          m_initialGenerator;
+      Random::BoostNormalSampler m_normalSampler;
+      
+      real_t                     m_largeStepProb;
+      real_t                     m_sigma;
+      
+      unsigned                   m_iteration;
+      unsigned                   m_lastLargeStep;
+      unsigned                   m_index;
+      bool                       m_largeStep;
+};
+
+}
+
+#endif // MLT_PRIMARY_SAMPLE_SPACE_H_
+
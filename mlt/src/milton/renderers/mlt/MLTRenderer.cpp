@@ -15,23 +15,87 @@
    that the probability density of simulating any one path is proportional to 
    that path's relative contribution to what that virtual sensor would end up 
    "seeing" in the virtual scene.
+      Two variants are supported, selected via the 'mltMode' property:  
+   'veach' (default) mutates paths directly in path space, whereas 'pss' 
+   performs primary sample space MLT (Kelemen et al., 2002), mutating the 
+   random numbers consumed by the underlying bidirectional path tracer.  In 
+   the latter mode, each render thread may run many interleaved chains with 
+   optional replica exchange between temperatures, and the brightness 
+   normalization is refined continuously throughout rendering (see 
+   MLTPSSMarkovProcess).
+      Rendering terminates once every Markov chain has exhausted its share 
+   of the 'mltMutationsPerPixel' budget, 'mltMaxSeconds' have elapsed, or 
+   stop is called, after which the output is finalized.  If an 
+   'mltCheckpointFile' is given, the film, seed paths, and chain states are 
+   written to it every 'mltCheckpointPeriod' seconds and upon termination, 
+   and rendering resumes from it if it already exists (eg. after being 
+   preempted, or to extend a finished render with a larger budget).
    
    @see MLTMarkovProcess
+   @see MLTPSSMarkovProcess
    @see MLTPathMutation
    <!-------------------------------------------------------------------->**/
 
 #include "MLTRenderer.h"
 #include <BidirectionalPathTracer.h>
 #include <ResourceManager.h>
+#include <Serialization.h>
 #include <RenderOutput.h>
 #include <PointSample.h>
 #include <Camera.h>
 #include <QtCore/QtCore>
 #include <Ray.h>
 #include <mlt.h>
+#include <fstream>
+#include <cstdio>
 
 namespace milton {
 
+// maximum number of attempts at generating a full path within mltMaxDepth
+#define MLT_MAX_SEED_ATTEMPTS       (1000)
+
+// maximum number of attempts at regenerating a valid seed path
+#define MLT_MAX_REGENERATE_ATTEMPTS (100)
+
+// interval in milliseconds at which time budgets and checkpoints are polled
+#define MLT_MONITOR_INTERVAL        (250)
+
+// identifies checkpoint files ('MLTC') and their format
+#define MLT_CHECKPOINT_MAGIC        (0x43544C4Du)
+#define MLT_CHECKPOINT_VERSION      (4)
+
+/**
+ * @brief 
+ *    Worker thread which generates a contiguous stratum of seed paths
+ * 
+ * @see MLTRenderer::_initSeedPaths
+ */
+class mltSeedPathThread : public QThread {
+   public:
+      inline mltSeedPathThread(MLTRenderer *renderer, unsigned begin, 
+                               unsigned end)
+         : QThread(), m_renderer(renderer), m_begin(begin), m_end(end), 
+           m_sum(0), m_noSplits(0)
+      { }
+      
+      virtual ~mltSeedPathThread()
+      { }
+      
+      virtual void run() {
+         m_renderer->_generateSeedPaths(m_begin, m_end, m_seeds, 
+                                        m_sum, m_noSplits);
+      }
+   
+   public:
+      MLTRenderer    *m_renderer;
+      unsigned        m_begin;
+      unsigned        m_end;
+      
+      mltSeedPathList m_seeds;
+      real_t          m_sum;
+      unsigned        m_noSplits;
+};
+
 MLTRenderer::~MLTRenderer() {
    if (m_pathGenerator) {
       m_pathGenerator->setCamera(NULL);
@@ -63,6 +127,34 @@ void MLTRenderer::init() {
       m_maxDepth = getValue<unsigned>("mltMaxDepth", 10);
       m_maxConsequtiveRejections = getValue<unsigned>("mltMaxConsequtiveRejections", 500);
       
+      const std::string &mode = getValue<std::string>("mltMode", "veach");
+      
+      if (mode == "pss" || mode == "kelemen") {
+         m_mode = MLT_MODE_PSS;
+      } else {
+         ASSERT(mode == "veach");
+         
+         m_mode = MLT_MODE_VEACH;
+      }
+      
+      m_noChainsPerThread = getValue<unsigned>("mltChainsPerThread", 1u);
+      m_noTemperatures    = getValue<unsigned>("mltNoTemperatures",  1u);
+      m_noChainsPerThread = MAX(m_noChainsPerThread, 1u);
+      m_noTemperatures    = MAX(m_noTemperatures,    1u);
+      
+      if (MLT_MODE_PSS == m_mode) {
+         // each thread runs an integral number of temperature ladders
+         m_noChainsPerThread = m_noTemperatures * 
+            ((m_noChainsPerThread + m_noTemperatures - 1) / m_noTemperatures);
+      } else if (m_noChainsPerThread > 1 || m_noTemperatures > 1) {
+         ResourceManager::log.warning << "mltChainsPerThread and "
+            << "mltNoTemperatures are only supported in primary sample "
+            << "space mode (mltMode = 'pss'); ignoring" << endl;
+         
+         m_noChainsPerThread = 1;
+         m_noTemperatures    = 1;
+      }
+      
       cout << "random seed: " << Random::s_seed << endl;
    }
 }
@@ -74,8 +166,12 @@ void MLTRenderer::render() {
    QMutexLocker lock(&m_renderMutex);
    m_output->init();
    
-   unsigned noRenderThreads = 0;
-   unsigned noInitialPaths  = 0;
+   unsigned    noRenderThreads   = 0;
+   unsigned    noInitialPaths    = 0;
+   real_t      mutationsPerPixel = 0;
+   real_t      maxSeconds        = 0;
+   real_t      checkpointPeriod  = 0;
+   std::string checkpointFile;
    
    { // parse parameters
       noRenderThreads  = getValue<unsigned>("noRenderThreads", 1u);
@@ -83,13 +179,54 @@ void MLTRenderer::render() {
       
       noInitialPaths   = getValue<unsigned>("mltNoInitialPaths",  10000u);
       noInitialPaths  += (noInitialPaths  == 0);
+      
+      // zero denotes no limit
+      mutationsPerPixel = MAX(getValue<real_t>("mltMutationsPerPixel", 0), 0);
+      maxSeconds        = MAX(getValue<real_t>("mltMaxSeconds", 0), 0);
+      
+      checkpointFile    = getValue<std::string>("mltCheckpointFile", "");
+      checkpointPeriod  = getValue<real_t>("mltCheckpointPeriod", 600);
    }
    
-   // initialize seed paths and estimate 'b,' the total radiant flux falling 
-   // on the film plane
-   PathList seedPaths;
-   RealList W;
-   real_t weight = _initSeedPaths(seedPaths, W, noInitialPaths);
+   m_stopped        = false;
+   m_pauseRequested = false;
+   m_noPausedChains = 0;
+   m_resumedTime    = 0;
+   
+   MLTMarkovProcessList processes;
+   
+   if (checkpointFile.empty() || 
+       !_loadCheckpoint(checkpointFile, noRenderThreads, processes))
+   {
+      // initialize seed paths and estimate 'b,' the total radiant flux 
+      // falling on the film plane
+      real_t weight = _initSeedPaths(noInitialPaths, noRenderThreads);
+      _initSeedDistribution();
+      
+      for(unsigned i = 0; i < noRenderThreads; ++i) {
+         MLTMarkovProcess *process = _createChain(i, weight);
+         
+         process->init();
+         processes.push_back(process);
+      }
+   }
+   
+   ASSERT(processes.size() == noRenderThreads);
+   
+   // split the mutation budget evenly across all chains
+   const Viewport &viewport = m_output->getViewport();
+   const uint64_t noMutations = (uint64_t) 
+      (mutationsPerPixel * viewport.getWidth() * viewport.getHeight());
+   
+   for(unsigned i = 0; i < noRenderThreads; ++i) {
+      uint64_t maxMutations = noMutations / noRenderThreads + 
+         (i < noMutations % noRenderThreads);
+      
+      if (noMutations > 0 && maxMutations == 0)
+         maxMutations = 1;
+      
+      processes[i]->setMaxMutations(maxMutations);
+   }
    
    // initialize timer to begin counting
    m_timer.reset();
@@ -98,147 +235,625 @@ void MLTRenderer::render() {
       << (noRenderThreads == 1 ? " thread" : " threads") 
       << endl << endl;
    
-   std::vector<MLTMarkovProcess*> processes;
-   for(unsigned i = noRenderThreads; i--;) {
-      const unsigned pathIndex = Random::sampleNormalizedCDF(&W[0], W.size());
-      ASSERT(W[pathIndex] > 0);
+   m_noActiveChains = noRenderThreads;
+   
+   for(unsigned i = 0; i < noRenderThreads; ++i)
+      processes[i]->start();
+   
+   // enforce the time budget and periodically write checkpoints until all 
+   // chains have terminated
+   double lastCheckpoint = _getRenderTime();
+   
+   // samples are splatted relative to the initial estimate of 'b,' so the 
+   // film is rescaled as that estimate is refined
+   const real_t initialWeight = processes[0]->getWeight();
+   
+   for(unsigned i = 0; i < noRenderThreads; ++i) {
+      MLTMarkovProcess *process = processes[i];
       
-      MLTMarkovProcess *process = 
-         new MLTMarkovProcess(this, seedPaths[pathIndex], weight, (i == 0));
+      while(!process->wait(MLT_MONITOR_INTERVAL)) {
+         const double elapsed = _getRenderTime();
+         
+         m_output->setMLTScale(_getNormalization() / initialWeight);
+         
+         if (maxSeconds > 0 && elapsed >= maxSeconds && !m_stopped) {
+            cout << "time budget of " << maxSeconds 
+                 << " seconds exhausted" << endl;
+            
+            stop();
+         }
+         
+         if (!checkpointFile.empty() && checkpointPeriod > 0 && 
+             elapsed >= lastCheckpoint + checkpointPeriod && !m_stopped)
+         {
+            _pauseChains();
+            _saveCheckpoint(checkpointFile, processes);
+            _resumeChains();
+            
+            lastCheckpoint = elapsed;
+         }
+      }
+   }
+   
+   // all chains have terminated, s.t. their final states may be saved and 
+   // the render extended later on
+   if (!checkpointFile.empty())
+      _saveCheckpoint(checkpointFile, processes);
+   
+   for(unsigned i = noRenderThreads; i--;)
+      safeDelete(processes[i]);
+   
+   m_output->setMLTScale(_getNormalization() / initialWeight);
+   m_output->finalize();
+   finalize();
+   
+   cout << endl << "done rendering in " << getElapsedTime() << endl << endl;
+}
+
+void MLTRenderer::stop() {
+   m_stopped = true;
+}
+
+MLTMarkovProcess *MLTRenderer::_createChain(unsigned index, real_t weight) {
+   const bool primary = (index == 0);
+   
+   if (MLT_MODE_PSS == m_mode) {
+      // chains in primary sample space start from the state which 
+      // generated their seed path
+      mltSeedPathList       seeds;
+      std::vector<unsigned> chainSeeds;
       
-      processes.push_back(process);
+      for(unsigned i = 0; i < m_noChainsPerThread; ++i) {
+         const unsigned chain = index * m_noChainsPerThread + i;
+         
+         seeds.push_back(m_seedPaths[_sampleSeedPath()]);
+         chainSeeds.push_back(
+            Random::getSubstreamSeed(~Random::s_seed, chain));
+      }
       
-      process->init();
-      process->start();
+      return new MLTPSSMarkovProcess(this, seeds, chainSeeds, weight, primary);
    }
    
-   // TODO: have different ways of stopping or run individual 
-   // processes forever?
+   // select a starting path for this chain proportional to its weight
+   Path seedPath(this);
+   unsigned attempts = 0;
    
-   for(unsigned i = noRenderThreads; i--;) {
-      MLTMarkovProcess *process = processes[i];
+   do {
+      const unsigned seedIndex = _sampleSeedPath();
+      ASSERT(m_seedPaths[seedIndex].weight > 0);
       
-      while(!process->wait());
-      safeDelete(process);
+      if (_regenerateSeedPath(m_seedPaths[seedIndex], seedPath))
+         break;
+   } while(++attempts < MLT_MAX_REGENERATE_ATTEMPTS);
+   
+   ASSERT(seedPath.length() >= 2);
+   
+   return new MLTMarkovProcess(this, seedPath, weight, primary);
+}
+
+void MLTRenderer::_pauseChains() {
+   QMutexLocker lock(&m_chainMutex);
+   m_pauseRequested = true;
+   
+   while(m_noPausedChains < m_noActiveChains)
+      m_chainsPaused.wait(&m_chainMutex);
+}
+
+void MLTRenderer::_resumeChains() {
+   QMutexLocker lock(&m_chainMutex);
+   m_pauseRequested = false;
+   
+   m_chainsResumed.wakeAll();
+}
+
+void MLTRenderer::_pauseChain(MLTMarkovProcess *) {
+   QMutexLocker lock(&m_chainMutex);
+   
+   ++m_noPausedChains;
+   m_chainsPaused.wakeAll();
+   
+   while(m_pauseRequested)
+      m_chainsResumed.wait(&m_chainMutex);
+   
+   --m_noPausedChains;
+}
+
+void MLTRenderer::_finishChain(MLTMarkovProcess *) {
+   QMutexLocker lock(&m_chainMutex);
+   ASSERT(m_noActiveChains > 0);
+   
+   --m_noActiveChains;
+   m_chainsPaused.wakeAll();
+}
+
+double MLTRenderer::_getRenderTime() const {
+   return m_resumedTime + m_timer.elapsed();
+}
+
+void MLTRenderer::_addNormalizationSamples(real_t sum, uint64_t n) {
+   QMutexLocker lock(&m_chainMutex);
+   
+   m_normalizationSum       += sum;
+   m_noNormalizationSamples += n;
+}
+
+real_t MLTRenderer::_getNormalization() {
+   QMutexLocker lock(&m_chainMutex);
+   ASSERT(m_noNormalizationSamples > 0);
+   
+   return m_normalizationSum / m_noNormalizationSamples;
+}
+
+bool MLTRenderer::_saveCheckpoint(const std::string &fileName, 
+                                  const MLTMarkovProcessList &processes)
+{
+   ASSERT(!processes.empty());
+   
+   // write to a temporary file first s.t. preemption during the write 
+   // never corrupts the previous checkpoint
+   const std::string &tempFileName = fileName + ".temp";
+   std::ofstream out(tempFileName.c_str(), 
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+   bool success = out.is_open();
+   
+   if (success) {
+      writeBinary<uint32_t>(out, MLT_CHECKPOINT_MAGIC);
+      writeBinary<uint32_t>(out, MLT_CHECKPOINT_VERSION);
+      writeBinary<uint32_t>(out, m_mode);
+      writeBinary<uint32_t>(out, processes.size());
+      writeBinary<uint32_t>(out, m_noChainsPerThread);
+      writeBinary<uint32_t>(out, m_noTemperatures);
+      writeBinary<real_t>  (out, processes[0]->getWeight());
+      writeBinary<double>  (out, _getRenderTime());
+      writeBinary<real_t>  (out, m_normalizationSum);
+      writeBinary<uint64_t>(out, m_noNormalizationSamples);
+      
+      writeTextual(out, Random::s_generator);
+      writeBinary<uint32_t>(out, m_seedPaths.size());
+      
+      FOREACH(mltSeedPathListConstIter, m_seedPaths, iter) {
+         writeBinary<uint32_t>(out, iter->seed);
+         writeBinary<unsigned short>(out, iter->s);
+         writeBinary<unsigned short>(out, iter->t);
+         writeBinary<real_t>  (out, iter->weight);
+      }
+      
+      success = m_output->saveState(out);
+      
+      for(unsigned i = 0; success && i < processes.size(); ++i)
+         success = processes[i]->saveState(out);
+      
+      out.close();
+      success &= !out.fail();
    }
+   
+   if (success) {
+      // rename doesn't replace existing files on all platforms
+      if (0 != std::rename(tempFileName.c_str(), fileName.c_str())) {
+         std::remove(fileName.c_str());
+         
+         success = (0 == std::rename(tempFileName.c_str(), fileName.c_str()));
+      }
+   }
+   
+   if (!success) {
+      std::remove(tempFileName.c_str());
+      
+      ResourceManager::log.error << "error saving MLT checkpoint to '" 
+         << fileName << "'" << endl;
+   } else {
+      ResourceManager::log.info  << "saved MLT checkpoint to '" 
+         << fileName << "'" << endl;
+   }
+   
+   return success;
 }
 
-real_t MLTRenderer::_initSeedPaths(PathList &outPaths, RealList &outW, 
-                                   const unsigned noInitialPaths)
+bool MLTRenderer::_loadCheckpoint(const std::string &fileName, 
+                                  unsigned noChains, 
+                                  MLTMarkovProcessList &outProcesses)
+{
+   ASSERT(outProcesses.empty());
+   std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+   
+   if (!in.is_open())
+      return false;
+   
+   uint32_t magic = 0, version = 0, mode = 0, noSavedChains = 0;
+   uint32_t noChainsPerThread = 0, noTemperatures = 0, noSeedPaths = 0;
+   real_t   weight = 0, normalizationSum = 0;
+   uint64_t noNormalizationSamples = 0;
+   double   renderTime = 0;
+   Random::Generator generator;
+   bool success = 
+      (readBinary(in, magic)   && magic   == MLT_CHECKPOINT_MAGIC   && 
+       readBinary(in, version) && version == MLT_CHECKPOINT_VERSION && 
+       readBinary(in, mode)    && mode    == (uint32_t) m_mode      && 
+       readBinary(in, noSavedChains)     && 
+       readBinary(in, noChainsPerThread) && 
+       readBinary(in, noTemperatures)    && 
+       readBinary(in, weight)  && weight > 0 && 
+       readBinary(in, renderTime) && 
+       readBinary(in, normalizationSum)  && 
+       readBinary(in, noNormalizationSamples) && 
+       noNormalizationSamples > 0 && 
+       readTextual(in, generator) && 
+       readBinary(in, noSeedPaths) && noSeedPaths > 0);
+   
+   mltSeedPathList seedPaths;
+   
+   for(unsigned i = 0; success && i < noSeedPaths; ++i) {
+      mltSeedPath seed;
+      uint32_t s = 0;
+      unsigned short l = 0, e = 0;
+      
+      success = (readBinary(in, s) && readBinary(in, l) && 
+                 readBinary(in, e) && readBinary(in, seed.weight) && 
+                 seed.weight > 0);
+      
+      seed.seed = s;
+      seed.s    = l;
+      seed.t    = e;
+      
+      seedPaths.push_back(seed);
+   }
+   
+   success = (success && m_output->loadState(in));
+   
+   if (success) {
+      Random::s_generator = generator;
+      m_seedPaths.swap(seedPaths);
+      _initSeedDistribution();
+      
+      for(unsigned i = 0; i < noChains; ++i) {
+         MLTMarkovProcess *process = _createChain(i, weight);
+         
+         process->init();
+         outProcesses.push_back(process);
+      }
+      
+      if (noSavedChains == noChains && 
+          noChainsPerThread == m_noChainsPerThread && 
+          noTemperatures    == m_noTemperatures)
+      {
+         for(unsigned i = 0; success && i < noChains; ++i)
+            success = outProcesses[i]->loadState(in);
+      } else {
+         ResourceManager::log.warning << "MLT checkpoint '" << fileName 
+            << "' was written with a different chain configuration; "
+            << "starting new chains instead" << endl;
+      }
+   }
+   
+   if (!success) {
+      ResourceManager::log.warning << "ignoring invalid or incompatible "
+         << "MLT checkpoint '" << fileName << "'" << endl;
+      
+      for(unsigned i = outProcesses.size(); i--;)
+         safeDelete(outProcesses[i]);
+      
+      outProcesses.clear();
+      m_seedPaths.clear();
+      
+      // discard any partially restored samples
+      m_output->init();
+      return false;
+   }
+   
+   m_resumedTime            = renderTime;
+   m_normalizationSum       = normalizationSum;
+   m_noNormalizationSamples = noNormalizationSamples;
+   
+   ResourceManager::log.info << "resuming MLT render from checkpoint '" 
+      << fileName << "' after " << renderTime << " seconds" << endl;
+   
+   return true;
+}
+
+real_t MLTRenderer::_initSeedPaths(const unsigned noInitialPaths, 
+                                   const unsigned noThreads)
 {
    ASSERT(noInitialPaths > 0);
+   ASSERT(noThreads > 0);
    
    cout 
       << endl 
       << "generating initial seed paths (noInitialPaths = " 
-      << noInitialPaths << ")" 
+      << noInitialPaths << ", noThreads = " << noThreads << ")" 
       << endl;
    
-   Path path(this);
-   unsigned n = 0;
-   real_t sum = 0;
+   m_seedPaths.clear();
+   
+   unsigned offset = 0;
+   unsigned n      = 0;
+   real_t   sum    = 0;
    
    do {
-      for(unsigned i = noInitialPaths; i--;) {
-         path.clear();
+      std::vector<mltSeedPathThread*> threads;
+      
+      // split this batch of full paths into one contiguous stratum per 
+      // thread; since each full path is seeded by its index, the resulting 
+      // seed paths are independent of the number of threads
+      for(unsigned i = 0; i < noThreads; ++i) {
+         const unsigned begin = offset + (noInitialPaths * i) / noThreads;
+         const unsigned end   = offset + (noInitialPaths * (i + 1)) / noThreads;
          
-#if 0
-         m_pathGenerator->generateE(path);
-         const unsigned length = path.length();
+         mltSeedPathThread *thread = new mltSeedPathThread(this, begin, end);
+         threads.push_back(thread);
          
-         if (length >= 2 && path.front().isEmitter()) {
-            Path aggregate(this);
-            aggregate.append(path);
-            ASSERT(aggregate.length() == path.length());
-            
-            const SpectralSampleSet &c = aggregate.getContribution(0, aggregate.length());
-            const real_t f = c.getRGB().luminance();
-            
-            outPaths.push_back(aggregate);
-            outW.push_back(f);
-         } else {
-            path.clear();
-            outPaths.push_back(path);
-            outW.push_back(0);
-         }
-#else
-         (void) m_pathGenerator->generate(path);
-         const unsigned length = path.length();
+         if (noThreads > 1)
+            thread->start();
+         else
+            thread->run();
+      }
+      
+      // merge results in stratum order s.t. m_seedPaths is deterministic
+      for(unsigned i = 0; i < noThreads; ++i) {
+         mltSeedPathThread *thread = threads[i];
+         
+         if (noThreads > 1)
+            while(!thread->wait());
+         
+         m_seedPaths.insert(m_seedPaths.end(), thread->m_seeds.begin(), 
+                            thread->m_seeds.end());
+         
+         sum += thread->m_sum;
+         n   += thread->m_noSplits;
          
-         if (m_maxDepth > 0 && path.length() > m_maxDepth) {
-            ++i;
-            continue;
+         safeDelete(thread);
+      }
+      
+      offset += noInitialPaths;
+   } while(n == 0 || sum <= 0);
+   ASSERT(n > 0);
+   
+   ResourceManager::log.info << "MLT normalization: sum: " << sum 
+      << ", n: " << n << ", weight: " << (sum / n) 
+      << ", noSeedPaths: " << m_seedPaths.size() << endl;
+   
+   m_normalizationSum       = sum;
+   m_noNormalizationSamples = n;
+   
+   return (sum / n);
+}
+
+void MLTRenderer::_generateSeedPaths(unsigned begin, unsigned end, 
+                                     mltSeedPathList &outSeeds, 
+                                     real_t &outSum, unsigned &outNoSplits)
+{
+   Path path(this);
+   
+   for(unsigned i = begin; i < end; ++i) {
+      const unsigned seed = Random::getSubstreamSeed(Random::s_seed, i);
+      
+      if (MLT_MODE_PSS == m_mode) {
+         // bootstrap primary sample space chains with a single independent 
+         // sample per seed, s.t. (sum / n) estimates the mean contribution
+         Random::Generator generator(seed);
+         Random::Generator *oldGenerator = Random::getThreadGenerator();
+         
+         Random::setThreadGenerator(&generator);
+         const real_t f = samplePrimarySpacePath(path).getRGB().luminance();
+         Random::setThreadGenerator(oldGenerator);
+         
+         ++outNoSplits;
+         
+         if (f > 0) {
+            mltSeedPath record;
+            record.seed   = seed;
+            record.s      = 0;
+            record.t      = 0;
+            record.weight = f;
+            
+            outSeeds.push_back(record);
+            outSum += f;
          }
          
-         for(unsigned k = 2; k <= length; ++k) {
-            for(unsigned t = k + 1, s = 0; t--; ++s) {
-               Path p2 = path.left(s);
-               bool v  = p2.append(path.right(t));
-               
-               ASSERT(s + t == k);
-               ASSERT(s >= 0 && s <= k);
-               ASSERT(t >= 0 && t <= k);
-               ASSERT(p2.length() == k);
+         continue;
+      }
+      
+      if (!_generateFullPath(seed, path))
+         continue;
+      
+      const unsigned length = path.length();
+      
+      // record each (s,t) split of the full path, discarding the split 
+      // paths themselves s.t. only the chosen paths are ever regenerated
+      for(unsigned k = 2; k <= length; ++k) {
+         for(unsigned t = k + 1, s = 0; t--; ++s) {
+            ASSERT(s + t == k);
+            ++outNoSplits;
+            
+            Path p2 = path.left(s);
+            
+            if (!p2.append(path.right(t)))
+               continue;
+            
+            ASSERT(p2.length() == k);
+            const real_t f = path.getContribution(s, t).getRGB().luminance();
+            
+            if (f > 0) {
+               mltSeedPath record;
+               record.seed   = seed;
+               record.s      = s;
+               record.t      = t;
+               record.weight = f;
                
-               if (!v) {
-                  outW.push_back(0);
-                  outPaths.push_back(Path(this));
-               } else {
-                  const real_t f = path.getContribution(s, t).getRGB().luminance();
-                  
-                  outW.push_back(f);
-                  outPaths.push_back(p2);
-               }
+               outSeeds.push_back(record);
+               outSum += f;
             }
          }
-#endif
       }
+   }
+}
+
+SpectralSampleSet MLTRenderer::samplePrimarySpacePath(Path &outPath) {
+   Path path(this);
+   outPath.clear();
+   
+   (void) m_pathGenerator->generate(path);
+   const unsigned length = path.length();
+   
+   if (length < 2 || (m_maxDepth > 0 && length > m_maxDepth))
+      return SpectralSampleSet::black();
+   
+   // select one of the (k + 1) splits of each subpath length k in [2, length]
+   const unsigned noSplits = ((length + 1) * (length + 2)) / 2 - 3;
+   unsigned index = MIN((unsigned) Random::sample(0, noSplits), noSplits - 1);
+   unsigned k = 2;
+   
+   while(index > k) {
+      index -= (k + 1);
+      ++k;
+   }
+   
+   const unsigned s = index;
+   const unsigned t = k - s;
+   ASSERT(s + t == k && k <= length);
+   
+   outPath = path.left(s);
+   
+   if (!outPath.append(path.right(t))) {
+      outPath.clear();
+      return SpectralSampleSet::black();
+   }
+   
+   SpectralSampleSet contribution = path.getContribution(s, t);
+   if (contribution.isZero())
+      return contribution;
+   
+   // weight the selected strategy against all k + 1 strategies for the same 
+   // path length via the power heuristic (as in BidirectionalPathTracer), 
+   // s.t. strategies which can't contribute (e.g., specular or occluded 
+   // connections) receive no weight instead of diluting the estimate; each 
+   // split is selected with probability (1 / noSplits)
+   const real_t pdf = path.getPd(s, t);
+   real_t sum = 0;
+   
+   for(unsigned i = 0; i <= k; ++i) {
+      const real_t p = (i == s ? pdf : path.getPd(i, k - i));
       
-      n = outW.size();
-      sum = 0;
+      sum += p * p;
+   }
+   
+   if (pdf <= 0 || sum <= 0)
+      return SpectralSampleSet::black();
+   
+   contribution *= create_real(noSplits) * (pdf * pdf) / sum;
+   return contribution;
+}
+
+bool MLTRenderer::_generateFullPath(unsigned seed, Path &outPath) {
+   Random::Generator generator(seed);
+   Random::Generator *oldGenerator = Random::getThreadGenerator();
+   
+   // generate from a private stream s.t. this path is reproducible 
+   // regardless of which thread generates it
+   Random::setThreadGenerator(&generator);
+   
+   bool valid = false;
+   
+   for(unsigned i = MLT_MAX_SEED_ATTEMPTS; i--;) {
+      outPath.clear();
+      (void) m_pathGenerator->generate(outPath);
       
-      for(unsigned i = n; i--;)
-         sum += outW[i];
-   } while(n == 0 || sum <= 0);
+      if (m_maxDepth <= 0 || outPath.length() <= m_maxDepth) {
+         valid = true;
+         break;
+      }
+   }
+   
+   Random::setThreadGenerator(oldGenerator);
+   
+   if (!valid)
+      outPath.clear();
+   
+   return valid;
+}
+
+bool MLTRenderer::_regenerateSeedPath(const mltSeedPath &seed, 
+                                      Path &outPath)
+{
+   Path path(this);
+   
+   if (!_generateFullPath(seed.seed, path) || 
+       (unsigned) (seed.s + seed.t) > path.length())
+   {
+      return false;
+   }
+   
+   outPath = path.left(seed.s);
+   
+   if (!outPath.append(path.right(seed.t)) || outPath.length() < 2)
+      return false;
+   
+   const SpectralSampleSet &radiance = outPath.getRadiance();
+
+#ifdef DEBUG
+   if (radiance.isZero())
+      cerr << "regenerated seed path has zero radiance:" << endl 
+           << outPath << endl;
+#endif
+   
+   return !radiance.isZero();
+}
+
+void MLTRenderer::_initSeedDistribution() {
+   const unsigned n = m_seedPaths.size();
    ASSERT(n > 0);
    
-   // normalize weights
+   m_seedProbs.resize(n);
+   m_seedAliases.resize(n);
+   
+   real_t sum = 0;
    for(unsigned i = n; i--;)
-      outW[i] /= sum;
+      sum += m_seedPaths[i].weight;
    
-#ifdef DEBUG
-   for(unsigned i = n; i--;) {
-      if (outW[i] > 0) {
-         ASSERT(outPaths[i].length() >= 2);
-         
-         const SpectralSampleSet &radiance = outPaths[i].getRadiance();
-         if (radiance.isZero())
-            cerr << outPaths[i] << endl;
-         ASSERT(!radiance.isZero());
-      }
+   ASSERT(sum > 0);
+   
+   // Vose's alias method:  partition scaled probabilities into those below 
+   // and above the mean, pairing each small entry with a large alias
+   std::vector<unsigned> small, large;
+   
+   for(unsigned i = 0; i < n; ++i) {
+      m_seedProbs[i]   = m_seedPaths[i].weight * n / sum;
+      m_seedAliases[i] = i;
+      
+      if (m_seedProbs[i] < 1)
+         small.push_back(i);
+      else
+         large.push_back(i);
    }
-#endif
    
-#if 0
-   for(unsigned i = outPaths.size(); i--;) {
-      if (outW[i] > 0) {
-         Path p = outPaths[i];
-         
-         if (p.length() == 4) {
-            outPaths.clear();
-            outPaths.push_back(p);
-            
-            outW.clear();
-            outW.push_back(1);
-            break;
-         }
+   while(!small.empty() && !large.empty()) {
+      const unsigned l = small.back();
+      const unsigned g = large.back();
+      small.pop_back();
+      
+      m_seedAliases[l] = g;
+      m_seedProbs[g]  -= (1 - m_seedProbs[l]);
+      
+      if (m_seedProbs[g] < 1) {
+         large.pop_back();
+         small.push_back(g);
       }
    }
-#endif
    
-   cerr << "sum: " << sum << ", n: " << n << ", weight: " << (sum / n) << endl;
-   return (sum / n);
+   // remaining entries are (up to roundoff) exactly at the mean
+   FOREACH(std::vector<unsigned>::iterator, small, iter)
+      m_seedProbs[*iter] = 1;
+   FOREACH(std::vector<unsigned>::iterator, large, iter)
+      m_seedProbs[*iter] = 1;
 }
 
+unsigned MLTRenderer::_sampleSeedPath() const {
+   const unsigned n = m_seedProbs.size();
+   ASSERT(n > 0);
+   
+   const real_t   x = Random::sample(0, n);
+   const unsigned i = MIN((unsigned) x, n - 1);
+   
+   return ((x - i) < m_seedProbs[i] ? i : m_seedAliases[i]);
 }
 
+}
@@ -15,8 +15,24 @@
    that the probability density of simulating any one path is proportional to 
    that path's relative contribution to what that virtual sensor would end up 
    "seeing" in the virtual scene.
+      Two variants are supported, selected via the 'mltMode' property:  
+   'veach' (default) mutates paths directly in path space, whereas 'pss' 
+   performs primary sample space MLT (Kelemen et al., 2002), mutating the 
+   random numbers consumed by the underlying bidirectional path tracer.  In 
+   the latter mode, each render thread may run many interleaved chains with 
+   optional replica exchange between temperatures, and the brightness 
+   normalization is refined continuously throughout rendering (see 
+   MLTPSSMarkovProcess).
+      Rendering terminates once every Markov chain has exhausted its share 
+   of the 'mltMutationsPerPixel' budget, 'mltMaxSeconds' have elapsed, or 
+   stop is called, after which the output is finalized.  If an 
+   'mltCheckpointFile' is given, the film, seed paths, and chain states are 
+   written to it every 'mltCheckpointPeriod' seconds and upon termination, 
+   and rendering resumes from it if it already exists (eg. after being 
+   preempted, or to extend a finished render with a larger budget).
    
    @see MLTMarkovProcess
+   @see MLTPSSMarkovProcess
    @see MLTPathMutation
    <!-------------------------------------------------------------------->**/
 
@@ -31,17 +47,56 @@ namespace milton {
 DECLARE_STL_TYPEDEF(std::vector<Path>,    PathList);
 DECLARE_STL_TYPEDEF(std::vector<real_t >, RealList);
 
+/**
+ * @brief 
+ *    Compact record of a single seed path from which the full path may be 
+ * deterministically regenerated on demand
+ * 
+ * @see MLTRenderer::_regenerateSeedPath
+ */
+struct MILTON_DLL_EXPORT mltSeedPath {
+   /// seed of the random number generator used to generate the full path
+   unsigned       seed;
+   
+   /// number of light (s) and eye (t) vertices of the full path which make 
+   /// up this seed path (unused in primary sample space mode)
+   unsigned short s, t;
+   
+   /// luminance of this seed path's contribution
+   real_t         weight;
+};
+
+DECLARE_STL_TYPEDEF(std::vector<mltSeedPath>, mltSeedPathList);
+
 class BidirectionalPathTracer;
+class MLTMarkovProcess;
+class mltSeedPathThread;
+
+DECLARE_STL_TYPEDEF(std::vector<MLTMarkovProcess *>, MLTMarkovProcessList);
 
 class MILTON_DLL_EXPORT MLTRenderer : public PointSampleRenderer {
    public:
+      /// space in which Markov chains perform their random walks
+      enum Mode {
+         /// path space mutations (Veach & Guibas, 1997)
+         MLT_MODE_VEACH = 0, 
+         
+         /// primary sample space mutations (Kelemen et al., 2002)
+         MLT_MODE_PSS
+      };
+      
+      
       ///@name Constructors
       //@{-----------------------------------------------------------------
       
       inline MLTRenderer(RenderOutput *output = NULL, 
                          Camera *camera = NULL, 
                          Scene *scene = NULL)
-         : PointSampleRenderer(output, camera, scene), m_pathGenerator(NULL)
+         : PointSampleRenderer(output, camera, scene), m_pathGenerator(NULL), 
+           m_noChainsPerThread(1), m_noTemperatures(1), 
+           m_stopped(false), m_pauseRequested(false), m_noActiveChains(0), 
+           m_noPausedChains(0), m_normalizationSum(0), 
+           m_noNormalizationSamples(0)
       { }
       
       virtual ~MLTRenderer();
@@ -64,6 +119,33 @@ class MILTON_DLL_EXPORT MLTRenderer : public PointSampleRenderer {
        */
       virtual void render();
       
+      /**
+       * @brief 
+       *    Requests that all Markov chains of the current render terminate 
+       * as soon as possible, after which render writes a final checkpoint 
+       * (if enabled), finalizes its output, and returns
+       * 
+       * @note safe to call from any thread
+       */
+      void stop();
+      
+      /**
+       * @brief 
+       *    Generates a path using the random numbers consumed on the calling 
+       * thread, which in primary sample space mode are supplied by the 
+       * current state of a Markov chain (@see MLTPrimarySampleSpace)
+       * 
+       * A full bidirectional path is generated, after which one of its 
+       * (s,t) splits is selected uniformly at random and weighted against 
+       * the other splits of the same length via the power heuristic.
+       * 
+       * @returns the contribution of the resulting path, weighted s.t. its 
+       *    expected value over all random numbers is an unbiased estimate of 
+       *    the image, or black if no valid path was generated
+       * @note safe to call concurrently from multiple threads
+       */
+      SpectralSampleSet samplePrimarySpacePath(Path &outPath);
+      
       
       //@}-----------------------------------------------------------------
       ///@name Accessors / Mutators
@@ -81,12 +163,187 @@ class MILTON_DLL_EXPORT MLTRenderer : public PointSampleRenderer {
          return m_maxConsequtiveRejections;
       }
       
+      inline Mode getMode() const {
+         return m_mode;
+      }
+      
+      /// @returns the number of chains run by each render thread (only 
+      ///    applicable in primary sample space mode)
+      inline unsigned getNoChainsPerThread() const {
+         return m_noChainsPerThread;
+      }
+      
+      /// @returns the number of replicas in each temperature ladder (only 
+      ///    applicable in primary sample space mode)
+      inline unsigned getNoTemperatures() const {
+         return m_noTemperatures;
+      }
+      
+      inline bool isStopped() const {
+         return m_stopped;
+      }
+      
+      /// @returns whether or not Markov chains should pause s.t. a 
+      ///    consistent checkpoint may be written
+      inline bool isPauseRequested() const {
+         return m_pauseRequested;
+      }
+      
+      /// @returns the seed paths (with non-zero contribution) from which 
+      ///    Markov chains may be started
+      inline const mltSeedPathList &getSeedPaths() const {
+         return m_seedPaths;
+      }
+      
       
       //@}-----------------------------------------------------------------
       
    protected:
-      virtual real_t _initSeedPaths(PathList &outPaths, RealList &outW, 
-                                    const unsigned noInitialPaths);
+      ///@name Seed path generation
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Generates @p noInitialPaths bidirectional paths, split evenly 
+       * across @p noThreads worker threads, recording every (s,t) split 
+       * with non-zero contribution in m_seedPaths
+       * 
+       * @returns the average luminance over all splits, which estimates 
+       *    'b,' the total radiant flux falling on the film plane
+       */
+      virtual real_t _initSeedPaths(const unsigned noInitialPaths, 
+                                    const unsigned noThreads);
+      
+      /**
+       * @brief 
+       *    Generates the full paths with the given indices in 
+       * [@p begin, @p end), appending a record for each (s,t) split with 
+       * non-zero contribution to @p outSeeds
+       * 
+       * @note safe to call concurrently from multiple threads
+       */
+      virtual void _generateSeedPaths(unsigned begin, unsigned end, 
+                                      mltSeedPathList &outSeeds, 
+                                      real_t &outSum, unsigned &outNoSplits);
+      
+      /**
+       * @brief 
+       *    Deterministically regenerates the full path with the given 
+       * generator seed into @p outPath
+       * 
+       * @returns false if no path within the maximum depth could be generated
+       */
+      virtual bool _generateFullPath(unsigned seed, Path &outPath);
+      
+      /**
+       * @brief 
+       *    Regenerates the given seed path into @p outPath
+       * 
+       * @returns whether or not the regenerated path is valid
+       */
+      virtual bool _regenerateSeedPath(const mltSeedPath &seed, 
+                                       Path &outPath);
+      
+      /**
+       * @brief 
+       *    Initializes an alias table over m_seedPaths s.t. seed paths may 
+       * be sampled proportional to their weights in O(1) time
+       */
+      virtual void _initSeedDistribution();
+      
+      /**
+       * @returns the index of a seed path in m_seedPaths, sampled 
+       *    proportional to its weight in O(1) time
+       */
+      unsigned _sampleSeedPath() const;
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Markov chain management
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @returns a new Markov chain starting from a seed path sampled 
+       *    proportional to its weight, where the chain with index zero is 
+       *    responsible for triggering output updates
+       */
+      virtual MLTMarkovProcess *_createChain(unsigned index, real_t weight);
+      
+      /**
+       * @brief 
+       *    Blocks until every active chain has paused at an iteration 
+       * boundary (see MLTMarkovProcess::_continue)
+       */
+      void _pauseChains();
+      
+      /// resumes all chains paused via _pauseChains
+      void _resumeChains();
+      
+      /// called by each chain upon reaching an iteration boundary while a 
+      /// pause has been requested, blocking until chains are resumed
+      void _pauseChain(MLTMarkovProcess *process);
+      
+      /// called by each chain upon terminating
+      void _finishChain(MLTMarkovProcess *process);
+      
+      /// @returns the number of seconds spent rendering thus far, including 
+      ///    any time spent before being resumed from a checkpoint
+      double _getRenderTime() const;
+      
+      /**
+       * @brief 
+       *    Refines the estimate of 'b,' the total luminance falling on the 
+       * film plane, with @p n additional independent samples whose 
+       * luminance sums to @p sum
+       * 
+       * @note safe to call concurrently from multiple chains
+       */
+      void _addNormalizationSamples(real_t sum, uint64_t n);
+      
+      /// @returns the current estimate of 'b'
+      real_t _getNormalization();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Checkpointing
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Writes the film, seed paths, random number generator state, and 
+       * the states of all given chains to @p fileName, replacing it 
+       * atomically s.t. an interrupted write never corrupts an existing 
+       * checkpoint
+       * 
+       * @note all chains must be paused or terminated
+       */
+      virtual bool _saveCheckpoint(const std::string &fileName, 
+                                   const MLTMarkovProcessList &processes);
+      
+      /**
+       * @brief 
+       *    Attempts to resume rendering from the checkpoint in @p fileName, 
+       * restoring the film and creating @p noChains initialized chains in 
+       * @p outProcesses
+       * 
+       * If the checkpoint was written with a different number of chains, 
+       * its chain states are discarded and new chains are started from its 
+       * seed paths instead.
+       * 
+       * @returns false if @p fileName doesn't exist or doesn't contain a 
+       *    valid checkpoint compatible with the current render, in which 
+       *    case no chains are created and the film is left empty
+       */
+      virtual bool _loadCheckpoint(const std::string &fileName, 
+                                   unsigned noChains, 
+                                   MLTMarkovProcessList &outProcesses);
+      
+      
+      //@}-----------------------------------------------------------------
+      
+      friend class mltSeedPathThread;
+      friend class MLTMarkovProcess;
+      friend class MLTPSSMarkovProcess;
       
    protected:
       BidirectionalPathTracer *m_pathGenerator;
@@ -96,6 +353,35 @@ class MILTON_DLL_EXPORT MLTRenderer : public PointSampleRenderer {
       
       // maximum number of consequtive rejections
       unsigned m_maxConsequtiveRejections;
+      
+      // path space or primary sample space
+      Mode     m_mode;
+      
+      // chains per render thread and replicas per temperature ladder
+      unsigned m_noChainsPerThread;
+      unsigned m_noTemperatures;
+      
+      // seed paths with non-zero contribution, in a deterministic order
+      mltSeedPathList       m_seedPaths;
+      
+      // alias table over m_seedPaths (@see _initSeedDistribution)
+      RealList              m_seedProbs;
+      std::vector<unsigned> m_seedAliases;
+      
+      // cooperative cancellation and pausing of chains
+      volatile bool         m_stopped;
+      volatile bool         m_pauseRequested;
+      
+      // synchronizes pausing / terminating chains
+      QMutex                m_chainMutex;
+      QWaitCondition        m_chainsPaused;
+      QWaitCondition        m_chainsResumed;
+      unsigned              m_noActiveChains;
+      unsigned              m_noPausedChains;
+      
+      // running estimate of 'b' (guarded by m_chainMutex)
+      real_t                m_normalizationSum;
+      uint64_t              m_noNormalizationSamples;
 };
 
 }
@@ -13,6 +13,8 @@
 
 #include <renderers/mlt/MLTRenderer.h>
 #include <renderers/mlt/MLTMarkovProcess.h>
+#include <renderers/mlt/MLTPSSMarkovProcess.h>
+#include <renderers/mlt/MLTPrimarySampleSpace.h>
 
 // path mutations
 #include <renderers/mlt/MLTAggregatePathMutation.h>
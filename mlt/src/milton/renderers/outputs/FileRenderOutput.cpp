@@ -6,6 +6,24 @@
    @brief
       Reconstructs an output image from point samples, writing the resulting 
    image out to a file periodically and upon completion of rendering.
+      Intermediate renders never stall the render threads on disk: the 
+   thread which triggers a save only copies the accumulated samples into a 
+   snapshot (see RenderOutput::getSnapshot), which is then tonemapped, 
+   encoded, and written by a dedicated background thread.  Snapshots are 
+   double-buffered, s.t. a save requested while another is in progress 
+   replaces any older pending snapshot.  Every image is first written to a 
+   temporary file which then atomically replaces its destination, s.t. 
+   readers never observe a partially written image.
+      If 'rawFilm' is set to 'exr', 'pfm', or 'hdr', the linear film is also 
+   written alongside each image as '<image>.film.<rawFilm>', together with 
+   per-pixel filter weights and sample counts (see RawFilm), s.t. renders 
+   may be re-exposed or merged with other partial renders later on.
+      If 'aov' is set, the filtered auxiliary outputs of all samples are 
+   also written alongside each image as the PFM files '<image>.depth.pfm' 
+   (distance to the first surface seen, INFINITY if none), 
+   '<image>.normal.pfm' (world-space shading normal), '<image>.albedo.pfm', 
+   and '<image>.id.pfm' (one-based object and material IDs in its red and 
+   green channels, zero if none; see PointSampleAOV).
    <!-------------------------------------------------------------------->**/
 
 #include "FileRenderOutput.h"
@@ -14,37 +32,209 @@
 #include <ResourceManager.h>
 #include <SpectralSampleSet.h>
 #include <Renderer.h>
+#include <ToneMap.h>
+#include <RawFilm.h>
+#include <HDRImage.h>
+#include <HDRUtils.h>
 #include <QtCore/QtCore>
+#include <cstdio>
 using namespace std;
 
+/// number of auxiliary output buffers written alongside each image
+#define FILE_RENDER_OUTPUT_NO_AOVS     (4)
+
 namespace milton {
 
+/// suffixes of the auxiliary output buffers written alongside each image
+static const char *fileRenderOutputAOVNames[FILE_RENDER_OUTPUT_NO_AOVS] = {
+   "depth", "normal", "albedo", "id"
+};
+
+/**
+ * @brief 
+ *    Background thread which tonemaps, encodes, and writes the snapshots 
+ * submitted by a FileRenderOutput, s.t. render threads never wait on disk
+ */
+class fileRenderOutputSaveThread : public QThread {
+   public:
+      inline fileRenderOutputSaveThread(FileRenderOutput *output)
+         : QThread(), m_output(output), m_pending(false), m_done(false)
+      { }
+      
+      virtual ~fileRenderOutputSaveThread()
+      { }
+      
+      /**
+       * @brief 
+       *    Copies all samples accumulated by the output thus far into the 
+       * pending snapshot, replacing any older snapshot which hasn't been 
+       * saved yet, and returns without waiting for it to be saved
+       */
+      void submit(const std::string &fileName) {
+         RenderOutputSnapshot snapshot;
+         
+         // copy the samples before acquiring m_mutex, s.t. neither the save 
+         // thread nor other submitters wait on the (potentially large) copy
+         m_output->getSnapshot(snapshot);
+         
+         // note: the save thread only holds m_mutex long enough to swap 
+         // buffers, so this never waits on a save in progress
+         QMutexLocker lock(&m_mutex);
+         
+         m_pendingSnapshot.swap(snapshot);
+         m_pendingFileName = fileName;
+         m_pending = true;
+         
+         m_condition.wakeOne();
+      }
+      
+      /// finishes any pending save and waits for this thread to exit
+      void stop() {
+         m_mutex.lock();
+         m_done = true;
+         m_condition.wakeOne();
+         m_mutex.unlock();
+         
+         while(!wait());
+      }
+      
+      virtual void run() {
+         for(;;) {
+            std::string fileName;
+            
+            { // wait for the next snapshot and take ownership of it
+               QMutexLocker lock(&m_mutex);
+               
+               while(!m_pending && !m_done)
+                  m_condition.wait(&m_mutex);
+               
+               if (!m_pending)
+                  break;
+               
+               m_activeSnapshot.swap(m_pendingSnapshot);
+               fileName  = m_pendingFileName;
+               m_pending = false;
+            }
+            
+            m_output->_save(fileName, m_activeSnapshot);
+         }
+      }
+   
+   protected:
+      FileRenderOutput    *m_output;
+      
+      /// double-buffered snapshots, where m_pendingSnapshot is written by 
+      /// submit and m_activeSnapshot is being saved by this thread
+      RenderOutputSnapshot m_pendingSnapshot;
+      RenderOutputSnapshot m_activeSnapshot;
+      std::string          m_pendingFileName;
+      
+      QMutex               m_mutex;
+      QWaitCondition       m_condition;
+      bool                 m_pending;
+      bool                 m_done;
+};
+
+/// @returns the temporary file to which @p fileName is written before 
+///    being atomically renamed, which preserves its extension s.t. the 
+///    image format may still be inferred from it
+static std::string fileRenderOutputGetTempFileName(const std::string &fileName) {
+   const size_t ext   = fileName.rfind('.');
+   const size_t slash = fileName.find_last_of("/\\");
+   
+   if (ext == std::string::npos || (slash != std::string::npos && ext < slash))
+      return fileName + ".part";
+   
+   return fileName.substr(0, ext) + ".part" + fileName.substr(ext);
+}
+
+/// @returns the file written alongside @p fileName with the given suffix 
+///    (eg. 'film.pfm') in place of its extension
+static std::string fileRenderOutputGetCompanionFileName( 
+   const std::string &fileName, const std::string &suffix)
+{
+   const size_t ext   = fileName.rfind('.');
+   const size_t slash = fileName.find_last_of("/\\");
+   
+   if (ext == std::string::npos || (slash != std::string::npos && ext < slash))
+      return fileName + "." + suffix;
+   
+   return fileName.substr(0, ext) + "." + suffix;
+}
+
+/// atomically replaces @p to with @p from
+static bool fileRenderOutputRename(const std::string &from, 
+                                   const std::string &to)
+{
+#ifdef MILTON_ARCH_WINDOWS
+   return (0 != MoveFileExA(from.c_str(), to.c_str(), 
+                            MOVEFILE_REPLACE_EXISTING));
+#else
+   return (0 == std::rename(from.c_str(), to.c_str()));
+#endif
+}
+
+FileRenderOutput::~FileRenderOutput() {
+   _stopSaveThread();
+}
+
 void FileRenderOutput::init() {
+   _stopSaveThread();
+   
    ReconstructionRenderOutput::init();
    
    m_lastSave   = 0;
    m_savePeriod = getValue<unsigned>("savePeriod", 5u);
+   m_rawFilm    = getValue<std::string>("rawFilm", "");
+   
+#ifndef HAVE_OPENEXR
+   if (m_rawFilm == "exr") {
+      ResourceManager::log.warning << "this build of Milton does not "
+         << "support OpenEXR; writing raw films as PFM instead" << endl;
+      
+      m_rawFilm = "pfm";
+   }
+#endif
+   
+   m_saveThread = new fileRenderOutputSaveThread(this);
+   m_saveThread->start();
 }
 
 void FileRenderOutput::addSample(PointSample &sample) {
    ReconstructionRenderOutput::addSample(sample);
    bool save = sample.save;
    
-   const unsigned seconds = m_parent->getTimer().elapsed();
-   save |= (m_isMLT && seconds >= m_lastSave + m_savePeriod);
+   const int seconds = m_parent->getTimer().elapsed();
+   
+   if (save) {
+      m_lastSave = seconds;
+   } else if (m_isMLT) {
+      // several MLT threads may observe an expired period at once; only the 
+      // one which successfully advances m_lastSave saves
+      const int lastSave = m_lastSave;
+      
+      save = (seconds >= lastSave + (int) m_savePeriod && 
+              m_lastSave.testAndSetOrdered(lastSave, seconds));
+   }
    
    // save an intermediate, temporary render
-   if (sample.save) {
+   if (save) {
       const std::string &fileName = std::string(".temp") + m_fileName;
       //cout << "saving temp render to '" << fileName << "'" << endl;
       
-      _save(fileName);
+      if (m_saveThread)
+         m_saveThread->submit(fileName);
+      else 
+         _save(fileName);
    }
 }
 
 void FileRenderOutput::finalize() {
    ReconstructionRenderOutput::finalize();
    
+   // make sure no intermediate render overwrites the final one
+   _stopSaveThread();
+   
    if (!_save(m_fileName)) {
       ResourceManager::log.error << "error saving rendered results to file '" 
          << m_fileName << "'" << endl;
@@ -55,18 +245,41 @@ void FileRenderOutput::finalize() {
 }
 
 bool FileRenderOutput::_save(const std::string &fileName) {
-   RgbaImage *finalizedOutput = getFinalizedOutput();
-   const unsigned seconds     = m_parent->getTimer().elapsed();
-   bool success = false;
+   RenderOutputSnapshot snapshot;
+   
+   getSnapshot(snapshot);
+   m_lastSave = m_parent->getTimer().elapsed();
    
-   m_lastSave = seconds;
+   return _save(fileName, snapshot);
+}
+
+bool FileRenderOutput::_save(const std::string &fileName, 
+                             const RenderOutputSnapshot &snapshot)
+{
+   HDRImage *linearOutput = developLinear(snapshot);
+   
+   if (!m_rawFilm.empty())
+      _saveRawFilm(fileName, linearOutput, snapshot);
+   
+   if (!snapshot.aovs.empty())
+      _saveAOVs(fileName, snapshot);
+   
+   // perform tonemapping
+   RgbaImage *finalizedOutput = m_tonemap->map(linearOutput);
+   bool success = false;
+   safeDelete(linearOutput);
    
    if (finalizedOutput) {
-      success = finalizedOutput->save(fileName);
+      const std::string &tempFileName = 
+         fileRenderOutputGetTempFileName(fileName);
+      
+      success = (finalizedOutput->save(tempFileName) && 
+                 fileRenderOutputRename(tempFileName, fileName));
+      
+      if (!success)
+         std::remove(tempFileName.c_str());
       
       safeDelete(finalizedOutput);
-   } else if (m_output) {
-      success = m_output->save(fileName);
    }
    
    if (!success)
@@ -75,5 +288,122 @@ bool FileRenderOutput::_save(const std::string &fileName) {
    return success;
 }
 
+bool FileRenderOutput::_saveRawFilm(const std::string &fileName, 
+                                    const HDRImage *linearOutput, 
+                                    const RenderOutputSnapshot &snapshot)
+{
+   ASSERT(linearOutput);
+   
+   const std::string &filmFileName = 
+      fileRenderOutputGetCompanionFileName(fileName, "film." + m_rawFilm);
+   const std::string &tempFileName = 
+      fileRenderOutputGetTempFileName(filmFileName);
+   
+   bool success = 
+      RawFilm::save(tempFileName, linearOutput, &snapshot.weights[0], 
+                    &snapshot.pixelSamples[0]);
+   
+   // weights are stored in a separate file unless the film is an OpenEXR 
+   // file; that file is renamed before the film s.t. a failure to rename 
+   // either can never pair the new film with stale weights
+   if (success && m_rawFilm != "exr") {
+      const std::string &weightsFileName = 
+         RawFilm::getWeightsFileName(filmFileName);
+      
+      success = fileRenderOutputRename(
+         RawFilm::getWeightsFileName(tempFileName), weightsFileName);
+      
+      if (success && !fileRenderOutputRename(tempFileName, filmFileName)) {
+         // rather than pairing the previous film with the new weights, 
+         // leave it without any (see RawFilm::load)
+         std::remove(weightsFileName.c_str());
+         success = false;
+      }
+   } else if (success) {
+      success = fileRenderOutputRename(tempFileName, filmFileName);
+   }
+   
+   if (!success) {
+      std::remove(tempFileName.c_str());
+      std::remove(RawFilm::getWeightsFileName(tempFileName).c_str());
+      
+      cerr << "\terror saving raw film to '" << filmFileName << "'" << endl;
+   }
+   
+   return success;
+}
+
+bool FileRenderOutput::_saveAOVs(const std::string &fileName, 
+                                 const RenderOutputSnapshot &snapshot)
+{
+   const unsigned width  = snapshot.width;
+   const unsigned height = snapshot.height;
+   ASSERT(snapshot.aovs.size() == width * height);
+   
+   HDRScanlineWriter writers[FILE_RENDER_OUTPUT_NO_AOVS];
+   std::string fileNames[FILE_RENDER_OUTPUT_NO_AOVS];
+   std::string tempFileNames[FILE_RENDER_OUTPUT_NO_AOVS];
+   bool success = true;
+   
+   // buffers are written losslessly as PFM, since normals may be negative
+   for(unsigned k = 0; k < FILE_RENDER_OUTPUT_NO_AOVS; ++k) {
+      fileNames[k] = fileRenderOutputGetCompanionFileName( 
+         fileName, std::string(fileRenderOutputAOVNames[k]) + ".pfm");
+      tempFileNames[k] = fileRenderOutputGetTempFileName(fileNames[k]);
+      
+      success &= writers[k].open(tempFileNames[k], width, height, 
+                                 HDRScanlineWriter::HDR_FORMAT_PFM);
+   }
+   
+   // each buffer is encoded one row at a time from the snapshot
+   std::vector<RgbaHDR> rows(FILE_RENDER_OUTPUT_NO_AOVS * width);
+   
+   for(unsigned i = 0; success && i < height; ++i) {
+      RgbaHDR *depth  = &rows[0];
+      RgbaHDR *normal = depth  + width;
+      RgbaHDR *albedo = normal + width;
+      RgbaHDR *id     = albedo + width;
+      
+      for(unsigned j = width; j--;) {
+         const PointSampleAOV &aov = snapshot.aovs[i * width + j].getValue();
+         
+         depth[j]  = RgbaHDR(aov.depth, aov.depth, aov.depth);
+         normal[j] = RgbaHDR::fromVector(aov.normal);
+         albedo[j] = RgbaHDR::fromVector(aov.albedo);
+         id[j]     = RgbaHDR(aov.objectId, aov.materialId, 0);
+      }
+      
+      for(unsigned k = 0; k < FILE_RENDER_OUTPUT_NO_AOVS; ++k)
+         success &= writers[k].writeScanline(i, &rows[k * width]);
+   }
+   
+   for(unsigned k = 0; k < FILE_RENDER_OUTPUT_NO_AOVS; ++k) {
+      success &= writers[k].close();
+      
+      if (success)
+         success = fileRenderOutputRename(tempFileNames[k], fileNames[k]);
+   }
+   
+   if (!success) {
+      // don't leave partially written buffers behind (those which were 
+      // already renamed no longer exist under their temporary names)
+      for(unsigned k = 0; k < FILE_RENDER_OUTPUT_NO_AOVS; ++k)
+         std::remove(tempFileNames[k].c_str());
+      
+      cerr << "\terror saving auxiliary outputs alongside '" << fileName 
+           << "'" << endl;
+   }
+   
+   return success;
+}
+
+void FileRenderOutput::_stopSaveThread() {
+   if (m_saveThread) {
+      m_saveThread->stop();
+      
+      safeDelete(m_saveThread);
+   }
+}
+
 }
 
@@ -6,15 +6,36 @@
    @brief
       Reconstructs an output image from point samples, writing the resulting 
    image out to a file periodically and upon completion of rendering.
+      Intermediate renders never stall the render threads on disk: the 
+   thread which triggers a save only copies the accumulated samples into a 
+   snapshot (see RenderOutput::getSnapshot), which is then tonemapped, 
+   encoded, and written by a dedicated background thread.  Snapshots are 
+   double-buffered, s.t. a save requested while another is in progress 
+   replaces any older pending snapshot.  Every image is first written to a 
+   temporary file which then atomically replaces its destination, s.t. 
+   readers never observe a partially written image.
+      If 'rawFilm' is set to 'exr', 'pfm', or 'hdr', the linear film is also 
+   written alongside each image as '<image>.film.<rawFilm>', together with 
+   per-pixel filter weights and sample counts (see RawFilm), s.t. renders 
+   may be re-exposed or merged with other partial renders later on.
+      If 'aov' is set, the filtered auxiliary outputs of all samples are 
+   also written alongside each image as the PFM files '<image>.depth.pfm' 
+   (distance to the first surface seen, INFINITY if none), 
+   '<image>.normal.pfm' (world-space shading normal), '<image>.albedo.pfm', 
+   and '<image>.id.pfm' (one-based object and material IDs in its red and 
+   green channels, zero if none; see PointSampleAOV).
    <!-------------------------------------------------------------------->**/
 
 #ifndef FILE_RENDER_OUTPUT_H_
 #define FILE_RENDER_OUTPUT_H_
 
 #include <renderers/outputs/ReconstructionRenderOutput.h>
+#include <QtCore/QAtomicInt>
 
 namespace milton {
 
+class fileRenderOutputSaveThread;
+
 class MILTON_DLL_EXPORT FileRenderOutput : public ReconstructionRenderOutput {
    
    public:
@@ -23,11 +44,10 @@ class MILTON_DLL_EXPORT FileRenderOutput : public ReconstructionRenderOutput {
       
       inline FileRenderOutput(Image *output, const std::string &fileName)
          : ReconstructionRenderOutput(output), m_fileName(fileName), 
-           m_lastSave(0), m_savePeriod(5)
+           m_lastSave(0), m_savePeriod(5), m_saveThread(NULL)
       { }
       
-      virtual ~FileRenderOutput()
-      { }
+      virtual ~FileRenderOutput();
       
       
       //@}-----------------------------------------------------------------
@@ -61,13 +81,39 @@ class MILTON_DLL_EXPORT FileRenderOutput : public ReconstructionRenderOutput {
       //@}-----------------------------------------------------------------
       
    protected:
+      /// synchronously saves all samples accumulated thus far
       virtual bool _save(const std::string &fileName);
       
+      /// atomically writes a tonemapped version of the given snapshot
+      virtual bool _save(const std::string &fileName, 
+                         const RenderOutputSnapshot &snapshot);
+      
+      /// writes the linear film of a snapshot alongside @p fileName
+      virtual bool _saveRawFilm(const std::string &fileName, 
+                                const HDRImage *linearOutput, 
+                                const RenderOutputSnapshot &snapshot);
+      
+      /// writes the auxiliary outputs of a snapshot alongside @p fileName
+      virtual bool _saveAOVs(const std::string &fileName, 
+                             const RenderOutputSnapshot &snapshot);
+      
+      /// stops the background save thread after it finishes any pending save
+      virtual void _stopSaveThread();
+      
+      friend class fileRenderOutputSaveThread;
+      
    protected:
       std::string m_fileName;
       
-      unsigned    m_lastSave;
+      /// time of the last intermediate save, in seconds (advanced via 
+      /// compare-and-swap, s.t. concurrent MLT threads save only once)
+      QAtomicInt  m_lastSave;
       unsigned    m_savePeriod;
+      
+      /// format of the raw film written alongside each image (empty if none)
+      std::string m_rawFilm;
+      
+      fileRenderOutputSaveThread *m_saveThread;
 };
 
 }
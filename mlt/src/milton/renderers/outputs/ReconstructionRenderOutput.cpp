@@ -20,7 +20,7 @@ namespace milton {
 
 ReconstructionRenderOutput::ReconstructionRenderOutput(Image *output, 
                                                        KernelFilter *f) 
-   : RenderOutput(output), m_filter(f)
+   : RenderOutput(output), m_filter(f), m_useFilterTable(true)
 { }
 
 ReconstructionRenderOutput::~ReconstructionRenderOutput() {
@@ -62,23 +62,46 @@ void ReconstructionRenderOutput::addSample(PointSample &sample) {
    const real_t centerX = sample.position[0] * width;
    const real_t centerY = sample.position[1] * height;
    
+   const unsigned minY  = (row > half ? row - half : 0);
+   const unsigned minX  = (col > half ? col - half : 0);
    const unsigned maxY  = MIN(height - 1, row + half);
    const unsigned maxX  = MIN(width  - 1, col + half);
    const bool update    = sample.update;
    
-   // progressive, normalized filter
-   for(unsigned y = (row > half ? row - half : 0); y <= maxY; ++y) {
-      for(unsigned x = (col > half ? col - half : 0); x <= maxX; ++x) {
-         const real_t weight = m_filter->evaluate(
-            Vector2(x - centerX, y - centerY)
-         );
+   // separable filters are evaluated once per row and once per column of 
+   // the sample's footprint via table lookups, as opposed to once per pixel
+   real_t weightsX[RECONSTRUCTION_MAX_FOOTPRINT];
+   real_t weightsY[RECONSTRUCTION_MAX_FOOTPRINT];
+   const bool separable = (m_useFilterTable && m_filter->hasTable() && 
+                           maxX - minX < RECONSTRUCTION_MAX_FOOTPRINT && 
+                           maxY - minY < RECONSTRUCTION_MAX_FOOTPRINT);
+   
+   if (separable) {
+      for(unsigned x = minX; x <= maxX; ++x)
+         weightsX[x - minX] = m_filter->evaluateTable(x - centerX);
+      
+      for(unsigned y = minY; y <= maxY; ++y)
+         weightsY[y - minY] = m_filter->evaluateTable(y - centerY);
+   }
+   
+   // progressive, normalized filter, where each column of the footprint is 
+   // accumulated while holding its lock once
+   for(unsigned x = minX; x <= maxX; ++x) {
+      _lockPixel(minY, x);
+      
+      for(unsigned y = minY; y <= maxY; ++y) {
+         const real_t weight = (separable ? 
+            weightsX[x - minX] * weightsY[y - minY] : 
+            m_filter->evaluate(Vector2(x - centerX, y - centerY)));
 		 
          if (weight > 0) {
             sample.update = (update && x == col && y == row);
             
-            _addSample(y, x, sample, weight, true);
+            _addSample(y, x, sample, weight, false);
          }
       }
+      
+      _unlockPixel(minY, x);
    }
 }
 
@@ -98,6 +121,8 @@ void ReconstructionRenderOutput::init() {
    
    if (m_filter)
       m_filter->init();
+   
+   m_useFilterTable = getValue<bool>("filterTable", true);
 }
 
 }
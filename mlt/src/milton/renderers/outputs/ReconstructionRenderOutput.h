@@ -6,6 +6,10 @@
    @brief
       Records point samples from a renderer and attempts to reconstruct the 
    underlying image by filtering samples with a reconstruction filter
+      Separable filters (see KernelFilter::isSeparable) are applied by 
+   looking up a single weight per row and column of a sample's footprint in 
+   the filter's precomputed table, unless 'filterTable' is disabled, and 
+   each column of the footprint is updated under a single lock acquisition.
    <!-------------------------------------------------------------------->**/
 
 #ifndef RECONSTRUCTION_RENDER_OUTPUT_H_
@@ -13,6 +17,10 @@
 
 #include <renderers/RenderOutput.h>
 
+/// maximum footprint width (in pixels) for which separable filter weights 
+/// are precomputed per sample
+#define RECONSTRUCTION_MAX_FOOTPRINT   (64)
+
 namespace milton {
 
 class MILTON_DLL_EXPORT ReconstructionRenderOutput : public RenderOutput {
@@ -64,6 +72,9 @@ class MILTON_DLL_EXPORT ReconstructionRenderOutput : public RenderOutput {
       
    protected:
       KernelFilter *m_filter;
+      
+      /// whether or not to use the filter's table if it is separable
+      bool          m_useFilterTable;
 };
 
 }
@@ -14,6 +14,7 @@
 #include <renderers/renderers/BidirectionalPathTracer.h>
 #include <renderers/renderers/OpenGLRenderer.h>
 #include <renderers/renderers/PathTracer.h>
+#include <renderers/renderers/ProgressivePhotonMapper.h>
 //#include <renderers/renderers/PhotonMapper.h>
 #include <renderers/renderers/RayCaster.h>
 #include <renderers/renderers/WhittedRayTracer.h>
@@ -22,6 +23,9 @@
 #include <renderers/utils/Path.h>
 #include <renderers/utils/PathVertex.h>
 #include <renderers/utils/IPathGenerator.h>
+#include <renderers/utils/IrradianceCache.h>
+#include <renderers/utils/PhotonTracer.h>
+#include <renderers/utils/RawFilm.h>
 //#include <renderers/utils/Photon.h>
 //#include <renderers/utils/PhotonMap.h>
 
@@ -16,6 +16,7 @@
 #include <Viewport.h>
 #include <HDRImage.h>
 #include <Rgba.h>
+#include <PointSample.h>
 #include <Camera.h>
 #include <Scene.h>
 #include <QtCore/QtCore>
@@ -74,6 +75,17 @@ void BidirectionalPathTracer::sample(PointSample &sample) {
    if (debug)
       cerr << eye << endl;
    
+   // record auxiliary outputs at the first surface seen from the camera, 
+   // whose vertex directly precedes the camera's along the eye subpath
+   if (m_output->hasAOVs()) {
+      const unsigned k = eye.length();
+      
+      if (k >= 2)
+         _recordAOV(eye[k - 2].pt.get(), eye[k - 2].tL, sample.getAOV());
+      else 
+         _recordAOV(NULL, INFINITY, sample.getAOV());
+   }
+   
    if (!eye.front().pt->emitter->isEmitter()) {
       if (debug) {
          cerr << "light" << endl;
@@ -142,6 +154,10 @@ void BidirectionalPathTracer::sample(PointSample &sample) {
    if (debug) 
       cerr << endl << path << endl;
    
+   // contributions of light subpaths connected directly to the camera 
+   // (t <= 1), which are splatted at the pixel they project to
+   PointSampleList splats;
+   
    // add weighted contributions from all possible combinations of light and 
    // eye subpaths using multiple importance sampling
    for(unsigned k = 2, n = 0; k <= length; ++k) {
@@ -168,6 +184,13 @@ void BidirectionalPathTracer::sample(PointSample &sample) {
             const real_t weight = (pdf[s]) / sums[k - 1];
             const SpectralSampleSet &c = path.getContribution(s, t);
             
+            if (t <= 1) {
+               if (!c.isZero())
+                  _addSplat(path, s, t, weight * c, splats);
+               
+               continue;
+            }
+            
             /*if (k < 10) {
                unsigned x, y;
                m_output->getViewport().getBin(sample.position, x, y);
@@ -184,6 +207,8 @@ void BidirectionalPathTracer::sample(PointSample &sample) {
    safeDeleteArray(pdfs);
    safeDeleteArray(sums);
    
+   m_output->addSplats(splats);
+   
    // TODO: hack
 #ifdef RADIANCE_HACK
    for(unsigned i = L.getN(); i--;)
@@ -198,6 +223,26 @@ void BidirectionalPathTracer::sample(PointSample &sample) {
 
 #endif
 
+void BidirectionalPathTracer::_addSplat(Path &path, unsigned s, unsigned t, 
+                                        const SpectralSampleSet &c, 
+                                        PointSampleList &outSplats)
+{
+   ASSERT(t <= 1 && s >= 2 - t);
+   
+   // the connecting edge ends at the camera, so the pixel receiving this 
+   // contribution is the one seen through the last vertex before the camera
+   const unsigned u = s - (1 - t) - 1;
+   const Point2 &filmPt = m_camera->getProjection(path[u].pt->position);
+   SpectralSampleSet value(c);
+   
+#ifdef RADIANCE_HACK
+   for(unsigned i = value.getN(); i--;)
+      value[i].value = CLAMP(value[i].value, 0, 1);
+#endif
+   
+   outSplats.push_back(PointSample(filmPt, Event(value)));
+}
+
 void BidirectionalPathTracer::finalize() {
    /*for(unsigned i = 10; i--;) {
       stringstream s;
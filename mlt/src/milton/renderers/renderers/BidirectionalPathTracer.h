@@ -6,6 +6,13 @@
    @brief
       Unbiased bidirectional path tracer with support for efficient direct 
    illumination
+
+   @note
+      Contributions of light subpaths which connect directly to the camera 
+   (light tracing, t <= 1) don't belong to the pixel whose eye subpath was 
+   traced, so they're projected onto the film via Camera::getProjection and 
+   splatted at their own pixel through RenderOutput::addSplats, with their 
+   multiple importance sampling weights intact
    <!-------------------------------------------------------------------->**/
 
 #ifndef BIDIRECTIONAL_PATH_TRACER_H_
@@ -14,6 +21,7 @@
 #include <renderers/PointSampleRenderer.h>
 #include <renderers/utils/IPathGenerator.h>
 #include <filters/ProgressiveFilterValue.h>
+#include <renderers/PointSample.h>
 
 namespace milton {
 
@@ -84,6 +92,17 @@ class MILTON_DLL_EXPORT BidirectionalPathTracer : public PointSampleRenderer,
       
       //@}-----------------------------------------------------------------
       
+   protected:
+      /**
+       * @brief
+       *    Appends the (weighted) contribution @p c of the subpath of 
+       * @p path consisting of @p s light vertices connected to @p t <= 1 eye 
+       * vertices to @p outSplats at the film position it projects to
+       */
+      virtual void _addSplat(Path &path, unsigned s, unsigned t, 
+                             const SpectralSampleSet &c, 
+                             PointSampleList &outSplats);
+      
    protected:
       HDRImage **m_images;
       ProgressiveFilterValue<SpectralSampleSet> **m_filters;
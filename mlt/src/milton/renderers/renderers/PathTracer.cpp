@@ -4,116 +4,251 @@
    @date   Fall 2008
 
    @brief
-      Unbiased path tracer with support for efficient direct illumination
+      Unbiased path tracer with support for efficient direct illumination. 
+   Paths are traced iteratively, with all per-path state kept in a plain 
+   pathTracerState s.t. no PropertyMap lookups are performed per bounce. 
+   If 'efficientDirect' is enabled (the default), direct illumination is 
+   estimated at every non-specular vertex by sampling the light sources, and 
+   combined with emission found by BSDF sampling via multiple importance 
+   sampling (power heuristic).  Paths are terminated via Russian roulette 
+   on their throughput after the first few bounces.
    <!-------------------------------------------------------------------->**/
 
 #include "PathTracer.h"
 #include <DirectIllumination.h>
+#include <RenderOutput.h>
 #include <SurfacePoint.h>
+#include <PointSample.h>
 #include <Material.h>
 #include <Camera.h>
+#include <System.h>
 #include <Random.h>
 #include <Scene.h>
 #include <QtCore/QtCore>
 #include <Ray.h>
 
+// number of bounces after which paths may be terminated via Russian roulette
+#define PATH_TRACER_ROULETTE_DEPTH (2)
+
 namespace milton {
 
+PathTracer::~PathTracer() {
+   safeDelete(m_irradianceCache);
+}
+
 void PathTracer::init() {
    m_efficientDirect = getValue<bool>("efficientDirect", true);
    
    RayTracer::init();
+   
+   safeDelete(m_irradianceCache);
+   m_irradianceCache = IrradianceCache::create(*this, m_scene);
 }
 
-void PathTracer::_evaluate(const Ray &ray, SpectralSampleSet &outRadiance, 
-                           PropertyMap &data)
-{
-   const unsigned depth = data.getValue<unsigned>("depth", 0);
-   const unsigned index = data.getValue<unsigned>("iorIndex", (unsigned) Random::sampleInt(0, 3));
+void PathTracer::render() {
+   ASSERT(m_output);
    
-   // find closest intersection
-   SurfacePoint pt;
-   const real_t t = m_scene->getIntersection(ray, pt);
+   if (!m_initted)
+      init();
    
-   // lazily initialize SurfacePoint and return if no intersection
-   if (!pt.init(ray, t)) {
-      outRadiance += m_scene->getBackgroundRadiance(ray.direction);
-      return;
+   if (m_irradianceCache && 
+       getValue<bool>("irradianceCachePrecompute", false))
+   {
+      m_output->setParent(this);
+      m_output->init();
+      
+      const Viewport &viewport = m_output->getViewport();
+      const unsigned stride    = 
+         getValue<unsigned>("irradianceCachePrecomputeStride", 4u);
+      unsigned noThreads = 
+         getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+      noThreads += (noThreads == 0);
+      
+      m_irradianceCache->precompute(m_camera, m_scene, this, 
+                                    viewport.getWidth(), 
+                                    viewport.getHeight(), 
+                                    MAX(stride, 1u), noThreads);
+      
+      cout << "irradiance cache: precomputed " 
+           << m_irradianceCache->size() << " records" << endl;
    }
    
-   pt.iorIndex = index + 1;
-   if (pt.bsdf->isSpecular())
-      data["specular"] = true;
+   RayTracer::render();
+}
+
+void PathTracer::sample(PointSample &outSample) {
+   ASSERT(m_scene);
+   ASSERT(m_camera);
    
-   // evaluate emitted radiance from intersection point, making sure 
-   // not to double-count direct illumination
-   if (pt.emitter->isEmitter()) {
-      if (!m_efficientDirect || (depth == 0)) {
-         outRadiance += pt.emitter->getLe(-ray.direction);
-      } else {
-         const real_t emittedContribution = 
-            data.getValue<real_t>("emittedContribution", 0);
-         
-         // note: this is a bit messy and really belongs in DirectIllumination, 
-         // but it is an optimization to place it here s.t. the reflected 
-         // ray from a specular surface only needs to be traced through the 
-         // scene once (we're in this case only if a specular bounce landed on 
-         // a light source)
-         if (emittedContribution > EPSILON) {
-            outRadiance += pt.emitter->getLe(-ray.direction) * 
-               (pt.shape->getSurfaceArea() / 
-                (t * t));
-                 //ABS(pt.normal.dot(-ray.direction)/* * emittedContribution*/)
-         }
-      }
-   }
+   const Ray &ray = m_camera->getWorldRay(outSample.position);
+   pathTracerState state((unsigned) Random::sampleInt(0, 3));
+   SpectralSampleSet radiance;
    
-   // estimate direct illumination
-   if (m_efficientDirect)
-      outRadiance += m_directIllumination->evaluate(pt);
+   if (m_output->hasAOVs())
+      state.aov = &outSample.getAOV();
    
-   // sample the BSDF for an exitant direction
-   const Event &event = pt.bsdf->sample();
-   const Vector3 &wo  = event;
+   _trace(ray, radiance, state);
    
-   if (wo == Vector3::zero())
-      return; // absorbed
+   // dispersion: specular surfaces only refracted the sampled wavelength
+   if (state.specular) {
+      for(unsigned i = radiance.getN(); i--;) {
+         if (i != state.iorIndex)
+            radiance[i].value = 0;
+         else 
+            radiance[i].value *= radiance.getN();
+      }
+   }
    
-   const real_t pdf = pt.bsdf->getPd(event);
-   const SpectralSampleSet &fs = pt.bsdf->evaluate(wo) / pdf;
+   outSample.value.setValue(radiance);
+}
+
+real_t PathTracer::getIncidentRadiance(const Ray &ray, 
+                                       SpectralSampleSet &outLi)
+{
+   // continue the path as an indirect bounce off of a diffuse surface, 
+   // s.t. the cache isn't queried recursively; direct illumination at the 
+   // record's position is estimated separately by light sampling
+   pathTracerState state((unsigned) Random::sampleInt(0, 3));
+   state.depth    = 1;
+   state.diffuse  = true;
+   state.emitted  = !m_efficientDirect;
    
-   // record russian roulette probability for terminating random walk
-   // note: russian roulette increases variance noticeably, so don't 
-   // use it until several bounces have passed
-   const real_t pCont = 
-      (depth < 2 ? !fs.isZero() : MIN(.95, fs[fs.getMaxSample()].value));
+   outLi = SpectralSampleSet::black();
+   return _trace(ray, outLi, state);
+}
+
+void PathTracer::_evaluate(const Ray &ray, SpectralSampleSet &outRadiance, 
+                           PropertyMap &data)
+{
+   pathTracerState state(data.getValue<unsigned>("iorIndex", 
+                         (unsigned) Random::sampleInt(0, 3)));
+   state.depth = data.getValue<unsigned>("depth", 0);
+   
+   _trace(ray, outRadiance, state);
+}
+
+real_t PathTracer::_trace(const Ray &initialRay, 
+                          SpectralSampleSet &outRadiance, 
+                          pathTracerState &state)
+{
+   Ray ray(initialRay);
+   real_t tFirst = INFINITY;
    
-   // russian roulette to terminate walk depending on albedo of surface
-   if (Random::sample(0, 1) < pCont) {
-      SpectralSampleSet Li;
-      
-      // estimate indirect illumination by recurring
-      data["depth"] = depth + 1;
-      data["emittedContribution"] = (pt.bsdf->isSpecular() ? 
-                                     pt.normal.dot(wo) : 0);
-      
-      _evaluate(Ray(pt.position, wo), Li, data);
-      
-      // attenuate indirect illumination estimate Li by reflectivity of surface 
-      // in exitant direction according to the bsdf and add its contribution to 
-      // the exitant radiance
-      outRadiance += fs * Li / pCont;
-      
-      if (depth == 0 && data.getValue<bool>("specular", false)) {
-         for(unsigned i = outRadiance.getN(); i--;) {
-            if (i != index)
-               outRadiance[i].value = 0;
-            else 
-               outRadiance[i].value *= outRadiance.getN();
+   for(unsigned bounce = 0; ; ++bounce) {
+      // find closest intersection
+      SurfacePoint pt;
+      const real_t t = m_scene->getIntersection(ray, pt);
+      
+      if (bounce == 0)
+         tFirst = t;
+      
+      // lazily initialize SurfacePoint
+      const bool hit = pt.init(ray, t);
+      
+      // record auxiliary outputs at the first surface intersected
+      if (bounce == 0 && state.aov)
+         _recordAOV((hit ? &pt : NULL), t, *state.aov);
+      
+      // stop if no intersection
+      if (!hit) {
+         outRadiance += 
+            state.throughput * m_scene->getBackgroundRadiance(ray.direction);
+         break;
+      }
+      
+      pt.iorIndex = state.iorIndex + 1;
+      
+      const bool specular = pt.bsdf->isSpecular();
+      state.specular |= specular;
+      
+      // add emitted radiance found via BSDF sampling, weighted against the 
+      // density with which direct illumination would have sampled it
+      if (state.emitted && pt.emitter->isEmitter()) {
+         real_t weight = 1;
+         
+         if (state.pdf > 0 && pt.shape != state.shape) {
+            const real_t area = pt.shape->getSurfaceArea();
+            const real_t cosL = ABS(pt.normal.dot(-ray.direction));
+            
+            if (area > EPSILON && cosL > 0) {
+               const real_t pdfL = 
+                  m_directIllumination->getLightPd(area, cosL, t);
+               
+               weight = DirectIllumination::getMISWeight(state.pdf, pdfL);
+            }
          }
+         
+         outRadiance += 
+            state.throughput * pt.emitter->getLe(-ray.direction) * weight;
       }
+      
+      // interpolate indirect illumination at the first diffuse surface from 
+      // the irradiance cache (which already accounts for emitted radiance 
+      // if direct illumination isn't estimated separately)
+      if (m_irradianceCache && !state.diffuse && 
+          IrradianceCache::isApplicable(pt))
+      {
+         SpectralSampleSet L = pt.bsdf->evaluate(pt.normalS) * 
+            m_irradianceCache->evaluate(pt.position, pt.normalS, this);
+         
+         if (m_efficientDirect)
+            L += m_directIllumination->evaluate(pt);
+         
+         outRadiance += state.throughput * L;
+         break;
+      }
+      
+      // sample the BSDF for an exitant direction
+      const Event &event = pt.bsdf->sample();
+      const Vector3 &wo  = event;
+      
+      // estimate direct illumination
+      if (m_efficientDirect && !specular) {
+         outRadiance += 
+            state.throughput * m_directIllumination->evaluateMIS(pt);
+      }
+      
+      if (wo == Vector3::zero())
+         break; // absorbed
+      
+      const real_t pdf = pt.bsdf->getPd(event);
+      if (pdf <= 0)
+         break;
+      
+      const SpectralSampleSet &fs = pt.bsdf->evaluate(wo) / pdf;
+      if (fs.isZero())
+         break;
+      
+      state.throughput *= fs;
+      
+      // russian roulette on the path's throughput
+      // note: russian roulette increases variance noticeably, so don't 
+      // use it until several bounces have passed
+      if (state.depth >= PATH_TRACER_ROULETTE_DEPTH) {
+         const SpectralSampleSet &beta = state.throughput;
+         const real_t pCont = MIN(.95, beta[beta.getMaxSample()].value);
+         
+         if (Random::sample(0, 1) >= pCont)
+            break;
+         
+         state.throughput /= pCont;
+      }
+      
+      // weight emission found along wo against light sampling via the 
+      // BSDF's density summed over all of its lobes, as evaluateMIS does 
+      // (BSDF densities are w.r.t. projected solid angle)
+      state.pdf      = (m_efficientDirect && !specular ? 
+                        pt.bsdf->getMarginalPd(wo) * ABS(pt.normal.dot(wo)) : 
+                        0);
+      state.shape    = pt.shape;
+      state.emitted  = true;
+      state.diffuse |= !specular;
+      ++state.depth;
+      
+      ray = Ray(pt.position, wo);
    }
+   
+   return tFirst;
 }
 
 }
-
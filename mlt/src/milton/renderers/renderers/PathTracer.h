@@ -4,17 +4,78 @@
    @date   Fall 2008
 
    @brief
-      Unbiased path tracer with support for efficient direct illumination
+      Unbiased path tracer with support for efficient direct illumination. 
+   Paths are traced iteratively, with all per-path state kept in a plain 
+   pathTracerState s.t. no PropertyMap lookups are performed per bounce. 
+   If 'efficientDirect' is enabled (the default), direct illumination is 
+   estimated at every non-specular vertex by sampling the light sources, and 
+   combined with emission found by BSDF sampling via multiple importance 
+   sampling (power heuristic).  Paths are terminated via Russian roulette 
+   on their throughput after the first few bounces.
+
+   @note
+      If 'irradianceCache' is enabled, indirect illumination reflected from 
+   the first diffuse surface along each path is instead interpolated from an 
+   IrradianceCache, which trades a small amount of bias for far less noise 
+   (see IrradianceCache::create for its parameters).  The cache may be 
+   populated up front via 'irradianceCachePrecompute,' which evaluates it at 
+   every 'irradianceCachePrecomputeStride'th pixel before rendering.
+
+   @see "Optimally Combining Sampling Techniques for Monte Carlo Rendering," 
+      Veach and Guibas (1995)
    <!-------------------------------------------------------------------->**/
 
 #ifndef PATH_TRACER_H_
 #define PATH_TRACER_H_
 
 #include <renderers/renderers/RayTracer.h>
+#include <renderers/utils/IrradianceCache.h>
 
 namespace milton {
 
-class MILTON_DLL_EXPORT PathTracer : public RayTracer {
+struct PointSampleAOV;
+class  Shape;
+
+/// per-path state carried between bounces by PathTracer
+struct MILTON_DLL_EXPORT pathTracerState {
+   /// product of BSDF values divided by sampling densities along the path
+   SpectralSampleSet throughput;
+   
+   /// number of bounces thus far
+   unsigned          depth;
+   
+   /// index of the wavelength used for dispersion at specular surfaces
+   unsigned          iorIndex;
+   
+   /// solid angle density with which the current ray's direction was 
+   /// sampled from the BSDF at its origin, or zero if emission found along 
+   /// the current ray should receive full weight
+   real_t            pdf;
+   
+   /// shape from which the current ray originated (NULL for camera rays)
+   Shape            *shape;
+   
+   /// whether emitted radiance found along the current ray is counted
+   bool              emitted;
+   
+   /// whether the path has undergone a specular / non-specular bounce
+   bool              specular;
+   bool              diffuse;
+   
+   /// auxiliary outputs recorded at the first surface intersected, or NULL 
+   /// if they aren't requested
+   PointSampleAOV   *aov;
+   
+   inline pathTracerState(unsigned iorIndex_ = 0)
+      : throughput(SpectralSampleSet::identity()), depth(0), 
+        iorIndex(iorIndex_), pdf(0), shape(NULL), emitted(true), 
+        specular(false), diffuse(false), aov(NULL)
+   { }
+};
+
+class MILTON_DLL_EXPORT PathTracer : public RayTracer, 
+                                     public IIrradianceSampler
+{
    public:
       ///@name Constructors
       //@{-----------------------------------------------------------------
@@ -22,23 +83,54 @@ class MILTON_DLL_EXPORT PathTracer : public RayTracer {
       inline PathTracer(RenderOutput *output = NULL, 
                         Camera *camera = NULL, 
                         Scene *scene = NULL)
-         : RayTracer(output, camera, scene)
+         : RayTracer(output, camera, scene), m_irradianceCache(NULL)
       { }
       
-      virtual ~PathTracer()
-      { }
+      virtual ~PathTracer();
       
       
       //@}-----------------------------------------------------------------
       
       virtual void init();
       
+      /**
+       * @brief 
+       *    Populates the irradiance cache if 'irradianceCachePrecompute' is 
+       * enabled before rendering the underlying scene synchronously
+       */
+      virtual void render();
+      
+      /**
+       * @brief 
+       *    Renders a single point sample by tracing a path from the point 
+       * specified on the film plane
+       */
+      virtual void sample(PointSample &outSample);
+      
+      /// estimates indirect radiance incident along sampling rays used to 
+      /// compute new irradiance cache records
+      virtual real_t getIncidentRadiance(const Ray &ray, 
+                                         SpectralSampleSet &outLi);
+      
    protected:
       virtual void _evaluate(const Ray &ray, SpectralSampleSet &outRadiance, 
                              PropertyMap &data);
       
+      /**
+       * @brief 
+       *    Traces a path starting along the given ray until it is absorbed 
+       * or terminated via Russian roulette, accumulating the radiance it 
+       * carries back to the ray's origin in @p outRadiance
+       * 
+       * @returns the distance to the first surface intersected along 
+       *    @p ray (INFINITY if none was intersected)
+       */
+      virtual real_t _trace(const Ray &ray, SpectralSampleSet &outRadiance, 
+                            pathTracerState &state);
+      
    protected:
-      bool m_efficientDirect;
+      bool             m_efficientDirect;
+      IrradianceCache *m_irradianceCache;
 };
 
 }
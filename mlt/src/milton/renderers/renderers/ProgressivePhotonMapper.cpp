@@ -0,0 +1,486 @@
+/**<!-------------------------------------------------------------------->
+   @file   ProgressivePhotonMapper.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Stochastic progressive photon mapping (Hachisuka & Jensen, 2009). 
+   Unlike Jensen's original two-pass photon mapping (see the photon mapping 
+   plugin in tests/dynamic/photon), whose quality is capped by the number of 
+   photons which fit in memory, SPPM renders a sequence of passes, each of 
+   which traces one eye path per pixel to a 'visible point,' traces a fixed 
+   number of photons which deposit their flux directly at nearby visible 
+   points (located via a spatial hash grid), and then progressively shrinks 
+   each pixel's gather radius while accumulating its flux.
+   
+   @see PhotonTracer
+   @see "Stochastic Progressive Photon Mapping," Hachisuka and Jensen (2009)
+   <!-------------------------------------------------------------------->**/
+
+#include "ProgressivePhotonMapper.h"
+#include <DirectIllumination.h>
+#include <PhotonTracer.h>
+#include <RenderOutput.h>
+#include <PointSample.h>
+#include <SurfacePoint.h>
+#include <Material.h>
+#include <System.h>
+#include <Camera.h>
+#include <Random.h>
+#include <Scene.h>
+#include <Path.h>
+#include <QtCore/QtCore>
+#include <Ray.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace milton {
+
+// number of consecutive eye paths or photons traced from a single random 
+// stream; blocks are the unit of work split between threads
+#define SPPM_BLOCK_SIZE             (64)
+
+// gather radius relative to the diagonal of the visible points' bounds, 
+// used when 'sppmInitialRadius' isn't specified
+#define SPPM_DEFAULT_RADIUS_SCALE   (0.01)
+
+/**
+ * @brief 
+ *    Worker thread which processes a contiguous range of blocks of a single
+ * stage of an SPPM pass
+ * 
+ * @see ProgressivePhotonMapper::_runStage
+ */
+class sppmThread : public QThread {
+   public:
+      inline sppmThread(ProgressivePhotonMapper *renderer, 
+                        ProgressivePhotonMapper::Stage stage, unsigned n, 
+                        unsigned begin, unsigned end)
+         : QThread(), m_renderer(renderer), m_stage(stage), m_n(n), 
+           m_begin(begin), m_end(end)
+      { }
+      
+      virtual ~sppmThread()
+      { }
+      
+      virtual void run() {
+         m_renderer->_runStage(m_stage, m_n, m_begin, m_end);
+      }
+   
+   public:
+      ProgressivePhotonMapper       *m_renderer;
+      ProgressivePhotonMapper::Stage m_stage;
+      unsigned                       m_n;
+      unsigned                       m_begin;
+      unsigned                       m_end;
+};
+
+inline unsigned ProgressivePhotonMapper::_hash(int x, int y, int z) const {
+   const unsigned h = ((unsigned) x * 73856093u) ^ 
+      ((unsigned) y * 19349663u) ^ ((unsigned) z * 83492791u);
+   
+   return h % m_pixels.size();
+}
+
+ProgressivePhotonMapper::~ProgressivePhotonMapper() {
+   safeDelete(m_photonTracer);
+}
+
+void ProgressivePhotonMapper::init() {
+   if (NULL == m_photonTracer) {
+      PointSampleRenderer::init();
+      
+      m_photonTracer = new PhotonTracer();
+   }
+}
+
+void ProgressivePhotonMapper::render() {
+   ASSERT(m_output);
+   
+   if (!m_initted)
+      init();
+   
+   QMutexLocker lock(&m_renderMutex);
+   m_output->setParent(this);
+   m_output->init();
+   
+   // parse parameters
+   const unsigned noPasses   = getValue<unsigned>("sppmNoPasses", 64u);
+   const real_t   maxSeconds = getValue<real_t>("sppmMaxSeconds", 0);
+   const real_t   radius     = getValue<real_t>("sppmInitialRadius", 0);
+   
+   m_noThreads = getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+   m_noThreads += (m_noThreads == 0);
+   
+   m_noPhotonsPerPass = 
+      getValue<unsigned>("sppmPhotonsPerPass", 100000u);
+   m_noPhotonsPerPass += (m_noPhotonsPerPass == 0);
+   
+   m_alpha    = CLAMP(getValue<real_t>("sppmAlpha", 0.7), EPSILON, 1);
+   m_maxDepth = getValue<unsigned>("maxDepth", 16u);
+   m_maxDepth += (m_maxDepth == 0);
+   
+   const unsigned noPixels = m_output->getViewport().getSize();
+   
+   m_pixels.clear();
+   m_pixels.resize(noPixels);
+   
+   m_initialRadius = MAX(radius, create_real(0));
+   
+   // initialize timer to begin counting
+   m_timer.reset();
+   
+   cout << endl;
+   cout << "rendering with " << m_noThreads << 
+      (m_noThreads == 1 ? " thread" : " threads") << " (" << 
+      m_noPhotonsPerPass << " photons per pass)" << endl;
+   
+   for(m_pass = 0; m_pass < noPasses; ) {
+      if (maxSeconds > 0 && m_timer.elapsed() >= maxSeconds)
+         break;
+      
+      _runStage(SPPM_STAGE_EYE, noPixels);
+      
+      _initRadii();
+      
+      _buildGrid();
+      _runStage(SPPM_STAGE_PHOTONS, m_noPhotonsPerPass);
+      _runStage(SPPM_STAGE_UPDATE, noPixels);
+      
+      ++m_pass;
+      cout << "pass " << m_pass << " (" << getElapsedTime() << ")" << endl;
+   }
+   
+   // release the grid and all per-pixel state
+   m_gridStart.clear();
+   m_gridEntries.clear();
+   m_pixels.clear();
+   
+   m_output->finalize();
+   finalize();
+   
+   cout << endl << "done rendering " << m_pass << " passes in " << 
+      getElapsedTime() << endl << endl;
+}
+
+void ProgressivePhotonMapper::_runStage(Stage stage, unsigned n) {
+   const unsigned noBlocks  = (n + SPPM_BLOCK_SIZE - 1) / SPPM_BLOCK_SIZE;
+   const unsigned noThreads = MIN(m_noThreads, MAX(noBlocks, 1u));
+   
+   if (noThreads <= 1) {
+      _runStage(stage, n, 0, noBlocks);
+      return;
+   }
+   
+   std::vector<sppmThread*> threads;
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      const unsigned begin = (noBlocks * i) / noThreads;
+      const unsigned end   = (noBlocks * (i + 1)) / noThreads;
+      
+      sppmThread *thread = new sppmThread(this, stage, n, begin, end);
+      threads.push_back(thread);
+      
+      thread->start();
+   }
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      sppmThread *thread = threads[i];
+      
+      while(!thread->wait());
+      safeDelete(thread);
+   }
+}
+
+void ProgressivePhotonMapper::_runStage(Stage stage, unsigned n, 
+                                        unsigned begin, unsigned end)
+{
+   Random::Generator *oldGenerator = Random::getThreadGenerator();
+   const unsigned baseSeed = 
+      Random::getSubstreamSeed(Random::s_seed, m_pass * 3 + (unsigned) stage);
+   
+   for(unsigned block = begin; block < end; ++block) {
+      const unsigned first = block * SPPM_BLOCK_SIZE;
+      const unsigned last  = MIN(first + SPPM_BLOCK_SIZE, n);
+      
+      // trace each block from a private stream s.t. the result doesn't 
+      // depend on which thread processes it
+      Random::Generator generator(Random::getSubstreamSeed(baseSeed, block));
+      Random::setThreadGenerator(&generator);
+      
+      for(unsigned i = first; i < last; ++i) {
+         switch(stage) {
+            case SPPM_STAGE_EYE:
+               _traceEyePath(i);
+               break;
+            case SPPM_STAGE_PHOTONS:
+               _tracePhoton();
+               break;
+            case SPPM_STAGE_UPDATE:
+            default:
+               _updatePixel(i);
+               break;
+         }
+      }
+      
+      Random::setThreadGenerator(oldGenerator);
+   }
+}
+
+void ProgressivePhotonMapper::_traceEyePath(unsigned index) {
+   const Viewport &viewport = m_output->getViewport();
+   const unsigned  width    = viewport.getWidth();
+   const unsigned  row      = index / width;
+   const unsigned  col      = index % width;
+   sppmPixel &pixel = m_pixels[index];
+   
+   pixel.pt.reset();
+   
+   // jitter the eye ray within this pixel
+   const Point2 pos((col + Random::sample(0, 1)) * viewport.getInvWidth(), 
+                    (row + Random::sample(0, 1)) * viewport.getInvHeight());
+   
+   Ray ray = m_camera->getWorldRay(pos);
+   SpectralSampleSet beta = SpectralSampleSet::identity();
+   SpectralSampleSet L;
+   
+   // follow specular bounces until reaching the first non-specular surface
+   for(unsigned depth = 0; depth < m_maxDepth; ++depth) {
+      SurfacePointPtr pt(new SurfacePoint());
+      const real_t t = m_scene->getIntersection(ray, *pt);
+      
+      if (!pt->init(ray, t)) {
+         L += beta * m_scene->getBackgroundRadiance(ray.direction);
+         break;
+      }
+      
+      // emitted radiance is only seen directly or via specular bounces, 
+      // since direct illumination at the visible point is estimated below
+      if (pt->emitter->isEmitter())
+         L += beta * pt->emitter->getLe(-ray.direction);
+      
+      if (!pt->bsdf->isSpecular()) {
+         L += beta * m_directIllumination->evaluate(*pt);
+         
+         pixel.pt   = pt;
+         pixel.wi   = ray.direction;
+         pixel.beta = beta;
+         break;
+      }
+      
+      const Event &event = pt->bsdf->sample();
+      const Vector3 &wo  = event;
+      
+      if (wo == Vector3::zero())
+         break; // absorbed
+      
+      const real_t pd = pt->bsdf->getPd(event);
+      if (pd <= 0)
+         break;
+      
+      beta *= pt->bsdf->evaluate(wo) / pd;
+      if (beta.isZero())
+         break;
+      
+      ray = Ray(pt->position, wo);
+   }
+   
+   pixel.Ld += L;
+}
+
+void ProgressivePhotonMapper::_tracePhoton() {
+   Path path(this);
+   
+   m_photonTracer->generateL(path, PhotonTracerParams(false, true));
+   
+   // photons are only deposited after at least one bounce, since direct 
+   // illumination is estimated separately at each visible point
+   for(unsigned i = 2; i < path.length(); ++i) {
+      const PathVertex &v = path[i];
+      
+      if (v.bsdf->isSpecular())
+         continue;
+      
+      const Point3 &p = v.pt->position;
+      
+      if (m_gridEntries.empty() || !m_gridBounds.contains(p))
+         continue;
+      
+      const unsigned cell = _hash( 
+         (int) floor((p[0] - m_gridBounds.min[0]) * m_invCellSize), 
+         (int) floor((p[1] - m_gridBounds.min[1]) * m_invCellSize), 
+         (int) floor((p[2] - m_gridBounds.min[2]) * m_invCellSize));
+      
+      for(unsigned j = m_gridStart[cell]; j < m_gridStart[cell + 1]; ++j) {
+         const unsigned index = m_gridEntries[j];
+         sppmPixel &pixel = m_pixels[index];
+         const real_t r = pixel.radius;
+         
+         if ((pixel.pt->position - p).getMagnitude2() > r * r)
+            continue;
+         
+         // note: assumes BSDF reciprocity (see Photon)
+         const SpectralSampleSet &phi = 
+            pixel.pt->bsdf->evaluate(pixel.wi, -v.wi) * v.alphaL;
+         
+         QMutexLocker lock(&m_pixelLocks[index % SPPM_NO_PIXEL_LOCKS]);
+         pixel.phi += phi;
+         ++pixel.M;
+      }
+   }
+}
+
+void ProgressivePhotonMapper::_updatePixel(unsigned index) {
+   const Viewport &viewport = m_output->getViewport();
+   const unsigned  width    = viewport.getWidth();
+   sppmPixel &pixel = m_pixels[index];
+   
+   // keep a fraction alpha of this pass' photons, shrinking the gather 
+   // radius s.t. the photon density remains constant
+   if (pixel.M > 0) {
+      const real_t N     = pixel.N + m_alpha * pixel.M;
+      const real_t scale = N / (pixel.N + pixel.M);
+      
+      pixel.tau     = (pixel.tau + pixel.beta * pixel.phi) * scale;
+      pixel.radius *= sqrt(scale);
+      pixel.N       = N;
+      
+      pixel.phi     = SpectralSampleSet::black();
+      pixel.M       = 0;
+   }
+   
+   pixel.pt.reset();
+   
+   const real_t k  = m_pass + 1;
+   const real_t r2 = pixel.radius * pixel.radius;
+   SpectralSampleSet L = pixel.Ld / k;
+   
+   if (r2 > 0)
+      L += pixel.tau / (k * m_noPhotonsPerPass * M_PI * r2);
+   
+   // add the change in this pixel's estimate, s.t. the film's running 
+   // average of all k samples equals the current estimate
+   PointSample sample((index % width + 0.5) * viewport.getInvWidth(), 
+                      (index / width + 0.5) * viewport.getInvHeight());
+   
+   sample.value.setValue(L * k - pixel.L * (k - 1));
+   m_output->addSample(sample);
+   
+   pixel.L = L;
+}
+
+void ProgressivePhotonMapper::_initRadii() {
+   if (m_initialRadius <= 0) {
+      AABB bounds;
+      bool valid = false;
+      
+      FOREACH(sppmPixelListConstIter, m_pixels, iter) {
+         if (iter->pt) {
+            bounds.add(iter->pt->position);
+            valid = true;
+         }
+      }
+      
+      if (!valid)
+         return;
+      
+      m_initialRadius = SPPM_DEFAULT_RADIUS_SCALE * 
+         bounds.getDiagonal().getMagnitude();
+      m_initialRadius = (m_initialRadius > 0 ? m_initialRadius : 1);
+   }
+   
+   FOREACH(sppmPixelListIter, m_pixels, iter) {
+      if (iter->pt && iter->radius <= 0)
+         iter->radius = m_initialRadius;
+   }
+}
+
+void ProgressivePhotonMapper::_buildGrid() {
+   const unsigned noCells = m_pixels.size();
+   real_t maxRadius = 0;
+   
+   m_gridBounds = AABB();
+   m_gridStart.assign(noCells + 1, 0);
+   m_gridEntries.clear();
+   
+   FOREACH(sppmPixelListConstIter, m_pixels, iter) {
+      if (iter->pt) {
+         m_gridBounds.add(iter->pt->position);
+         maxRadius = MAX(maxRadius, iter->radius);
+      }
+   }
+   
+   if (maxRadius <= 0)
+      return;
+   
+   // expand bounds by the largest gather radius s.t. photons outside of 
+   // them can be rejected without a lookup
+   for(unsigned i = 3; i--;) {
+      m_gridBounds.min[i] -= maxRadius;
+      m_gridBounds.max[i] += maxRadius;
+   }
+   
+   m_invCellSize = 1.0 / (2 * maxRadius);
+   
+   // distinct cells overlapped by the current visible point, which may 
+   // collide in the hash table and must only be entered once
+   std::vector<unsigned> cells;
+   
+   // the grid is stored contiguously; the first pass counts the number of 
+   // entries in each cell, and the second pass fills them in
+   for(unsigned pass = 0; pass < 2; ++pass) {
+      std::vector<unsigned> offsets;
+      
+      if (pass == 1) {
+         for(unsigned i = 0; i < noCells; ++i)
+            m_gridStart[i + 1] += m_gridStart[i];
+         
+         m_gridEntries.resize(m_gridStart[noCells]);
+         offsets.assign(m_gridStart.begin(), m_gridStart.end() - 1);
+      }
+      
+      for(unsigned index = 0; index < noCells; ++index) {
+         const sppmPixel &pixel = m_pixels[index];
+         
+         if (!pixel.pt || pixel.radius <= 0)
+            continue;
+         
+         const Point3 &p = pixel.pt->position;
+         int lo[3], hi[3];
+         
+         for(unsigned i = 3; i--;) {
+            lo[i] = (int) floor((p[i] - pixel.radius - m_gridBounds.min[i]) * 
+                                m_invCellSize);
+            hi[i] = (int) floor((p[i] + pixel.radius - m_gridBounds.min[i]) * 
+                                m_invCellSize);
+         }
+         
+         cells.clear();
+         
+         for(int z = lo[2]; z <= hi[2]; ++z) {
+            for(int y = lo[1]; y <= hi[1]; ++y) {
+               for(int x = lo[0]; x <= hi[0]; ++x) {
+                  const unsigned cell = _hash(x, y, z);
+                  
+                  if (std::find(cells.begin(), cells.end(), cell) == 
+                      cells.end())
+                  {
+                     cells.push_back(cell);
+                  }
+               }
+            }
+         }
+         
+         FOREACH(std::vector<unsigned>::const_iterator, cells, iter) {
+            if (pass == 0)
+               ++m_gridStart[*iter + 1];
+            else
+               m_gridEntries[offsets[*iter]++] = index;
+         }
+      }
+   }
+}
+
+}
+
@@ -0,0 +1,216 @@
+/**<!-------------------------------------------------------------------->
+   @class  ProgressivePhotonMapper
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Stochastic progressive photon mapping (Hachisuka & Jensen, 2009). 
+   Unlike Jensen's original two-pass photon mapping (see the photon mapping 
+   plugin in tests/dynamic/photon), whose quality is capped by the number of 
+   photons which fit in memory, SPPM renders a sequence of passes, each of 
+   which consists of: 
+      1) tracing one eye path per pixel through specular bounces to its 
+         first non-specular surface, the pixel's 'visible point,' at which 
+         direct illumination is estimated 
+      2) building a spatial hash grid over the visible points, where each 
+         visible point is inserted into every cell overlapping its gather 
+         sphere 
+      3) tracing 'sppmPhotonsPerPass' photons from the light sources via 
+         PhotonTracer, depositing the flux of each photon at every visible 
+         point whose gather sphere contains it (photons themselves are never 
+         stored) 
+      4) progressively updating each pixel's accumulated flux and shrinking 
+         its gather radius s.t. the estimate converges to the correct 
+         solution as the number of passes -> infinity, where 'sppmAlpha' 
+         controls the fraction of new photons kept in each pass
+   
+   Memory usage is therefore constant per pass and proportional only to the 
+   number of pixels.  Each stage of a pass runs on 'noRenderThreads' worker 
+   threads, where each block of eye paths or photons is traced from its own 
+   random stream seeded by its index, s.t. the result is independent of the 
+   number of threads. 
+      The film is updated after every pass s.t. each pixel's running 
+   average equals its current estimate, so intermediate results may be 
+   displayed progressively.
+   
+   @see PhotonTracer
+   @see "Stochastic Progressive Photon Mapping," Hachisuka and Jensen (2009)
+   <!-------------------------------------------------------------------->**/
+
+#ifndef PROGRESSIVE_PHOTON_MAPPER_H_
+#define PROGRESSIVE_PHOTON_MAPPER_H_
+
+#include <renderers/PointSampleRenderer.h>
+#include <core/SurfacePoint.h>
+#include <accel/AABB.h>
+
+// number of locks guarding per-pixel photon statistics
+#define SPPM_NO_PIXEL_LOCKS (1024)
+
+namespace milton {
+
+class PhotonTracer;
+class sppmThread;
+
+/// per-pixel state maintained across passes by ProgressivePhotonMapper
+struct MILTON_DLL_EXPORT sppmPixel {
+   /// visible point found during the current pass (NULL if none was found)
+   SurfacePointPtr   pt;
+   
+   /// direction of the eye ray incident to the visible point
+   Vector3           wi;
+   
+   /// throughput of the eye path from the camera to the visible point
+   SpectralSampleSet beta;
+   
+   /// sum of emitted and direct illumination estimates over all passes
+   SpectralSampleSet Ld;
+   
+   /// current gather radius
+   real_t            radius;
+   
+   /// accumulated (reduced) number of photons
+   real_t            N;
+   
+   /// accumulated (reduced) flux, unnormalized by the number of photons
+   SpectralSampleSet tau;
+   
+   /// flux and number of photons gathered during the current pass
+   SpectralSampleSet phi;
+   unsigned          M;
+   
+   /// radiance estimate as of the previous pass
+   SpectralSampleSet L;
+   
+   inline sppmPixel()
+      : radius(0), N(0), M(0)
+   { }
+};
+
+DECLARE_STL_TYPEDEF(std::vector<sppmPixel>, sppmPixelList);
+
+class MILTON_DLL_EXPORT ProgressivePhotonMapper : public PointSampleRenderer {
+   public:
+      /// stages of a single pass, each of which is run in parallel
+      enum Stage {
+         SPPM_STAGE_EYE = 0, 
+         SPPM_STAGE_PHOTONS, 
+         SPPM_STAGE_UPDATE
+      };
+      
+      
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline ProgressivePhotonMapper(RenderOutput *output = NULL, 
+                                     Camera *camera = NULL, 
+                                     Scene *scene = NULL)
+         : PointSampleRenderer(output, camera, scene), m_photonTracer(NULL), 
+           m_invCellSize(0), m_initialRadius(0), m_noPhotonsPerPass(0), 
+           m_noThreads(1), m_pass(0), m_alpha(0.7), m_maxDepth(0)
+      { }
+      
+      virtual ~ProgressivePhotonMapper();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Initialization
+      //@{-----------------------------------------------------------------
+      
+      virtual void init();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Renders the underlying scene synchronously, running passes until
+       * either 'sppmNoPasses' passes have completed or 'sppmMaxSeconds' 
+       * have elapsed
+       */
+      virtual void render();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      /// @returns the number of passes completed thus far
+      inline unsigned getNoPasses() const {
+         return m_pass;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      ///@name Pass stages
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Splits [0, n) into blocks which are processed by the given stage
+       * on all worker threads, returning once all blocks are done
+       */
+      virtual void _runStage(Stage stage, unsigned n);
+      
+      /// processes blocks [begin, end) of [0, n) on the calling thread
+      virtual void _runStage(Stage stage, unsigned n, unsigned begin, 
+                             unsigned end);
+      
+      /// traces an eye path for pixel @p index to its visible point
+      virtual void _traceEyePath(unsigned index);
+      
+      /// traces a single photon path, depositing its flux at nearby 
+      /// visible points
+      virtual void _tracePhoton();
+      
+      /// progressively updates pixel @p index with this pass' photons and 
+      /// adds the change in its estimate to the film
+      virtual void _updatePixel(unsigned index);
+      
+      /// initializes the gather radius of every pixel which has a visible 
+      /// point but no radius yet (e.g., whose eye paths escaped during all 
+      /// previous passes), relative to the extent of the first visible 
+      /// points found unless 'sppmInitialRadius' is given
+      virtual void _initRadii();
+      
+      /// builds the hash grid over all current visible points
+      virtual void _buildGrid();
+      
+      /// @returns the index of the hash grid cell (x, y, z)
+      inline unsigned _hash(int x, int y, int z) const;
+      
+      
+      //@}-----------------------------------------------------------------
+      
+      friend class sppmThread;
+   
+   protected:
+      PhotonTracer         *m_photonTracer;
+      sppmPixelList         m_pixels;
+      QMutex                m_pixelLocks[SPPM_NO_PIXEL_LOCKS];
+      
+      /// hash grid over visible points, where the entries of cell i are 
+      /// stored in m_gridEntries[m_gridStart[i], m_gridStart[i + 1])
+      std::vector<unsigned> m_gridStart;
+      std::vector<unsigned> m_gridEntries;
+      AABB                  m_gridBounds;
+      real_t                m_invCellSize;
+      
+      /// gather radius assigned to pixels by _initRadii (zero until known)
+      real_t                m_initialRadius;
+      
+      unsigned              m_noPhotonsPerPass;
+      unsigned              m_noThreads;
+      unsigned              m_pass;
+      real_t                m_alpha;
+      unsigned              m_maxDepth;
+};
+
+}
+
+#endif // PROGRESSIVE_PHOTON_MAPPER_H_
+
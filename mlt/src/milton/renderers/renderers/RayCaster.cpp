@@ -10,6 +10,7 @@
 #include "RayCaster.h"
 #include <DirectIllumination.h>
 #include <SurfacePoint.h>
+#include <PointSample.h>
 #include <Material.h>
 #include <Camera.h>
 #include <Scene.h>
@@ -31,8 +32,17 @@ void RayCaster::_evaluate(const Ray &ray, SpectralSampleSet &outRadiance,
    SurfacePoint pt;
    const real_t t = m_scene->getIntersection(ray, pt);
    
-   // lazily initialize SurfacePoint and return if no intersection
-   if (!pt.init(ray, t)) {
+   // lazily initialize SurfacePoint
+   const bool hit = pt.init(ray, t);
+   
+   // record auxiliary outputs if requested by RayTracer::sample
+   if (data.contains("aov")) {
+      _recordAOV((hit ? &pt : NULL), t, 
+                 *data.getValue<PointSampleAOV*>("aov"));
+   }
+   
+   // return if no intersection
+   if (!hit) {
       outRadiance += m_scene->getBackgroundRadiance(ray.direction);
       return;
    }
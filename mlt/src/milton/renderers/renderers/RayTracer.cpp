@@ -9,6 +9,7 @@
    <!-------------------------------------------------------------------->**/
 
 #include "RayTracer.h"
+#include <RenderOutput.h>
 #include <PointSample.h>
 #include <Camera.h>
 #include <QtCore/QtCore>
@@ -24,6 +25,11 @@ void RayTracer::sample(PointSample &outSample) {
    const Ray &ray = m_camera->getWorldRay(outSample.position);
    SpectralSampleSet radiance;
    
+   // subclasses which support auxiliary outputs record them at the first 
+   // surface intersected along the primary ray
+   if (m_output && m_output->hasAOVs())
+      data["aov"] = &outSample.getAOV();
+   
    _evaluate(ray, radiance, data);
    outSample.value.setValue(radiance);
    
@@ -42,10 +42,20 @@ void WhittedRayTracer::_evaluate(const Ray &ray, SpectralSampleSet &outRadiance,
    SurfacePoint pt;
    const real_t t = m_scene->getIntersection(ray, pt);
    
-   // lazily initialize SurfacePoint and return if no intersection
+   // lazily initialize SurfacePoint
+   const bool hit = pt.init(ray, t);
+   
+   // record auxiliary outputs at the first surface intersected if 
+   // requested by RayTracer::sample
+   if (depth == 0 && data.contains("aov")) {
+      _recordAOV((hit ? &pt : NULL), t, 
+                 *data.getValue<PointSampleAOV*>("aov"));
+   }
+   
+   // return if no intersection
    // also return if we hit an emitter after the first bounce, 
    // ensuring we don't real_t-count direct illumination
-   if (!pt.init(ray, t)) {
+   if (!hit) {
       outRadiance += m_scene->getBackgroundRadiance(ray.direction);
       return;
    }
@@ -6,6 +6,10 @@
    @brief
       A ToneMap converts radiance values stored in an HDRImage to displayable 
    sRGB pixels in an RgbaImage.
+      ReinhardToneMap implements the global operator from Reinhard et al., 
+   which scales luminance s.t. the image's log-average luminance (its key) 
+   maps to a given exposure and then compresses it s.t. a given white point 
+   maps to one.
    
    @note for more info, see 
       Photographic Tone Reproduction for Digital Images. Reinhard et al, 2002
@@ -13,87 +17,264 @@
 
 #include "ReinhardToneMap.h"
 #include <common/image/miltonimage.h>
-#include <ColorUtils.h>
+#include <System.h>
+#include <QtCore/QtCore>
 using namespace std;
 
+#if (MILTON_SIMD != MILTON_SIMD_NONE) && MILTON_DOUBLE_PRECISION
+#  include <emmintrin.h> // SSE2
+#  define REINHARD_TONE_MAP_SIMD (1)
+#else
+#  define REINHARD_TONE_MAP_SIMD (0)
+#endif
+
+/// minimum number of pixels each thread is given, below which the overhead 
+/// of starting threads would outweigh the parallel speedup
+#define REINHARD_TONE_MAP_MIN_PIXELS_PER_THREAD   (1 << 15)
+
 namespace milton {
 
+/// coefficients of the Y row of the linear sRGB -> XYZ matrix (see RGBtoXYZ)
+static const real_t s_luminanceR = 0.21267112134122;
+static const real_t s_luminanceG = 0.71515920531078;
+static const real_t s_luminanceB = 0.07216877677613;
+
+static inline real_t reinhardToneMapGetLuminance(const RgbaHDR &p) {
+   const real_t Y = 
+      s_luminanceR * p.r + s_luminanceG * p.g + s_luminanceB * p.b;
+   
+   return (Y > 0 ? Y : 0);
+}
+
+/**
+ * @brief 
+ *    Worker thread which processes a contiguous block of rows of the input 
+ * image in either of ReinhardToneMap's two passes
+ */
+class reinhardToneMapThread : public QThread {
+   public:
+      inline reinhardToneMapThread(const ReinhardToneMap *tonemap, 
+                                   const RgbaHDR *input, Rgba32 *output, 
+                                   unsigned begin, unsigned end)
+         : QThread(), m_tonemap(tonemap), m_input(input), m_output(output), 
+           m_begin(begin), m_end(end), m_mapping(false), m_logSum(0), 
+           m_maxLuminance(0), m_scale(0), m_white(0)
+      { }
+      
+      virtual ~reinhardToneMapThread()
+      { }
+      
+      /// accumulates the log and maximum luminance of this block's pixels
+      void reduce() {
+         real_t logSum = 0, maxLuminance = 0;
+         
+         for(unsigned i = m_begin; i < m_end; ++i) {
+            const real_t Y = reinhardToneMapGetLuminance(m_input[i]);
+            
+            logSum      += log(EPSILON + Y);
+            maxLuminance = MAX(maxLuminance, Y);
+         }
+         
+         m_logSum       = logSum;
+         m_maxLuminance = maxLuminance;
+      }
+      
+      /// scales and compresses the luminance of this block's pixels and 
+      /// encodes them for display
+      void map() {
+         const real_t scale = m_scale;
+         const real_t white = m_white;
+         unsigned i = m_begin;
+         
+#if REINHARD_TONE_MAP_SIMD
+         const __m128d cR     = _mm_set1_pd(s_luminanceR);
+         const __m128d cG     = _mm_set1_pd(s_luminanceG);
+         const __m128d cB     = _mm_set1_pd(s_luminanceB);
+         const __m128d vScale = _mm_set1_pd(scale);
+         const __m128d vWhite = _mm_set1_pd(white);
+         const __m128d one    = _mm_set1_pd(1.0);
+         const __m128d zero   = _mm_setzero_pd();
+         
+         // two pixels at a time, one per lane
+         for(; i + 1 < m_end; i += 2) {
+            const real_t *p0 = m_input[i].data;
+            const real_t *p1 = m_input[i + 1].data;
+            
+            // transpose the two pixels' channels into [r0, r1], [g0, g1], 
+            // and [b0, b1]
+            const __m128d rg0 = _mm_loadu_pd(p0), ba0 = _mm_loadu_pd(p0 + 2);
+            const __m128d rg1 = _mm_loadu_pd(p1), ba1 = _mm_loadu_pd(p1 + 2);
+            const __m128d r   = _mm_unpacklo_pd(rg0, rg1);
+            const __m128d g   = _mm_unpackhi_pd(rg0, rg1);
+            const __m128d b   = _mm_unpacklo_pd(ba0, ba1);
+            
+            // note: _mm_max_pd returns its second operand if either is NaN, 
+            // matching reinhardToneMapGetLuminance
+            const __m128d Y   = _mm_max_pd(_mm_add_pd(_mm_add_pd(
+               _mm_mul_pd(cR, r), _mm_mul_pd(cG, g)), _mm_mul_pd(cB, b)), 
+               zero);
+            const __m128d lum = _mm_mul_pd(vScale, Y);
+            
+            const __m128d ratio = _mm_and_pd(_mm_cmpgt_pd(Y, zero), 
+               _mm_div_pd(_mm_mul_pd(vScale, _mm_add_pd(one, 
+                  _mm_mul_pd(lum, vWhite))), _mm_add_pd(one, lum)));
+            
+            real_t rr[2], gg[2], bb[2];
+            _mm_storeu_pd(rr, _mm_mul_pd(ratio, r));
+            _mm_storeu_pd(gg, _mm_mul_pd(ratio, g));
+            _mm_storeu_pd(bb, _mm_mul_pd(ratio, b));
+            
+            for(unsigned j = 0; j < 2; ++j) {
+               Rgba32 &o = m_output[i + j];
+               
+               o.r = m_tonemap->_encode(rr[j]);
+               o.g = m_tonemap->_encode(gg[j]);
+               o.b = m_tonemap->_encode(bb[j]);
+               o.a = 255;
+            }
+         }
+#endif
+         
+         for(; i < m_end; ++i) {
+            const RgbaHDR &p = m_input[i];
+            Rgba32 &o = m_output[i];
+            
+            const real_t Y   = reinhardToneMapGetLuminance(p);
+            const real_t lum = scale * Y;
+            
+            // ratio of compressed to original luminance, which is applied 
+            // uniformly to all channels s.t. chromaticity is preserved
+            const real_t ratio = (Y > 0 ? 
+               scale * (1.0 + lum * white) / (1.0 + lum) : 0);
+            
+            o.r = m_tonemap->_encode(ratio * p.r);
+            o.g = m_tonemap->_encode(ratio * p.g);
+            o.b = m_tonemap->_encode(ratio * p.b);
+            o.a = 255;
+         }
+      }
+      
+      virtual void run() {
+         if (m_mapping)
+            map();
+         else 
+            reduce();
+      }
+   
+   public:
+      const ReinhardToneMap *m_tonemap;
+      const RgbaHDR         *m_input;
+      Rgba32                *m_output;
+      unsigned               m_begin;
+      unsigned               m_end;
+      
+      /// whether this thread performs the mapping or reduction pass
+      bool                   m_mapping;
+      
+      /// results of the reduction pass
+      real_t                 m_logSum;
+      real_t                 m_maxLuminance;
+      
+      /// parameters of the mapping pass
+      real_t                 m_scale;
+      real_t                 m_white;
+};
+
 void ReinhardToneMap::init() {
-   // TODO
+   ToneMap::init();
+   
+   m_exposure   = getValue<real_t>("tonemapExposure", 0.18);
+   m_whitePoint = getValue<real_t>("tonemapWhitePoint", 0);
+   m_noThreads  = 
+      getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+   m_noThreads += (m_noThreads == 0);
 }
 
 RgbaImage *ReinhardToneMap::map(const HDRImage *input) {
    ASSERT(input);
    
-   // create temporary, working image and an output image
-   HDRImage  *image   = new HDRImage (*input);
-   RgbaImage *out     = new RgbaImage(input->getWidth(), input->getHeight());
-   RgbaHDR *imageData = image->getData();
-   Rgba32 *outData    = out->getData();
-   const unsigned n   = image->getSize();
+   const unsigned width  = input->getWidth();
+   const unsigned height = input->getHeight();
+   const unsigned n      = input->getSize();
    
-   real_t exposure = 0.18;
-   real_t white    = 0;
-   real_t key      = 0;
+   RgbaImage *out = new RgbaImage(width, height);
+   if (n == 0)
+      return out;
    
-   { // convert to xyY color space and find image key
-      for(unsigned i = n; i--;) {
-         RgbaHDR &p = imageData[i];
-         
-         // convert RGB to XYZ
-         RGBtoXYZ(p.r, p.g, p.b, p.r, p.g, p.b);
-         ASSERT(p.g >= 0);
-         
-         // convert XYZ to xyY to remove X and Z dependence on luminance
-         //XYZtoxyY(p.r, p.g, p.b, p.r, p.b, p.g);
-         const RgbaHDR temp = p;
-         p.r = temp.r / (temp.r + temp.g + temp.b);
-         p.b = temp.g / (temp.r + temp.g + temp.b);
-         
-         key  += log(EPSILON + p.g);
-         white = MAX(white, p.g);
-      }
+   const RgbaHDR *inputData = input->getData();
+   Rgba32 *outData = out->getData();
+   
+   // split the image into blocks of rows, only using as many threads as 
+   // there are blocks large enough to be worth processing in parallel
+   unsigned noThreads = MIN(m_noThreads, 
+                            n / REINHARD_TONE_MAP_MIN_PIXELS_PER_THREAD);
+   noThreads = CLAMP(noThreads, 1u, height);
+   
+   std::vector<reinhardToneMapThread *> threads;
+   threads.reserve(noThreads);
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      const unsigned begin = (unsigned)(((uint64_t)height * i) / noThreads);
+      const unsigned end   = 
+         (unsigned)(((uint64_t)height * (i + 1)) / noThreads);
       
-      key   = exp(key / ((real_t)n));
-      white = (white <= 0 ? 0 : 1.0 / (white * white));
+      threads.push_back(new reinhardToneMapThread(this, inputData, outData, 
+                                                  begin * width, end * width));
    }
    
-   { // scale luminance, convert back to RGB, and perform gamma correction
-      const real_t scale = (key <= 0 ? 0 : exposure / key);
-      const real_t gamma = 2.22;
-      const real_t correction = 1.0 / gamma;
+   // note: the last block is always processed on the calling thread
+   reinhardToneMapThread *last = threads.back();
+   
+   real_t logSum = 0, maxLuminance = 0;
+   
+   { // compute image key and maximum luminance via a parallel reduction
+      for(unsigned i = 0; i + 1 < noThreads; ++i)
+         threads[i]->start();
       
-      for(unsigned i = n; i--;) {
-         RgbaHDR &p = imageData[i];
-         Rgba32  &o = outData[i];
-         
-         const real_t lum = scale * p.g;
-         p.g = lum * (1.0 + lum * white) / (1.0 + lum);
-         
-         const RgbaHDR temp = p;
-         p.r = temp.g * (temp.r) / temp.b;
-         p.b = temp.g * (1 - temp.r - temp.b) / temp.b;
+      last->reduce();
+      
+      for(unsigned i = 0; i < noThreads; ++i) {
+         reinhardToneMapThread *thread = threads[i];
          
-         // note: this also works fairly well
-         //p.r *= p.g / old;
-         //p.b *= p.g / old;
+         if (thread != last)
+            while(!thread->wait());
          
-         // convert xyY to XYZ to RGB
-         //xyYtoXYZ(p.r, p.b, p.g, p.r, p.g, p.b);
-         XYZtoRGB(p.r, p.g, p.b, p.r, p.g, p.b);
+         logSum      += thread->m_logSum;
+         maxLuminance = MAX(maxLuminance, thread->m_maxLuminance);
+      }
+   }
+   
+   { // scale and compress luminance and encode for display
+      const real_t key   = exp(logSum / ((real_t)n));
+      const real_t scale = (key <= 0 ? 0 : m_exposure / key);
+      
+      // luminance (after exposure) which is mapped to pure white
+      const real_t whitePoint = 
+         (m_whitePoint > 0 ? m_whitePoint : scale * maxLuminance);
+      const real_t white = 
+         (whitePoint <= 0 ? 0 : 1.0 / (whitePoint * whitePoint));
+      
+      for(unsigned i = 0; i < noThreads; ++i) {
+         reinhardToneMapThread *thread = threads[i];
          
-         p.r = 255 * pow(p.r, correction);
-         p.g = 255 * pow(p.g, correction);
-         p.b = 255 * pow(p.b, correction);
+         thread->m_mapping = true;
+         thread->m_scale   = scale;
+         thread->m_white   = white;
          
-         o.r = (unsigned char) CLAMP(p.r, 0, 255);
-         o.g = (unsigned char) CLAMP(p.g, 0, 255);
-         o.b = (unsigned char) CLAMP(p.b, 0, 255);
-         o.a = 255;
+         if (thread != last)
+            thread->start();
       }
+      
+      last->map();
+      
+      for(unsigned i = 0; i + 1 < noThreads; ++i)
+         while(!threads[i]->wait());
+   }
+   
+   FOREACH(std::vector<reinhardToneMapThread *>::iterator, threads, iter) {
+      safeDelete(*iter);
    }
    
-   safeDelete(image);
    return out;
 }
 
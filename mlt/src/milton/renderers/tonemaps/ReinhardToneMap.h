@@ -6,6 +6,14 @@
    @brief
       A ToneMap converts radiance values stored in an HDRImage to displayable 
    sRGB pixels in an RgbaImage.
+      ReinhardToneMap implements the global operator from Reinhard et al., 
+   which scales luminance s.t. the image's log-average luminance (its key) 
+   maps to a given exposure and then compresses it s.t. a given white point 
+   maps to one.  Since chromaticity is preserved, this is equivalent to 
+   scaling each pixel's linear RGB by the ratio of its compressed to original 
+   luminance, s.t. no per-pixel color space conversions are needed.  Both 
+   the reduction which computes the image key and the mapping itself are 
+   performed in parallel over blocks of rows.
    
    @note for more info, see 
       Photographic Tone Reproduction for Digital Images. Reinhard et al, 2002
@@ -18,8 +26,22 @@
 
 namespace milton {
 
+class reinhardToneMapThread;
+
 class MILTON_DLL_EXPORT ReinhardToneMap : public ToneMap {
    public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline ReinhardToneMap()
+         : ToneMap(), m_exposure(0.18), m_whitePoint(0), m_noThreads(1)
+      { }
+      
+      virtual ~ReinhardToneMap()
+      { }
+      
+      
+      //@}-----------------------------------------------------------------
       ///@name Initialization
       //@{-----------------------------------------------------------------
       
@@ -27,7 +49,15 @@ class MILTON_DLL_EXPORT ReinhardToneMap : public ToneMap {
        * @brief
        *    Performs any initialization which may be necessary before using 
        * this ToneMap, including parsing user parameters from this ToneMap's 
-       * PropertyMap
+       * PropertyMap, which include (in addition to those parsed by 
+       * ToneMap::init): 
+       *    tonemapExposure   - luminance to which the image's key is mapped 
+       *                        (default 0.18) 
+       *    tonemapWhitePoint - smallest exposed luminance which is mapped to 
+       *                        pure white (defaults to the maximum exposed 
+       *                        luminance in the image) 
+       *    noRenderThreads   - number of threads to tonemap with (defaults 
+       *                        to the number of CPUs)
        */
       virtual void init();
       
@@ -40,6 +70,14 @@ class MILTON_DLL_EXPORT ReinhardToneMap : public ToneMap {
       
       
       //@}-----------------------------------------------------------------
+   
+   protected:
+      friend class reinhardToneMapThread;
+   
+   protected:
+      real_t   m_exposure;
+      real_t   m_whitePoint;
+      unsigned m_noThreads;
 };
 
 }
@@ -0,0 +1,549 @@
+/**<!-------------------------------------------------------------------->
+   @file   IrradianceCache.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Irradiance cache (Ward et al., 1988) which exploits the fact that 
+   indirect diffuse illumination generally varies slowly across surfaces by 
+   sparsely computing irradiance estimates via hemispherical sampling and 
+   interpolating between them elsewhere.
+   
+   @see IrradianceCache.h for more details
+   <!-------------------------------------------------------------------->**/
+
+#include "IrradianceCache.h"
+#include <materials/bsdfs/DiffuseBSDF.h>
+#include <SurfacePoint.h>
+#include <PropertyMap.h>
+#include <ShapeSet.h>
+#include <Camera.h>
+#include <Random.h>
+#include <Scene.h>
+#include <Ray.h>
+
+namespace milton {
+
+// maximum depth of the underlying octree
+#define IRRADIANCE_CACHE_MAX_DEPTH           (24)
+
+// maximum number of specular bounces followed from the camera when 
+// looking for surfaces at which to evaluate the cache during precompute
+#define IRRADIANCE_CACHE_MAX_SPECULAR_DEPTH  (8)
+
+// records further than this fraction of their radius of validity in front 
+// of a query point are ignored, since they may see occluders which the 
+// query point can't see (Ward et al., 1988)
+#define IRRADIANCE_CACHE_FRONT_TOLERANCE     (0.05)
+
+/// node in the singly-linked list of records stored at an octree node
+struct irradianceCacheEntry {
+   const IrradianceRecord *record;
+   irradianceCacheEntry   *next;
+};
+
+/**
+ * @brief 
+ *    Octree node, whose children and entries are only ever published 
+ * (atomically, after being fully initialized) and never modified or removed 
+ * while the cache is in use, s.t. lookups may proceed without locking
+ */
+struct irradianceCacheNode {
+   QAtomicPointer<irradianceCacheNode>  children[8];
+   QAtomicPointer<irradianceCacheEntry> entries;
+};
+
+/**
+ * @returns the current value of @p ptr with acquire semantics, pairing with 
+ *    the release in fetchAndStoreRelease s.t. lock-free readers observe the 
+ *    published node or entry fully initialized
+ */
+template <typename T>
+static inline T *irradianceCacheLoad(const QAtomicPointer<T> &ptr) {
+#if QT_VERSION >= 0x050000
+   return ptr.loadAcquire();
+#else
+   // Qt4 has no acquire load, so use an acquire read-modify-write of zero
+   return const_cast<QAtomicPointer<T> &>(ptr).fetchAndAddAcquire(0);
+#endif
+}
+
+/**
+ * @brief 
+ *    Worker thread which evaluates the cache at every stride'th row of the 
+ * image, starting at row 'offset' and skipping rows handled by the other 
+ * workers
+ * 
+ * @see IrradianceCache::precompute
+ */
+class irradianceCachePrecomputeThread : public QThread {
+   public:
+      inline irradianceCachePrecomputeThread(IrradianceCache *cache, 
+                                             Camera *camera, Scene *scene, 
+                                             IIrradianceSampler *sampler, 
+                                             unsigned width, unsigned height, 
+                                             unsigned stride, unsigned offset, 
+                                             unsigned noThreads)
+         : QThread(), m_cache(cache), m_camera(camera), m_scene(scene), 
+           m_sampler(sampler), m_width(width), m_height(height), 
+           m_stride(stride), m_offset(offset), m_noThreads(noThreads)
+      { }
+      
+      virtual ~irradianceCachePrecomputeThread()
+      { }
+      
+      virtual void run() {
+         Random::Generator generator(
+            Random::getSubstreamSeed(Random::s_seed, m_offset));
+         Random::Generator *oldGenerator = Random::getThreadGenerator();
+         Random::setThreadGenerator(&generator);
+         
+         const real_t invWidth  = 1.0 / m_width;
+         const real_t invHeight = 1.0 / m_height;
+         
+         for(unsigned y = m_offset * m_stride; y < m_height; 
+             y += m_noThreads * m_stride)
+         {
+            for(unsigned x = 0; x < m_width; x += m_stride) {
+               const Point2 pos((x + 0.5) * invWidth, (y + 0.5) * invHeight);
+               
+               m_cache->_precompute(m_camera->getWorldRay(pos), m_scene, 
+                                    m_sampler);
+            }
+         }
+         
+         Random::setThreadGenerator(oldGenerator);
+      }
+   
+   public:
+      IrradianceCache    *m_cache;
+      Camera             *m_camera;
+      Scene              *m_scene;
+      IIrradianceSampler *m_sampler;
+      unsigned            m_width;
+      unsigned            m_height;
+      unsigned            m_stride;
+      unsigned            m_offset;
+      unsigned            m_noThreads;
+};
+
+static void irradianceCacheDeleteNode(irradianceCacheNode *node) {
+   if (NULL == node)
+      return;
+   
+   for(unsigned i = 8; i--;)
+      irradianceCacheDeleteNode(node->children[i]);
+   
+   irradianceCacheEntry *entry = node->entries;
+   while(entry) {
+      irradianceCacheEntry *next = entry->next;
+      
+      delete entry;
+      entry = next;
+   }
+   
+   delete node;
+}
+
+/// @returns the bounds of child @p i of a node with the given bounds
+static inline AABB irradianceCacheGetChildBounds(const AABB &bounds, 
+                                                 unsigned i)
+{
+   const Point3 &center = bounds.getCenter();
+   AABB child;
+   
+   for(unsigned axis = 0; axis < 3; ++axis) {
+      if (i & (1 << axis)) {
+         child.min[axis] = center[axis];
+         child.max[axis] = bounds.max[axis];
+      } else {
+         child.min[axis] = bounds.min[axis];
+         child.max[axis] = center[axis];
+      }
+   }
+   
+   return child;
+}
+
+IrradianceCache::IrradianceCache(const AABB &bounds, real_t maxError, 
+                                 real_t minSpacing, real_t maxSpacing, 
+                                 unsigned noSamples)
+   : m_root(new irradianceCacheNode()), m_maxError(maxError), 
+     m_minSpacing(minSpacing), m_maxSpacing(MAX(minSpacing, maxSpacing)), 
+     m_size(0)
+{
+   ASSERT(bounds.isValid());
+   ASSERT(m_maxError > 0);
+   
+   // use a cube slightly larger than the given bounds s.t. points on the 
+   // boundary are contained
+   const Point3 &center  = bounds.getCenter();
+   const Vector3 &extent = bounds.getDiagonal();
+   const real_t halfSize = 
+      0.5 * MAX(extent[0], MAX(extent[1], extent[2])) * 1.01 + EPSILON;
+   
+   for(unsigned axis = 0; axis < 3; ++axis) {
+      m_bounds.min[axis] = center[axis] - halfSize;
+      m_bounds.max[axis] = center[axis] + halfSize;
+   }
+   
+   // Ward recommends using roughly pi times as many divisions in phi as in 
+   // theta
+   m_noThetaSamples = MAX(1u, 
+                          (unsigned) floor(sqrt(noSamples / M_PI) + 0.5));
+   m_noPhiSamples   = MAX(3u, 
+                          (unsigned) floor(M_PI * m_noThetaSamples + 0.5));
+}
+
+IrradianceCache::~IrradianceCache() {
+   irradianceCacheDeleteNode(m_root);
+   
+   FOREACH(std::vector<IrradianceRecord *>::iterator, m_records, iter) {
+      safeDelete(*iter);
+   }
+}
+
+IrradianceCache *IrradianceCache::create(PropertyMap &params, Scene *scene) {
+   ASSERT(scene && scene->getShapes());
+   
+   if (!params.getValue<bool>("irradianceCache", false))
+      return NULL;
+   
+   const AABB &bounds    = scene->getShapes()->getAABB();
+   const real_t diagonal = bounds.getDiagonal().getMagnitude();
+   
+   const real_t maxError   = 
+      params.getValue<real_t>("irradianceCacheError", 0.2);
+   const unsigned noSamples = 
+      params.getValue<unsigned>("irradianceCacheSamples", 256u);
+   const real_t minSpacing = 
+      params.getValue<real_t>("irradianceCacheMinSpacing", 0.0005 * diagonal);
+   const real_t maxSpacing = 
+      params.getValue<real_t>("irradianceCacheMaxSpacing", 0.1 * diagonal);
+   
+   return new IrradianceCache(bounds, MAX(maxError, EPSILON), 
+                              MAX(minSpacing, EPSILON), maxSpacing, 
+                              MAX(noSamples, 1u));
+}
+
+bool IrradianceCache::isApplicable(const SurfacePoint &pt) {
+   // irradiance is only meaningful for Lambertian surfaces, and the 
+   // DiffuseBSDF is one-sided
+   return (NULL != dynamic_cast<DiffuseBSDF*>(pt.bsdf) && 
+           pt.normal.dot(pt.bsdf->getWi()) < 0);
+}
+
+SpectralSampleSet IrradianceCache::evaluate(const Point3 &p, 
+                                            const Vector3 &n, 
+                                            IIrradianceSampler *sampler)
+{
+   SpectralSampleSet E;
+   
+   if (getIrradiance(p, n, E))
+      return E;
+   
+   // note: other threads may concurrently compute records in the same 
+   // region, which is harmless aside from the wasted work
+   IrradianceRecord record;
+   computeRecord(p, n, sampler, record);
+   
+   if (m_bounds.contains(p))
+      insert(record);
+   
+   return record.E;
+}
+
+bool IrradianceCache::getIrradiance(const Point3 &p, const Vector3 &n, 
+                                    SpectralSampleSet &outE) const
+{
+   if (!m_bounds.contains(p))
+      return false;
+   
+   const irradianceCacheNode *node = m_root;
+   AABB bounds = m_bounds;
+   SpectralSampleSet sum;
+   real_t sumWeights = 0;
+   
+   // visit every node along the path from the root to the leaf containing p
+   while(node) {
+      for(const irradianceCacheEntry *entry = 
+             irradianceCacheLoad(node->entries); entry; entry = entry->next)
+      {
+         const IrradianceRecord &record = *entry->record;
+         const Vector3 &d = p - record.position;
+         
+         // ignore records in front of p
+         if (0.5 * d.dot(n + record.normal) <
+             -IRRADIANCE_CACHE_FRONT_TOLERANCE * record.R)
+         {
+            continue;
+         }
+         
+         const real_t nDot  = n.dot(record.normal);
+         const real_t error = d.getMagnitude() / record.R + 
+            sqrt(MAX(0, 1 - nDot));
+         
+         if (error >= m_maxError)
+            continue;
+         
+         // extrapolate the record's irradiance to p and n via its gradients
+         const real_t   weight = 1.0 / MAX(error, EPSILON);
+         const Vector3 &axis   = record.normal.cross(n);
+         SpectralSampleSet E   = record.E;
+         
+         for(unsigned i = 0; i < 3; ++i) {
+            E += record.gradR[i] * axis[i];
+            E += record.gradT[i] * d[i];
+         }
+         
+         sum        += E * weight;
+         sumWeights += weight;
+      }
+      
+      // descend into the child containing p
+      const Point3 &center = bounds.getCenter();
+      unsigned child = 0;
+      
+      for(unsigned axis = 0; axis < 3; ++axis) {
+         if (p[axis] >= center[axis])
+            child |= (1 << axis);
+      }
+      
+      bounds = irradianceCacheGetChildBounds(bounds, child);
+      node   = irradianceCacheLoad(node->children[child]);
+   }
+   
+   if (sumWeights <= 0)
+      return false;
+   
+   outE = sum / sumWeights;
+   
+   // extrapolation may overshoot
+   for(unsigned i = outE.getN(); i--;)
+      outE[i].value = MAX(0, outE[i].value);
+   
+   return true;
+}
+
+void IrradianceCache::computeRecord(const Point3 &p, const Vector3 &n, 
+                                    IIrradianceSampler *sampler, 
+                                    IrradianceRecord &outRecord) const
+{
+   ASSERT(sampler);
+   
+   const unsigned M = m_noThetaSamples;
+   const unsigned N = m_noPhiSamples;
+   std::vector<SpectralSampleSet> L(M * N);
+   std::vector<real_t> r(M * N);
+   std::vector<real_t> sinTheta(M * N);
+   
+   Vector3 normal(n), U, V;
+   normal.getOrthonormalBasis(U, V);
+   
+   SpectralSampleSet E;
+   real_t invDistSum = 0;
+   
+   // stratified, cosine-weighted sampling of the hemisphere
+   for(unsigned j = 0; j < M; ++j) {
+      for(unsigned k = 0; k < N; ++k) {
+         const unsigned index = j * N + k;
+         const real_t sin2  = (j + Random::sample(0, 1)) / M;
+         const real_t phi   = 2 * M_PI * (k + Random::sample(0, 1)) / N;
+         const real_t sinT  = sqrt(sin2);
+         const Vector3 &dir = (U * cos(phi) + V * sin(phi)) * sinT + 
+            normal * sqrt(MAX(0, 1 - sin2));
+         
+         const real_t t = sampler->getIncidentRadiance(Ray(p, dir), L[index]);
+         
+         // clamp distances s.t. nearby occluders don't blow up gradients
+         r[index]        = MAX(t, m_minSpacing);
+         sinTheta[index] = MAX(sinT, EPSILON);
+         
+         if (t < INFINITY)
+            invDistSum += 1.0 / r[index];
+         
+         E += L[index];
+      }
+   }
+   
+   outRecord.position = p;
+   outRecord.normal   = n;
+   outRecord.E        = E * (M_PI / (M * N));
+   
+   // radius of validity is the harmonic mean distance to visible surfaces
+   outRecord.R = (invDistSum > 0 ? (M * N) / invDistSum : m_maxSpacing);
+   outRecord.R = CLAMP(outRecord.R, m_minSpacing, m_maxSpacing);
+   
+   // gradients (Ward and Heckbert, 1992)
+   for(unsigned i = 0; i < 3; ++i) {
+      outRecord.gradT[i] = SpectralSampleSet::black();
+      outRecord.gradR[i] = SpectralSampleSet::black();
+   }
+   
+   for(unsigned k = 0; k < N; ++k) {
+      const unsigned kPrev  = (k + N - 1) % N;
+      const real_t phi      = 2 * M_PI * (k + 0.5) / N;
+      const real_t phiMinus = 2 * M_PI * k / N;
+      
+      // u is the center direction of the k'th column of cells in the base 
+      // plane, v is perpendicular to it, and vMinus is perpendicular to the 
+      // boundary between columns k - 1 and k
+      const Vector3 &u      = U * cos(phi) + V * sin(phi);
+      const Vector3 &v      = V * cos(phi) - U * sin(phi);
+      const Vector3 &vMinus = V * cos(phiMinus) - U * sin(phiMinus);
+      
+      // change in irradiance across boundaries between cells in theta
+      SpectralSampleSet sumU;
+      for(unsigned j = 1; j < M; ++j) {
+         const real_t sin2 = (real_t) j / M;
+         const real_t minR = MIN(r[j * N + k], r[(j - 1) * N + k]);
+         
+         sumU += (L[j * N + k] - L[(j - 1) * N + k]) * 
+            (sqrt(sin2) * (1 - sin2) / minR);
+      }
+      
+      // change in irradiance across boundaries between cells in phi
+      SpectralSampleSet sumV;
+      for(unsigned j = 0; j < M; ++j) {
+         const real_t cosMinus = sqrt(1 - (real_t) j / M);
+         const real_t cosPlus  = sqrt(MAX(0, 1 - (real_t) (j + 1) / M));
+         const real_t minR     = MIN(r[j * N + k], r[j * N + kPrev]);
+         
+         sumV += (L[j * N + k] - L[j * N + kPrev]) * 
+            ((cosMinus - cosPlus) / (sinTheta[j * N + k] * minR));
+      }
+      
+      // change in irradiance as the normal rotates towards this column
+      SpectralSampleSet sumR;
+      for(unsigned j = 0; j < M; ++j) {
+         const real_t sin2 = (j + 0.5) / M;
+         
+         sumR += L[j * N + k] * sqrt(sin2 / (1 - sin2));
+      }
+      
+      for(unsigned i = 0; i < 3; ++i) {
+         outRecord.gradT[i] += sumU * (u[i] * 2 * M_PI / N);
+         outRecord.gradT[i] += sumV * vMinus[i];
+         outRecord.gradR[i] += sumR * (v[i] * M_PI / (M * N));
+      }
+   }
+}
+
+void IrradianceCache::insert(const IrradianceRecord &record) {
+   // records are only valid within m_maxError * R of their position
+   const real_t radius = m_maxError * record.R;
+   const Vector3 extent(radius, radius, radius);
+   AABB influence;
+   
+   influence.add(record.position - extent);
+   influence.add(record.position + extent);
+   
+   QMutexLocker lock(&m_mutex);
+   IrradianceRecord *copy = new IrradianceRecord(record);
+   m_records.push_back(copy);
+   
+   _insert(m_root, m_bounds, copy, influence, 0);
+   ++m_size;
+}
+
+void IrradianceCache::_insert(irradianceCacheNode *node, 
+                              const AABB &nodeBounds, 
+                              const IrradianceRecord *record, 
+                              const AABB &influence, unsigned depth)
+{
+   const real_t nodeSize = nodeBounds.max[0] - nodeBounds.min[0];
+   const real_t size     = influence.max[0] - influence.min[0];
+   
+   // store the record at the coarsest nodes comparable in size to its 
+   // region of influence
+   if (depth >= IRRADIANCE_CACHE_MAX_DEPTH || nodeSize < 2 * size) {
+      irradianceCacheEntry *entry = new irradianceCacheEntry();
+      entry->record = record;
+      entry->next   = node->entries;
+      
+      node->entries.fetchAndStoreRelease(entry);
+      return;
+   }
+   
+   for(unsigned i = 0; i < 8; ++i) {
+      const AABB &childBounds = irradianceCacheGetChildBounds(nodeBounds, i);
+      
+      if (!childBounds.intersects(influence))
+         continue;
+      
+      irradianceCacheNode *child = node->children[i];
+      if (NULL == child) {
+         child = new irradianceCacheNode();
+         
+         node->children[i].fetchAndStoreRelease(child);
+      }
+      
+      _insert(child, childBounds, record, influence, depth + 1);
+   }
+}
+
+void IrradianceCache::precompute(Camera *camera, Scene *scene, 
+                                 IIrradianceSampler *sampler, unsigned width, 
+                                 unsigned height, unsigned stride, 
+                                 unsigned noThreads)
+{
+   ASSERT(camera && scene && sampler);
+   stride    += (stride == 0);
+   noThreads += (noThreads == 0);
+   
+   std::vector<irradianceCachePrecomputeThread *> threads;
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      threads.push_back( 
+         new irradianceCachePrecomputeThread(this, camera, scene, sampler, 
+                                             width, height, stride, i, 
+                                             noThreads));
+   }
+   
+   if (noThreads == 1) {
+      threads[0]->run();
+   } else {
+      for(unsigned i = 0; i < noThreads; ++i)
+         threads[i]->start();
+   }
+   
+   for(unsigned i = 0; i < noThreads; ++i) {
+      while(!threads[i]->wait());
+      
+      safeDelete(threads[i]);
+   }
+}
+
+void IrradianceCache::_precompute(const Ray &ray, Scene *scene, 
+                                  IIrradianceSampler *sampler)
+{
+   Ray r = ray;
+   
+   for(unsigned depth = 0; depth < IRRADIANCE_CACHE_MAX_SPECULAR_DEPTH; 
+       ++depth)
+   {
+      SurfacePoint pt;
+      const real_t t = scene->getIntersection(r, pt);
+      
+      if (!pt.init(r, t))
+         return;
+      
+      if (!pt.bsdf->isSpecular()) {
+         if (isApplicable(pt))
+            evaluate(pt.position, pt.normalS, sampler);
+         
+         return;
+      }
+      
+      const Event &event = pt.bsdf->sample();
+      const Vector3 &wo  = event;
+      
+      if (wo == Vector3::zero())
+         return; // absorbed
+      
+      r = Ray(pt.position, wo);
+   }
+}
+
+}
+
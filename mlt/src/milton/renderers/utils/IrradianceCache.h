@@ -0,0 +1,248 @@
+/**<!-------------------------------------------------------------------->
+   @class  IrradianceCache
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Irradiance cache (Ward et al., 1988) which exploits the fact that 
+   indirect diffuse illumination generally varies slowly across surfaces by 
+   sparsely computing irradiance estimates via hemispherical sampling and 
+   interpolating between them elsewhere.  Each record stores the 
+   irradiance at a point along with its translational and rotational 
+   gradients (Ward and Heckbert, 1992), which are used to extrapolate the 
+   record's irradiance to nearby points and orientations, as well as its 
+   radius of validity, the harmonic mean distance to the surfaces seen 
+   from the record. 
+      Records are stored in an octree over the scene's bounds, where each 
+   record is inserted into every node overlapping its region of influence 
+   whose extent is comparable to it, s.t. a lookup only needs to visit the 
+   nodes along the path from the root to the leaf containing the query 
+   point.  The cache is populated lazily and shared between render threads; 
+   insertions are serialized, but nodes and records are never modified 
+   after being published, so lookups never block.
+   
+   @note
+      Irradiance is only meaningful for Lambertian surfaces, so the cache 
+   should only be used at points whose BSDF is a DiffuseBSDF (see 
+   isApplicable)
+   
+   @see IIrradianceSampler
+   @see "A Ray Tracing Solution for Diffuse Interreflection," Ward, Rubinstein, 
+      and Clear (1988)
+   @see "Irradiance Gradients," Ward and Heckbert (1992)
+   <!-------------------------------------------------------------------->**/
+
+#ifndef IRRADIANCE_CACHE_H_
+#define IRRADIANCE_CACHE_H_
+
+#include <common/common.h>
+#include <utils/SpectralSampleSet.h>
+#include <accel/AABB.h>
+#include <QtCore/QtCore>
+
+namespace milton {
+
+struct Ray;
+struct SurfacePoint;
+class  PropertyMap;
+class  Camera;
+class  Scene;
+struct irradianceCacheNode;
+
+/**
+ * @brief 
+ *    Interface to the renderer which estimates the radiance incident along 
+ * the hemispherical sampling rays used to compute new IrradianceCache 
+ * records
+ */
+class MILTON_DLL_EXPORT IIrradianceSampler {
+   public:
+      virtual ~IIrradianceSampler()
+      { }
+      
+      /**
+       * @brief 
+       *    Estimates the radiance incident to the origin of @p ray from its 
+       * direction, excluding any contributions which are accounted for 
+       * separately (eg. direct illumination)
+       * 
+       * @returns the distance to the first surface intersected along the 
+       *    given ray or INFINITY if none was intersected, and the incident 
+       *    radiance in @p outLi
+       * 
+       * @note must be thread-safe
+       */
+      virtual real_t getIncidentRadiance(const Ray &ray, 
+                                         SpectralSampleSet &outLi) = 0;
+};
+
+/// cached irradiance estimate
+struct MILTON_DLL_EXPORT IrradianceRecord {
+   Point3            position;
+   Vector3           normal;
+   SpectralSampleSet E;
+   
+   /// radius of validity (harmonic mean distance to visible surfaces)
+   real_t            R;
+   
+   /// translational and rotational gradients of E, where element i holds 
+   /// the partial derivatives w.r.t. the i'th world-space axis
+   SpectralSampleSet gradT[3];
+   SpectralSampleSet gradR[3];
+};
+
+class MILTON_DLL_EXPORT IrradianceCache {
+   public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @param bounds should contain all points at which the cache will be 
+       *    queried (eg. the scene's bounds)
+       * @param maxError is Ward's 'a' parameter, the maximum allowed error 
+       *    when interpolating records; smaller values yield more records
+       * @param minSpacing and @p maxSpacing clamp the radius of validity 
+       *    of records (in world units)
+       * @param noSamples is the approximate number of hemispherical 
+       *    sampling rays used to compute each new record
+       */
+      IrradianceCache(const AABB &bounds, real_t maxError, 
+                      real_t minSpacing, real_t maxSpacing, 
+                      unsigned noSamples);
+      
+      virtual ~IrradianceCache();
+      
+      /**
+       * @brief 
+       *    Creates an irradiance cache over the given scene's bounds 
+       * according to the following parameters, if 'irradianceCache' is 
+       * enabled:
+       *    irradianceCacheError      - Ward's 'a' parameter (default 0.2)
+       *    irradianceCacheSamples    - number of hemispherical samples per 
+       *                                record (default 256)
+       *    irradianceCacheMinSpacing - minimum radius of validity (defaults 
+       *                                to 0.05% of the scene's diagonal)
+       *    irradianceCacheMaxSpacing - maximum radius of validity (defaults 
+       *                                to 10% of the scene's diagonal)
+       * 
+       * @returns the new cache, or NULL if 'irradianceCache' is disabled
+       */
+      static IrradianceCache *create(PropertyMap &params, Scene *scene);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Interpolates the irradiance at the given point and surface 
+       * normal from all nearby records, computing and inserting a new 
+       * record via @p sampler if none are valid
+       * 
+       * @note thread-safe
+       */
+      SpectralSampleSet evaluate(const Point3 &p, const Vector3 &n, 
+                                 IIrradianceSampler *sampler);
+      
+      /**
+       * @brief 
+       *    Interpolates the irradiance at the given point and surface 
+       * normal from all nearby records
+       * 
+       * @returns whether or not any records were valid at the given point, 
+       *    and the interpolated irradiance in @p outE
+       * 
+       * @note thread-safe and lock-free
+       */
+      bool getIrradiance(const Point3 &p, const Vector3 &n, 
+                         SpectralSampleSet &outE) const;
+      
+      /**
+       * @brief 
+       *    Computes a new record at the given point and surface normal via 
+       * stratified hemispherical sampling
+       * 
+       * @note thread-safe
+       */
+      void computeRecord(const Point3 &p, const Vector3 &n, 
+                         IIrradianceSampler *sampler, 
+                         IrradianceRecord &outRecord) const;
+      
+      /**
+       * @brief 
+       *    Inserts a copy of the given record into this cache
+       * 
+       * @note thread-safe
+       */
+      void insert(const IrradianceRecord &record);
+      
+      /**
+       * @brief 
+       *    Populates this cache in parallel on @p noThreads threads before 
+       * rendering by evaluating the cache at the first non-specular surface 
+       * seen through every @p stride'th pixel in each dimension of a
+       * @p width by @p height image
+       */
+      void precompute(Camera *camera, Scene *scene, 
+                      IIrradianceSampler *sampler, unsigned width, 
+                      unsigned height, unsigned stride, unsigned noThreads);
+      
+      /**
+       * @returns whether or not the cache may be used to estimate 
+       *    reflected indirect illumination at the given point
+       */
+      static bool isApplicable(const SurfacePoint &pt);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      /// @returns the number of records stored in this cache
+      inline unsigned size() const {
+         return m_size;
+      }
+      
+      inline real_t getMaxError() const {
+         return m_maxError;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   protected:
+      void _insert(irradianceCacheNode *node, const AABB &nodeBounds, 
+                   const IrradianceRecord *record, const AABB &influence, 
+                   unsigned depth);
+      
+      /// evaluates the cache along the given primary ray during precompute
+      void _precompute(const Ray &ray, Scene *scene, 
+                       IIrradianceSampler *sampler);
+      
+      friend class irradianceCachePrecomputeThread;
+   
+   protected:
+      irradianceCacheNode *m_root;
+      AABB                 m_bounds;
+      
+      real_t               m_maxError;
+      real_t               m_minSpacing;
+      real_t               m_maxSpacing;
+      
+      /// number of stratified samples in theta and phi used per record
+      unsigned             m_noThetaSamples;
+      unsigned             m_noPhiSamples;
+      
+      /// records stored in the octree, which are owned by this cache
+      std::vector<IrradianceRecord *> m_records;
+      
+      /// serializes insertions
+      QMutex               m_mutex;
+      unsigned             m_size;
+};
+
+}
+
+#endif // IRRADIANCE_CACHE_H_
+
@@ -7,12 +7,16 @@
    @brief
       Photon tracer which traces paths of 'photons' from light sources 
    throughout the scene, terminating via Russian Roulette
+   
+   @see ProgressivePhotonMapper
    <!-------------------------------------------------------------------->**/
 
 #include "PhotonTracer.h"
 #include <renderers/utils/Path.h>
 #include <materials/BSDF.h>
-#include <QtCore>
+#include <QtCore/QtCore>
+
+namespace milton {
 
 void PhotonTracer::generateL(Path &light, 
                              const PhotonTracerParams &params) const
@@ -29,7 +33,9 @@ void PhotonTracer::generateL(Path &light,
          continue;
       
       const PathVertex &v = light.back();
-      if (params.caustic) {
+      if (params.unrestricted) {
+         continue;
+      } else if (params.caustic) {
          if (!v.bsdf->isSpecular())
             break;
       } else {
@@ -55,3 +61,5 @@ void PhotonTracer::generateL(Path &light,
                               boost::match_partial));
 }*/
 
+}
+
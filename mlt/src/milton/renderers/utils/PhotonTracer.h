@@ -3,53 +3,78 @@
    @author Travis Fischer (fisch0920@gmail.com)
    @author Matthew Jacobs (jacobs.mh@gmail.com)
    @date   Fall 2008
-
+   
    @brief
       Photon tracer which traces paths of 'photons' from light sources 
    throughout the scene, terminating via Russian Roulette
+   
+   @see ProgressivePhotonMapper
    <!-------------------------------------------------------------------->**/
 
 #ifndef PHOTON_TRACER_H_
 #define PHOTON_TRACER_H_
 
+#include <common/common.h>
 //#include <boost/regex.hpp>
 
+namespace milton {
+
 class Path;
 
-struct PhotonTracerParams {
+struct MILTON_DLL_EXPORT PhotonTracerParams {
    /*const boost::regex pathNotation;
    
    inline PhotonTracerParams(const std::string &pathNotation_)
       : pathNotation(pathNotation_)
    { }*/
    
+   /// whether to trace caustic (LS+D) or diffuse (LD+) photon paths
    bool caustic;
    
-   inline PhotonTracerParams(bool caustic_)
-      : caustic(caustic_)
+   /// whether to trace unrestricted photon paths (L(S|D)+), which are only 
+   /// terminated via Russian Roulette (overrides caustic)
+   bool unrestricted;
+   
+   inline PhotonTracerParams(bool caustic_, bool unrestricted_ = false)
+      : caustic(caustic_), unrestricted(unrestricted_)
    { }
 };
 
-class PhotonTracer {
+class MILTON_DLL_EXPORT PhotonTracer {
    public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline PhotonTracer()
+      { }
+      
+      virtual ~PhotonTracer()
+      { }
+      
+      
+      //@}-----------------------------------------------------------------
       ///@name Main usage interface
       //@{-----------------------------------------------------------------
       
       /**
-       * @brief
+       * @brief 
        *    Generates a light subpath which is assumed to start at an emitter, 
        * constrained by the given parameters
+       * 
+       * @note thread-safe
        */
       virtual void generateL(Path &light, 
                              const PhotonTracerParams &params) const;
       
       
       //@}-----------------------------------------------------------------
-      
+   
    protected:
       //virtual bool _isPotentialMatch(const boost::regex &e, 
       //                               const std::string &s) const;
 };
 
+}
+
 #endif // PHOTON_TRACER_H_
 
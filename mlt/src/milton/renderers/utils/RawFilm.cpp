@@ -0,0 +1,398 @@
+/**<!-------------------------------------------------------------------->
+   @file   RawFilm.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Linear (not tonemapped) film of a render, along with the sum of the 
+   reconstruction filter weights and the number of samples which 
+   contributed to each of its pixels.  Raw films may be tonemapped later on 
+   without re-rendering, and raw films written by independent renders of 
+   the same scene (eg. with different seeds) may be merged into a single, 
+   less noisy film by weighting each pixel by its filter weights.
+   <!-------------------------------------------------------------------->**/
+
+#include "RawFilm.h"
+
+#include <ResourceManager.h>
+#include <HDRUtils.h>
+#include <HDRImage.h>
+#include <cctype>
+
+#ifdef HAVE_OPENEXR
+#  include <ImfChannelList.h>
+#  include <ImfFrameBuffer.h>
+#  include <ImfOutputFile.h>
+#  include <ImfInputFile.h>
+#  include <ImfHeader.h>
+#endif
+
+using namespace std;
+
+namespace milton {
+
+/// @returns the lowercase extension of @p fileName (without the '.')
+static std::string rawFilmGetExtension(const std::string &fileName) {
+   const size_t ext   = fileName.rfind('.');
+   const size_t slash = fileName.find_last_of("/\\");
+   
+   if (ext == std::string::npos || (slash != std::string::npos && ext < slash))
+      return "";
+   
+   std::string suffix = fileName.substr(ext + 1);
+   for(unsigned i = suffix.size(); i--;)
+      suffix[i] = (char) std::tolower(suffix[i]);
+   
+   return suffix;
+}
+
+/// @returns @p fileName without its extension
+static std::string rawFilmGetStem(const std::string &fileName) {
+   const std::string &ext = rawFilmGetExtension(fileName);
+   
+   if (ext.empty())
+      return fileName;
+   
+   return fileName.substr(0, fileName.size() - ext.size() - 1);
+}
+
+#ifdef HAVE_OPENEXR
+static bool rawFilmSaveEXR(const std::string &fileName, 
+                           const HDRImage *image, const real_t *weights, 
+                           const unsigned long *noSamples)
+{
+   const unsigned width  = image->getWidth();
+   const unsigned height = image->getHeight();
+   
+   std::vector<float>    rgb(3 * width);
+   std::vector<float>    weight(width);
+   std::vector<unsigned> samples(width);
+   
+   try {
+      Imf::Header header(width, height);
+      header.channels().insert("R",       Imf::Channel(Imf::FLOAT));
+      header.channels().insert("G",       Imf::Channel(Imf::FLOAT));
+      header.channels().insert("B",       Imf::Channel(Imf::FLOAT));
+      header.channels().insert("weight",  Imf::Channel(Imf::FLOAT));
+      header.channels().insert("samples", Imf::Channel(Imf::UINT));
+      
+      Imf::OutputFile file(fileName.c_str(), header);
+      
+      // a y stride of zero maps every scanline onto the same row buffers, 
+      // s.t. the film may be written one scanline at a time
+      Imf::FrameBuffer frameBuffer;
+      frameBuffer.insert("R", Imf::Slice(Imf::FLOAT, (char *) &rgb[0], 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, (char *) &rgb[1], 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, (char *) &rgb[2], 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("weight",  Imf::Slice(Imf::FLOAT, 
+                                               (char *) &weight[0], 
+                                               sizeof(float), 0));
+      frameBuffer.insert("samples", Imf::Slice(Imf::UINT, 
+                                               (char *) &samples[0], 
+                                               sizeof(unsigned), 0));
+      file.setFrameBuffer(frameBuffer);
+      
+      for(unsigned i = 0; i < height; ++i) {
+         const RgbaHDR *row = (*image)[i];
+         const unsigned offset = i * width;
+         
+         for(unsigned j = width; j--;) {
+            rgb[3 * j + 0] = static_cast<float>(row[j].r);
+            rgb[3 * j + 1] = static_cast<float>(row[j].g);
+            rgb[3 * j + 2] = static_cast<float>(row[j].b);
+            
+            weight[j]  = static_cast<float>(weights[offset + j]);
+            samples[j] = static_cast<unsigned>(noSamples[offset + j]);
+         }
+         
+         file.writePixels(1);
+      }
+   } catch(const std::exception &e) {
+      ResourceManager::log.error << "error writing raw film '" << fileName
+         << "': " << e.what() << endl;
+      
+      return false;
+   }
+   
+   return true;
+}
+
+static bool rawFilmLoadEXR(const std::string &fileName, HDRImage *&image, 
+                           std::vector<real_t> &outWeights, 
+                           std::vector<unsigned long> &outNoSamples)
+{
+   try {
+      Imf::InputFile file(fileName.c_str());
+      const Imath::Box2i &window = file.header().dataWindow();
+      const unsigned width  = window.max.x - window.min.x + 1;
+      const unsigned height = window.max.y - window.min.y + 1;
+      
+      std::vector<float>    rgb(3 * width);
+      std::vector<float>    weight(width);
+      std::vector<unsigned> samples(width);
+      
+      // slices are addressed relative to the data window's origin, and a 
+      // y stride of zero maps every scanline onto the same row buffers
+      const long x = window.min.x;
+      
+      Imf::FrameBuffer frameBuffer;
+      frameBuffer.insert("R", Imf::Slice(Imf::FLOAT, 
+                                         (char *) (&rgb[0] - 3 * x), 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, 
+                                         (char *) (&rgb[1] - 3 * x), 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, 
+                                         (char *) (&rgb[2] - 3 * x), 
+                                         3 * sizeof(float), 0));
+      frameBuffer.insert("weight",  Imf::Slice(Imf::FLOAT, 
+                                               (char *) (&weight[0] - x), 
+                                               sizeof(float), 0));
+      frameBuffer.insert("samples", Imf::Slice(Imf::UINT, 
+                                               (char *) (&samples[0] - x), 
+                                               sizeof(unsigned), 0));
+      file.setFrameBuffer(frameBuffer);
+      
+      image = new HDRImage(width, height);
+      outWeights.resize(width * height);
+      outNoSamples.resize(width * height);
+      
+      for(unsigned i = 0; i < height; ++i) {
+         file.readPixels(window.min.y + i);
+         
+         RgbaHDR *row = (*image)[i];
+         const unsigned offset = i * width;
+         
+         for(unsigned j = width; j--;) {
+            row[j] = RgbaHDR(rgb[3 * j + 0], rgb[3 * j + 1], rgb[3 * j + 2]);
+            
+            outWeights  [offset + j] = weight[j];
+            outNoSamples[offset + j] = samples[j];
+         }
+      }
+   } catch(const std::exception &e) {
+      ResourceManager::log.error << "error reading raw film '" << fileName
+         << "': " << e.what() << endl;
+      
+      safeDelete(image);
+      return false;
+   }
+   
+   return true;
+}
+#endif
+
+RawFilm::~RawFilm() {
+   safeDelete(m_image);
+}
+
+bool RawFilm::save(const std::string &fileName, const HDRImage *image, 
+                   const real_t *weights, const unsigned long *noSamples)
+{
+   ASSERT(image);
+   ASSERT(weights);
+   ASSERT(noSamples);
+   
+   const std::string &ext = rawFilmGetExtension(fileName);
+   
+   if (ext == "exr") {
+#ifdef HAVE_OPENEXR
+      return rawFilmSaveEXR(fileName, image, weights, noSamples);
+#else
+      const std::string &pfmFileName = rawFilmGetStem(fileName) + ".pfm";
+      
+      ResourceManager::log.warning << "this build of Milton does not "
+         << "support OpenEXR; writing raw film to '" << pfmFileName
+         << "' instead" << endl;
+      
+      return RawFilm::save(pfmFileName, image, weights, noSamples);
+#endif
+   }
+   
+   const unsigned width  = image->getWidth();
+   const unsigned height = image->getHeight();
+   HDRScanlineWriter film, aux;
+   
+   // weights and sample counts are always stored losslessly as PFM
+   if (!film.open(fileName, width, height, 
+                  (ext == "hdr" || ext == "rgbe" ? 
+                   HDRScanlineWriter::HDR_FORMAT_RGBE :
+                   HDRScanlineWriter::HDR_FORMAT_PFM)) || 
+       !aux.open(RawFilm::getWeightsFileName(fileName), width, height, 
+                 HDRScanlineWriter::HDR_FORMAT_PFM))
+   {
+      return false;
+   }
+   
+   std::vector<RgbaHDR> row(width);
+   
+   for(unsigned i = 0; i < height; ++i) {
+      const unsigned offset = i * width;
+      
+      for(unsigned j = width; j--;) {
+         row[j] = RgbaHDR(weights[offset + j], 
+                          (real_t) noSamples[offset + j], 0);
+      }
+      
+      film.writeScanline(i, (*image)[i]);
+      aux.writeScanline(i, &row[0]);
+   }
+   
+   const bool success = film.close();
+   return (aux.close() && success);
+}
+
+bool RawFilm::save(const std::string &fileName) const {
+   if (NULL == m_image)
+      return false;
+   
+   return RawFilm::save(fileName, m_image, &m_weights[0], &m_noSamples[0]);
+}
+
+RawFilm *RawFilm::load(const std::string &fileName) {
+   const std::string &ext = rawFilmGetExtension(fileName);
+   HDRImage *image = NULL;
+   RawFilm  *film  = NULL;
+   std::vector<real_t>        weights;
+   std::vector<unsigned long> noSamples;
+   bool hasWeights = false;
+   
+   if (ext == "exr") {
+#ifdef HAVE_OPENEXR
+      if (rawFilmLoadEXR(fileName, image, weights, noSamples)) {
+         film       = new RawFilm();
+         hasWeights = true;
+      }
+#else
+      ResourceManager::log.error << "this build of Milton does not "
+         << "support OpenEXR; unable to load raw film '" << fileName
+         << "'" << endl;
+#endif
+   } else {
+      image = (ext == "hdr" || ext == "rgbe" ? 
+               HDRUtils::loadHDR(fileName) : HDRUtils::loadPFM(fileName));
+      
+      if (image) {
+         const unsigned size = image->getSize();
+         HDRImage *aux = 
+            HDRUtils::loadPFM(RawFilm::getWeightsFileName(fileName));
+         
+         weights.resize(size, 0);
+         noSamples.resize(size, 0);
+         
+         if (aux && aux->getWidth()  == image->getWidth() && 
+             aux->getHeight() == image->getHeight())
+         {
+            const RgbaHDR *data = aux->getData();
+            
+            for(unsigned i = size; i--;) {
+               weights[i]   = data[i].r;
+               noSamples[i] = (unsigned long) (data[i].g + 0.5);
+            }
+            
+            hasWeights = true;
+         } else {
+            ResourceManager::log.warning << "raw film '" << fileName
+               << "' has no weights; it will be merged with the mean weight "
+               << "of the films which do" << endl;
+         }
+         
+         safeDelete(aux);
+         film = new RawFilm();
+      }
+   }
+   
+   if (NULL == film || NULL == image) {
+      safeDelete(film);
+      safeDelete(image);
+      
+      return NULL;
+   }
+   
+   film->m_image      = image;
+   film->m_noFilms    = 1;
+   film->m_hasWeights = hasWeights;
+   film->m_weights.swap(weights);
+   film->m_noSamples.swap(noSamples);
+   
+   return film;
+}
+
+bool RawFilm::merge(const RawFilm &film) {
+   if (NULL == film.m_image)
+      return false;
+   
+   if (NULL == m_image) {
+      m_image     = new HDRImage(*film.m_image);
+      m_weights   = film.m_weights;
+      m_noSamples = film.m_noSamples;
+      m_noFilms   = film.m_noFilms;
+      
+      m_hasWeights = film.m_hasWeights;
+      return true;
+   }
+   
+   if (m_image->getWidth()  != film.m_image->getWidth() || 
+       m_image->getHeight() != film.m_image->getHeight())
+   {
+      return false;
+   }
+   
+   RgbaHDR *dest = m_image->getData();
+   const RgbaHDR *src = film.m_image->getData();
+   const unsigned size = m_image->getSize();
+   
+   // a film without weights is weighted uniformly by the mean weight per 
+   // film of the other film (zero if neither has weights)
+   real_t w0Default = 0, w1Default = 0;
+   
+   if (m_hasWeights != film.m_hasWeights) {
+      const RawFilm &weighted = (m_hasWeights ? *this : film);
+      real_t sum = 0;
+      
+      for(unsigned i = size; i--;)
+         sum += weighted.m_weights[i];
+      
+      const real_t mean = sum / (size * weighted.m_noFilms);
+      
+      if (m_hasWeights)
+         w1Default = mean * film.m_noFilms;
+      else 
+         w0Default = mean * m_noFilms;
+   }
+   
+   for(unsigned i = size; i--;) {
+      const real_t w0 = (m_hasWeights ? m_weights[i] : w0Default);
+      const real_t w1 = (film.m_hasWeights ? film.m_weights[i] : w1Default);
+      real_t a, b;
+      
+      if (w0 + w1 > 0) {
+         a = w0 / (w0 + w1);
+         b = w1 / (w0 + w1);
+      } else {
+         a = ((real_t) m_noFilms) / (m_noFilms + film.m_noFilms);
+         b = ((real_t) film.m_noFilms) / (m_noFilms + film.m_noFilms);
+      }
+      
+      dest[i] = RgbaHDR(dest[i].r * a + src[i].r * b, 
+                        dest[i].g * a + src[i].g * b, 
+                        dest[i].b * a + src[i].b * b);
+      
+      m_weights[i]    = w0 + w1;
+      m_noSamples[i] += film.m_noSamples[i];
+   }
+   
+   m_noFilms    += film.m_noFilms;
+   m_hasWeights |= film.m_hasWeights;
+   return true;
+}
+
+std::string RawFilm::getWeightsFileName(const std::string &fileName) {
+   return rawFilmGetStem(fileName) + ".weights.pfm";
+}
+
+}
+
@@ -0,0 +1,145 @@
+/**<!-------------------------------------------------------------------->
+   @class  RawFilm
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Linear (not tonemapped) film of a render, along with the sum of the 
+   reconstruction filter weights and the number of samples which 
+   contributed to each of its pixels.  Raw films may be tonemapped later on 
+   without re-rendering, and raw films written by independent renders of 
+   the same scene (eg. with different seeds) may be merged into a single, 
+   less noisy film by weighting each pixel by its filter weights. 
+      Raw films are stored in a single OpenEXR file with R, G, B, 'weight', 
+   and 'samples' channels if an '.exr' file is requested and OpenEXR is 
+   available.  Otherwise, the linear film is stored in the requested PFM 
+   or HDR file, and the weights and sample counts are stored in the red and 
+   green channels of a companion PFM file (see getWeightsFileName).
+   
+   @note
+      Films are written one scanline at a time, s.t. saving a film never 
+   requires a second full-resolution copy of it
+   <!-------------------------------------------------------------------->**/
+
+#ifndef RAW_FILM_H_
+#define RAW_FILM_H_
+
+#include <common/common.h>
+#include <string>
+#include <vector>
+
+namespace milton {
+
+class HDRImage;
+
+class MILTON_DLL_EXPORT RawFilm {
+   public:
+      ///@name Constructors
+      //@{-----------------------------------------------------------------
+      
+      inline RawFilm()
+         : m_image(NULL), m_noFilms(0), m_hasWeights(false)
+      { }
+      
+      virtual ~RawFilm();
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Writes the given linear film, filter weights, and per-pixel 
+       * sample counts (both in row-major order) to @p fileName, whose 
+       * extension determines the format ('exr', 'pfm', or 'hdr')
+       * 
+       * @note if OpenEXR isn't available, '.exr' films are written as PFM 
+       *    instead
+       * @returns whether or not the film was written successfully
+       */
+      static bool save(const std::string &fileName, const HDRImage *image, 
+                       const real_t *weights, 
+                       const unsigned long *noSamples);
+      
+      /// writes this film to @p fileName (see above)
+      bool save(const std::string &fileName) const;
+      
+      /**
+       * @returns the raw film stored in @p fileName, which is owned by the 
+       *    caller, or NULL if it couldn't be loaded
+       * 
+       * @note films without weights (eg. plain HDR images) are loaded with 
+       *    zero weights and hasWeights returns false for them (see merge)
+       */
+      static RawFilm *load(const std::string &fileName);
+      
+      /**
+       * @brief 
+       *    Merges the given film of the same dimensions into this one, s.t. 
+       * each pixel becomes the filter-weighted average of both films' 
+       * pixels, and weights and sample counts are accumulated
+       * 
+       * @note if only one of the films has weights, every pixel of the 
+       *    other is weighted by the mean weight per film of the one which 
+       *    does, s.t. films without weights neither dominate nor vanish
+       * @note pixels without any weight in either film are averaged with 
+       *    respect to the number of films merged into each
+       * @returns whether or not the films' dimensions matched
+       */
+      bool merge(const RawFilm &film);
+      
+      /**
+       * @returns the companion PFM file in which the weights and sample 
+       *    counts of a raw film stored in @p fileName are stored if it isn't 
+       *    an OpenEXR file
+       */
+      static std::string getWeightsFileName(const std::string &fileName);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Accessors
+      //@{-----------------------------------------------------------------
+      
+      inline const HDRImage *getImage() const {
+         return m_image;
+      }
+      
+      inline const std::vector<real_t> &getWeights() const {
+         return m_weights;
+      }
+      
+      inline const std::vector<unsigned long> &getNoSamples() const {
+         return m_noSamples;
+      }
+      
+      /// @returns whether or not this film's filter weights are known
+      inline bool hasWeights() const {
+         return m_hasWeights;
+      }
+      
+      
+      //@}-----------------------------------------------------------------
+   
+   private:
+      // films own their underlying image and may not be copied
+      RawFilm(const RawFilm &);
+      RawFilm &operator=(const RawFilm &);
+   
+   protected:
+      HDRImage                  *m_image;
+      std::vector<real_t>        m_weights;
+      std::vector<unsigned long> m_noSamples;
+      
+      /// number of films which have been merged into this one
+      unsigned                   m_noFilms;
+      
+      /// whether or not m_weights holds filter weights (false for films 
+      /// loaded without them, whose weights are all zero)
+      bool                       m_hasWeights;
+};
+
+}
+
+#endif // RAW_FILM_H_
+
@@ -94,23 +94,19 @@ void Blob::preview() {
 real_t Blob::getIntersection(const Ray &ray, SurfacePoint &pt) {
    ASSERT(m_mesh);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   return m_mesh->getIntersection(Ray(P, D), pt);
+   return m_mesh->getIntersection(rObj, pt);
 }
 
 bool Blob::intersects(const Ray &ray, real_t tMax) {
    ASSERT(m_mesh);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   return m_mesh->intersects(Ray(P, D), tMax);
+   return m_mesh->intersects(rObj, tMax);
 }
 
 real_t Blob::evaluate(const Point3 &pt) const {
@@ -10,6 +10,12 @@
 #include "InstancedShape.h"
 #include <SurfacePoint.h>
 #include <Material.h>
+#include <SpatialAccel.h>
+#include <ResourceManager.h>
+#include <Mesh.h>
+#include <Random.h>
+#include <algorithm>
+using namespace std;
 
 namespace milton {
 
@@ -32,6 +38,25 @@ void InstancedShape::init() {
       // even knowing
       m_transToWorld    = m_transToWorld * trans->getTransToWorldInv();
       m_transToWorldInv = trans->getTransToWorld() * m_transToWorldInv;
+      
+      // collapse both levels of transformation s.t. rays may skip the 
+      // instancee and go straight to its accel (if any)
+      m_accel           = trans->getSpatialAccel();
+      m_transToAccel    = trans->getTransToAccel() * m_transToWorldInv;
+   } else {
+      m_objSpaceAABB = m_instancee->getAABB();
+   }
+   
+   Transformable::init();
+}
+
+void InstancedShape::update() {
+   ASSERT(m_instancee);
+   
+   if (m_instancee->isTransformable()) {
+      Transformable *trans = dynamic_cast<Transformable*>(m_instancee);
+      m_objSpaceAABB    = trans->getObjSpaceAABB();
+      m_accel           = trans->getSpatialAccel();
    } else {
       m_objSpaceAABB = m_instancee->getAABB();
    }
@@ -40,11 +65,20 @@ void InstancedShape::init() {
 }
 
 real_t InstancedShape::getIntersection(const Ray &ray, SurfacePoint &pt) {
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   real_t t;
    
-   const real_t t = m_instancee->getIntersection(Ray(P, D), pt);
+   if (m_accel) {
+      rObj.origin    = m_transToAccel * ray.origin;
+      rObj.direction = m_transToAccel * ray.direction;
+      rObj.invDir    = rObj.direction.getReciprocal();
+      
+      t = m_accel->getIntersection(rObj, pt);
+   } else {
+      _transformRayWorldToObj(ray, rObj);
+      
+      t = m_instancee->getIntersection(rObj, pt);
+   }
    
    if (Ray::isValid(t))
       pt.shape = this;
@@ -53,11 +87,18 @@ real_t InstancedShape::getIntersection(const Ray &ray, SurfacePoint &pt) {
 }
 
 bool InstancedShape::intersects(const Ray &ray, real_t tMax) {
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   
+   if (m_accel) {
+      rObj.origin    = m_transToAccel * ray.origin;
+      rObj.direction = m_transToAccel * ray.direction;
+      rObj.invDir    = rObj.direction.getReciprocal();
+      
+      return m_accel->intersects(rObj, tMax);
+   }
    
-   return m_instancee->intersects(Ray(P, D), tMax);
+   _transformRayWorldToObj(ray, rObj);
+   return m_instancee->intersects(rObj, tMax);
 }
 
 bool InstancedShape::hasNormal() const {
@@ -71,9 +112,64 @@ void InstancedShape::preview() {
 }
 
 void InstancedShape::getRandomPoint(SurfacePoint &pt) {
-   m_instancee->getRandomPoint(pt);
+   if (m_areaCDF.empty()) {
+      m_instancee->getRandomPoint(pt);
+      
+      _initInstancedPoint(pt);
+      return;
+   }
+   
+   // choose a triangle of the instanced mesh proportionally to its 
+   // world-space area, and then a point uniformly within that triangle
+   Mesh *mesh = static_cast<Mesh*>(m_instancee);
+   const real_t u1 = Random::sample(0, 1);
+   const real_t u2 = Random::sample(0, 1);
+   const real_t u3 = Random::sample(0, 1);
+   
+   const unsigned index = MIN((unsigned) (std::upper_bound(
+      m_areaCDF.begin(), m_areaCDF.end(), u1 * m_areaCDF.back()) - 
+      m_areaCDF.begin()), (unsigned) m_areaCDF.size() - 1);
+   
+   unsigned nTriangles = 0;
+   const MeshTriangle &t  = mesh->getTriangles(nTriangles)[index];
+   const Vertex *vertices = mesh->getVertices();
+   ASSERT(index < nTriangles);
+   
+   const real_t su = sqrt(u2);
+   const real_t b1 = 1 - su, b2 = u3 * su, b3 = 1 - b1 - b2;
+   const Vertex &p = 
+      vertices[t.A] * b1 + vertices[t.B] * b2 + vertices[t.C] * b3;
    
-   pt.shape = this;
+   // the instancee's normals and UVs expect its own world space
+   pt.index    = index;
+   pt.uv       = UV(u2, u3);
+   pt.position = mesh->getTransToWorld() * Point3(p.data);
+   
+   m_instancee->_getUV(pt);
+   
+   if ((pt.normal.hasNormal = m_instancee->hasNormal()))
+      m_instancee->_getGeometricNormal(pt);
+   
+   _initInstancedPoint(pt);
+}
+
+void InstancedShape::getPoint(SurfacePoint &pt, const UV &uv) {
+   m_instancee->getPoint(pt, uv);
+   
+   _initInstancedPoint(pt);
+}
+
+void InstancedShape::_initInstancedPoint(SurfacePoint &pt) {
+   ASSERT(m_material);
+   
+   pt.shape    = this;
+   pt.position = m_transToWorld * pt.position;
+   
+   if (pt.normal.hasNormal)
+      _transformVector3ObjToWorld(pt.normalG, pt.normalG);
+   
+   // fill in material properties (bsdf, emitter, normalS)
+   m_material->initSurfacePoint(pt);
 }
 
 Point3 InstancedShape::getPosition(const UV &uv) {
@@ -83,9 +179,63 @@ Point3 InstancedShape::getPosition(const UV &uv) {
 }
 
 real_t InstancedShape::_getSurfaceArea() {
-   // TODO: this is probably incorrect for world-space surface area!!!
+   Mesh *mesh = dynamic_cast<Mesh*>(m_instancee);
+   
+   if (mesh) {
+      // sum the areas of the instancee's triangles in world space, which is 
+      // exact under arbitrary (including non-uniform) scaling, recording 
+      // their running sum for getRandomPoint; note this is only computed 
+      // when this instance is (re)initialized (see Shape::init)
+      const Matrix4x4 &trans = m_transToWorld * mesh->getTransToWorld();
+      const Vertex *vertices = mesh->getVertices();
+      unsigned nTriangles = 0;
+      const MeshTriangle *triangles = mesh->getTriangles(nTriangles);
+      real_t area = 0;
+      
+      m_areaCDF.resize(nTriangles);
+      
+      for(unsigned i = 0; i < nTriangles; ++i) {
+         const MeshTriangle &t = triangles[i];
+         
+         const Vertex &v1 = trans * vertices[t.A];
+         const Vertex &v2 = trans * vertices[t.B];
+         const Vertex &v3 = trans * vertices[t.C];
+         
+         area += (v2 - v1).cross(v3 - v1).getMagnitude();
+         m_areaCDF[i] = area;
+      }
+      
+      // fall back to sampling via the instancee if the mesh is degenerate
+      if (!(area > 0))
+         m_areaCDF.clear();
+      
+      return 0.5 * area;
+   }
+   
+   // otherwise, scale the instancee's area by the areal scale factor of the 
+   // instance transform, which is exact for rotations, translations, and 
+   // uniform scales, but only approximate under non-uniform scaling
+   const real_t det = fabs(m_transToWorld.getDeterminant());
+   
+   { // points sampled via the instancee won't be uniform in world space 
+     // either if the transform's axes differ in length or aren't orthogonal
+      const Vector3 &x = m_transToWorld * Vector3(1, 0, 0);
+      const Vector3 &y = m_transToWorld * Vector3(0, 1, 0);
+      const Vector3 &z = m_transToWorld * Vector3(0, 0, 1);
+      const real_t s   = x.getMagnitude2();
+      
+      if (fabs(y.getMagnitude2() - s) > 1e-4 * s || 
+          fabs(z.getMagnitude2() - s) > 1e-4 * s || 
+          fabs(x.dot(y)) > 1e-4 * s || fabs(y.dot(z)) > 1e-4 * s || 
+          fabs(z.dot(x)) > 1e-4 * s)
+      {
+         ResourceManager::log.warning << "InstancedShape: non-uniformly "
+            << "scaled instances of shapes other than meshes are only "
+            << "sampled approximately uniformly by area" << endl;
+      }
+   }
    
-   return m_instancee->_getSurfaceArea();
+   return m_instancee->_getSurfaceArea() * pow(det, 2.0 / 3.0);
 }
 
 void InstancedShape::initSurfacePoint(SurfacePoint &pt) const {
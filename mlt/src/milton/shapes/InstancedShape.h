@@ -11,6 +11,7 @@
 #define INSTANCED_SHAPE_H_
 
 #include <shapes/Transformable.h>
+#include <vector>
 
 namespace milton {
 
@@ -20,7 +21,18 @@ class MILTON_DLL_EXPORT InstancedShape : public Transformable {
       //@{-----------------------------------------------------------------
       
       inline InstancedShape(Shape *instancee = NULL)
-         : Transformable(), m_instancee(instancee)
+         : Transformable(), m_instancee(instancee), m_accel(NULL)
+      { }
+      
+      /**
+       * @brief
+       *    Instances a shape whose lifetime is shared between all of its 
+       * instances (ex. a cached Mesh from ResourceManager::getMesh); the 
+       * instancee will be freed once its last reference goes away
+       */
+      inline InstancedShape(const ShapePtr &instancee)
+         : Transformable(), m_instancee(instancee.get()), 
+           m_instanceeRef(instancee), m_accel(NULL)
       { }
       
       virtual ~InstancedShape()
@@ -35,9 +47,24 @@ class MILTON_DLL_EXPORT InstancedShape : public Transformable {
        * @brief
        *    Initializes this InstancedShape, assuming the underlying instancee 
        * has already been initialized
+       * 
+       * @note composes this instance's transform with the instancee's, and 
+       *    so must only be called once; see update for refreshing an 
+       *    instance after its instancee has changed
        */
       virtual void init();
       
+      /**
+       * @brief
+       *    Refreshes this instance's bounds (and surface area) after the 
+       * geometry of its already initialized instancee has been updated in 
+       * place (e.g., via Mesh::update), leaving its transforms untouched
+       * 
+       * @note any SpatialAccel containing this instance must be updated 
+       *    afterwards as well (see SpatialAccel::update)
+       */
+      void update();
+      
       
       //@}-----------------------------------------------------------------
       ///@name Main usage interface
@@ -98,9 +125,19 @@ class MILTON_DLL_EXPORT InstancedShape : public Transformable {
        *    shape in 'pt'
        * @note the probability density of selecting this point is assumed to 
        *    be (1.0 / getSurfaceArea())
+       * @note instances of meshes are sampled uniformly w.r.t. world-space 
+       *    area under arbitrary transformations; other instancees are 
+       *    sampled via the instancee, which is only uniform in world space 
+       *    if this instance's transformation doesn't scale non-uniformly
        */
       virtual void getRandomPoint(SurfacePoint &pt);
       
+      /**
+       * @returns the point on the surface of this shape corresponding to the 
+       *    given UV coordinates in 'pt'
+       */
+      virtual void getPoint(SurfacePoint &pt, const UV &uv);
+      
       /**
        * @returns the point on the surface of this shape corresponding to the 
        *    given UV coordinates
@@ -114,16 +151,54 @@ class MILTON_DLL_EXPORT InstancedShape : public Transformable {
       
       virtual void initSurfacePoint(SurfacePoint &pt) const;
       
+      
+      //@}-----------------------------------------------------------------
+      ///@name Two-level hierarchy support
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @returns the instancee's underlying SpatialAccel if the instancee 
+       *    is a Mesh (or an instance thereof), s.t. rays may be transformed 
+       *    directly from world space into the instancee's object space
+       */
+      virtual SpatialAccel *getSpatialAccel() const {
+         return m_accel;
+      }
+      
+      virtual const Matrix4x4 &getTransToAccel() const {
+         return m_transToAccel;
+      }
+      
    protected:
       virtual void _getUV(SurfacePoint &pt) const;
       virtual void _getGeometricNormal(SurfacePoint &pt) const;
       
       virtual real_t _getSurfaceArea();
       
+      /**
+       * @brief
+       *    Transforms a point sampled on the surface of the instancee into 
+       * world space and reinitializes it with respect to this instance's 
+       * material
+       */
+      void _initInstancedPoint(SurfacePoint &pt);
+      
       //@}-----------------------------------------------------------------
       
    protected:
-      Shape *m_instancee;
+      Shape   *m_instancee;
+      
+      /// optional shared ownership of m_instancee
+      ShapePtr m_instanceeRef;
+      
+      /// instancee's bottom-level accel (if any) and the composite 
+      /// transformation from world space into its space
+      SpatialAccel *m_accel;
+      Matrix4x4     m_transToAccel;
+      
+      /// cumulative world-space areas of the instancee's triangles if it's a 
+      /// Mesh (see _getSurfaceArea), used to sample it uniformly by area
+      std::vector<real_t> m_areaCDF;
 };
 
 }
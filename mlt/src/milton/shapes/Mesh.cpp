@@ -13,6 +13,7 @@
 #include "Mesh.h"
 #include <SurfacePoint.h>
 #include <kdTreeAccel.h>
+#include <BVHAccel.h>
 #include <NaiveSpatialAccel.h>
 #include <ResourceManager.h>
 #include <Material.h>
@@ -97,6 +98,7 @@ Mesh::Mesh(const MeshData &data) {
    if (0 == m_nNormals)
       computeNormals();
    
+   m_positions    = NULL;
    m_batch        = 0;
    m_spatialAccel = NULL;
 }
@@ -140,6 +142,7 @@ Mesh::Mesh(unsigned nVertices, unsigned nNormals, unsigned nUVs,
    if (0 == m_nNormals)
       computeNormals();
    
+   m_positions    = NULL;
    m_batch        = 0;
    m_spatialAccel = NULL;
 }
@@ -181,6 +184,7 @@ Mesh::Mesh(const Mesh &mesh) {
       }
    }
    
+   m_positions    = NULL;
    m_batch        = 0;
    m_spatialAccel = NULL;
    
@@ -192,6 +196,7 @@ Mesh::~Mesh() {
    safeDeleteArray(m_normals);
    safeDeleteArray(m_uvs);
    safeDeleteArray(m_triangles);
+   safeDeleteArray(m_positions);
    
    safeDelete(m_spatialAccel);
    
@@ -216,6 +221,8 @@ void Mesh::init() {
    ASSERT(m_material);
    
    if (NULL == m_spatialAccel) {
+      _initPositions();
+      
       for(unsigned i = 0; i < m_nTriangles; ++i) {
          m_triangles[i].init();
          
@@ -231,6 +238,8 @@ void Mesh::init() {
       
       if (accelType == "kdTree") {
          m_spatialAccel = new kdTreeAccel();
+      } else if (accelType == "bvh") {
+         m_spatialAccel = new BVHAccel();
       } else {
          ASSERT(accelType == "naive");
          
@@ -250,6 +259,37 @@ void Mesh::init() {
    }
 }
 
+void Mesh::update() {
+   if (NULL == m_spatialAccel) {
+      init();
+      return;
+   }
+   
+   _initPositions();
+   
+   for(unsigned i = 0; i < m_nTriangles; ++i)
+      m_triangles[i].init();
+   
+   m_spatialAccel->update();
+   m_objSpaceAABB = m_spatialAccel->getAABB();
+   
+   // transform AABB into parent coordinate system
+   Transformable::init();
+   
+   setPreviewDirty();
+}
+
+void Mesh::setVertices(const Vertex *vertices, bool recomputeNormals) {
+   ASSERT(vertices);
+   
+   memcpy(m_vertices, vertices, sizeof(Vertex) * m_nVertices);
+   
+   if (recomputeNormals)
+      computeNormals();
+   
+   update();
+}
+
 void Mesh::preview() {
    /*GLreal_t data[16];
 	glGetDoublev(GL_MODELVIEW_MATRIX, data);
@@ -376,15 +416,47 @@ void Mesh::computeNormals() {
    //safeDeleteArray(normalFlip);
 }
 
+void Mesh::normalize() {
+   AABB aabb;
+   
+   for(unsigned i = m_nVertices; i--;)
+      aabb.add(m_vertices[i]);
+   
+   const Vector3 &center = Vector3(aabb.getCenter().data);
+   Vector3 diag = aabb.getDiagonal();
+   for(unsigned j = 3; j--;)
+      diag[j] += (diag[j] == 0);
+   
+   for(unsigned i = m_nVertices; i--;) {
+      m_vertices[i] -= center;
+      
+      for(unsigned j = 3; j--;)
+         m_vertices[i][j] /= diag[j];
+   }
+   
+   setPreviewDirty();
+}
+
+void Mesh::_initPositions() {
+   if (NULL == m_positions)
+      m_positions = new geom_real_t[3 * m_nVertices];
+   
+   for(unsigned i = m_nVertices; i--;) {
+      const Vertex &v = m_vertices[i];
+      
+      m_positions[3 * i + 0] = static_cast<geom_real_t>(v[0]);
+      m_positions[3 * i + 1] = static_cast<geom_real_t>(v[1]);
+      m_positions[3 * i + 2] = static_cast<geom_real_t>(v[2]);
+   }
+}
+
 real_t Mesh::getIntersection(const Ray &ray, SurfacePoint &pt) {
    ASSERT(m_spatialAccel);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   real_t retVal = m_spatialAccel->getIntersection(Ray(P, D), pt);
+   real_t retVal = m_spatialAccel->getIntersection(rObj, pt);
    
    if (Ray::isValid(retVal)) {
       ASSERT(pt.index < m_nTriangles);
@@ -397,12 +469,10 @@ real_t Mesh::getIntersection(const Ray &ray, SurfacePoint &pt) {
 bool Mesh::intersects(const Ray &ray, real_t tMax) {
    ASSERT(m_spatialAccel);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   return m_spatialAccel->intersects(Ray(P, D), tMax);
+   return m_spatialAccel->intersects(rObj, tMax);
 }
 
 void Mesh::_getUV(SurfacePoint &pt) const {
@@ -17,6 +17,7 @@
 #include <shapes/MeshTriangle.h>
 #include <utils/PropertyMap.h>
 
+#include <boost/shared_ptr.hpp>
 #include <GL/gl.h>
 
 namespace milton {
@@ -72,6 +73,32 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
        */
       virtual void init();
       
+      /**
+       * @brief 
+       *    Updates this mesh after its vertex positions have been modified in 
+       * place (e.g., between frames of an animation), refitting its 
+       * underlying SpatialAccel instead of rebuilding it where supported
+       * 
+       * @note the mesh's topology (triangle indices) must be unchanged
+       * @note the SpatialAccel object itself is preserved, so instances of 
+       *    this mesh remain valid, though their world-space AABBs must be 
+       *    recomputed via InstancedShape::update (not init, which must only 
+       *    be called once), followed by SpatialAccel::update on any accel 
+       *    containing them
+       * @see SpatialAccel::update
+       */
+      virtual void update();
+      
+      /**
+       * @brief 
+       *    Overwrites this mesh's vertex positions with the given array of 
+       * getNoVertices() vertices and updates this mesh accordingly
+       * 
+       * @param recomputeNormals whether or not to recompute averaged vertex 
+       *    normals from the new positions
+       */
+      void setVertices(const Vertex *vertices, bool recomputeNormals = false);
+      
       /**
        * @brief
        *    Displays an OpenGL preview of this mesh; optimized for repeated 
@@ -89,6 +116,16 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
        */
       void computeNormals();
       
+      /**
+       * @brief
+       *    Rescales and recenters the vertices of this mesh in object space 
+       * such that it resides within the unit cube [-.5,-.5,-.5] to 
+       * [.5,.5,.5]
+       * 
+       * @note must be called before init
+       */
+      void normalize();
+      
       
       //@}-----------------------------------------------------------------
       ///@name Sampling functionality
@@ -179,6 +216,21 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
          return m_triangles;
       }
       
+      /**
+       * @returns a pointer to the packed (x, y, z) vertex positions in 
+       *    geom_real_t precision used for visibility testing, which is NULL 
+       *    until this mesh is initialized
+       */
+      inline const geom_real_t *getPositions() const {
+         return m_positions;
+      }
+      
+      /// @returns the object-space kd-Tree (or other SpatialAccel) over this 
+      ///    mesh's triangles, which is NULL until this mesh is initialized
+      virtual SpatialAccel *getSpatialAccel() const {
+         return m_spatialAccel;
+      }
+      
       void setPreviewDirty();
       
       
@@ -193,6 +245,9 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
        */
       virtual real_t _getSurfaceArea();
       
+      /// (re)initializes m_positions from m_vertices
+      void _initPositions();
+      
    protected:
       unsigned	     m_nVertices;
       unsigned      m_nNormals;
@@ -204,6 +259,9 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
       UV           *m_uvs;
       MeshTriangle *m_triangles;
       
+      // compact copy of m_vertices used for visibility testing
+      geom_real_t  *m_positions;
+      
       // display list
       GLuint        m_batch;
       
@@ -212,6 +270,10 @@ class MILTON_DLL_EXPORT Mesh : public Transformable, public PropertyMap {
       bool          m_enableAccelPreview;
 };
 
+/// Shared reference to a Mesh whose geometry may be instanced many times 
+/// (@see ResourceManager::getMesh)
+typedef boost::shared_ptr<Mesh> MeshPtr;
+
 }
 
 #endif // MESH_H_
@@ -76,7 +76,7 @@ real_t MeshTriangle::getIntersection(const Ray &ray, SurfacePoint &pt) {
    return t;
 }
 
-#else // 2 == MESH_TRIANGLE_INTERSECTION_TYPE
+#elif (2 == MESH_TRIANGLE_INTERSECTION_TYPE)
 
 #define CROSS(dest,v1,v2) \
           dest[0]=v1[1]*v2[2]-v1[2]*v2[1]; \
@@ -167,6 +167,162 @@ real_t MeshTriangle::getIntersection(const Ray &ray, SurfacePoint &pt) {
 #endif // 0
 }
 
+#else // 3 == MESH_TRIANGLE_INTERSECTION_TYPE
+
+// Watertight ray-triangle intersection (Woop, Benthin, and Wald, JCGT 2013) 
+// performed in geom_real_t precision on the mesh's compact vertex positions.
+// The test is first carried out in a coordinate system where the ray is the 
+// +z axis, s.t. edges shared between adjacent triangles are evaluated 
+// identically and rays can't slip through cracks.  Hits whose t-value is 
+// within the conservative floating-point error bound of zero (Pharr and 
+// Humphreys, PBRT 2nd ed.) are rejected, and the t-value of the remaining 
+// hits is refined in real_t against the plane of the triangle, s.t. the 
+// resulting intersection point lies on the stored geometry as accurately 
+// as in the all-real_t path and secondary rays spawned from it don't 
+// self-intersect.
+
+/// conservative bound on the relative rounding error of n geom_real_t ops
+#define GEOM_GAMMA(n) \
+   (((n) * std::numeric_limits<geom_real_t>::epsilon() * 0.5) / \
+    (1 - (n) * std::numeric_limits<geom_real_t>::epsilon() * 0.5))
+
+real_t MeshTriangle::getIntersection(const Ray &ray, SurfacePoint &pt) {
+   const geom_real_t *positions = mesh->getPositions();
+   ASSERT(positions);
+   
+   const geom_real_t *const p0 = positions + 3 * A;
+   const geom_real_t *const p1 = positions + 3 * B;
+   const geom_real_t *const p2 = positions + 3 * C;
+   
+   const geom_real_t dir[3] = {
+      static_cast<geom_real_t>(ray.direction[0]), 
+      static_cast<geom_real_t>(ray.direction[1]), 
+      static_cast<geom_real_t>(ray.direction[2]), 
+   };
+   
+   // permute s.t. the dominant axis of the ray direction becomes z, 
+   // preserving winding
+   unsigned kz = 0;
+   if (fabs(dir[1]) > fabs(dir[kz]))
+      kz = 1;
+   if (fabs(dir[2]) > fabs(dir[kz]))
+      kz = 2;
+   
+   unsigned kx = (kz + 1) % 3;
+   unsigned ky = (kx + 1) % 3;
+   
+   if (dir[kz] < 0)
+      std::swap(kx, ky);
+   
+   if (dir[kz] == 0)
+      return INFINITY;
+   
+   // shear constants which transform the ray direction to (0, 0, 1)
+   const geom_real_t sz = 1 / dir[kz];
+   const geom_real_t sx = dir[kx] * sz;
+   const geom_real_t sy = dir[ky] * sz;
+   
+   // translate vertices relative to the ray origin
+   const geom_real_t ox = static_cast<geom_real_t>(ray.origin[kx]);
+   const geom_real_t oy = static_cast<geom_real_t>(ray.origin[ky]);
+   const geom_real_t oz = static_cast<geom_real_t>(ray.origin[kz]);
+   
+   const geom_real_t az = p0[kz] - oz;
+   const geom_real_t bz = p1[kz] - oz;
+   const geom_real_t cz = p2[kz] - oz;
+   
+   const geom_real_t ax = (p0[kx] - ox) - sx * az;
+   const geom_real_t ay = (p0[ky] - oy) - sy * az;
+   const geom_real_t bx = (p1[kx] - ox) - sx * bz;
+   const geom_real_t by = (p1[ky] - oy) - sy * bz;
+   const geom_real_t cx = (p2[kx] - ox) - sx * cz;
+   const geom_real_t cy = (p2[ky] - oy) - sy * cz;
+   
+   // scaled barycentric coordinates (edge functions)
+   real_t u = cx * by - cy * bx;
+   real_t v = ax * cy - ay * cx;
+   real_t w = bx * ay - by * ax;
+   
+   // fall back to real_t for edges which pass exactly through the ray
+   if (u == 0 || v == 0 || w == 0) {
+      u = (real_t) cx * by - (real_t) cy * bx;
+      v = (real_t) ax * cy - (real_t) ay * cx;
+      w = (real_t) bx * ay - (real_t) by * ax;
+   }
+   
+   if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+      return INFINITY;
+   
+   const real_t det = u + v + w;
+   if (det == 0)
+      return INFINITY;
+   
+   // scaled hit distance, whose sign must agree with that of det
+   const real_t sazv = sz * az, sbzv = sz * bz, sczv = sz * cz;
+   const real_t T = u * sazv + v * sbzv + w * sczv;
+   
+   if ((det < 0 && T >= 0) || (det > 0 && T <= 0))
+      return INFINITY;
+   
+   const real_t invDet = 1 / det;
+   const real_t t      = T * invDet;
+   
+   // conservatively reject hits whose t-value can't be distinguished from 
+   // zero given the rounding error accumulated above
+   {
+      const real_t maxZ = MAX(MAX(fabs(sazv), fabs(sbzv)), fabs(sczv));
+      const real_t maxX = MAX(MAX(fabs(ax), fabs(bx)), fabs(cx));
+      const real_t maxY = MAX(MAX(fabs(ay), fabs(by)), fabs(cy));
+      const real_t maxE = MAX(MAX(fabs(u), fabs(v)), fabs(w));
+      
+      const real_t deltaZ = GEOM_GAMMA(3) * maxZ;
+      const real_t deltaX = GEOM_GAMMA(5) * (maxX + maxZ);
+      const real_t deltaY = GEOM_GAMMA(5) * (maxY + maxZ);
+      const real_t deltaE = 2 * (GEOM_GAMMA(2) * maxX * maxY + 
+                                 deltaY * maxX + deltaX * maxY);
+      const real_t deltaT = 3 * (GEOM_GAMMA(3) * maxE * maxZ + 
+                                 deltaE * maxZ + deltaZ * maxE) * 
+                                 fabs(invDet);
+      
+      if (t <= deltaT)
+         return INFINITY;
+   }
+   
+   // refine t in real_t against the plane of the stored triangle
+   const real_t e1[3] = { 
+      (real_t) p1[0] - p0[0], (real_t) p1[1] - p0[1], (real_t) p1[2] - p0[2]
+   };
+   const real_t e2[3] = { 
+      (real_t) p2[0] - p0[0], (real_t) p2[1] - p0[1], (real_t) p2[2] - p0[2]
+   };
+   const real_t n[3] = {
+      e1[1] * e2[2] - e1[2] * e2[1], 
+      e1[2] * e2[0] - e1[0] * e2[2], 
+      e1[0] * e2[1] - e1[1] * e2[0], 
+   };
+   
+   const real_t nDotD = 
+      n[0] * ray.direction[0] + n[1] * ray.direction[1] + 
+      n[2] * ray.direction[2];
+   
+   real_t tRefined = t;
+   
+   if (nDotD != 0) {
+      tRefined = (n[0] * (p0[0] - ray.origin[0]) + 
+                  n[1] * (p0[1] - ray.origin[1]) + 
+                  n[2] * (p0[2] - ray.origin[2])) / nDotD;
+   }
+   
+   // the refined t-value may have moved outside of the valid range (e.g., 
+   // for rays grazing the plane of the triangle)
+   if (!Ray::isValid(tRefined))
+      return INFINITY;
+   
+   return tRefined;
+}
+
+#undef GEOM_GAMMA
+
 #endif // MESH_TRIANGLE_INTERSECTION_TYPE
 
 
@@ -194,6 +350,21 @@ AABB MeshTriangle::getAABB() const {
    aabb.add(vertices[B]);
    aabb.add(vertices[C]);
    
+#if (3 == MESH_TRIANGLE_INTERSECTION_TYPE)
+   // bound the compact copy of the geometry which is actually intersected
+   const geom_real_t *positions = mesh->getPositions();
+   
+   if (positions) {
+      const unsigned indices[3] = { A, B, C };
+      
+      for(unsigned i = 3; i--;) {
+         const geom_real_t *p = positions + 3 * indices[i];
+         
+         aabb.add(Vector3(p[0], p[1], p[2]));
+      }
+   }
+#endif
+   
    return aabb;
 }
 
@@ -21,7 +21,8 @@ namespace milton {
 
 //#define MESH_TRIANGLE_INTERSECTION_TYPE    0
 //#define MESH_TRIANGLE_INTERSECTION_TYPE    1
-#define MESH_TRIANGLE_INTERSECTION_TYPE    2
+//#define MESH_TRIANGLE_INTERSECTION_TYPE    2
+#define MESH_TRIANGLE_INTERSECTION_TYPE    3
 
 typedef Vector3 Vertex;
 typedef Vector3 Normal;
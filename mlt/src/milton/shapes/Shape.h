@@ -13,6 +13,7 @@
 #include <shapes/Intersectable.h>
 #include <common/math/algebra.h>
 #include <core/UV.h>
+#include <boost/shared_ptr.hpp>
 
 namespace milton {
 
@@ -21,6 +22,7 @@ class Material;
 class Shape;
 
 DECLARE_STL_TYPEDEF(std::vector<Shape*>, PrimitiveList);
+typedef boost::shared_ptr<Shape> ShapePtr;
 
 class MILTON_DLL_EXPORT Shape : public Intersectable, public SSEAligned {
    public:
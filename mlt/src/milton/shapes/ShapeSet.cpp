@@ -9,6 +9,7 @@
 
 #include "ShapeSet.h"
 #include <kdTreeAccel.h>
+#include <BVHAccel.h>
 #include <NaiveSpatialAccel.h>
 #include <ResourceManager.h>
 #include <GL/gl.h>
@@ -55,11 +56,27 @@ void ShapeSet::init(bool initChildren) {
          }
       }
       
+      // default to a two-level hierarchy (top-level BVH over instances) if 
+      // any children carry their own bottom-level accel, since a kd-Tree 
+      // would otherwise have to clip many large, overlapping instance AABBs
+      bool hasInstances = false;
+      
+      FOREACH(PrimitiveListIter, m_primitives, iter) {
+         Transformable *trans = dynamic_cast<Transformable*>(*iter);
+         
+         if (trans && trans->getSpatialAccel()) {
+            hasInstances = true;
+            break;
+         }
+      }
+      
       const std::string &accelType = getValue<std::string>("spatialAccel", 
-                                                           "kdTree");
+         (hasInstances ? "bvh" : "kdTree"));
       
       if (accelType == "kdTree") {
          m_spatialAccel = new kdTreeAccel();
+      } else if (accelType == "bvh") {
+         m_spatialAccel = new BVHAccel();
       } else {
          ASSERT(accelType == "naive");
          
@@ -102,23 +119,19 @@ void ShapeSet::preview() {
 real_t ShapeSet::getIntersection(const Ray &ray, SurfacePoint &pt) {
    ASSERT(m_spatialAccel);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   return m_spatialAccel->getIntersection(Ray(P, D), pt);
+   return m_spatialAccel->getIntersection(rObj, pt);
 }
 
 bool ShapeSet::intersects(const Ray &ray, real_t tMax) {
    ASSERT(m_spatialAccel);
    
-   // TODO: creating a new Ray here is rather inefficient...
-   Point3  P;
-   Vector3 D;
-   _transformRayWorldToObj(ray, P, D);
+   Ray rObj;
+   _transformRayWorldToObj(ray, rObj);
    
-   return m_spatialAccel->intersects(Ray(P, D), tMax);
+   return m_spatialAccel->intersects(rObj, tMax);
 }
 
 real_t ShapeSet::_getSurfaceArea() {
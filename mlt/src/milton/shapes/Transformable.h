@@ -16,6 +16,8 @@
 
 namespace milton {
 
+class SpatialAccel;
+
 class MILTON_DLL_EXPORT Transformable : public Shape {
    public:
       ///@name Constructors
@@ -115,6 +117,25 @@ class MILTON_DLL_EXPORT Transformable : public Shape {
          return true;
       }
       
+      /**
+       * @returns the SpatialAccel over this shape's underlying geometry if 
+       *    any intersection found with it may be attributed directly to this 
+       *    shape (ex. a Mesh or an instance of a Mesh), or NULL otherwise
+       * @note allows BVHAccel to descend directly into bottom-level accels 
+       *    as part of a two-level hierarchy
+       */
+      virtual SpatialAccel *getSpatialAccel() const {
+         return NULL;
+      }
+      
+      /**
+       * @returns the transformation from world space into the space of 
+       *    getSpatialAccel()
+       */
+      virtual const Matrix4x4 &getTransToAccel() const {
+         return m_transToWorldInv;
+      }
+      
       
       //@}-----------------------------------------------------------------
       
@@ -122,6 +143,8 @@ class MILTON_DLL_EXPORT Transformable : public Shape {
       void _transformRayWorldToObj(const Ray &ray, Point3 &p, 
                                    Vector3 &d) const;
       
+      void _transformRayWorldToObj(const Ray &ray, Ray &rObj) const;
+      
       void _transformPoint3WorldToObj(const Point3 &pWorld, 
                                       Point3 &pObj) const;
       
@@ -22,6 +22,14 @@ inline void Transformable::_transformRayWorldToObj(const Ray &ray, Point3 &p,
    d = m_transToWorldInv * ray.direction;
 }
 
+inline void Transformable::_transformRayWorldToObj(const Ray &ray, 
+                                                   Ray &rObj) const
+{
+   rObj.origin    = m_transToWorldInv * ray.origin;
+   rObj.direction = m_transToWorldInv * ray.direction;
+   rObj.invDir    = rObj.direction.getReciprocal();
+}
+
 inline void Transformable::_transformPoint3WorldToObj(const Point3 &pWorld, 
                                                       Point3 &pObj) const
 {
@@ -26,25 +26,137 @@ unsigned Random::s_seed = static_cast<unsigned>(std::time(0));
 
 Sampler *Random::s_contUniformSampler = new ContUniformSampler(0, 1);
 
-real_t Random::sample(real_t min, real_t max) {
-#if 0
-   ostringstream oss;
-   oss << "random::" << QThread::currentThreadId();
-   const std::string &key = oss.str(); 
+/// per-thread override of the global generator (@see setThreadGenerator)
+struct RandomThreadData {
+   Random::Generator *generator;
+   RandomStream      *stream;
    
-   Sampler *sampler = 
-      ResourceManager::getValueThreadLocal<Sampler*>(key, NULL);
+   inline RandomThreadData()
+      : generator(NULL), stream(NULL)
+   { }
+};
+
+static QThreadStorage<RandomThreadData*> s_threadData;
+
+// number of threads which currently have a generator or stream installed; 
+// while zero, Random::sample and Random::getGenerator skip the thread-local 
+// lookup entirely
+static QAtomicInt s_noThreadOverrides(0);
+
+static inline bool hasThreadOverrides() {
+   // a plain read suffices, since a thread always observes its own updates 
+   // to the counter, and only its own overrides matter to it
+   return (static_cast<int>(s_noThreadOverrides) > 0);
+}
+
+static inline RandomThreadData *getThreadData() {
+   RandomThreadData *data = s_threadData.localData();
    
-   if (NULL == sampler) {
-      sampler = new ContUniformSampler(0, 1);
-      sampler->init();
-      ResourceManager::insertThreadLocal<Sampler*>(key, sampler);
+   if (NULL == data) {
+      data = new RandomThreadData();
+      s_threadData.setLocalData(data);
    }
    
-   const real_t x = sampler->sample();
+   return data;
+}
+
+/// updates s_noThreadOverrides after the calling thread's overrides change
+static inline void updateThreadOverrides(bool hadOverride, 
+                                         const RandomThreadData *data)
+{
+   const bool hasOverride = (data->generator || data->stream);
+   
+   if (hasOverride && !hadOverride)
+      s_noThreadOverrides.ref();
+   else if (hadOverride && !hasOverride)
+      s_noThreadOverrides.deref();
+}
+
+void Random::setThreadGenerator(Generator *generator) {
+   if (generator || s_threadData.hasLocalData()) {
+      RandomThreadData *data = getThreadData();
+      const bool hadOverride = (data->generator || data->stream);
+      
+      data->generator = generator;
+      updateThreadOverrides(hadOverride, data);
+   }
+}
+
+Random::Generator *Random::getThreadGenerator() {
+   if (!hasThreadOverrides() || !s_threadData.hasLocalData())
+      return NULL;
+   
+   return s_threadData.localData()->generator;
+}
+
+Random::Generator &Random::getGenerator() {
+   if (hasThreadOverrides() && s_threadData.hasLocalData()) {
+      Generator *generator = s_threadData.localData()->generator;
+      
+      if (generator)
+         return *generator;
+   }
+   
+   return s_generator;
+}
+
+void Random::setThreadStream(RandomStream *stream) {
+   if (stream || s_threadData.hasLocalData()) {
+      RandomThreadData *data = getThreadData();
+      const bool hadOverride = (data->generator || data->stream);
+      
+      data->stream = stream;
+      updateThreadOverrides(hadOverride, data);
+   }
+}
+
+RandomStream *Random::getThreadStream() {
+   if (!hasThreadOverrides() || !s_threadData.hasLocalData())
+      return NULL;
+   
+   return s_threadData.localData()->stream;
+}
+
+Random::ThreadEngine::ThreadEngine()
+   : m_stream(getThreadStream()), 
+     m_generator(m_stream ? NULL : &getGenerator())
+{ }
+
+real_t Random::sample(real_t min, real_t max) {
+   // fast path: skip the thread-local lookup while no thread has 
+   // installed a generator or stream of its own
+   const RandomThreadData *data = 
+      (hasThreadOverrides() && s_threadData.hasLocalData() ? 
+       s_threadData.localData() : NULL);
+   real_t x;
+   
+   if (data && data->stream) {
+      x = data->stream->next();
+   } else if (data && data->generator) {
+      Generator *generator = data->generator;
+      BoostContUniformSampler sampler(*generator, ContUniformDist(0, 1));
+      x = sampler();
+   } else {
+#if 0
+      ostringstream oss;
+      oss << "random::" << QThread::currentThreadId();
+      const std::string &key = oss.str(); 
+      
+      Sampler *sampler = 
+         ResourceManager::getValueThreadLocal<Sampler*>(key, NULL);
+      
+      if (NULL == sampler) {
+         sampler = new ContUniformSampler(0, 1);
+         sampler->init();
+         ResourceManager::insertThreadLocal<Sampler*>(key, sampler);
+      }
+      
+      x = sampler->sample();
 #else
-   const real_t x = s_contUniformSampler->sample();
+      BoostContUniformSampler sampler(s_generator, ContUniformDist(0, 1));
+      x = sampler();
 #endif
+   }
    
    ASSERT(x >= 0.0 && x < 1.0);
    
@@ -20,6 +20,22 @@
 
 namespace milton {
 
+/**
+ * @brief 
+ *    Abstract source of uniform random numbers in [0, 1) which may be 
+ * installed in place of the default generator on a per-thread basis 
+ * (e.g., to replay or mutate the random numbers consumed by a renderer)
+ * 
+ * @see Random::setThreadStream
+ */
+struct MILTON_DLL_EXPORT RandomStream {
+   virtual ~RandomStream()
+   { }
+   
+   /// @returns the next random number in [0, 1) from this stream
+   virtual real_t next() = 0;
+};
+
 struct MILTON_DLL_EXPORT Random {
    
    ///@name Typedefs for boost's generator/distribution interface
@@ -47,6 +63,56 @@ struct MILTON_DLL_EXPORT Random {
    typedef boost::variate_generator<Generator&, UniformOnSphereDist > 
       BoostUniformOnSphereSampler;
    
+   /**
+    * @brief 
+    *    Adapts the calling thread's source of random numbers to boost's 
+    * UniformRandomNumberGenerator interface, i.e., the thread's 
+    * RandomStream if one is installed (see setThreadStream), and its 
+    * generator otherwise (see getGenerator)
+    * 
+    * @note all Samplers draw from a ThreadEngine, s.t. their samples are a 
+    *    function of the installed stream's numbers (e.g., of a primary 
+    *    sample space state during MLT) rather than of the shared generator
+    * @note the source is resolved once upon construction
+    */
+   struct MILTON_DLL_EXPORT ThreadEngine {
+      typedef Generator::result_type result_type;
+      
+      ThreadEngine();
+      
+      inline result_type operator()() {
+         if (m_stream) {
+            return static_cast<result_type>( 
+               m_stream->next() * 4294967296.0);
+         }
+         
+         return (*m_generator)();
+      }
+      
+      inline result_type min BOOST_PREVENT_MACRO_SUBSTITUTION () const {
+         return 0;
+      }
+      
+      inline result_type max BOOST_PREVENT_MACRO_SUBSTITUTION () const {
+         return 0xFFFFFFFFu;
+      }
+      
+      protected:
+         RandomStream *m_stream;
+         Generator    *m_generator;
+   };
+   
+   typedef boost::variate_generator<ThreadEngine&, NormalDist > 
+      ThreadNormalSampler;
+   typedef boost::variate_generator<ThreadEngine&, ContUniformDist > 
+      ThreadContUniformSampler;
+   typedef boost::variate_generator<ThreadEngine&, DiscreteUniformDist > 
+      ThreadDiscreteUniformSampler;
+   typedef boost::variate_generator<ThreadEngine&, ExponentialDist > 
+      ThreadExponentialSampler;
+   typedef boost::variate_generator<ThreadEngine&, UniformOnSphereDist > 
+      ThreadUniformOnSphereSampler;
+   
    //@}-----------------------------------------------------------------
    ///@name Static utility methods
    //@{-----------------------------------------------------------------
@@ -67,6 +133,73 @@ struct MILTON_DLL_EXPORT Random {
       s_contUniformSampler->init();
    }
    
+   /**
+    * @brief 
+    *    Overrides the source of random numbers used by Random::sample and 
+    * all Samplers on the calling thread with @p generator, or restores the 
+    * shared, global generator if @p generator is NULL
+    * 
+    * @note allows worker threads to generate reproducible sequences which 
+    *    are independent of one another and of thread scheduling
+    * @note the caller retains ownership of @p generator
+    */
+   static void setThreadGenerator(Generator *generator);
+   
+   /**
+    * @returns the generator used by Random::sample on the calling thread, 
+    *    or NULL if the calling thread uses the shared, global generator
+    */
+   static Generator *getThreadGenerator();
+   
+   /**
+    * @returns the generator which random numbers should be drawn from on 
+    *    the calling thread, i.e., the generator installed via 
+    *    setThreadGenerator if any, and the shared, global generator 
+    *    otherwise
+    * 
+    * @note ignores any RandomStream installed on the calling thread; use 
+    *    a ThreadEngine (as all Samplers do) to respect both
+    * @note callers drawing many numbers in a tight loop may cache the 
+    *    returned reference for as long as the thread's generator is 
+    *    unchanged
+    */
+   static Generator &getGenerator();
+   
+   /**
+    * @returns a well-mixed generator seed for the substream with the given 
+    *    @p index derived from @p baseSeed, s.t. consecutive indices yield 
+    *    uncorrelated random sequences (e.g., for seeding per-path or 
+    *    per-thread generators independently of thread scheduling)
+    */
+   static unsigned getSubstreamSeed(unsigned baseSeed, unsigned index) {
+      unsigned h = baseSeed ^ (index * 0x9E3779B9u);
+      
+      h = (h ^ 61) ^ (h >> 16);
+      h *= 9;
+      h ^= (h >> 4);
+      h *= 0x27d4eb2d;
+      h ^= (h >> 15);
+      
+      return h;
+   }
+   
+   /**
+    * @brief 
+    *    Overrides the source of random numbers used by Random::sample and 
+    * all Samplers on the calling thread with @p stream (taking precedence over any generator 
+    * installed via setThreadGenerator), or removes the override if 
+    * @p stream is NULL
+    * 
+    * @note the caller retains ownership of @p stream
+    */
+   static void setThreadStream(RandomStream *stream);
+   
+   /**
+    * @returns the stream used by Random::sample on the calling thread, or 
+    *    NULL if none has been installed
+    */
+   static RandomStream *getThreadStream();
+   
    /**
     * @returns a random floating point number inbetween the specified 
     *    bounds [@p min, @p max)
@@ -14,7 +14,10 @@
 namespace milton {
 
 Event ContUniformSampler::sample() {
-   return Event(m_sampler(), this);
+   // draw from the calling thread's source (@see Random::ThreadEngine)
+   Random::ThreadEngine engine;
+   Random::ThreadContUniformSampler sampler(engine, m_dist);
+   return Event(sampler(), this);
 }
 
 real_t ContUniformSampler::getPd(const Event &event) {
@@ -24,13 +24,12 @@ class MILTON_DLL_EXPORT ContUniformSampler : public UniformSampler<real_t> {
       
       inline explicit ContUniformSampler(real_t min = 0, real_t max = 1)
          : UniformSampler<real_t>(min, max), 
-           m_sampler(Random::s_generator, 
-                     Random::ContUniformDist(min, max))
+           m_dist(min, max)
       { }
       
       inline ContUniformSampler(const ContUniformSampler &copy)
          : UniformSampler<real_t>(copy), 
-           m_sampler(copy.m_sampler)
+           m_dist(copy.m_dist)
       { }
       
       virtual ~ContUniformSampler()
@@ -61,7 +60,7 @@ class MILTON_DLL_EXPORT ContUniformSampler : public UniformSampler<real_t> {
       //@}-----------------------------------------------------------------
       
    protected:
-      Random::BoostContUniformSampler m_sampler;
+      Random::ContUniformDist m_dist;
 };
 
 }
@@ -14,7 +14,9 @@
 namespace milton {
 
 Event DiscreteUniformSampler::sample() {
-   const int x = m_sampler();
+   Random::ThreadEngine engine;
+   Random::ThreadDiscreteUniformSampler sampler(engine, m_dist);
+   const int x = sampler();
    
    if (m_data)
       return Event(m_data[x], this);
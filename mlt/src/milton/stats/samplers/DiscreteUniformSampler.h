@@ -24,21 +24,19 @@ class MILTON_DLL_EXPORT DiscreteUniformSampler : public UniformSampler<int> {
       
       inline explicit DiscreteUniformSampler(int min = 0, int max = 6)
          : UniformSampler<int>(min, max), 
-           m_sampler(Random::s_generator, 
-                     Random::DiscreteUniformDist(min, max)), 
+           m_dist(min, max), 
            m_data(NULL)
       { }
       
       inline explicit DiscreteUniformSampler(const int *data, const unsigned n)
          : UniformSampler<int>(0, n), 
-           m_sampler(Random::s_generator, 
-                     Random::DiscreteUniformDist(0, n)), 
+           m_dist(0, n), 
            m_data(data)
       { }
       
       inline DiscreteUniformSampler(const DiscreteUniformSampler &copy)
          : UniformSampler<int>(copy), 
-           m_sampler(copy.m_sampler), 
+           m_dist(copy.m_dist), 
            m_data(copy.m_data)
       { }
       
@@ -70,7 +68,7 @@ class MILTON_DLL_EXPORT DiscreteUniformSampler : public UniformSampler<int> {
       //@}-----------------------------------------------------------------
       
    protected:
-      Random::BoostDiscreteUniformSampler m_sampler;
+      Random::DiscreteUniformDist m_dist;
       
       const int                     *m_data;
 };
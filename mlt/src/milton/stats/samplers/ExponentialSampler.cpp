@@ -28,7 +28,9 @@ void ExponentialSampler::init() {
 }
 
 Event ExponentialSampler::sample() {
-   return Event(m_sampler(), this);
+   Random::ThreadEngine engine;
+   Random::ThreadExponentialSampler sampler(engine, m_dist);
+   return Event(sampler(), this);
 }
 
 real_t ExponentialSampler::getPd(const Event &event) {
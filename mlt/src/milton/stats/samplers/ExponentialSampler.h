@@ -32,14 +32,13 @@ class MILTON_DLL_EXPORT ExponentialSampler : public Sampler {
       
       inline explicit ExponentialSampler(const real_t lambda = 1.0)
          : Sampler(), 
-           m_sampler(Random::s_generator, 
-                     Random::ExponentialDist(lambda)), 
+           m_dist(lambda), 
            m_lambda(lambda)
       { }
       
       inline ExponentialSampler(const ExponentialSampler &copy)
          : Sampler(copy), 
-           m_sampler(copy.m_sampler), 
+           m_dist(copy.m_dist), 
            m_lambda(copy.m_lambda)
       { }
       
@@ -100,7 +99,7 @@ class MILTON_DLL_EXPORT ExponentialSampler : public Sampler {
       //@}-----------------------------------------------------------------
       
    protected:
-      Random::BoostExponentialSampler m_sampler;
+      Random::ExponentialDist m_dist;
       
       real_t m_lambda;
 };
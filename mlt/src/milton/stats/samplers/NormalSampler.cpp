@@ -31,7 +31,9 @@ void NormalSampler::init() {
 }
 
 Event NormalSampler::sample() {
-   return Event(m_sampler(), this);
+   Random::ThreadEngine engine;
+   Random::ThreadNormalSampler sampler(engine, m_dist);
+   return Event(sampler(), this);
 }
 
 real_t NormalSampler::getPd(const Event &event) {
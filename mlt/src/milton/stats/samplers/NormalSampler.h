@@ -35,14 +35,13 @@ class MILTON_DLL_EXPORT NormalSampler : public Sampler {
       
       inline explicit NormalSampler(real_t mean = 0, real_t variance = 1)
          : Sampler(), 
-           m_sampler(Random::s_generator, 
-                     Random::NormalDist(mean, sqrt(variance))), 
+           m_dist(mean, sqrt(variance)), 
            m_mean(mean), m_variance(variance)
       { }
       
       inline NormalSampler(const NormalSampler &copy)
          : Sampler(copy), 
-           m_sampler(copy.m_sampler), 
+           m_dist(copy.m_dist), 
            m_mean(copy.getMean()), m_variance(copy.getVariance())
       { }
       
@@ -109,7 +108,7 @@ class MILTON_DLL_EXPORT NormalSampler : public Sampler {
        * @returns the standard deviation 'sigma' of this normal random variable
        */
       inline real_t getStdDev() const {
-         return m_sampler.distribution().sigma();
+         return m_dist.sigma();
       }
       
       /**
@@ -123,7 +122,7 @@ class MILTON_DLL_EXPORT NormalSampler : public Sampler {
       //@}-----------------------------------------------------------------
       
    protected:
-      Random::BoostNormalSampler m_sampler;
+      Random::NormalDist m_dist;
       
       real_t m_mean;
       real_t m_variance;
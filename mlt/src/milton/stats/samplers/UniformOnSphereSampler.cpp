@@ -20,7 +20,9 @@ void UniformOnSphereSampler::init() {
 }
 
 Event UniformOnSphereSampler::sample() {
-   const Random::UniformOnSphereDist::result_type &s = m_sampler();
+   Random::ThreadEngine engine;
+   Random::ThreadUniformOnSphereSampler sampler(engine, m_dist);
+   const Random::UniformOnSphereDist::result_type &s = sampler();
    ASSERT(s.size() == m_dimension);
    
    ASSERT(m_dimension == 3);
@@ -23,14 +23,13 @@ class MILTON_DLL_EXPORT UniformOnSphereSampler : public Sampler {
       
       inline explicit UniformOnSphereSampler(unsigned dimension = 3)
          : Sampler(), 
-           m_sampler(Random::s_generator, 
-                     Random::UniformOnSphereDist(dimension)), 
+           m_dist(dimension), 
            m_dimension(dimension)
       { }
       
       inline UniformOnSphereSampler(const UniformOnSphereSampler &copy)
          : Sampler(copy), 
-           m_sampler(copy.m_sampler), 
+           m_dist(copy.m_dist), 
            m_dimension(copy.m_dimension)
       { }
       
@@ -102,7 +101,7 @@ class MILTON_DLL_EXPORT UniformOnSphereSampler : public Sampler {
       unsigned _factorial(unsigned n);
       
    protected:
-      Random::BoostUniformOnSphereSampler m_sampler;
+      Random::UniformOnSphereDist m_dist;
       
       unsigned m_dimension;
 };
@@ -5,7 +5,7 @@
 
    @brief
       Static resource manager synchronized across all Milton threads, 
-   containing references to loaded images, global logging utilities, and 
+   containing references to loaded images and meshes, global logging utilities, and 
    user-definable options which may be used to affect Milton functionality.
    Many user-definable options that are supported are aimed at dynamic, 
    on-the-fly debugging changes (whether or not to preview kd-Trees built 
@@ -15,6 +15,8 @@
 #include "ResourceManager.h"
 #include <SharedLibraryManager.h>
 #include <SharedLibraryPlatform.h>
+#include <MeshLoader.h>
+#include <Mesh.h>
 #include <QtCore/QtCore>
 
 namespace milton {
@@ -23,6 +25,7 @@ namespace milton {
 Log ResourceManager::log;
 
 ImagePtrMap             ResourceManager::s_imagePtrMap;
+MeshPtrMap              ResourceManager::s_meshPtrMap;
 ThreadLocalStorage      ResourceManager::s_threadLocalStorage;
 PropertyMap             ResourceManager::s_propertyMap;
 QMutex                  ResourceManager::s_mutex;
@@ -37,6 +40,33 @@ SharedLibraryManager   *ResourceManager::manager =
    new SharedLibraryManager(ResourceManager::s_sharedLibraryPlatform);
 
 
+MeshPtr ResourceManager::getMesh(const std::string &filename, 
+                                 bool normalize)
+{
+   QMutexLocker lock(&s_mutex);
+   
+   // normalized and unnormalized versions of a mesh have different geometry
+   const std::string &key = (normalize ? filename + "#normalize" : filename);
+   
+   // attempt to find previously loaded mesh in cache
+   MeshPtrMapIter iter = s_meshPtrMap.find(key);
+   
+   if (iter != s_meshPtrMap.end())
+      return iter->second;
+   
+   MeshPtr meshPtr = MeshPtr(MeshLoader::load(filename));
+   
+   if (!meshPtr) {
+      ResourceManager::log.error << "failed to load mesh '" << 
+         filename << "'" << std::endl;
+   } else if (normalize) {
+      meshPtr->normalize();
+   }
+   
+   s_meshPtrMap.insert(MeshPtrMap::value_type(key, meshPtr));
+   return meshPtr;
+}
+
 void ResourceManager::cleanup() {
    QMutexLocker lock(&s_mutex);
    
@@ -51,6 +81,16 @@ void ResourceManager::cleanup() {
       s_imagePtrMap.erase(*iter);
    }
    
+   toRemove.clear();
+   FOREACH(MeshPtrMapIter, s_meshPtrMap, iter) {
+      if (iter->second.use_count() <= 1)
+         toRemove.push_back(iter->first);
+   }
+   
+   FOREACH(std::vector<std::string>::iterator, toRemove, iter) {
+      s_meshPtrMap.erase(*iter);
+   }
+   
    // note s_threadLocalStorage takes care of itself as QThreadStorage takes 
    // ownership of all thread-specific data
 }
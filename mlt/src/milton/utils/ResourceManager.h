@@ -5,7 +5,7 @@
 
    @brief
       Static resource manager synchronized across all Milton threads, 
-   containing references to loaded images, global logging utilities, and 
+   containing references to loaded images and meshes, global logging utilities, and 
    user-definable options which may be used to affect Milton functionality.
    Many user-definable options that are supported are aimed at dynamic, 
    on-the-fly debugging changes (whether or not to preview kd-Trees built 
@@ -24,7 +24,11 @@
 
 namespace milton {
 
+class Mesh;
+typedef boost::shared_ptr<Mesh> MeshPtr;
+
 DECLARE_STL_TYPEDEF2(std::map<std::string, ImagePtr>, ImagePtrMap);
+DECLARE_STL_TYPEDEF2(std::map<std::string, MeshPtr>,  MeshPtrMap);
 
 typedef QThreadStorage<PropertyMap*> ThreadLocalStorage;
 
@@ -65,11 +69,43 @@ class MILTON_DLL_EXPORT ResourceManager {
          return imagePtr;
       }
       
+      
+      //@}-----------------------------------------------------------------
+      ///@name External mesh geometry cache
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief
+       *    Loads the requested mesh from the given file, retaining a global 
+       * cache of all previously loaded meshes to default to upon future 
+       * calls to 'getMesh'
+       * 
+       * Meshes returned from this cache are meant to be shared between 
+       * several InstancedShapes, each with their own transformation and 
+       * material, such that a mesh referenced many times throughout a scene 
+       * is only parsed, has its normals computed, and has its SpatialAccel 
+       * built once
+       * 
+       * @param normalize whether or not the mesh should be normalized to 
+       *    reside within the unit cube (@see Mesh::normalize); normalized 
+       *    and unnormalized versions of the same file are cached separately
+       * 
+       * @returns a reference to a Mesh upon success or an empty 
+       *    reference upon failure
+       */
+      static MeshPtr getMesh(const std::string &filename, 
+                             bool normalize = false);
+      
+      
+      //@}-----------------------------------------------------------------
+      ///@name Resource cleanup
+      //@{-----------------------------------------------------------------
+      
       /**
        * @brief
        *    Attempts to synchronously clean up all resources which are not 
        * currently in use, flushing the static cache of any currently 
-       * unused images.
+       * unused images and meshes.
        */
       static void cleanup();
       
@@ -176,6 +212,7 @@ class MILTON_DLL_EXPORT ResourceManager {
       
    private:
       static ImagePtrMap            s_imagePtrMap;
+      static MeshPtrMap             s_meshPtrMap;
       static ThreadLocalStorage     s_threadLocalStorage;
       static PropertyMap            s_propertyMap;
       static QMutex                 s_mutex;
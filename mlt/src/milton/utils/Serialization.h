@@ -0,0 +1,111 @@
+/**<!-------------------------------------------------------------------->
+   @file   Serialization.h
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Minimal helpers for reading and writing native binary data to and
+   from std streams (eg. for checkpointing renderer state to disk).  Data is
+   written in the host's native byte order and representation, so files are
+   only meant to be read back by the same build on the same architecture.
+   <!-------------------------------------------------------------------->**/
+
+#ifndef SERIALIZATION_H_
+#define SERIALIZATION_H_
+
+#include <common/common.h>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace milton {
+
+/// writes the raw bytes of @p value to @p out
+template <typename T>
+inline void writeBinary(std::ostream &out, const T &value) {
+   out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/// reads the raw bytes of @p outValue from @p in
+/// @returns whether or not the read succeeded
+template <typename T>
+inline bool readBinary(std::istream &in, T &outValue) {
+   in.read(reinterpret_cast<char *>(&outValue), sizeof(T));
+   
+   return !in.fail();
+}
+
+/// writes @p n contiguous values to @p out
+template <typename T>
+inline void writeBinaryArray(std::ostream &out, const T *values, 
+                             unsigned n)
+{
+   out.write(reinterpret_cast<const char *>(values), sizeof(T) * n);
+}
+
+/// reads @p n contiguous values from @p in
+/// @returns whether or not the read succeeded
+template <typename T>
+inline bool readBinaryArray(std::istream &in, T *outValues, unsigned n) {
+   in.read(reinterpret_cast<char *>(outValues), sizeof(T) * n);
+   
+   return !in.fail();
+}
+
+/// writes a length-prefixed string to @p out
+inline void writeBinaryString(std::ostream &out, const std::string &s) {
+   writeBinary<uint32_t>(out, s.length());
+   out.write(s.data(), s.length());
+}
+
+/// reads a length-prefixed string from @p in
+/// @returns whether or not the read succeeded
+inline bool readBinaryString(std::istream &in, std::string &outString) {
+   uint32_t length = 0;
+   
+   if (!readBinary(in, length))
+      return false;
+   
+   outString.resize(length);
+   if (length > 0)
+      in.read(&outString[0], length);
+   
+   return !in.fail();
+}
+
+/**
+ * @brief 
+ *    Writes @p value to @p out via its stream insertion operator, which is
+ * useful for types whose internal state is otherwise opaque (eg. the 
+ * state of boost random number generators)
+ */
+template <typename T>
+inline void writeTextual(std::ostream &out, const T &value) {
+   std::ostringstream s;
+   
+   // trailing delimiter s.t. extraction operators which skip whitespace
+   // after the value don't fail by reaching the end of the stream
+   s << value << ' ';
+   writeBinaryString(out, s.str());
+}
+
+/// reads a value written by writeTextual via its stream extraction operator
+/// @returns whether or not the read succeeded
+template <typename T>
+inline bool readTextual(std::istream &in, T &outValue) {
+   std::string str;
+   
+   if (!readBinaryString(in, str))
+      return false;
+   
+   std::istringstream s(str);
+   s >> outValue;
+   
+   return !s.fail();
+}
+
+}
+
+#endif // SERIALIZATION_H_
+
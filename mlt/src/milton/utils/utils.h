@@ -16,6 +16,7 @@
 #include <utils/Log.h>
 #include <utils/PropertyMap.h>
 #include <utils/ResourceManager.h>
+#include <utils/Serialization.h>
 #include <utils/SpectralSampleSet.h>
 #include <utils/Timer.h>
 #include <utils/sort.h>
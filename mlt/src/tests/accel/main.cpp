@@ -0,0 +1,211 @@
+/**<!-------------------------------------------------------------------->
+   @file   main.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Verifies that deforming a mesh in place and refitting its BVH (see 
+   Mesh::update), along with an instance of it stored in a top-level BVH 
+   (see InstancedShape::update and BVHAccel::update), yields the same 
+   intersections as rebuilding the deformed mesh, instance, and top-level 
+   BVH from scratch.
+   <!-------------------------------------------------------------------->**/
+
+#include <milton.h>
+#include <iostream>
+#include <cstdlib>
+using namespace std;
+using namespace milton;
+
+#define GRID_SIZE             (32)
+#define NO_TEST_RAYS          (1 << 14)
+
+/// @returns a uniform random real_t in [0, 1)
+static inline real_t randomReal() {
+   return create_real(rand()) / (create_real(RAND_MAX) + 1);
+}
+
+/// @returns a uniform random real_t in [a, b)
+static inline real_t randomReal(real_t a, real_t b) {
+   return a + (b - a) * randomReal();
+}
+
+/// fills @p data with a flat GRID_SIZE x GRID_SIZE grid of quads spanning 
+/// [-1, 1] x [-1, 1] in the z = 0 plane
+static void init_grid(MeshData &data) {
+   const unsigned n = GRID_SIZE + 1;
+   
+   for(unsigned j = 0; j < n; ++j) {
+      for(unsigned i = 0; i < n; ++i) {
+         data.vertices.push_back(Vertex(2 * create_real(i) / GRID_SIZE - 1, 
+                                        2 * create_real(j) / GRID_SIZE - 1, 
+                                        0));
+      }
+   }
+   
+   for(unsigned j = 0; j < GRID_SIZE; ++j) {
+      for(unsigned i = 0; i < GRID_SIZE; ++i) {
+         const unsigned v = j * n + i;
+         
+         data.triangles.push_back(MeshTriangle(v, v + 1, v + n + 1));
+         data.triangles.push_back(MeshTriangle(v, v + n + 1, v + n));
+      }
+   }
+}
+
+/// displaces and stretches the given grid's vertices s.t. every triangle's 
+/// bounds change (without changing the grid's topology)
+static void deform_grid(std::vector<Vertex> &vertices) {
+   FOREACH(std::vector<Vertex>::iterator, vertices, iter) {
+      Vertex &v = *iter;
+      
+      v[2]  = 0.4 * sin(3 * v[0]) * cos(2 * v[1]);
+      v[0] *= 1.5;
+      v[1] += 0.25 * v[0];
+   }
+}
+
+/// @returns a Mesh over @p data using a BVH, which is never rebuilt during 
+///    updates
+static Mesh *create_mesh(const MeshData &data) {
+   Mesh *mesh = new Mesh(data);
+   
+   (*mesh)["spatialAccel"]      = std::string("bvh");
+   (*mesh)["bvhRefitThreshold"] = create_real(1e30);
+   mesh->init();
+   
+   return mesh;
+}
+
+/// @returns a scaled and translated instance of @p mesh
+static InstancedShape *create_instance(Mesh *mesh) {
+   const Vector3 scale(2, 2, 2), offset(0.5, -0.25, 1);
+   InstancedShape *instance = new InstancedShape(mesh);
+   
+   instance->setTransToWorld(getTransMat(offset) * getScaleMat(scale));
+   instance->setTransToWorldInv(getInvScaleMat(scale) * 
+                                getInvTransMat(offset));
+   instance->setMaterial(mesh->getMaterial());
+   instance->init();
+   
+   return instance;
+}
+
+/// @returns a top-level BVH containing only @p instance
+static BVHAccel *create_scene(InstancedShape *instance, 
+                              IntersectableList &primitives)
+{
+   BVHAccel *scene = new BVHAccel();
+   
+   primitives.push_back(instance);
+   (*scene)["bvhRefitThreshold"] = create_real(1e30);
+   scene->setGeometry(&primitives);
+   scene->init();
+   
+   return scene;
+}
+
+/// @returns a random ray aimed roughly at the (deformed) grid, 
+///    transformed by @p trans
+static Ray random_ray(const Matrix4x4 &trans) {
+   const Point3 origin(randomReal(-3, 3), randomReal(-3, 3), 2);
+   const Point3 target(randomReal(-3, 3), randomReal(-3, 3), -0.5);
+   
+   const Point3  o = trans * origin;
+   const Vector3 d = (trans * target - o).getNormalized();
+   
+   return Ray(o, d);
+}
+
+/// @returns the number of rays for which @p a and @p b disagree
+static unsigned compare_intersections(SpatialAccel *a, SpatialAccel *b, 
+                                      const Matrix4x4 &trans)
+{
+   unsigned noErrors = 0, noHits = 0;
+   
+   for(unsigned i = NO_TEST_RAYS; i--;) {
+      const Ray &ray = random_ray(trans);
+      SurfacePoint ptA, ptB;
+      
+      const real_t tA = a->getIntersection(ray, ptA);
+      const real_t tB = b->getIntersection(ray, ptB);
+      
+      const bool hitA = Ray::isValid(tA);
+      const bool hitB = Ray::isValid(tB);
+      
+      noHits += hitA;
+      
+      if (hitA != hitB || a->intersects(ray) != hitA || 
+          b->intersects(ray) != hitB || 
+          (hitA && fabs(tA - tB) > 1e-5 * MAX(create_real(1), tB)))
+      {
+         if (noErrors++ < 4) {
+            cerr << "   mismatch: refitted t = " << tA 
+                 << ", rebuilt t = " << tB << endl;
+         }
+      }
+   }
+   
+   // the test is meaningless unless a fair number of rays actually hit
+   if (noHits < NO_TEST_RAYS / 4) {
+      cerr << "   only " << noHits << " of " << NO_TEST_RAYS 
+           << " rays hit the mesh" << endl;
+      ++noErrors;
+   }
+   
+   return noErrors;
+}
+
+bool test_refit() {
+   MeshData data;
+   init_grid(data);
+   
+   // build the flat grid, an instance of it, and a top-level BVH around it
+   Mesh *mesh = create_mesh(data);
+   InstancedShape *instance = create_instance(mesh);
+   IntersectableList primitives;
+   BVHAccel *scene = create_scene(instance, primitives);
+   
+   // deform the grid in place and refit everything
+   deform_grid(data.vertices);
+   mesh->setVertices(&data.vertices[0], true);
+   instance->update();
+   scene->update();
+   
+   // rebuild the deformed grid, instance, and top-level BVH from scratch
+   Mesh *reference = create_mesh(data);
+   InstancedShape *referenceInstance = create_instance(reference);
+   IntersectableList referencePrimitives;
+   BVHAccel *referenceScene = 
+      create_scene(referenceInstance, referencePrimitives);
+   
+   srand(0);
+   
+   const unsigned meshErrors = 
+      compare_intersections(mesh->getSpatialAccel(), 
+                            reference->getSpatialAccel(), 
+                            Matrix4x4::identity());
+   const unsigned sceneErrors = 
+      compare_intersections(scene, referenceScene, 
+                            instance->getTransToWorld());
+   
+   cerr << "mesh:  " << meshErrors  << " mismatches" << endl;
+   cerr << "scene: " << sceneErrors << " mismatches" << endl;
+   
+   safeDelete(referenceScene);
+   safeDelete(referenceInstance);
+   safeDelete(reference);
+   safeDelete(scene);
+   safeDelete(instance);
+   safeDelete(mesh);
+   
+   return (0 == meshErrors && 0 == sceneErrors);
+}
+
+int main(int argc, char** argv) {
+   const bool passed = test_refit();
+   
+   cerr << (passed ? "all tests passed" : "tests failed!") << endl;
+   return !passed;
+}
+
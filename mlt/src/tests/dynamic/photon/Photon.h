@@ -43,12 +43,6 @@ struct Photon : public SSEAligned {
     */
    SpectralSampleSet Li;
    
-   /**
-    * used internally by PhotonKdTree for internal nodes to store the index of a
-    * child photon representing the location of the current node's split plane
-    */
-   short    plane;
-   
    /**
     * convenience constructor
     */
@@ -5,14 +5,15 @@
    @date   Fall 2008
    
    @brief
-      Slightly modified version of Henrik Wann Jensen's open source kd-Tree 
-   implementation used for photon mapping.  The PhotonMap is a balanced, 
-   axis-aligned binary tree which supports efficient nearest neighbor (KNN) 
-   searches over a three-dimensional point set of photons.
+      Balanced, axis-aligned kd-Tree over a three-dimensional point set of 
+   photons which supports efficient nearest neighbor (KNN) and fixed-radius 
+   searches, originally based on Henrik Wann Jensen's open source kd-Tree 
+   implementation used for photon mapping.
    
    @note
-      This version implements thread-safe KNN (which is necessary for 
-   multithreaded photon mapping) via thread-local storage
+      This version implements thread-safe queries (which is necessary for 
+   multithreaded photon mapping) via thread-local storage, and balances the 
+   kd-Tree in parallel by handing off disjoint subtrees to worker threads
    
    @see Photon
    @see PhotonMapper
@@ -23,130 +24,265 @@
 #include "PhotonMap.h"
 #include <milton.h>
 #include <QtCore>
+#include <algorithm>
 
-/// thread-local utility struct which is used internally during KNN search
+#if (MILTON_SIMD != MILTON_SIMD_NONE)
+#  include <xmmintrin.h> // SSE1
+#endif
+
+// minimum number of photons in a subtree for it to be balanced on its own 
+// thread, below which the overhead of spawning a thread isn't worthwhile
+#define PHOTON_MAP_MIN_PARALLEL_BALANCE (16384)
+
+// number of photon positions whose distances are evaluated at once
+#define PHOTON_MAP_SIMD_WIDTH (4)
+
+// coordinate of the padding at the end of the position arrays, which is 
+// far enough away to never be found by a search but whose square is finite
+#define PHOTON_MAP_FAR (1e18f)
+
+// maximum depth of a PhotonMap's kd-Tree
+#define PHOTON_MAP_MAX_DEPTH (64)
+
+/**
+ * @brief 
+ *    Worker thread which balances a single subtree of a PhotonMap
+ * 
+ * @see PhotonMap::_balance
+ */
+class photonBalanceThread : public QThread {
+   public:
+      inline photonBalanceThread(PhotonMap *map, Photon **porg, 
+                                 unsigned index, unsigned start, 
+                                 unsigned end, const AABB &aabb, 
+                                 unsigned noThreads)
+         : QThread(), m_map(map), m_porg(porg), m_index(index), 
+           m_start(start), m_end(end), m_aabb(aabb), m_noThreads(noThreads)
+      { }
+      
+      virtual ~photonBalanceThread()
+      { }
+      
+      virtual void run() {
+         m_map->_balance(m_porg, m_index, m_start, m_end, m_aabb, 
+                         m_noThreads);
+      }
+   
+   public:
+      PhotonMap *m_map;
+      Photon   **m_porg;
+      unsigned   m_index;
+      unsigned   m_start;
+      unsigned   m_end;
+      AABB       m_aabb;
+      unsigned   m_noThreads;
+};
+
+/// candidate photon found during a search
+struct photonCandidate {
+   float    dist2;
+   unsigned index;
+   
+   inline bool operator<(const photonCandidate &rhs) const {
+      return dist2 < rhs.dist2;
+   }
+};
+
+/// thread-local utility struct which is used internally during searches
 struct NearestPhotons {
-   unsigned       max_photons;
-   unsigned       num_found;
-   unsigned       heap;
-   Point3         pos;
-   real_t        *dist2;
-   const Photon **photons;
+   std::vector<photonCandidate> candidates;
+   std::vector<const Photon *>  photons;
+   std::vector<real_t>          dist2;
+};
+
+/**
+ * @brief 
+ *    Gathers the K nearest photons within an initial maximum radius in a 
+ * max-heap of candidates, s.t. the search radius shrinks to the distance 
+ * of the farthest candidate once K photons have been found
+ */
+struct photonKNNGatherer {
+   float            maxDist2;
+   unsigned         k;
+   unsigned         size;
+   photonCandidate *heap;
+   
+   inline void add(unsigned index, float dist2) {
+      if (size < k) {
+         heap[size].dist2 = dist2;
+         heap[size].index = index;
+         
+         if (++size == k) {
+            std::make_heap(heap, heap + k);
+            maxDist2 = heap[0].dist2;
+         }
+      } else {
+         // replace the farthest candidate
+         std::pop_heap(heap, heap + k);
+         heap[k - 1].dist2 = dist2;
+         heap[k - 1].index = index;
+         std::push_heap(heap, heap + k);
+         
+         maxDist2 = heap[0].dist2;
+      }
+   }
 };
 
-PhotonMap::PhotonMap(unsigned gatherPhotons, real_t gatherRadius)
-   : m_gatherPhotons(gatherPhotons), m_gatherRadius(gatherRadius)
+/// gathers all photons within a fixed radius
+struct photonRangeGatherer {
+   float                         maxDist2;
+   std::vector<photonCandidate> *candidates;
+   
+   inline void add(unsigned index, float dist2) {
+      photonCandidate c;
+      c.dist2 = dist2;
+      c.index = index;
+      
+      candidates->push_back(c);
+   }
+};
+
+PhotonMap::PhotonMap(unsigned gatherPhotons, real_t gatherRadius, 
+                     bool fixedRadius)
+   : m_gatherPhotons(gatherPhotons), m_gatherRadius(gatherRadius), 
+     m_fixedRadius(fixedRadius)
 {
+   ASSERT(!m_fixedRadius || m_gatherRadius < INFINITY);
+   
    clear();
 }
 
 void PhotonMap::clear() {
    m_photons.clear();
+   m_x.clear();
+   m_y.clear();
+   m_z.clear();
+   m_nodes.clear();
+   m_buckets.clear();
+   m_noBuckets = 0;
    
-   // push on a dummy photon to make the vector 1-indexed for heap
+   // push on a dummy photon to make the vector 1-indexed
    Photon p;
    m_photons.push_back(p);
    m_size = 1;
 }
 
-void PhotonMap::init() {
+void PhotonMap::init(unsigned noThreads) {
+   const unsigned n = size();
+   
+   // choose the smallest complete tree whose buckets hold at most 
+   // PHOTON_MAP_BUCKET_SIZE photons, s.t. every bucket is non-empty
+   m_noBuckets = 1;
+   while (m_noBuckets * PHOTON_MAP_BUCKET_SIZE < n)
+      m_noBuckets += m_noBuckets;
+   
+   m_nodes.resize(m_noBuckets);
+   m_buckets.resize(m_noBuckets + 1);
+   m_buckets[0] = 1;
+   m_buckets[m_noBuckets] = n + 1;
+   
    // build the underlying balanced kd-Tree
-   if (size() > 1) {
-      Photon **orig = (Photon **) malloc(sizeof(Photon*) * (size() + 1));
-      Photon **tree = (Photon **) malloc(sizeof(Photon*) * (size() + 1));
+   if (n > 0) {
+      Photon **orig = (Photon **) malloc(sizeof(Photon*) * (n + 1));
       AABB aabb;
       
       // add all photons
-      for (unsigned i = 1; i <= size(); ++i) {
+      for (unsigned i = 1; i <= n; ++i) {
          orig[i] = &m_photons[i];
-         m_photons[i].plane = 0;
          
          aabb.add(m_photons[i].position);
-         tree[i] = NULL;
       }
       
       // recursively balance tree
-      _balance(tree, orig, 1, 1, size(), aabb);
+      _balance(orig, 1, 1, n, aabb, MAX(noThreads, 1u));
       
-      free(orig);
+      // reorder photons s.t. each bucket is contiguous
+      PhotonList photons;
+      photons.reserve(n + 1);
+      photons.push_back(m_photons[0]);
       
-      unsigned d, j = 1, temp = 1;
-      Photon temp_photon = m_photons[j];
+      for (unsigned i = 1; i <= n; ++i)
+         photons.push_back(*orig[i]);
       
-      // update internal bookkeeping
-      for (unsigned i = 1; i <= size(); ++i) {
-         d = tree[j] - &m_photons[0];
-         tree[j] = NULL;
-         
-         if (d != temp) {
-            m_photons[j] = m_photons[d];
-         } else {
-            m_photons[j] = temp_photon;
-
-            if (i < size()) {
-               for (; temp <= size(); ++temp) 
-                  if (tree[temp] != NULL)
-                     break;
-               
-               temp_photon = m_photons[temp];
-               j = temp;
-            }
-            
-            continue;
-         }
-         
-         j = d;
-      }
-      
-      free(tree);
+      m_photons.swap(photons);
+      free(orig);
    }
    
-   m_halfPhotons = m_size / 2 - 1;
+   // store positions separately, padded s.t. the last bucket may be read 
+   // PHOTON_MAP_SIMD_WIDTH positions at a time
+   const unsigned noPositions = n + PHOTON_MAP_SIMD_WIDTH;
+   m_x.assign(noPositions, PHOTON_MAP_FAR);
+   m_y.assign(noPositions, PHOTON_MAP_FAR);
+   m_z.assign(noPositions, PHOTON_MAP_FAR);
+   
+   for (unsigned i = 1; i <= n; ++i) {
+      const Point3 &p = m_photons[i].position;
+      
+      m_x[i] = (float) p[0];
+      m_y[i] = (float) p[1];
+      m_z[i] = (float) p[2];
+   }
 }
 
-void PhotonMap::_balance(Photon **pbal, Photon **porg, unsigned index, 
-                         unsigned start, unsigned end, AABB &aabb)
+void PhotonMap::_balance(Photon **porg, unsigned index, unsigned start, 
+                         unsigned end, AABB &aabb, unsigned noThreads)
 {
-   const unsigned last = end - start + 1;
-   unsigned median = 1;
-   
-   while ((median * 4) <= last)
-      median += median;
-   
-   if ((3 * median)  <= last) {
-      median += median;
-      median += start - 1;
-   } else {
-      median  = end - median + 1;
+   if (index >= m_noBuckets) {
+      // leaf; buckets are visited in order, so each bucket ends where the 
+      // next one begins
+      m_buckets[index - m_noBuckets] = start;
+      return;
    }
    
-   const unsigned axis = aabb.getMaxExtent();
+   // split [start, end] in half s.t. all subtrees at the same depth differ 
+   // in size by at most one photon
+   const unsigned median = start + (end - start + 1) / 2;
+   const unsigned axis   = aabb.getMaxExtent();
    assert(axis >= 0 && axis <3);
    _median_split(porg, start, end, median, axis);
    
-   pbal[index] = porg[median];
-   pbal[index]->plane = axis;
+   // photons in [start, median) lie on or below the split plane, and 
+   // photons in [median, end] lie on or above it
+   const real_t split  = porg[median]->position[axis];
+   m_nodes[index].split = (float) split;
+   m_nodes[index].axis  = axis;
+   
+   // the left and right subtrees partition disjoint ranges of porg into 
+   // disjoint nodes and buckets, so the left subtree may be balanced on its 
+   // own thread, with its own copy of the bounds, while this thread 
+   // continues with the right subtree
+   photonBalanceThread *left = NULL;
+   unsigned rightThreads = noThreads;
    
-   if (median > start) {
-      if (start < median - 1) {
-         const real_t tmp = aabb.max[axis];
-         aabb.max[axis]   = pbal[index]->position[axis];
-         _balance(pbal, porg, 2 * index, start, median - 1, aabb);
-         aabb.max[axis]   = tmp;
+   {
+      const real_t tmp = aabb.max[axis];
+      aabb.max[axis]   = split;
+      
+      if (noThreads > 1 && 
+          median - start > PHOTON_MAP_MIN_PARALLEL_BALANCE)
+      {
+         left = new photonBalanceThread(this, porg, 2 * index, start, 
+                                        median - 1, aabb, noThreads / 2);
+         rightThreads -= noThreads / 2;
+         left->start();
       } else {
-         pbal[2 * index]  = porg[start];
+         _balance(porg, 2 * index, start, median - 1, aabb);
       }
+      
+      aabb.max[axis]   = tmp;
    }
    
-   if (median < end) {
-      if (median + 1 < end) {
-         const real_t tmp = aabb.min[axis];
-         aabb.min[axis]   = pbal[index]->position[axis];
-         _balance(pbal, porg, 2 * index + 1, median + 1, end, aabb);
-         aabb.min[axis]   = tmp;
-      } else {
-         pbal[2 * index + 1] = porg[end];
-      }
+   {
+      const real_t tmp = aabb.min[axis];
+      aabb.min[axis]   = split;
+      _balance(porg, 2 * index + 1, median, end, aabb, rightThreads);
+      aabb.min[axis]   = tmp;
+   }
+   
+   if (left) {
+      while(!left->wait());
+      
+      safeDelete(left);
    }
 }
 
@@ -183,124 +319,188 @@ void PhotonMap::_median_split(Photon **p, unsigned start, unsigned end,
    }
 }
 
-void PhotonMap::_k_nearest_photons(unsigned index, NearestPhotons *np) const {
-   if (index > size())
-      return;
+template <class Gatherer>
+inline void PhotonMap::_searchBucket(unsigned begin, unsigned end, 
+                                     const float *pos, 
+                                     Gatherer &gatherer) const
+{
+#if (MILTON_SIMD != MILTON_SIMD_NONE)
+   const __m128 qx = _mm_set1_ps(pos[0]);
+   const __m128 qy = _mm_set1_ps(pos[1]);
+   const __m128 qz = _mm_set1_ps(pos[2]);
    
-   const Photon *p = &m_photons[index];
-   real_t dist = np->pos[p->plane] - p->position[p->plane];
+   float dist2[PHOTON_MAP_SIMD_WIDTH];
    
-   if (dist > 0) {
-      _k_nearest_photons(2 * index + 1, np);
+   for (unsigned i = begin; i < end; i += PHOTON_MAP_SIMD_WIDTH) {
+      const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_x[i]), qx);
+      const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_y[i]), qy);
+      const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_z[i]), qz);
+      const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), 
+                                              _mm_mul_ps(dy, dy)), 
+                                   _mm_mul_ps(dz, dz));
       
-      if (dist * dist < np->dist2[0])
-         _k_nearest_photons(2 * index, np);
-   } else {
-      _k_nearest_photons(2 * index, np);
+      // skip the common case where none of these photons are in range
+      if (!_mm_movemask_ps(_mm_cmplt_ps(d2, _mm_set1_ps(gatherer.maxDist2))))
+         continue;
       
-      if (dist * dist < np->dist2[0])
-         _k_nearest_photons(2 * index + 1, np);
+      _mm_storeu_ps(dist2, d2);
+      
+      // note: the search radius may shrink as photons are added, and the 
+      // last few positions read may belong to the next bucket
+      const unsigned n = MIN(end - i, (unsigned) PHOTON_MAP_SIMD_WIDTH);
+      for (unsigned j = 0; j < n; ++j) {
+         if (dist2[j] < gatherer.maxDist2)
+            gatherer.add(i + j, dist2[j]);
+      }
    }
+#else
+   for (unsigned i = begin; i < end; ++i) {
+      const float dx = m_x[i] - pos[0];
+      const float dy = m_y[i] - pos[1];
+      const float dz = m_z[i] - pos[2];
+      const float d2 = dx * dx + dy * dy + dz * dz;
+      
+      if (d2 < gatherer.maxDist2)
+         gatherer.add(i, d2);
+   }
+#endif
+}
+
+template <class Gatherer>
+void PhotonMap::_search(const Point3 &pos, Gatherer &gatherer) const {
+   const float q[3] = { (float) pos[0], (float) pos[1], (float) pos[2] };
    
-   const real_t dist2 = (np->pos - p->position).getMagnitude2();
+   // subtrees which have yet to be visited, along with the squared distance 
+   // from q to their split plane
+   unsigned stack[PHOTON_MAP_MAX_DEPTH];
+   float    stackDist2[PHOTON_MAP_MAX_DEPTH];
+   unsigned top   = 0;
+   unsigned index = 1;
    
-   if (dist2 < np->dist2[0]) {
-      // there was enough room to just add the photon to the end
-      if (np->num_found < np->max_photons) {
-         np->num_found++;
-         np->dist2[np->num_found] = dist2;
-         np->photons[np->num_found] = p;
-      } else {
-         // we need to kick out a photon and build a heap if we don't have one
-         unsigned j, parent;
+   for(;;) {
+      // descend to the bucket containing q, deferring farther subtrees
+      while (index < m_noBuckets) {
+         const photonKdNode &node = m_nodes[index];
+         const float diff = q[node.axis] - node.split;
+         const unsigned child = 2 * index + (diff >= 0);
          
-         if (!np->heap) {
-            real_t temp;
-            const Photon *photon;
-            unsigned half_found = np->num_found >> 1;
-            
-            for (unsigned k = half_found; k >= 1; --k) {
-               parent = k;
-               photon = np->photons[k];
-               temp = np->dist2[k];
-               while (parent <= half_found) {
-                  j = parent + parent;
-                  if (j < np->num_found && np->dist2[j] < np->dist2[j+1])
-                     j++;
-                  if (temp >= np->dist2[j])
-                     break;
-                  
-                  np->dist2[parent] = np->dist2[j];
-                  np->photons[parent] = np->photons[j];
-                  parent = j;
-               }
-               
-               np->photons[parent] = photon;
-               np->dist2[parent] = temp;
-            }
-            
-            np->heap = 1;
-         }
-
-         // insert photon into the heap
-         parent = 1;
-         j = 2;
-         while (j <= np->num_found) {
-            if (j < np->num_found && np->dist2[j] < np->dist2[j+1])
-               j++;
-            if (dist2 > np->dist2[j])
-               break;
-            
-            np->dist2[parent] = np->dist2[j];
-            np->photons[parent] = np->photons[j];
-            parent = j;
-            j += j;
-         }
+         ASSERT(top < PHOTON_MAP_MAX_DEPTH);
+         stack[top]      = child ^ 1;
+         stackDist2[top] = diff * diff;
+         ++top;
          
-         np->photons[parent] = p;
-         np->dist2[parent] = dist2;
-         np->dist2[0] = np->dist2[1];
+         index = child;
       }
+      
+      const unsigned bucket = index - m_noBuckets;
+      _searchBucket(m_buckets[bucket], m_buckets[bucket + 1], q, gatherer);
+      
+      // pop the nearest deferred subtree which may still contain photons 
+      // within range
+      do {
+         if (top == 0)
+            return;
+      } while (stackDist2[--top] >= gatherer.maxDist2);
+      
+      index = stack[top];
    }
 }
 
-unsigned PhotonMap::getKNN(const Point3 &pos, const Photon ***neighbors, 
-                           real_t *radius) const
-{
+/// @returns the calling thread's search scratch space
+static NearestPhotons *photonGetNearestPhotons() {
    static const std::string &key = "photonKdTreeNearestPhotons";
    NearestPhotons *np = 
       ResourceManager::getValueThreadLocal<NearestPhotons*>(key, NULL);
    
    if (NULL == np) {
       np = new NearestPhotons();
-      np->dist2       = (real_t*) malloc(sizeof(real_t) * (m_gatherPhotons + 1));
-      np->photons     = (const Photon**) malloc(sizeof(Photon*) * (m_gatherPhotons + 1));
-      np->max_photons = m_gatherPhotons;
       
       // TODO: need some way of cleaning up thread-local storage
       ResourceManager::insertThreadLocal<NearestPhotons*>(key, np);
    }
    
+   return np;
+}
+
+unsigned PhotonMap::getKNN(const Point3 &pos, const Photon ***neighbors, 
+                           real_t *radius) const
+{
+   NearestPhotons *np = photonGetNearestPhotons();
+   
+   // scratch space is shared by all maps on this thread, which may gather 
+   // different numbers of photons
+   if (np->candidates.size() < m_gatherPhotons + 1)
+      np->candidates.resize(m_gatherPhotons + 1);
+   if (np->photons.size() < m_gatherPhotons + 1)
+      np->photons.resize(m_gatherPhotons + 1);
+   
    // initialize search structure
-   np->pos       = pos.data;
-   np->num_found = 0;
-   np->heap      = 0;
-   np->dist2[0]  = m_gatherRadius * m_gatherRadius;
+   photonKNNGatherer gatherer;
+   gatherer.maxDist2 = (float) (m_gatherRadius * m_gatherRadius);
+   gatherer.k        = m_gatherPhotons;
+   gatherer.size     = 0;
+   gatherer.heap     = &np->candidates[0];
    
    // perform KNN search
-   _k_nearest_photons(1, np);
+   if (m_gatherPhotons > 0)
+      _search(pos, gatherer);
+   
+   for(unsigned i = 0; i < gatherer.size; ++i)
+      np->photons[i] = &m_photons[gatherer.heap[i].index];
    
-   *neighbors = &np->photons[1];
-   *radius    = sqrt(np->dist2[0]);
+   *neighbors = &np->photons[0];
+   *radius    = sqrt((real_t) gatherer.maxDist2);
    
-   return np->num_found;
+   return gatherer.size;
+}
+
+unsigned PhotonMap::getInRadius(const Point3 &pos, real_t radius, 
+                                const Photon ***neighbors, 
+                                const real_t **dist2) const
+{
+   NearestPhotons *np = photonGetNearestPhotons();
+   np->candidates.clear();
+   
+   photonRangeGatherer gatherer;
+   gatherer.maxDist2   = (float) (radius * radius);
+   gatherer.candidates = &np->candidates;
+   
+   _search(pos, gatherer);
+   
+   const unsigned noFound = np->candidates.size();
+   if (np->photons.size() < noFound + 1)
+      np->photons.resize(noFound + 1);
+   if (np->dist2.size() < noFound + 1)
+      np->dist2.resize(noFound + 1);
+   
+   for(unsigned i = 0; i < noFound; ++i) {
+      const photonCandidate &c = np->candidates[i];
+      
+      np->photons[i] = &m_photons[c.index];
+      np->dist2[i]   = c.dist2;
+   }
+   
+   *neighbors = &np->photons[0];
+   *dist2     = &np->dist2[0];
+   
+   return noFound;
 }
 
 SpectralSampleSet PhotonMap::getIrradiance(const SurfacePoint &pt) const {
    const Photon **neighbors = NULL;
    real_t radius = 0;
+   unsigned noPhotons;
+   
+   if (m_fixedRadius) {
+      const real_t *dist2 = NULL;
+      
+      noPhotons = getInRadius(pt.position, m_gatherRadius, &neighbors, 
+                              &dist2);
+      radius    = m_gatherRadius;
+   } else {
+      noPhotons = getKNN(pt.position, &neighbors, &radius);
+   }
    
-   const unsigned noPhotons  = getKNN(pt.position, &neighbors, &radius);
    const real_t filterK      = 1.0; // cone filter; see Jensen, pg 82
    const real_t weightFactor = 1.0 / (filterK * radius);
    const real_t filterNorm   = 1.0 / (1.0 - 2.0 / (3 * filterK));
@@ -5,14 +5,23 @@
    @date   Fall 2008
    
    @brief
-      Slightly modified version of Henrik Wann Jensen's open source kd-Tree 
-   implementation used for photon mapping.  The PhotonMap is a balanced, 
-   axis-aligned binary tree which supports efficient nearest neighbor (KNN) 
-   searches over a three-dimensional point set of photons.
+      Balanced, axis-aligned kd-Tree over a three-dimensional point set of 
+   photons which supports efficient nearest neighbor (KNN) and fixed-radius 
+   searches, originally based on Henrik Wann Jensen's open source kd-Tree 
+   implementation used for photon mapping.
+      Unlike Jensen's left-balanced tree, which stores a single photon at 
+   every node, interior nodes only store split planes, and photons are 
+   stored in buckets of up to PHOTON_MAP_BUCKET_SIZE photons at the leaves.  
+   Photons are reordered s.t. each bucket is contiguous, and their positions 
+   are additionally stored in separate single-precision x, y, and z arrays 
+   (structure of arrays), s.t. queries traverse the tree iteratively and 
+   evaluate squared distances to a whole bucket at a time with SIMD 
+   instructions (see MILTON_SIMD).
    
    @note
-      This version implements thread-safe KNN (which is necessary for 
-   multithreaded photon mapping) via thread-local storage
+      This version implements thread-safe queries (which is necessary for 
+   multithreaded photon mapping) via thread-local storage, and balances the 
+   kd-Tree in parallel by handing off disjoint subtrees to worker threads
    
    @see Photon
    @see PhotonMapper
@@ -26,10 +35,21 @@
 #include <Photon.h>
 #include <accel/AABB.h>
 
+// maximum number of photons stored in each leaf of the kd-Tree
+#define PHOTON_MAP_BUCKET_SIZE (16)
+
 class  SurfacePoint;
 class  Camera;
 struct NearestPhotons;
 
+/// interior node of a PhotonMap's kd-Tree
+struct photonKdNode {
+   float    split;
+   unsigned axis;
+};
+
+DECLARE_STL_TYPEDEF(std::vector<photonKdNode>, photonKdNodeList);
+
 DECLARE_STL_TYPEDEF(std::vector<Photon>, PhotonList);
 
 class PhotonMap {
@@ -41,6 +61,9 @@ class PhotonMap {
        * @param gatherPhotons specifies the maximum number of photons to be 
        *    gathered during KNN (the maximum value of K)
        * @param gatherRadius specifies the maximum KNN search radius
+       * @param fixedRadius specifies whether irradiance estimates should 
+       *    gather all photons within @p gatherRadius instead of the 
+       *    @p gatherPhotons nearest photons
        * 
        * @note
        *    As gatherPhotons -> infinity and gatherRadius -> zero, the 
@@ -50,7 +73,8 @@ class PhotonMap {
        * that the estimated value only converges to the true value in the 
        * limit as the number of samples -> infinity
        */
-      PhotonMap(unsigned gatherPhotons, real_t gatherRadius = INFINITY);
+      PhotonMap(unsigned gatherPhotons, real_t gatherRadius = INFINITY, 
+                bool fixedRadius = false);
       
       
       //@}-----------------------------------------------------------------
@@ -74,14 +98,15 @@ class PhotonMap {
       
       /**
        * @brief
-       *    Builds the underlying kd-Tree of photons
+       *    Builds the underlying kd-Tree of photons, balancing disjoint 
+       * subtrees on up to @p noThreads threads
        * 
        * @note
        *    All photons should be added via 'addPhoton' before calling init, 
        * and 'addPhoton' should not be called again after initializing the 
        * kd-Tree
        */
-      void init();
+      void init(unsigned noThreads = 1);
       
       
       //@}-----------------------------------------------------------------
@@ -116,10 +141,29 @@ class PhotonMap {
       unsigned getKNN(const Point3 &pos, const Photon ***neighbors, 
                       real_t *radius) const;
       
+      /**
+       * @brief
+       *    Finds all photons within @p radius of the given point @p pos, 
+       * which is considerably cheaper than a KNN search for large K since 
+       * no heap of candidates needs to be maintained
+       * 
+       * @returns the number of photons found
+       * @returns an array of pointers to photons in @p neighbors
+       * @returns an array of the corresponding squared distances in 
+       *    @p dist2
+       * 
+       * @note
+       *    getInRadius is thread-safe, and the same caveats apply to the 
+       * returned arrays as those returned by getKNN
+       */
+      unsigned getInRadius(const Point3 &pos, real_t radius, 
+                           const Photon ***neighbors, 
+                           const real_t **dist2) const;
+      
       /**
        * @returns an estimate of the irradiance at the given SurfacePoint with 
        *    respect to the type of illumination represented by the underlying 
-       *    photons
+       *    photons, gathered either via KNN or a fixed-radius search
        */
       SpectralSampleSet getIrradiance(const SurfacePoint &pt) const;
       
@@ -156,6 +200,13 @@ class PhotonMap {
          return m_gatherRadius;
       }
       
+      /**
+       * @returns whether irradiance estimates use a fixed-radius search
+       */
+      inline bool isFixedRadius() const {
+         return m_fixedRadius;
+      }
+      
       /**
        * @returns a list containing the underlying photons stored in this map
        */
@@ -192,22 +243,47 @@ class PhotonMap {
       ///@name Internal kd-Tree construction and KNN
       //@{-----------------------------------------------------------------
       
-      void _balance(Photon **pbal, Photon **porg, unsigned index, 
-                   unsigned start, unsigned end, AABB &bb);
+      void _balance(Photon **porg, unsigned index, unsigned start, 
+                    unsigned end, AABB &bb, unsigned noThreads = 1);
       void _median_split(Photon **p, unsigned start, unsigned end, 
                         unsigned median, unsigned axis);
-      void _k_nearest_photons(unsigned index, NearestPhotons *np) const;
+      
+      /// visits every bucket within range of the given gatherer
+      template <class Gatherer>
+      void _search(const Point3 &pos, Gatherer &gatherer) const;
+      
+      /// passes all photons in [begin, end) within range of the given 
+      /// gatherer on to it
+      template <class Gatherer>
+      inline void _searchBucket(unsigned begin, unsigned end, 
+                                const float *pos, Gatherer &gatherer) const;
       
       
       //@}-----------------------------------------------------------------
       
+      friend class photonBalanceThread;
+      
    private:
-      PhotonList m_photons;
+      PhotonList         m_photons;
+      
+      /// photon positions in tree order (padded to a multiple of the SIMD 
+      /// width), where index i corresponds to m_photons[i]
+      std::vector<float> m_x;
+      std::vector<float> m_y;
+      std::vector<float> m_z;
+      
+      /// interior nodes of the tree, where node i has children 2i and 
+      /// 2i + 1, and nodes [m_noBuckets, 2 * m_noBuckets) are leaves
+      photonKdNodeList   m_nodes;
+      
+      /// the photons in bucket i are m_photons[m_buckets[i], m_buckets[i + 1])
+      std::vector<unsigned> m_buckets;
+      unsigned           m_noBuckets;
       
-      unsigned   m_gatherPhotons;
-      real_t     m_gatherRadius;
-      unsigned   m_halfPhotons;
-      unsigned   m_size;
+      unsigned           m_gatherPhotons;
+      real_t             m_gatherRadius;
+      bool               m_fixedRadius;
+      unsigned           m_size;
 };
 
 #endif // PHOTON_MAP_H_
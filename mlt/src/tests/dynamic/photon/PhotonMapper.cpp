@@ -11,6 +11,16 @@
    photon map. Final gathering is then performed by tracing paths from the eye 
    and using photons from the photon map to approximate irradiance at points 
    in the scene.
+      Photons are traced in parallel on 'noRenderThreads' worker threads, 
+   each of which emits a contiguous range of photon paths into its own 
+   buffer.  Every photon path is traced from its own random stream, seeded 
+   by its emission index, and the buffers are merged in emission order, s.t. 
+   the resulting photon maps don't depend on the number of threads.
+      If 'irradianceCache' is enabled, the diffuse photon map is only used 
+   for a final gather step, where the indirect illumination at the first 
+   diffuse surface seen from the eye is interpolated from an IrradianceCache 
+   whose records are computed by gathering the direct, caustic, and diffuse 
+   photon map estimates at the surfaces seen from each record.
     
    @see Photon
    @see PhotonMap
@@ -19,12 +29,13 @@
    <!-------------------------------------------------------------------->**/
 
 #include "PhotonMapper.h"
-#include "PhotonTracer.h"
 #include "PhotonMap.h"
 #include <renderers/utils/Path.h>
 
 #include <renderers/DirectIllumination.h>
+#include <renderers/RenderOutput.h>
 #include <utils/ResourceManager.h>
+#include <utils/System.h>
 #include <core/SurfacePoint.h>
 #include <materials/Material.h>
 #include <cameras/Camera.h>
@@ -32,10 +43,46 @@
 #include <core/Ray.h>
 #include <QtCore>
 
+// minimum number of photon paths emitted by each thread per batch
+#define PHOTON_MIN_BATCH_SIZE (256)
+
+/**
+ * @brief 
+ *    Worker thread which traces a contiguous range of photon paths
+ * 
+ * @see PhotonMapper::_tracePhotons
+ */
+class photonTraceThread : public QThread {
+   public:
+      inline photonTraceThread(PhotonMapper *mapper, bool caustic, 
+                               unsigned begin, unsigned end)
+         : QThread(), m_mapper(mapper), m_caustic(caustic), 
+           m_begin(begin), m_end(end)
+      { }
+      
+      virtual ~photonTraceThread()
+      { }
+      
+      virtual void run() {
+         m_mapper->_tracePhotons(m_caustic, m_begin, m_end, 
+                                 m_photons, m_ends);
+      }
+   
+   public:
+      PhotonMapper         *m_mapper;
+      bool                  m_caustic;
+      unsigned              m_begin;
+      unsigned              m_end;
+      
+      PhotonList            m_photons;
+      std::vector<unsigned> m_ends;
+};
+
 PhotonMapper::~PhotonMapper() {
    safeDelete(m_photonTracer);
    safeDelete(m_diffusePhotonMap);
    safeDelete(m_causticPhotonMap);
+   safeDelete(m_irradianceCache);
 }
 
 void PhotonMapper::init() {
@@ -53,10 +100,20 @@ void PhotonMapper::init() {
          const real_t causticGatherRadius = 
             getValue<real_t>("causticGatherRadius", 50.0);
          
+         // whether to gather all photons within the gather radius instead 
+         // of the K nearest photons, which avoids maintaining a heap of 
+         // candidates when K is large
+         const bool diffuseFixedRadius = 
+            getValue<bool>("diffuseFixedRadius", false);
+         const bool causticFixedRadius = 
+            getValue<bool>("causticFixedRadius", false);
+         
          m_diffusePhotonMap = 
-            new PhotonMap(diffuseNoGatherPhotons, diffuseGatherRadius);
+            new PhotonMap(diffuseNoGatherPhotons, diffuseGatherRadius, 
+                          diffuseFixedRadius);
          m_causticPhotonMap = 
-            new PhotonMap(causticNoGatherPhotons, causticGatherRadius);
+            new PhotonMap(causticNoGatherPhotons, causticGatherRadius, 
+                          causticFixedRadius);
          
          m_photonTracer     = new PhotonTracer();
       }
@@ -66,15 +123,74 @@ void PhotonMapper::init() {
       }
       
       { // build kd-Trees
+         unsigned noThreads = 
+            getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+         noThreads += (noThreads == 0);
+         
          cerr << "building kd-Tree for " << 
             m_diffusePhotonMap->size() << " diffuse photons" << endl;
-         m_diffusePhotonMap->init();
+         m_diffusePhotonMap->init(noThreads);
          
          cerr << "building kd-Tree for " << 
             m_causticPhotonMap->size() << " caustic photons" << endl;
-         m_causticPhotonMap->init();
+         m_causticPhotonMap->init(noThreads);
       }
+      
+      m_irradianceCache = IrradianceCache::create(*this, m_scene);
+   }
+}
+
+void PhotonMapper::render() {
+   ASSERT(m_output);
+   
+   if (!m_initted)
+      init();
+   
+   if (m_irradianceCache && 
+       getValue<bool>("irradianceCachePrecompute", false))
+   {
+      m_output->setParent(this);
+      m_output->init();
+      
+      const Viewport &viewport = m_output->getViewport();
+      const unsigned stride    = 
+         getValue<unsigned>("irradianceCachePrecomputeStride", 4u);
+      unsigned noThreads = 
+         getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+      noThreads += (noThreads == 0);
+      
+      cerr << "precomputing irradiance cache" << endl;
+      m_irradianceCache->precompute(m_camera, m_scene, this, 
+                                    viewport.getWidth(), 
+                                    viewport.getHeight(), 
+                                    MAX(stride, 1u), noThreads);
+      
+      cerr << "irradiance cache holds " << m_irradianceCache->size() 
+           << " records" << endl;
    }
+   
+   RayTracer::render();
+}
+
+real_t PhotonMapper::getIncidentRadiance(const Ray &ray, 
+                                         SpectralSampleSet &outLi)
+{
+   SurfacePoint pt;
+   const real_t t = m_scene->getIntersection(ray, pt);
+   
+   outLi = SpectralSampleSet::black();
+   
+   // note: gather rays which land on specular surfaces are ignored, since 
+   // caustics at the record's position are already estimated separately 
+   // from the caustic photon map
+   if (!pt.init(ray, t) || pt.bsdf->isSpecular())
+      return t;
+   
+   outLi += m_directIllumination->evaluate(pt);
+   outLi += m_causticPhotonMap->getIrradiance(pt);
+   outLi += m_diffusePhotonMap->getIrradiance(pt);
+   
+   return t;
 }
 
 void PhotonMapper::_tracePhotons() {
@@ -83,21 +199,17 @@ void PhotonMapper::_tracePhotons() {
    const unsigned causticNoPhotons = 
       getValue<unsigned>("causticNoPhotons", 60000);
    
-   unsigned diffuseNoEmitted = 0;
-   unsigned causticNoEmitted = 0;
+   unsigned noThreads = 
+      getValue<unsigned>("noRenderThreads", System::getNoCPUs());
+   noThreads += (noThreads == 0);
    
    cerr << "tracing " << diffuseNoPhotons << " diffuse photons" << endl;
-   while(diffuseNoEmitted < diffuseNoPhotons && m_diffusePhotonMap->size() < diffuseNoPhotons) {
-      _tracePhoton(false);
-      ++diffuseNoEmitted;
-   }
+   const unsigned diffuseNoEmitted = 
+      _tracePhotons(m_diffusePhotonMap, false, diffuseNoPhotons, noThreads);
    
    cerr << "tracing " << causticNoPhotons << " caustic photons" << endl;
-   while(causticNoEmitted < causticNoPhotons && m_causticPhotonMap->size() < causticNoPhotons) {
-      _tracePhoton(true);
-      
-      ++causticNoEmitted;
-   }
+   const unsigned causticNoEmitted = 
+      _tracePhotons(m_causticPhotonMap, true, causticNoPhotons, noThreads);
    
    // normalize photon powers
    m_diffusePhotonMap->scalePhotonPower(1.0 / diffuseNoEmitted);
@@ -107,25 +219,116 @@ void PhotonMapper::_tracePhotons() {
    //m_causticPhotonMap->save("caustic.png", m_camera);
 }
 
-void PhotonMapper::_tracePhoton(bool caustic) {
+unsigned PhotonMapper::_tracePhotons(PhotonMap *photonMap, bool caustic, 
+                                     unsigned noPhotons, unsigned noThreads)
+{
+   ASSERT(photonMap);
+   ASSERT(noThreads > 0);
+   
+   unsigned noEmitted = 0;
+   
+   // emit photon paths in batches until the photon map is full; each batch 
+   // is sized according to the number of photons stored per path thus far 
+   // s.t. little work is wasted on paths beyond the last one needed
+   while(noEmitted < noPhotons && photonMap->size() < noPhotons) {
+      const unsigned remaining = noPhotons - photonMap->size();
+      unsigned batchSize = remaining;
+      
+      if (photonMap->size() > 0) {
+         batchSize = (unsigned) ceil(((double) remaining) * noEmitted / 
+                                     photonMap->size());
+      }
+      
+      batchSize = MAX(batchSize, noThreads * PHOTON_MIN_BATCH_SIZE);
+      batchSize = MIN(batchSize, noPhotons - noEmitted);
+      
+      std::vector<photonTraceThread*> threads;
+      
+      for(unsigned i = 0; i < noThreads; ++i) {
+         const unsigned begin = noEmitted + (batchSize * i) / noThreads;
+         const unsigned end   = noEmitted + (batchSize * (i + 1)) / noThreads;
+         
+         photonTraceThread *thread = 
+            new photonTraceThread(this, caustic, begin, end);
+         threads.push_back(thread);
+         
+         if (noThreads > 1)
+            thread->start();
+         else
+            thread->run();
+      }
+      
+      // merge photon paths in emission order, stopping at the same path 
+      // sequential emission would have, s.t. the result is deterministic
+      for(unsigned i = 0; i < noThreads; ++i) {
+         photonTraceThread *thread = threads[i];
+         
+         if (noThreads > 1)
+            while(!thread->wait());
+         
+         unsigned begin = 0;
+         
+         FOREACH(std::vector<unsigned>::const_iterator, thread->m_ends, 
+                 iter)
+         {
+            if (photonMap->size() >= noPhotons)
+               break;
+            
+            for(unsigned j = begin; j < *iter; ++j)
+               photonMap->addPhoton(thread->m_photons[j]);
+            
+            begin = *iter;
+            ++noEmitted;
+         }
+         
+         safeDelete(thread);
+      }
+   }
+   
+   return noEmitted;
+}
+
+void PhotonMapper::_tracePhotons(bool caustic, unsigned begin, unsigned end, 
+                                 PhotonList &outPhotons, 
+                                 std::vector<unsigned> &outEnds)
+{
+   // decorrelate diffuse and caustic photon paths with the same index
+   const unsigned baseSeed = (caustic ? ~Random::s_seed : Random::s_seed);
+   
+   outEnds.reserve(end - begin);
+   
+   for(unsigned i = begin; i < end; ++i) {
+      _tracePhoton(caustic, Random::getSubstreamSeed(baseSeed, i), outPhotons);
+      
+      outEnds.push_back(outPhotons.size());
+   }
+}
+
+void PhotonMapper::_tracePhoton(bool caustic, unsigned seed, 
+                                PhotonList &outPhotons)
+{
    //const std::string &pathNotation = (caustic ? "LS+D" : "LD+");
    Path path(this);
    
+   Random::Generator generator(seed);
+   Random::Generator *oldGenerator = Random::getThreadGenerator();
+   
+   // trace from a private stream s.t. this photon path is reproducible 
+   // regardless of which thread traces it
+   Random::setThreadGenerator(&generator);
    m_photonTracer->generateL(path, caustic);//pathNotation);
+   Random::setThreadGenerator(oldGenerator);
    
    if (path.length() <= 2)
       return;
    
-   PhotonMap *photonKdTree = 
-      (caustic ? m_causticPhotonMap : m_diffusePhotonMap);
-   
    for(unsigned i = 2; i < path.length(); ++i) {
       const PathVertex &v = path[i];
       
       if (!v.bsdf->isSpecular()) {
          Photon p(v.pt->position, -v.wi, v.alphaL);
          
-         photonKdTree->addPhoton(p);
+         outPhotons.push_back(p);
       }
    }
 }
@@ -184,9 +387,15 @@ void PhotonMapper::_evaluate(const Ray &ray, SpectralSampleSet &outRadiance,
       // LS+DE
       outRadiance += m_causticPhotonMap->getIrradiance(pt);
       
-      // compute indirect illumination
+      // compute indirect illumination, either via a final gather from the 
+      // irradiance cache or directly from the diffuse photon map
       // LD+DE
-      outRadiance += m_diffusePhotonMap->getIrradiance(pt);
+      if (m_irradianceCache && IrradianceCache::isApplicable(pt)) {
+         outRadiance += pt.bsdf->evaluate(pt.normalS) * 
+            m_irradianceCache->evaluate(pt.position, pt.normalS, this);
+      } else {
+         outRadiance += m_diffusePhotonMap->getIrradiance(pt);
+      }
    }
 }
 
@@ -11,6 +11,16 @@
    photon map. Final gathering is then performed by tracing paths from the eye 
    and using photons from the photon map to approximate irradiance at points 
    in the scene.
+      Photons are traced in parallel on 'noRenderThreads' worker threads, 
+   each of which emits a contiguous range of photon paths into its own 
+   buffer.  Every photon path is traced from its own random stream, seeded 
+   by its emission index, and the buffers are merged in emission order, s.t. 
+   the resulting photon maps don't depend on the number of threads.
+      If 'irradianceCache' is enabled, the diffuse photon map is only used 
+   for a final gather step, where the indirect illumination at the first 
+   diffuse surface seen from the eye is interpolated from an IrradianceCache 
+   whose records are computed by gathering the direct, caustic, and diffuse 
+   photon map estimates at the surfaces seen from each record.
    
    @see Photon
    @see PhotonMap
@@ -22,11 +32,11 @@
 #define PHOTON_MAPPER_H_
 
 #include <renderers/renderers/RayTracer.h>
+#include <renderers/utils/PhotonTracer.h>
+#include <renderers/utils/IrradianceCache.h>
+#include <PhotonMap.h>
 
-class PhotonTracer;
-class PhotonMap;
-
-class PhotonMapper : public RayTracer {
+class PhotonMapper : public RayTracer, public IIrradianceSampler {
    public:
       ///@name Constructors
       //@{-----------------------------------------------------------------
@@ -35,7 +45,8 @@ class PhotonMapper : public RayTracer {
                           Camera *camera = NULL, 
                           Scene *scene = NULL)
          : RayTracer(output, camera, scene), m_photonTracer(NULL), 
-           m_diffusePhotonMap(NULL), m_causticPhotonMap(NULL)
+           m_diffusePhotonMap(NULL), m_causticPhotonMap(NULL), 
+           m_irradianceCache(NULL)
       { }
       
       virtual ~PhotonMapper();
@@ -52,6 +63,24 @@ class PhotonMapper : public RayTracer {
       virtual void init();
       
       
+      //@}-----------------------------------------------------------------
+      ///@name Main usage interface
+      //@{-----------------------------------------------------------------
+      
+      /**
+       * @brief 
+       *    Populates the irradiance cache if 'irradianceCachePrecompute' is 
+       * enabled before rendering the underlying scene synchronously
+       */
+      virtual void render();
+      
+      /// final gather step, which estimates the radiance incident along 
+      /// sampling rays used to compute new irradiance cache records from 
+      /// the photon maps
+      virtual real_t getIncidentRadiance(const Ray &ray, 
+                                         SpectralSampleSet &outLi);
+      
+      
       //@}-----------------------------------------------------------------
       
    protected:
@@ -60,7 +89,30 @@ class PhotonMapper : public RayTracer {
       
       virtual void _tracePhotons();
       
-      virtual void _tracePhoton(bool caustic = false);
+      /**
+       * @brief
+       *    Emits photon paths into @p photonMap until either @p noPhotons 
+       * paths have been emitted or the map holds @p noPhotons photons
+       * 
+       * @returns the number of photon paths emitted
+       */
+      virtual unsigned _tracePhotons(PhotonMap *photonMap, bool caustic, 
+                                     unsigned noPhotons, unsigned noThreads);
+      
+      /**
+       * @brief
+       *    Emits the photon paths with indices in [begin, end), appending 
+       * their photons to @p outPhotons and, for each path, the size of 
+       * @p outPhotons after it was traced to @p outEnds
+       * 
+       * @note thread-safe
+       */
+      virtual void _tracePhotons(bool caustic, unsigned begin, unsigned end, 
+                                 PhotonList &outPhotons, 
+                                 std::vector<unsigned> &outEnds);
+      
+      virtual void _tracePhoton(bool caustic, unsigned seed, 
+                                PhotonList &outPhotons);
       
       
       //@}-----------------------------------------------------------------
@@ -73,10 +125,13 @@ class PhotonMapper : public RayTracer {
       
       //@}-----------------------------------------------------------------
       
+      friend class photonTraceThread;
+      
    protected:
-      PhotonTracer *m_photonTracer;
-      PhotonMap    *m_diffusePhotonMap;
-      PhotonMap    *m_causticPhotonMap;
+      PhotonTracer    *m_photonTracer;
+      PhotonMap       *m_diffusePhotonMap;
+      PhotonMap       *m_causticPhotonMap;
+      IrradianceCache *m_irradianceCache;
 };
 
 #endif // PHOTON_MAPPER_H_
@@ -0,0 +1,173 @@
+/**<!-------------------------------------------------------------------->
+   @file   main.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Verifies PhotonMap's bucketed kd-Tree queries (getKNN and getInRadius) 
+   against brute-force searches over the same photons, for maps of various 
+   sizes which are balanced on one or more threads.
+   <!-------------------------------------------------------------------->**/
+
+#include <milton.h>
+#include <iostream>
+#include <cstdlib>
+using namespace std;
+using namespace milton;
+
+// note: the photon plugin's headers expect milton's namespace to be in use
+#include <PhotonMap.h>
+
+#define NO_TEST_QUERIES       (256)
+
+/// relative tolerance on squared distances, since the map stores photon 
+/// positions in single precision
+#define DIST2_TOLERANCE       (1e-4)
+
+/// @returns a uniform random real_t in [0, 1)
+static inline real_t randomReal() {
+   return create_real(rand()) / (create_real(RAND_MAX) + 1);
+}
+
+/// @returns a random point in [-1, 1]^3, clustered s.t. the tree is 
+///    unevenly populated
+static Point3 randomPoint() {
+   const real_t s = (rand() & 1 ? 1 : 0.05);
+   
+   return Point3(s * (2 * randomReal() - 1), s * (2 * randomReal() - 1), 
+                 s * (2 * randomReal() - 1));
+}
+
+/// @returns the squared distances from @p pos to all photons in @p map 
+///    in ascending order
+static std::vector<real_t> brute_force(const PhotonMap &map, 
+                                       const Point3 &pos)
+{
+   const PhotonList &photons = map.getPhotons();
+   std::vector<real_t> dist2;
+   
+   // note: photon 0 is unused
+   for(unsigned i = 1; i <= map.size(); ++i)
+      dist2.push_back((photons[i].position - pos).getMagnitude2());
+   
+   std::sort(dist2.begin(), dist2.end());
+   return dist2;
+}
+
+/// @returns whether @p a and @p b are equal up to DIST2_TOLERANCE
+static inline bool dist2_equal(real_t a, real_t b) {
+   return (fabs(a - b) <= DIST2_TOLERANCE * MAX(create_real(1e-6), b));
+}
+
+/// @returns the number of KNN and fixed-radius queries on @p map which 
+///    disagree with a brute-force search
+static unsigned test_queries(const PhotonMap &map, real_t radius) {
+   unsigned noErrors = 0;
+   
+   for(unsigned q = NO_TEST_QUERIES; q--;) {
+      const Point3 &pos = randomPoint();
+      const std::vector<real_t> &expected = brute_force(map, pos);
+      
+      // the brute-force results which lie within the gather radius
+      const real_t   maxDist2 = map.getGatherRadius() * map.getGatherRadius();
+      const unsigned noInGatherRadius = (unsigned) (std::upper_bound(
+         expected.begin(), expected.end(), maxDist2) - expected.begin());
+      
+      { // KNN should find the K nearest photons within the gather radius
+         const Photon **neighbors = NULL;
+         real_t knnRadius = 0;
+         
+         const unsigned n = map.getKNN(pos, &neighbors, &knnRadius);
+         std::vector<real_t> found(n);
+         
+         for(unsigned i = 0; i < n; ++i)
+            found[i] = (neighbors[i]->position - pos).getMagnitude2();
+         
+         std::sort(found.begin(), found.end());
+         
+         const unsigned k = MIN(map.getGatherPhotons(), noInGatherRadius);
+         bool valid = (n == k || (n == k + 1 && n <= map.getGatherPhotons() 
+                                  && dist2_equal(found[k], maxDist2)));
+         
+         for(unsigned i = 0; valid && i < MIN(n, k); ++i)
+            valid = dist2_equal(found[i], expected[i]);
+         
+         if (valid && n > 0)
+            valid = (knnRadius * knnRadius >= found[n - 1] * (1 - DIST2_TOLERANCE));
+         
+         if (!valid && noErrors++ < 4) {
+            cerr << "   KNN mismatch at " << pos << ": found " << n 
+                 << " photons, expected " << k << endl;
+         }
+      }
+      
+      { // getInRadius should find every photon within the given radius
+         const Photon **neighbors = NULL;
+         const real_t *dist2 = NULL;
+         
+         const unsigned n = map.getInRadius(pos, radius, &neighbors, &dist2);
+         const real_t   r2 = radius * radius;
+         
+         // photons within tolerance of the boundary may go either way
+         const unsigned lo = (unsigned) (std::upper_bound(expected.begin(), 
+            expected.end(), r2 * (1 - DIST2_TOLERANCE)) - expected.begin());
+         const unsigned hi = (unsigned) (std::upper_bound(expected.begin(), 
+            expected.end(), r2 * (1 + DIST2_TOLERANCE)) - expected.begin());
+         
+         bool valid = (n >= lo && n <= hi);
+         
+         for(unsigned i = 0; valid && i < n; ++i) {
+            const real_t d2 = (neighbors[i]->position - pos).getMagnitude2();
+            
+            valid = (d2 <= r2 * (1 + DIST2_TOLERANCE) && 
+                     dist2_equal(dist2[i], d2));
+         }
+         
+         if (!valid && noErrors++ < 4) {
+            cerr << "   range mismatch at " << pos << ": found " << n 
+                 << " photons, expected " << lo << " to " << hi << endl;
+         }
+      }
+   }
+   
+   return noErrors;
+}
+
+/// @returns whether queries on a map of @p noPhotons random photons agree 
+///    with brute force for the given KNN parameters
+bool test_photon_map(unsigned noPhotons, unsigned gatherPhotons, 
+                     real_t gatherRadius, unsigned noThreads)
+{
+   PhotonMap map(gatherPhotons, gatherRadius);
+   
+   for(unsigned i = noPhotons; i--;)
+      map.addPhoton(Photon(randomPoint(), Vector3(0, 0, 1), 
+                           SpectralSampleSet::fill(1)));
+   
+   map.init(noThreads);
+   
+   const unsigned noErrors = test_queries(map, 0.1);
+   
+   cerr << noPhotons << " photons, K = " << gatherPhotons << ", radius = " 
+        << gatherRadius << ", " << noThreads << " thread(s): " 
+        << noErrors << " mismatches" << endl;
+   
+   return (0 == noErrors);
+}
+
+int main(int argc, char** argv) {
+   const unsigned sizes[] = { 0, 1, 15, 16, 17, 1000, 100000 };
+   bool passed = true;
+   
+   srand(0);
+   
+   for(unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      passed &= test_photon_map(sizes[i], 1,   INFINITY, 1);
+      passed &= test_photon_map(sizes[i], 50,  INFINITY, 1);
+      passed &= test_photon_map(sizes[i], 200, 0.05,     4);
+   }
+   
+   cerr << (passed ? "all tests passed" : "tests failed!") << endl;
+   return !passed;
+}
+
@@ -0,0 +1,172 @@
+/**<!-------------------------------------------------------------------->
+   @file   main.cpp
+   @author Travis Fischer (fisch0920@gmail.com)
+   @date   Spring 2009
+   
+   @brief
+      Benchmarks ReconstructionRenderOutput::addSample for each of the 
+   standard reconstruction filters, with and without the precomputed, 
+   separable filter tables (see KernelFilter::evaluateTable), and verifies 
+   that both paths reconstruct the same image. Also verifies KernelFilter's 
+   (separable, multithreaded) image convolution against a brute-force 2D 
+   convolution with each filter's kernel.
+   <!-------------------------------------------------------------------->**/
+
+#include <milton.h>
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+using namespace std;
+using namespace milton;
+
+#define NO_BENCH_SAMPLES      (1 << 20)
+#define BENCH_IMAGE_SIZE      (256)
+
+/// @returns a uniform random real_t in [0, 1)
+static inline real_t randomReal() {
+   return create_real(rand()) / (create_real(RAND_MAX) + 1);
+}
+
+/// @returns the number of seconds spent adding NO_BENCH_SAMPLES random 
+///    samples to a new ReconstructionRenderOutput, a copy of whose image is 
+///    returned in @p outImage
+double bench_filter(const std::string &type, unsigned support, bool table, 
+                    HDRImage *&outImage)
+{
+   PropertyMap params;
+   params["support"] = support;
+   
+   KernelFilter *filter = KernelFilter::create(type, params);
+   
+   ReconstructionRenderOutput output( 
+      new HDRImage(BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE), filter);
+   output["filterTable"] = table;
+   output.init();
+   
+   // use the same sequence of samples for both configurations
+   srand(0);
+   
+   const clock_t t0 = clock();
+   for(unsigned i = NO_BENCH_SAMPLES; i--;) {
+      PointSample sample(randomReal(), randomReal());
+      sample.value.setValue(SpectralSampleSet::fill(randomReal()));
+      
+      output.addSample(sample);
+   }
+   
+   const clock_t t1 = clock();
+   
+   outImage = new HDRImage(*((HDRImage *) output.getImage()));
+   return double(t1 - t0) / CLOCKS_PER_SEC;
+}
+
+/// @returns the maximum absolute difference between KernelFilter::apply and 
+///    a brute-force 2D convolution with the filter's kernel
+real_t test_apply(const std::string &type, unsigned support) {
+   PropertyMap params;
+   params["support"] = support;
+   params["noRenderThreads"] = 4u;
+   
+   KernelFilter *filter = KernelFilter::create(type, params);
+   filter->init();
+   
+   // large enough to be split into several bands of uneven height (see 
+   // KERNEL_FILTER_MIN_PIXELS_PER_THREAD), s.t. band boundaries are tested
+   const int width  = 389;
+   const int height = 257;
+   const int half   = (filter->getWidth() >> 1);
+   const real_t *kernel = filter->getKernel();
+   
+   HDRImage *image = new HDRImage(width, height);
+   for(int y = height; y--;) {
+      for(int x = width; x--;)
+         image->setPixel<RgbaHDR>(y, x, RgbaHDR(randomReal(), 0, 0));
+   }
+   
+   HDRImage *filtered = new HDRImage(*image);
+   const clock_t t0 = clock();
+   filter->apply(filtered);
+   const clock_t t1 = clock();
+   
+   real_t maxError = 0;
+   for(int i = height; i--;) {
+      for(int j = width; j--;) {
+         real_t sum = 0, value = 0;
+         
+         for(int y = -half; y <= half; ++y) {
+            for(int x = -half; x <= half; ++x) {
+               const int row = CLAMP(i + y, 0, height - 1);
+               const int col = CLAMP(j + x, 0, width  - 1);
+               const real_t weight = 
+                  kernel[(y + half) * filter->getWidth() + (x + half)];
+               
+               value += image->getPixel<RgbaHDR>(row, col).r * weight;
+               sum   += weight;
+            }
+         }
+         
+         const real_t error = 
+            ABS(value / sum - filtered->getPixel<RgbaHDR>(i, j).r);
+         maxError = MAX(maxError, error);
+      }
+   }
+   
+   cerr << "   apply:  " << double(t1 - t0) / CLOCKS_PER_SEC << "s" << endl;
+   
+   safeDelete(image);
+   safeDelete(filtered);
+   safeDelete(filter);
+   return maxError;
+}
+
+int main(int argc, char** argv) {
+   const char  *types[]    = { "box", "triangle", "gaussian", "mitchell", 
+                               "lanczosSinc" };
+   const unsigned supports[] = { 1, 2, 4 };
+   bool passed = true;
+   
+   for(unsigned i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+      for(unsigned j = 0; j < sizeof(supports) / sizeof(supports[0]); ++j) {
+         HDRImage *direct = NULL, *tabulated = NULL;
+         
+         const double directTime = 
+            bench_filter(types[i], supports[j], false, direct);
+         const double tableTime  = 
+            bench_filter(types[i], supports[j], true,  tabulated);
+         
+         real_t maxError = 0;
+         for(unsigned y = BENCH_IMAGE_SIZE; y--;) {
+            for(unsigned x = BENCH_IMAGE_SIZE; x--;) {
+               const RgbaHDR &a = direct->getPixel<RgbaHDR>(y, x);
+               const RgbaHDR &b = tabulated->getPixel<RgbaHDR>(y, x);
+               
+               maxError = MAX(maxError, ABS(a.r - b.r));
+            }
+         }
+         
+         cerr << types[i] << " (support " << supports[j] << "):" << endl 
+              << "   direct: " << NO_BENCH_SAMPLES / directTime 
+              << " samples/s" << endl 
+              << "   table:  " << NO_BENCH_SAMPLES / tableTime 
+              << " samples/s" << endl 
+              << "   max abs error: " << maxError << endl;
+         
+         passed &= (maxError < 1e-2);
+         
+         safeDelete(direct);
+         safeDelete(tabulated);
+         
+         // note: the discrete box kernel with a support of one is empty
+         if (supports[j] > 1) {
+            const real_t applyError = test_apply(types[i], supports[j]);
+            
+            cerr << "   apply max abs error: " << applyError << endl;
+            passed &= (applyError < 1e-6);
+         }
+      }
+   }
+   
+   cerr << (passed ? "all tests passed" : "tests failed!") << endl;
+   return !passed;
+}
+
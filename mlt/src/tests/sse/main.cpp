@@ -4,24 +4,56 @@
    @date   Fall 2008
    
    @brief
-      Tests stability and accuracy of SSE linear algebra library
+      Tests stability and accuracy of SSE linear algebra library, as well as 
+   the correctness and relative performance of the SIMD matrix-vector 
+   kernels selected via MILTON_SIMD (see common/math/simd/MatrixSIMD.inl)
    <!-------------------------------------------------------------------->**/
 
 #include <common/math/algebra.h>
 #include <iostream>
+#include <cstdlib>
+#include <ctime>
 using namespace std;
 using namespace milton;
 
 void test_alignment();
 void test_math();
+void test_transform();
+void bench_transform();
 
 #define TEST_EQ(a, b)   (EQ((create_real(a)), (create_real(b))))
 
+// number of failed checks; unlike ASSERT, CHECK isn't compiled out in 
+// release (NDEBUG) builds
+static unsigned s_noFailures = 0;
+
+#define CHECK(expr)                                                     \
+   do {                                                                 \
+      if (!(expr)) {                                                    \
+         cerr << __FILE__ << ":" << __LINE__ << ": check failed: "      \
+              << #expr << endl;                                         \
+         ++s_noFailures;                                                \
+      }                                                                 \
+   } while(0)
+
 int main(int argc, char** argv) {
-#if MILTON_ENABLE_SEE
+#if MILTON_ENABLE_SSE
    test_alignment();
    test_math();
+#endif
+
+#if (MILTON_SIMD != MILTON_SIMD_NONE)
+   test_transform();
+   bench_transform();
+#endif
+
+#if MILTON_ENABLE_SSE || (MILTON_SIMD != MILTON_SIMD_NONE)
+   if (s_noFailures > 0) {
+      cerr << s_noFailures << " checks failed!" << endl;
+      return 1;
+   }
    
+   cerr << "all tests passed" << endl;
    return 0;
 #else
    cerr << "SSE was not enabled in this build!" << endl;
@@ -44,7 +76,7 @@ void test_alignment() {
    for(unsigned i = 0; i < 99999; ++i) {
       Vector3 *v = new Vector3(i, i, i);
       
-      ASSERT((((unsigned long)v) & 15) == 0);
+      CHECK((((unsigned long)v) & 15) == 0);
       safeDelete(v);
    }
    
@@ -58,12 +90,12 @@ void test_alignment() {
       
       cerr << a << ", " << b << ", " << c << ", " << d << ", " << e << ", " << f << endl;
       
-      ASSERT((((unsigned long)&a) & 15) == 0);
-      ASSERT((((unsigned long)&b) & 15) == 0);
-      ASSERT((((unsigned long)&c) & 15) == 0);
-      ASSERT((((unsigned long)&d) & 15) == 0);
-      ASSERT((((unsigned long)&e) & 15) == 0);
-      ASSERT((((unsigned long)&f) & 15) == 0);
+      CHECK((((unsigned long)&a) & 15) == 0);
+      CHECK((((unsigned long)&b) & 15) == 0);
+      CHECK((((unsigned long)&c) & 15) == 0);
+      CHECK((((unsigned long)&d) & 15) == 0);
+      CHECK((((unsigned long)&e) & 15) == 0);
+      CHECK((((unsigned long)&f) & 15) == 0);
    }
    
    { // test compound alignment
@@ -78,7 +110,7 @@ void test_alignment() {
    for(unsigned i = 0; i < 99999; ++i) {
       Test *t = new Test();
       
-      ASSERT((((unsigned long)t) & 15) == 0);
+      CHECK((((unsigned long)t) & 15) == 0);
       safeDelete(t);
    }
 }
@@ -88,87 +120,87 @@ void test_math() {
    real_t d0[] = { 0.1, 2.1, -3.9999 };
    
    Vector3 v0(d0);
-   for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v0[i], d0[i]));
+   for(unsigned i = 3; i--;) CHECK(TEST_EQ(v0[i], d0[i]));
    
    Vector3 v1;
-   for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v1[i], 0));
-   ASSERT(v1.isZero());
+   for(unsigned i = 3; i--;) CHECK(TEST_EQ(v1[i], 0));
+   CHECK(v1.isZero());
    
    real_t d2[] = { -77, 0.003, 40 };
    Vector3 v2(d2[0], d2[1], d2[2]);
-   for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v2[i], d2[i]));
+   for(unsigned i = 3; i--;) CHECK(TEST_EQ(v2[i], d2[i]));
    
    Vector3 v3(v2);
-   for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v3[i], v2[i]));
-   ASSERT(v2 == v3);
+   for(unsigned i = 3; i--;) CHECK(TEST_EQ(v3[i], v2[i]));
+   CHECK(v2 == v3);
    
    { // equality / assignment operators
       Vector3 v4 = v2;
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v4[i], v2[i]));
-      ASSERT(v4 == v2);
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v4[i], v2[i]));
+      CHECK(v4 == v2);
       
-      ASSERT(v0 != v1);
+      CHECK(v0 != v1);
       v4[2] = 41;
-      ASSERT(v4 != v2);
+      CHECK(v4 != v2);
       v4[2] = 40;
-      ASSERT(v4 == v2);
+      CHECK(v4 == v2);
    }
    
    { // test static factory constructors
       Vector3 v4 = Vector3::zero();
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v4[i], 0));
-      ASSERT(v4.isZero());
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v4[i], 0));
+      CHECK(v4.isZero());
       
       Vector3 v5 = Vector3::ones();
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v5[i], 1));
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v5[i], 1));
       
       Vector3 v6 = Vector3::min(v2, v2);
-      ASSERT(v6 == v2);
+      CHECK(v6 == v2);
       
       Vector3 v7 = Vector3::min(v4, v5);
-      ASSERT(v7 == v4);
+      CHECK(v7 == v4);
       
       Vector3 v8 = Vector3::max(v4, v5);
-      ASSERT(v8 == v5);
+      CHECK(v8 == v5);
    }
    
    { // test arithmetic assignment operators
       Vector3 v4 = v0;
       v4 += Vector3::fill(1);
-      ASSERT(v4 - Vector3::fill(1) == v0);
+      CHECK(v4 - Vector3::fill(1) == v0);
       
       v4 -= Vector3::fill(1);
-      ASSERT(v4 == v0);
+      CHECK(v4 == v0);
       
       v4 *= -1;
-      ASSERT(v4 == -v0);
+      CHECK(v4 == -v0);
       
       v4 /= -1;
-      ASSERT(v4 == v0);
+      CHECK(v4 == v0);
       
       v4 /= 2;
       v0 *= 0.5;
       
-      ASSERT(v4 == v0);
+      CHECK(v4 == v0);
    }
    
    { // test arithmetic operators
       Vector3 v4 = v0 + v2;
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v4[i], v0[i] + v2[i]));
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v4[i], v0[i] + v2[i]));
       
       Vector3 v5 = v0 - v2;
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v5[i], v0[i] - v2[i]));
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v5[i], v0[i] - v2[i]));
       
       Vector3 v6 = v0 * v2;
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v6[i], v0[i] * v2[i]));
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v6[i], v0[i] * v2[i]));
       
       Vector3 v7 = v0 * M_PI;
-      for(unsigned i = 3; i--;) ASSERT(TEST_EQ(v7[i], v0[i] * M_PI));
+      for(unsigned i = 3; i--;) CHECK(TEST_EQ(v7[i], v0[i] * M_PI));
       
       Vector3 v8 = v0 * -9999;
       for(unsigned i = 3; i--;) {
          const real_t d = v0[i] * -9999;
-         ASSERT(TEST_EQ(v8[i], d));
+         CHECK(TEST_EQ(v8[i], d));
       }
    }
    
@@ -182,18 +214,159 @@ void test_math() {
       real_t mag2 = v4.getMagnitude2();
       real_t mag  = v4.getMagnitude();
       
-      ASSERT(TEST_EQ(sqrt(mag2), mag));
-      ASSERT(TEST_EQ(s, mag));
+      CHECK(TEST_EQ(sqrt(mag2), mag));
+      CHECK(TEST_EQ(s, mag));
       
       const real_t t0 = v4.normalize();
-      ASSERT(v4.isUnit());
-      ASSERT(TEST_EQ(t0, mag));
+      CHECK(v4.isUnit());
+      CHECK(TEST_EQ(t0, mag));
       
       const real_t t1 = v4.getMagnitude();
-      ASSERT(TEST_EQ(t1, 1));
+      CHECK(TEST_EQ(t1, 1));
       
       Vector3 v3 = v0.getNormalized();
-      ASSERT(v3.isUnit());
+      CHECK(v3.isUnit());
+   }
+}
+
+#if (MILTON_SIMD != MILTON_SIMD_NONE)
+
+#define NO_TRANSFORM_TESTS    (10000)
+#define NO_BENCH_ITERATIONS   (4000000)
+
+static inline real_t randomReal() {
+   return create_real(rand()) / RAND_MAX * 200 - 100;
+}
+
+static void randomMatrix(Matrix4x4 &m) {
+   for(unsigned i = 4; i--;)
+      for(unsigned j = 4; j--;)
+         m[i][j] = randomReal();
+}
+
+/// scalar reference implementation of the full 4x4 product
+static inline void scalarTransform4(const Matrix4x4 &m, const Point3 &p, 
+                                    Point3 &out)
+{
+   for(unsigned i = 4; i--;) {
+      out[i] = 0;
+      
+      for(unsigned j = 4; j--;)
+         out[i] += m[i][j] * p[j];
+   }
+}
+
+/// scalar reference implementation of the upper 3x3 product
+static inline void scalarTransform3(const Matrix4x4 &m, const Vector3 &v, 
+                                    Vector3 &out)
+{
+   for(unsigned i = 3; i--;) {
+      out[i] = 0;
+      
+      for(unsigned j = 3; j--;)
+         out[i] += m[i][j] * v[j];
    }
 }
 
+/// relative equality test, allowing for differing summation orders
+static inline bool closeEnough(real_t a, real_t b, real_t scale) {
+#if MILTON_SINGLE_PRECISION
+   return (ABS(a - b) <= 1e-4 * scale);
+#else
+   return (ABS(a - b) <= 1e-12 * scale);
+#endif
+}
+
+void test_transform() {
+   srand(1);
+   
+   Matrix4x4 m;
+   for(unsigned k = NO_TRANSFORM_TESTS; k--;) {
+      randomMatrix(m);
+      
+      const Point3  p(randomReal(), randomReal(), randomReal());
+      const Vector3 v(randomReal(), randomReal(), randomReal());
+      
+      Point3  pRef, pSIMD = m * p;
+      Vector3 vRef, vSIMD = m * v;
+      
+      scalarTransform4(m, p, pRef);
+      scalarTransform3(m, v, vRef);
+      
+      // products are bounded by 4 * 100 * 100
+      for(unsigned i = 4; i--;) {
+         if (!closeEnough(pSIMD[i], pRef[i], 40000)) {
+            cerr << "point mismatch: " << pSIMD << " vs " << pRef << endl;
+            ++s_noFailures;
+            break;
+         }
+      }
+      
+      for(unsigned i = 3; i--;) {
+         if (!closeEnough(vSIMD[i], vRef[i], 40000)) {
+            cerr << "vector mismatch: " << vSIMD << " vs " << vRef << endl;
+            ++s_noFailures;
+            break;
+         }
+      }
+   }
+   
+   { // affine transformations should preserve w = 1 for points
+      const Matrix4x4 &trans = getTransMat(Vector3(1, 2, 3)) * 
+         getRotMat(Point3(), Vector3(0, 1, 0), M_PI / 3) * 
+         getScaleMat(Vector3(2, 2, 2));
+      const Point3 &p = trans * Point3(1, 1, 1);
+      
+      CHECK(TEST_EQ(p[3], 1));
+   }
+   
+   cerr << "SIMD transform test ran (" << NO_TRANSFORM_TESTS 
+        << " random cases)" << endl;
+}
+
+void bench_transform() {
+   // rigid transformation s.t. repeated application remains bounded
+   const Matrix4x4 &m = getTransMat(Vector3(0.1, 0.2, 0.3)) * 
+      getRotMat(Point3(), Vector3(1, 1, 1).getNormalized(), 0.01);
+   
+   const Point3  p0(randomReal(), randomReal(), randomReal());
+   const Vector3 v0(randomReal(), randomReal(), randomReal());
+   
+   // feed each result back into the next iteration to prevent the compiler 
+   // from hoisting the transformations out of the loop
+   Point3  p = p0;
+   Vector3 v = v0;
+   
+   const clock_t t0 = clock();
+   for(unsigned i = NO_BENCH_ITERATIONS; i--;) {
+      p = m * p;
+      v = m * v;
+      
+      p[0] = p0[0]; v[0] = v0[0];
+   }
+   
+   const clock_t t1 = clock();
+   Point3  pRef = p0, pTemp;
+   Vector3 vRef = v0, vTemp;
+   
+   for(unsigned i = NO_BENCH_ITERATIONS; i--;) {
+      scalarTransform4(m, pRef, pTemp);
+      scalarTransform3(m, vRef, vTemp);
+      
+      pRef = pTemp; pRef[0] = p0[0];
+      vRef = vTemp; vRef[0] = v0[0];
+   }
+   
+   const clock_t t2 = clock();
+   const double simdTime   = double(t1 - t0) / CLOCKS_PER_SEC;
+   const double scalarTime = double(t2 - t1) / CLOCKS_PER_SEC;
+   
+   cerr << "SIMD transform benchmark (" << NO_BENCH_ITERATIONS 
+        << " iterations, backend " << MILTON_SIMD << "):" << endl 
+        << "   simd:   " << simdTime   << "s" << endl 
+        << "   scalar: " << scalarTime << "s" << endl 
+        << "   (checksum " << p[1] + v[1] + pRef[1] + vRef[1] << ")" << endl;
+}
+
+#endif // MILTON_SIMD != MILTON_SIMD_NONE
+